@@ -0,0 +1,169 @@
+// Copyright 2022 <Maros Varchola - mvarchdev>
+
+#include "bench.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "flappybird/common_tools.h"
+
+/// @brief Set when the first result of the JSON array has been written.
+static bool g_json_has_result = false;
+
+int bench_compare_double(const void *a, const void *b) {
+  double lhs = *(const double *)a;
+  double rhs = *(const double *)b;
+  return (lhs > rhs) - (lhs < rhs);
+}
+
+/// @brief Nearest-rank percentile of a sorted array
+/// @param sorted Values in ascending order
+/// @param count Number of values
+/// @param pct Percentile, 0 to 100
+/// @return Value at the percentile
+double bench_percentile(const double *sorted, int count, double pct) {
+  int rank = (int)ceil(pct / 100.0 * count);
+  if (rank < 1) {
+    rank = 1;
+  } else if (rank > count) {
+    rank = count;
+  }
+  return sorted[rank - 1];
+}
+
+static double median_of(const double *sorted, int count) {
+  if (count % 2 == 1) {
+    return sorted[count / 2];
+  }
+  return (sorted[count / 2 - 1] + sorted[count / 2]) / 2.0;
+}
+
+static long long time_iterations(const bench_case *bc, long iterations) {
+  long long start = timeInNanoseconds();
+  bc->run(bc->ctx, iterations);
+  return timeInNanoseconds() - start;
+}
+
+void bench_options_init(bench_options *opts) {
+  memset(opts, 0, sizeof(*opts));
+  opts->samples = BENCH_DEFAULT_SAMPLES;
+  opts->warmup = BENCH_DEFAULT_WARMUP;
+  opts->min_sample_ns = BENCH_MIN_SAMPLE_NS;
+  opts->max_lines = 1000000;
+  opts->out = stdout;
+}
+
+/// @brief Check if a case passes the name filter
+/// @param opts Options with optional substring filter
+/// @param name Case name
+/// @return True if the case should run
+bool bench_selected(const bench_options *opts, const char *name) {
+  return opts->filter == NULL || strstr(name, opts->filter) != NULL;
+}
+
+/// @brief Calibrate, warm up and measure a case
+/// @param opts Shared options
+/// @param bc Case to measure
+/// @return Per-operation statistics
+bench_result bench_measure(const bench_options *opts, const bench_case *bc) {
+  long iterations = 1;
+  while (bc->max_iterations == 0 || iterations < bc->max_iterations) {
+    if (time_iterations(bc, iterations) >= opts->min_sample_ns) {
+      break;
+    }
+    iterations *= 2;
+  }
+  if (bc->max_iterations > 0 && iterations > bc->max_iterations) {
+    iterations = bc->max_iterations;
+  }
+
+  for (int i = 0; i < opts->warmup; i++) {
+    time_iterations(bc, iterations);
+  }
+
+  int samples = bench_sample_count(opts);
+  double per_op[BENCH_MAX_SAMPLES];
+  for (int i = 0; i < samples; i++) {
+    per_op[i] = (double)time_iterations(bc, iterations) / (double)iterations;
+  }
+  return bench_summarize(per_op, samples, iterations);
+}
+
+/// @brief Number of samples to take, clamped to 1..BENCH_MAX_SAMPLES
+/// @param opts Shared options
+/// @return Sample count
+int bench_sample_count(const bench_options *opts) {
+  if (opts->samples < 1) {
+    return 1;
+  } else if (opts->samples > BENCH_MAX_SAMPLES) {
+    return BENCH_MAX_SAMPLES;
+  }
+  return opts->samples;
+}
+
+/// @brief Compute statistics of per-operation sample times
+/// @param per_op Sample times, sorted in place
+/// @param samples Number of samples
+/// @param iterations Iterations per sample
+/// @return Per-operation statistics
+bench_result bench_summarize(double *per_op, int samples, long iterations) {
+  bench_result result = {0};
+  qsort(per_op, (size_t)samples, sizeof(per_op[0]), bench_compare_double);
+
+  result.samples = samples;
+  result.iterations = iterations;
+  result.median_ns = median_of(per_op, samples);
+  result.min_ns = per_op[0];
+  result.max_ns = per_op[samples - 1];
+  result.p10_ns = bench_percentile(per_op, samples, 10);
+  result.p90_ns = bench_percentile(per_op, samples, 90);
+
+  double deviations[BENCH_MAX_SAMPLES];
+  for (int i = 0; i < samples; i++) {
+    deviations[i] = fabs(per_op[i] - result.median_ns);
+  }
+  qsort(deviations, (size_t)samples, sizeof(deviations[0]), bench_compare_double);
+  result.mad_ns = median_of(deviations, samples);
+  result.ops_per_sec = result.median_ns > 0 ? 1e9 / result.median_ns : 0;
+
+  return result;
+}
+
+/// @brief Measure a case and append it to the JSON report
+/// @param opts Shared options
+/// @param bc Case to run
+void bench_execute(const bench_options *opts, const bench_case *bc) {
+  if (!bench_selected(opts, bc->name)) {
+    return;
+  }
+
+  fprintf(stderr, "bench: %s %s\n", bc->name, bc->param ? bc->param : "");
+  bench_result res = bench_measure(opts, bc);
+  bench_report(opts, bc, &res);
+}
+
+/// @brief Print a measured case as one JSON result
+/// @param opts Shared options
+/// @param bc Measured case
+/// @param res Its statistics
+void bench_report(const bench_options *opts, const bench_case *bc, const bench_result *res) {
+  fprintf(opts->out, "%s\n    {\"name\": \"%s\", \"param\": \"%s\", \"samples\": %d, ",
+          g_json_has_result ? "," : "", bc->name, bc->param ? bc->param : "", res->samples);
+  fprintf(opts->out, "\"iterations\": %ld, \"median_ns\": %.1f, \"min_ns\": %.1f, ",
+          res->iterations, res->median_ns, res->min_ns);
+  fprintf(opts->out, "\"max_ns\": %.1f, \"p10_ns\": %.1f, \"p90_ns\": %.1f, \"mad_ns\": %.1f, ",
+          res->max_ns, res->p10_ns, res->p90_ns, res->mad_ns);
+  fprintf(opts->out, "\"ops_per_sec\": %.1f}", res->ops_per_sec);
+  fflush(opts->out);
+  g_json_has_result = true;
+}
+
+void bench_json_begin(const bench_options *opts) {
+  g_json_has_result = false;
+  fprintf(opts->out, "{\n  \"suite\": \"flappybird-microbench\",\n");
+  fprintf(opts->out, "  \"samples\": %d,\n  \"warmup\": %d,\n  \"results\": [", opts->samples,
+          opts->warmup);
+}
+
+void bench_json_end(const bench_options *opts) { fprintf(opts->out, "\n  ]\n}\n"); }
@@ -0,0 +1,74 @@
+// Copyright 2022 <Maros Varchola - mvarchdev>
+
+#ifndef FLAPPYBIRD_BENCH_H
+#define FLAPPYBIRD_BENCH_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+/// @brief Default number of measured samples per case.
+#define BENCH_DEFAULT_SAMPLES 15
+/// @brief Default number of discarded warm-up samples per case.
+#define BENCH_DEFAULT_WARMUP 3
+/// @brief Iterations per sample are raised until a sample takes at least this long.
+#define BENCH_MIN_SAMPLE_NS 2000000LL
+/// @brief Upper bound of measured samples.
+#define BENCH_MAX_SAMPLES 1000
+
+/// @brief Options shared by every benchmark case.
+typedef struct bench_options {
+  int samples;
+  int warmup;
+  long long min_sample_ns;
+  long max_lines;
+  const char *filter;
+  FILE *out;
+} bench_options;
+
+/// @brief One benchmarked operation.
+typedef struct bench_case {
+  const char *name;
+  const char *param;
+  /// Runs the operation the given number of times, this is the timed part.
+  void (*run)(void *ctx, long iterations);
+  void *ctx;
+  /// Upper bound of iterations per sample, 0 for no bound.
+  long max_iterations;
+} bench_case;
+
+/// @brief Statistics of one benchmark case, all times are per operation.
+typedef struct bench_result {
+  int samples;
+  long iterations;
+  double median_ns;
+  double min_ns;
+  double max_ns;
+  double p10_ns;
+  double p90_ns;
+  double mad_ns;
+  double ops_per_sec;
+} bench_result;
+
+void bench_options_init(bench_options *opts);
+bool bench_selected(const bench_options *opts, const char *name);
+bench_result bench_measure(const bench_options *opts, const bench_case *bc);
+int bench_sample_count(const bench_options *opts);
+bench_result bench_summarize(double *per_op, int samples, long iterations);
+int bench_compare_double(const void *a, const void *b);
+double bench_percentile(const double *sorted, int count, double pct);
+void bench_execute(const bench_options *opts, const bench_case *bc);
+void bench_report(const bench_options *opts, const bench_case *bc, const bench_result *res);
+void bench_json_begin(const bench_options *opts);
+void bench_json_end(const bench_options *opts);
+
+void bench_confparser_suite(const bench_options *opts);
+void bench_game_suite(const bench_options *opts);
+void bench_vterm_suite(const bench_options *opts);
+bool bench_write_config(const char *path, long lines);
+
+int perf_write_baseline(const bench_options *opts, const char *path);
+int perf_check(const bench_options *opts, const char *path);
+
+int stress_persist(const bench_options *opts, int instances, int rounds);
+
+#endif  // FLAPPYBIRD_BENCH_H
@@ -0,0 +1,102 @@
+// Copyright 2022 <Maros Varchola - mvarchdev>
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "flappybird/confparser.h"
+
+/// @brief Config file sizes, in lines, that are benchmarked.
+static const long g_line_counts[] = {10, 100, 1000, 10000, 100000, 1000000};
+
+/// @brief State of one config file benchmark.
+typedef struct config_bench {
+  char datafile[256];
+  char tmpfile[256];
+  char first_key[64];
+  int value;
+} config_bench;
+
+/// @brief Write a config file with the given number of HOF-like lines
+/// @param path File to write
+/// @param lines Number of key = value lines
+/// @return True on success
+bool bench_write_config(const char *path, long lines) {
+  FILE *fp = fopen(path, "w");
+  if (fp == NULL) {
+    return false;
+  }
+  fprintf(fp, "# generated by flappy_bench\n");
+  for (long i = 0; i < lines; i++) {
+    fprintf(fp, "player_%07ld#lvl_%ld# = %ld\n", i, (i % 4) + 1, i * 7);
+  }
+  fclose(fp);
+  return true;
+}
+
+static void run_read_config(void *ctx, long iterations) {
+  config_bench *cb = ctx;
+  for (long i = 0; i < iterations; i++) {
+    free_config_options(read_config_file(cb->datafile));
+  }
+}
+
+static void run_get_int(void *ctx, long iterations) {
+  config_bench *cb = ctx;
+  for (long i = 0; i < iterations; i++) {
+    cb->value += get_int_key_value(cb->datafile, cb->first_key);
+  }
+}
+
+static void run_set_int(void *ctx, long iterations) {
+  config_bench *cb = ctx;
+  for (long i = 0; i < iterations; i++) {
+    set_int_key_value(cb->tmpfile, cb->datafile, cb->first_key, cb->value++);
+  }
+}
+
+/// @brief Benchmarks of the config parser on generated files
+/// @param opts Shared options
+void bench_confparser_suite(const bench_options *opts) {
+  char dir[] = "/tmp/flappy_bench_XXXXXX";
+  if (mkdtemp(dir) == NULL) {
+    fprintf(stderr, "bench: cannot create temporary directory\n");
+    return;
+  }
+
+  for (size_t i = 0; i < sizeof(g_line_counts) / sizeof(g_line_counts[0]); i++) {
+    long lines = g_line_counts[i];
+    if (lines > opts->max_lines) {
+      break;
+    }
+
+    config_bench cb = {0};
+    snprintf(cb.datafile, sizeof(cb.datafile), "%s/data_%ld.conf", dir, lines);
+    snprintf(cb.tmpfile, sizeof(cb.tmpfile), "%s/tmpfile", dir);
+    // The list is built in reverse, so the first key in the file is the last one found.
+    snprintf(cb.first_key, sizeof(cb.first_key), "player_%07d#lvl_1#", 0);
+    if (!bench_write_config(cb.datafile, lines)) {
+      fprintf(stderr, "bench: cannot write %s\n", cb.datafile);
+      continue;
+    }
+
+    char param[32] = {0};
+    snprintf(param, sizeof(param), "lines=%ld", lines);
+    long max_iterations = lines >= 100000 ? 1 : 0;
+
+    bench_case read_case = {"read_config_file", param, run_read_config, &cb, max_iterations};
+    bench_execute(opts, &read_case);
+    bench_case get_case = {"get_int_key_value", param, run_get_int, &cb, max_iterations};
+    bench_execute(opts, &get_case);
+    bench_case set_case = {"set_int_key_value", param, run_set_int, &cb, max_iterations};
+    bench_execute(opts, &set_case);
+
+    remove(cb.datafile);
+    remove(cb.tmpfile);
+  }
+
+  rmdir(dir);
+}
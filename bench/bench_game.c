@@ -0,0 +1,279 @@
+// Copyright 2022 <Maros Varchola - mvarchdev>
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <ncurses.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "flappybird/autopilot.h"
+#include "flappybird/batch_env.h"
+#include "flappybird/game_context.h"
+#include "flappybird/rendering.h"
+#include "flappybird/rewind.h"
+#include "flappybird/sim.h"
+#include "flappybird/spectate.h"
+#include "flappybird/trajectory.h"
+
+/// @brief Bird x offset used by the game loop.
+#define BENCH_BIRD_X 30
+/// @brief Terminal type of the off-screen curses screen.
+#define BENCH_TERM_TYPE "xterm"
+/// @brief Gameplay time advanced per simulated frame, 29 fps like the shipped settings.
+#define BENCH_FRAME_MS 34
+/// @brief Instances of the batch environment case.
+#define BENCH_BATCH_ENVS 1024
+
+/// @brief Shared state of gameplay benchmarks.
+typedef struct game_bench {
+  level lvl;
+  fbpipe pipe;
+  bird bird;
+  long sink;
+} game_bench;
+
+static void run_load_level(void *ctx, long iterations) {
+  game_bench *gb = ctx;
+  for (long i = 0; i < iterations; i++) {
+    level lvl = load_level_file(1);
+    gb->sink += lvl.max_lives;
+  }
+}
+
+static void run_get_pipe(void *ctx, long iterations) {
+  game_bench *gb = ctx;
+  int prevupheight = -1;
+  for (long i = 0; i < iterations; i++) {
+    fbpipe pipe = get_pipe(&local_game, MAPSIZEX - 1, &gb->lvl, true, prevupheight);
+    prevupheight = pipe.upheight;
+  }
+  gb->sink += prevupheight;
+}
+
+static void run_move_pipes(void *ctx, long iterations) {
+  game_bench *gb = ctx;
+  for (long i = 0; i < iterations; i++) {
+    advance_game_clock(BENCH_FRAME_MS);
+    gb->sink += move_pipes(&local_game, &gb->lvl);
+  }
+}
+
+static void run_move_process_pipes(void *ctx, long iterations) {
+  game_bench *gb = ctx;
+  for (long i = 0; i < iterations; i++) {
+    advance_game_clock(BENCH_FRAME_MS);
+    gb->sink += move_pipes(&local_game, &gb->lvl);
+    process_pipes(&local_game, &gb->lvl);
+  }
+}
+
+static void run_autopilot_decide(void *ctx, long iterations) {
+  autopilot *ap = ctx;
+  for (long i = 0; i < iterations; i++) {
+    ap->stats.decisions += autopilot_decide(ap, &local_game.sim) == ' ';
+  }
+}
+
+/// @brief Batch stepped with a fixed action pattern, every instance jumps on its own phase.
+typedef struct batch_bench {
+  batch_env env;
+  uint8_t actions[8][BENCH_BATCH_ENVS];
+  long step;
+} batch_bench;
+
+static void run_batch_env_step(void *ctx, long iterations) {
+  batch_bench *bb = ctx;
+  for (long i = 0; i < iterations; i++) {
+    batch_env_step(&bb->env, bb->actions[bb->step++ % 8]);
+  }
+}
+
+/// @brief Every call is a due frame, so each iteration copies one snapshot.
+static void run_rewind_record(void *ctx, long iterations) {
+  static long frame = 0;
+  for (long i = 0; i < iterations; i++) {
+    rewind_record(ctx, &local_game.sim, 0, frame);
+    frame += REWIND_SNAPSHOT_FRAMES;
+  }
+}
+
+/// @brief Predictor fed by a world that plays on, the bird jumps every twelfth frame.
+typedef struct trajectory_bench {
+  trajectory tr;
+  sim_state world;
+  long frame;
+  /// Reset before every update, so each one simulates the whole horizon.
+  bool rebuild;
+} trajectory_bench;
+
+static void run_trajectory_update(void *ctx, long iterations) {
+  trajectory_bench *tb = ctx;
+  for (long i = 0; i < iterations; i++) {
+    if (tb->frame++ % 12 == 0)
+      jump_bird(&tb->world.bird);
+    if (tb->rebuild)
+      trajectory_reset(&tb->tr);
+    trajectory_update(&tb->tr, &tb->world);
+    sim_move_bird(&tb->world, &tb->world.bird);
+    sim_move_pipes(&tb->world, &tb->tr.lvl);
+    sim_process_pipes(&tb->world, &tb->tr.lvl);
+    sim_increase_speed(&tb->world, &tb->tr.lvl);
+    tb->world.clock += BENCH_FRAME_MS;
+  }
+}
+
+static void run_spectate_publish(void *ctx, long iterations) {
+  for (long i = 0; i < iterations; i++) {
+    spectate_publish_frame(ctx);
+  }
+}
+
+static void run_render_pipe(void *ctx, long iterations) {
+  game_bench *gb = ctx;
+  for (long i = 0; i < iterations; i++) {
+    render_pipe(&local_game, &gb->pipe, &gb->lvl);
+  }
+}
+
+static void run_render_pipes(void *ctx, long iterations) {
+  game_bench *gb = ctx;
+  for (long i = 0; i < iterations; i++) {
+    render_pipes(&local_game, &gb->lvl);
+  }
+}
+
+/// @brief Sweep the bird over every row, so hits and misses of the sprite masks are both timed
+static void run_bird_hits_pipes(void *ctx, long iterations) {
+  game_bench *gb = ctx;
+  bird probe = gb->bird;
+  for (long i = 0; i < iterations; i++) {
+    probe.act_position = fixed_from_int((int)(i % MAPSIZEY));
+    gb->sink += bird_hits_pipes(&local_game, &probe, BENCH_BIRD_X);
+  }
+}
+
+/// @brief Fill the pipe array like a level that has been running for a while
+static void populate_pipes(game_bench *gb) {
+  clear_all_pipes(&local_game);
+  init_speed(&local_game, &gb->lvl);
+  for (int step = 0; step < MAPSIZEX; step++) {
+    process_pipes(&local_game, &gb->lvl);
+    for (int i = 0; i < MAX_PIPES; i++) {
+      if (local_game.sim.pipes[i].enabled) {
+        local_game.sim.pipes[i].position--;
+      }
+    }
+  }
+}
+
+static void screen_benchmarks(const bench_options *opts, game_bench *gb) {
+  FILE *out = fopen("/dev/null", "w");
+  FILE *in = fopen("/dev/null", "r");
+  if (out == NULL || in == NULL || init_screen_term(BENCH_TERM_TYPE, out, in) != 0) {
+    fprintf(stderr, "bench: no off-screen terminal, skipping render benchmarks\n");
+    if (out)
+      fclose(out);
+    if (in)
+      fclose(in);
+    return;
+  }
+
+  gb->pipe = get_pipe(&local_game, MAPSIZEX / 2, &gb->lvl, true, -1);
+  bench_case render_case = {"render_pipe", "", run_render_pipe, gb, 0};
+  bench_execute(opts, &render_case);
+
+  populate_pipes(gb);
+  bench_case render_all_case = {"render_pipes", "", run_render_pipes, gb, 0};
+  bench_execute(opts, &render_all_case);
+
+  // A private feed, a spectator of a running game must not see benchmark frames.
+  refresh();
+  spectate_feed *feed = calloc(1, sizeof(*feed));
+  if (feed) {
+    bench_case publish_case = {"spectate_publish", "", run_spectate_publish, feed, 0};
+    bench_execute(opts, &publish_case);
+    free(feed);
+  }
+
+  endwin();
+  fclose(out);
+  fclose(in);
+}
+
+/// @brief Benchmarks of level loading, pipe simulation and rendering
+/// @param opts Shared options
+void bench_game_suite(const bench_options *opts) {
+  game_bench gb = {0};
+  gb.lvl = load_level_file(1);
+  if (!gb.lvl.loaded) {
+    fprintf(stderr, "bench: ./assets/levels/level_1.conf not found, run from repository root\n");
+    return;
+  }
+
+  bench_case load_case = {"load_level_file", "level=1", run_load_level, &gb, 0};
+  bench_execute(opts, &load_case);
+
+  bench_case get_pipe_case = {"get_pipe", "", run_get_pipe, &gb, 0};
+  bench_execute(opts, &get_pipe_case);
+
+  populate_pipes(&gb);
+  bench_case move_case = {"move_pipes", "", run_move_pipes, &gb, 0};
+  bench_execute(opts, &move_case);
+
+  populate_pipes(&gb);
+  bench_case world_case = {"move_pipes+process_pipes", "", run_move_process_pipes, &gb, 0};
+  bench_execute(opts, &world_case);
+
+  populate_pipes(&gb);
+  gb.bird = get_bird(&local_game, &gb.lvl);
+  bench_case hits_case = {"bird_hits_pipes", "", run_bird_hits_pipes, &gb, 0};
+  bench_execute(opts, &hits_case);
+
+  // Every decision searches the same world, so the node count per operation is fixed.
+  static autopilot pilot;
+  populate_pipes(&gb);
+  local_game.sim.bird = get_bird(&local_game, &gb.lvl);
+  autopilot_init(&pilot, &gb.lvl, BENCH_FRAME_MS);
+  autopilot_decide(&pilot, &local_game.sim);
+  char pilot_param[32] = {0};
+  snprintf(pilot_param, sizeof(pilot_param), "nodes=%lld", pilot.stats.nodes);
+  bench_case pilot_case = {"autopilot_decide", pilot_param, run_autopilot_decide, &pilot, 0};
+  bench_execute(opts, &pilot_case);
+
+  static rewind_ring ring;
+  rewind_reset(&ring);
+  char rewind_param[32] = {0};
+  snprintf(rewind_param, sizeof(rewind_param), "bytes=%zu", sizeof(game_snapshot));
+  bench_case rewind_case = {"rewind_record", rewind_param, run_rewind_record, &ring, 0};
+  bench_execute(opts, &rewind_case);
+
+  // The steady case extends the prediction by one frame, the rebuild case redoes all of it.
+  static trajectory_bench traj;
+  for (int rebuild = 0; rebuild < 2; rebuild++) {
+    populate_pipes(&gb);
+    local_game.sim.bird = get_bird(&local_game, &gb.lvl);
+    trajectory_init(&traj.tr, &gb.lvl, BENCH_FRAME_MS);
+    traj.world = local_game.sim;
+    traj.frame = 0;
+    traj.rebuild = rebuild;
+    char traj_param[32] = {0};
+    snprintf(traj_param, sizeof(traj_param), "frames=%d", traj.tr.frames);
+    bench_case traj_case = {rebuild ? "trajectory_rebuild" : "trajectory_update", traj_param,
+                            run_trajectory_update, &traj, 0};
+    bench_execute(opts, &traj_case);
+  }
+
+  static batch_bench batch;
+  if (batch_env_init(&batch.env, &gb.lvl, BENCH_BATCH_ENVS, 1, BENCH_FRAME_MS,
+                     local_game.sim.gravity_constant) == 0) {
+    for (int i = 0; i < BENCH_BATCH_ENVS; i++) {
+      batch.actions[i % 8][i] = BATCH_ACTION_JUMP;
+    }
+    bench_case batch_case = {"batch_env_step", "envs=1024", run_batch_env_step, &batch, 0};
+    bench_execute(opts, &batch_case);
+    batch_env_free(&batch.env);
+  }
+
+  screen_benchmarks(opts, &gb);
+}
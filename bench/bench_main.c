@@ -0,0 +1,71 @@
+// Copyright 2022 <Maros Varchola - mvarchdev>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "bench.h"
+#include "flappybird/rendering.h"
+
+static void print_usage(const char *argv0) {
+  fprintf(stderr,
+          "Usage: %s [--samples N] [--warmup N] [--max-lines N] [--filter NAME]\n"
+          "       [--check BASELINE | --write-baseline BASELINE]\n"
+          "       [--stress-persist INSTANCES [--rounds N]]\n"
+          "Runs microbenchmarks from the repository root and prints JSON to stdout.\n"
+          "--check compares gameplay and persistence scenarios with a baseline file and\n"
+          "fails on regressions, --write-baseline stores the current numbers.\n"
+          "--stress-persist runs concurrent instances against one save directory and reports\n"
+          "latency percentiles and lost updates.\n",
+          argv0);
+}
+
+int main(int argc, char *argv[]) {
+  bench_options opts;
+  bench_options_init(&opts);
+  const char *check_path = NULL;
+  const char *baseline_path = NULL;
+  int stress_instances = 0;
+  int stress_rounds = 200;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc) {
+      opts.samples = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+      opts.warmup = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--max-lines") == 0 && i + 1 < argc) {
+      opts.max_lines = atol(argv[++i]);
+    } else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+      opts.filter = argv[++i];
+    } else if (strcmp(argv[i], "--check") == 0 && i + 1 < argc) {
+      check_path = argv[++i];
+    } else if (strcmp(argv[i], "--write-baseline") == 0 && i + 1 < argc) {
+      baseline_path = argv[++i];
+    } else if (strcmp(argv[i], "--stress-persist") == 0 && i + 1 < argc) {
+      stress_instances = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--rounds") == 0 && i + 1 < argc) {
+      stress_rounds = atoi(argv[++i]);
+    } else {
+      print_usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (stress_instances > 0) {
+    return stress_persist(&opts, stress_instances, stress_rounds) == 0 ? EXIT_SUCCESS
+                                                                        : EXIT_FAILURE;
+  } else if (check_path) {
+    return perf_check(&opts, check_path) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+  } else if (baseline_path) {
+    return perf_write_baseline(&opts, baseline_path) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+  seed_game_rng((uint64_t)time(NULL), false);
+  bench_json_begin(&opts);
+  bench_confparser_suite(&opts);
+  bench_game_suite(&opts);
+  bench_vterm_suite(&opts);
+  bench_json_end(&opts);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,191 @@
+// Copyright 2022 <Maros Varchola - mvarchdev>
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <ncurses.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "flappybird/game_context.h"
+#include "flappybird/rendering.h"
+#include "flappybird/term_io.h"
+#include "flappybird/vterm.h"
+
+/// @brief Terminal type of the off-screen curses screen.
+#define BENCH_VT_TERM_TYPE "xterm"
+/// @brief Gameplay time advanced per simulated frame, 29 fps like the shipped settings.
+#define BENCH_VT_FRAME_MS 34
+/// @brief Bird x offset used by the game loop.
+#define BENCH_VT_BIRD_X 30
+/// @brief Frames of gameplay output recorded for the parser benchmark.
+#define BENCH_VT_RECORD_FRAMES 200
+/// @brief Screen setups are slow and allocate, bound them per sample.
+#define BENCH_VT_MAX_SCREENS 64
+/// @brief Operations averaged for the bytes per operation figure, a frame often changes nothing.
+#define BENCH_VT_BYTE_OPS 32
+
+/// @brief Shared state of virtual terminal benchmarks.
+typedef struct vterm_bench {
+  vterm vt;
+  level lvl;
+  bird bird;
+  /// Recorded terminal output, replayed by the parser benchmark.
+  char *record;
+  size_t record_len;
+  size_t record_cap;
+  FILE *out;
+  FILE *in;
+  char param[64];
+} vterm_bench;
+
+static void record_write(void *ctx, const char *data, size_t len) {
+  vterm_bench *vb = ctx;
+  if (vb->record_len + len > vb->record_cap) {
+    size_t cap = vb->record_cap ? vb->record_cap : 4096;
+    while (cap < vb->record_len + len) {
+      cap *= 2;
+    }
+    char *grown = realloc(vb->record, cap);
+    if (grown == NULL) {
+      return;
+    }
+    vb->record = grown;
+    vb->record_cap = cap;
+  }
+  memcpy(vb->record + vb->record_len, data, len);
+  vb->record_len += len;
+}
+
+/// @brief Draw one gameplay frame the way run_level does
+static void draw_frame(vterm_bench *vb) {
+  advance_game_clock(BENCH_VT_FRAME_MS);
+  move_pipes(&local_game, &vb->lvl);
+  process_pipes(&local_game, &vb->lvl);
+  move_bird(&local_game, &vb->bird);
+  if (vb->bird.act_position >= fixed_from_int(MAPSIZEY - 1) || vb->bird.act_position < FIXED_ONE) {
+    vb->bird = get_bird(&local_game, &vb->lvl);
+  }
+  clear_map_area(&vb->lvl, false);
+  render_pipes(&local_game, &vb->lvl);
+  render_bird(&local_game, &vb->bird, BENCH_VT_BIRD_X, false);
+  refresh();
+}
+
+static void run_parse(void *ctx, long iterations) {
+  vterm_bench *vb = ctx;
+  for (long i = 0; i < iterations; i++) {
+    vterm_feed(&vb->vt, vb->record, vb->record_len);
+  }
+}
+
+static void run_init_screen(void *ctx, long iterations) {
+  vterm_bench *vb = ctx;
+  for (long i = 0; i < iterations; i++) {
+    if (init_screen_term(BENCH_VT_TERM_TYPE, vb->out, vb->in) != 0) {
+      return;
+    }
+    endwin();
+    delscreen(set_term(NULL));
+  }
+}
+
+static void run_render_borders(void *ctx, long iterations) {
+  for (long i = 0; i < iterations; i++) {
+    clear();
+    render_borders();
+    refresh();
+  }
+}
+
+static void run_frame(void *ctx, long iterations) {
+  vterm_bench *vb = ctx;
+  for (long i = 0; i < iterations; i++) {
+    draw_frame(vb);
+  }
+}
+
+/// @brief Measure a case with the virtual terminal attached, the param field reports the bytes
+/// one operation writes and the screen it leaves behind
+static void execute_through_vt(const bench_options *opts, vterm_bench *vb, bench_case *bc) {
+  if (!bench_selected(opts, bc->name)) {
+    return;
+  }
+  fprintf(stderr, "bench: %s\n", bc->name);
+  term_io_sink sink = vterm_sink(&vb->vt);
+  term_io_add_sink(&sink);
+  bench_result res = bench_measure(opts, bc);
+
+  unsigned long long before = term_io_total().bytes;
+  bc->run(bc->ctx, BENCH_VT_BYTE_OPS);
+  double bytes = (double)(term_io_total().bytes - before) / BENCH_VT_BYTE_OPS;
+  term_io_remove_sink(&vb->vt);
+
+  snprintf(vb->param, sizeof(vb->param), "bytes_per_op=%.1f,screen=%016llx", bytes,
+           (unsigned long long)vterm_screen_hash(&vb->vt));
+  bc->param = vb->param;
+  bench_report(opts, bc, &res);
+}
+
+/// @brief Record gameplay output once so the parser can be measured on its own
+static void record_frames(vterm_bench *vb) {
+  term_io_sink sink = {record_write, NULL, vb};
+  term_io_add_sink(&sink);
+  clearok(stdscr, TRUE);
+  for (int i = 0; i < BENCH_VT_RECORD_FRAMES; i++) {
+    draw_frame(vb);
+  }
+  term_io_remove_sink(vb);
+}
+
+/// @brief Benchmarks of the virtual terminal and of rendering measured through it
+/// @param opts Shared options
+void bench_vterm_suite(const bench_options *opts) {
+  vterm_bench vb = {0};
+  vb.lvl = load_level_file(1);
+  if (!vb.lvl.loaded) {
+    fprintf(stderr, "bench: ./assets/levels/level_1.conf not found, run from repository root\n");
+    return;
+  }
+  vb.out = fopen("/dev/null", "w");
+  vb.in = fopen("/dev/null", "r");
+  if (vb.out == NULL || vb.in == NULL ||
+      init_screen_term(BENCH_VT_TERM_TYPE, vb.out, vb.in) != 0) {
+    fprintf(stderr, "bench: no off-screen terminal, skipping virtual terminal benchmarks\n");
+    goto cleanup;
+  }
+  if (vterm_init(&vb.vt, LINES, COLS) != 0) {
+    endwin();
+    goto cleanup;
+  }
+
+  clear_all_pipes(&local_game);
+  init_speed(&local_game, &vb.lvl);
+  vb.bird = get_bird(&local_game, &vb.lvl);
+  record_frames(&vb);
+
+  char param[64] = {0};
+  snprintf(param, sizeof(param), "bytes=%zu,frames=%d", vb.record_len, BENCH_VT_RECORD_FRAMES);
+  bench_case parse_case = {"vterm_parse", param, run_parse, &vb, 0};
+  bench_execute(opts, &parse_case);
+
+  bench_case borders_case = {"vt_render_borders", "", run_render_borders, &vb, 0};
+  execute_through_vt(opts, &vb, &borders_case);
+
+  bench_case frame_case = {"vt_frame", "", run_frame, &vb, 0};
+  execute_through_vt(opts, &vb, &frame_case);
+
+  endwin();
+  delscreen(set_term(NULL));
+  bench_case init_case = {"vt_init_screen", "", run_init_screen, &vb, BENCH_VT_MAX_SCREENS};
+  execute_through_vt(opts, &vb, &init_case);
+
+  vterm_free(&vb.vt);
+cleanup:
+  free(vb.record);
+  if (vb.out)
+    fclose(vb.out);
+  if (vb.in)
+    fclose(vb.in);
+}
@@ -0,0 +1,311 @@
+// Copyright 2022 <Maros Varchola - mvarchdev>
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "flappybird/confparser.h"
+#include "flappybird/headless.h"
+
+/// @brief Allowed relative slowdown of timings.
+#define PERF_TIME_TOLERANCE 0.25
+/// @brief Allowed relative change of deterministic counters.
+#define PERF_COUNT_TOLERANCE 0.02
+/// @brief Width of the noise band in standard deviations.
+#define PERF_NOISE_SIGMAS 3.0
+/// @brief Scales a median absolute deviation to a standard deviation of normal noise.
+#define PERF_MAD_TO_SIGMA 1.4826
+/// @brief Frames played per headless sample.
+#define PERF_FRAMES 1000
+/// @brief Seed of headless samples, fixed so every build plays the same game.
+#define PERF_SEED 1
+/// @brief Highest level number that is looked for.
+#define PERF_MAX_LEVEL 16
+/// @brief Lines of the config file that is loaded.
+#define PERF_CONFIG_LINES 10000
+/// @brief Lines of the file a persistence write rewrites.
+#define PERF_PERSIST_LINES 1000
+/// @brief Maximum number of scenarios.
+#define PERF_MAX_SCENARIOS 64
+
+/// @brief One measured scenario.
+typedef struct perf_scenario {
+  char name[64];
+  double median;
+  double mad;
+  double tolerance;
+} perf_scenario;
+
+/// @brief Scenarios of one run or of the baseline file.
+typedef struct perf_set {
+  perf_scenario items[PERF_MAX_SCENARIOS];
+  int count;
+} perf_set;
+
+/// @brief State of config file scenarios.
+typedef struct perf_files {
+  char datafile[256];
+  char tmpfile[256];
+  int value;
+} perf_files;
+
+static perf_scenario *find_scenario(perf_set *set, const char *name, bool create) {
+  for (int i = 0; i < set->count; i++) {
+    if (strcmp(set->items[i].name, name) == 0) {
+      return &set->items[i];
+    }
+  }
+  if (!create || set->count == PERF_MAX_SCENARIOS) {
+    return NULL;
+  }
+  perf_scenario *sc = &set->items[set->count++];
+  memset(sc, 0, sizeof(*sc));
+  snprintf(sc->name, sizeof(sc->name), "%s", name);
+  sc->tolerance = PERF_TIME_TOLERANCE;
+  return sc;
+}
+
+static void add_scenario(perf_set *set, const char *name, double median, double mad,
+                         double tolerance) {
+  perf_scenario *sc = find_scenario(set, name, true);
+  if (sc == NULL) {
+    return;
+  }
+  sc->median = median;
+  sc->mad = mad;
+  sc->tolerance = tolerance;
+  fprintf(stderr, "perf: %-32s %12.1f (mad %.1f)\n", name, median, mad);
+}
+
+/// @brief Sample headless plays of every level with one renderer
+static void collect_frames(const bench_options *opts, render_backend renderer, perf_set *set) {
+  headless_options hopts;
+  headless_options_init(&hopts);
+  hopts.seed = PERF_SEED;
+  hopts.frames = PERF_FRAMES;
+  hopts.renderer = renderer;
+  hopts.profile = false;
+  const char *renderer_name = renderer == RENDER_BACKEND_NONE ? "none" : "null";
+  if (headless_begin(&hopts) != 0) {
+    return;
+  }
+
+  for (int levelnum = 1; levelnum <= PERF_MAX_LEVEL; levelnum++) {
+    if (!load_level_file(levelnum).loaded) {
+      break;
+    }
+    hopts.levelnum = levelnum;
+
+    headless_result res;
+    for (int i = 0; i < opts->warmup; i++) {
+      headless_play(&hopts, &res);
+    }
+    int samples = bench_sample_count(opts);
+    double per_frame[BENCH_MAX_SAMPLES];
+    for (int i = 0; i < samples; i++) {
+      headless_play(&hopts, &res);
+      per_frame[i] = (double)res.wall_ns / (double)res.profile.frames;
+    }
+    bench_result stats = bench_summarize(per_frame, samples, 1);
+
+    char name[64] = {0};
+    snprintf(name, sizeof(name), "frame_ns.level_%d.%s", levelnum, renderer_name);
+    add_scenario(set, name, stats.median_ns, stats.mad_ns, PERF_TIME_TOLERANCE);
+    if (renderer == RENDER_BACKEND_NULL) {
+      snprintf(name, sizeof(name), "bytes_per_frame.level_%d", levelnum);
+      add_scenario(set, name, (double)res.output.bytes / (double)res.profile.frames, 0,
+                   PERF_COUNT_TOLERANCE);
+    }
+  }
+
+  headless_end(&hopts);
+}
+
+static void run_config_load(void *ctx, long iterations) {
+  perf_files *pf = ctx;
+  for (long i = 0; i < iterations; i++) {
+    free_config_options(read_config_file(pf->datafile));
+  }
+}
+
+static void run_persist_write(void *ctx, long iterations) {
+  perf_files *pf = ctx;
+  for (long i = 0; i < iterations; i++) {
+    set_int_key_value(pf->tmpfile, pf->datafile, "player_0000000#lvl_1#", pf->value++);
+  }
+}
+
+static void collect_file(const bench_options *opts, const char *dir, const char *name,
+                         long lines, void (*run)(void *ctx, long iterations), perf_set *set) {
+  perf_files pf = {0};
+  snprintf(pf.datafile, sizeof(pf.datafile), "%s/data.conf", dir);
+  snprintf(pf.tmpfile, sizeof(pf.tmpfile), "%s/tmpfile", dir);
+  if (!bench_write_config(pf.datafile, lines)) {
+    fprintf(stderr, "perf: cannot write %s\n", pf.datafile);
+    return;
+  }
+
+  bench_case bc = {name, "", run, &pf, 0};
+  bench_result res = bench_measure(opts, &bc);
+  add_scenario(set, name, res.median_ns, res.mad_ns, PERF_TIME_TOLERANCE);
+  remove(pf.datafile);
+  remove(pf.tmpfile);
+}
+
+/// @brief Measure every scenario
+static void collect(const bench_options *opts, perf_set *set) {
+  memset(set, 0, sizeof(*set));
+  collect_frames(opts, RENDER_BACKEND_NONE, set);
+  collect_frames(opts, RENDER_BACKEND_NULL, set);
+
+  char dir[] = "/tmp/flappy_perf_XXXXXX";
+  if (mkdtemp(dir) == NULL) {
+    fprintf(stderr, "perf: cannot create temporary directory\n");
+    return;
+  }
+  char name[64] = {0};
+  snprintf(name, sizeof(name), "config_load_ns.lines_%d", PERF_CONFIG_LINES);
+  collect_file(opts, dir, name, PERF_CONFIG_LINES, run_config_load, set);
+  snprintf(name, sizeof(name), "persist_write_ns.lines_%d", PERF_PERSIST_LINES);
+  collect_file(opts, dir, name, PERF_PERSIST_LINES, run_persist_write, set);
+  rmdir(dir);
+}
+
+/// @brief Read "<scenario>.<median|mad|tolerance> = value" lines
+static int load_baseline(const char *path, perf_set *set) {
+  memset(set, 0, sizeof(*set));
+  config_option_t options = read_config_file(path);
+  if (options == NULL) {
+    return -1;
+  }
+
+  // The list is built in reverse, walk it to the end to keep the file order.
+  config_option_t ordered[PERF_MAX_SCENARIOS * 3];
+  int count = 0;
+  for (config_option_t cursor = options; cursor != NULL; cursor = cursor->prev) {
+    if (count < PERF_MAX_SCENARIOS * 3) {
+      ordered[count++] = cursor;
+    }
+  }
+
+  for (int i = count - 1; i >= 0; i--) {
+    char name[CONFIG_ARG_MAX_BYTES] = {0};
+    snprintf(name, sizeof(name), "%s", ordered[i]->key);
+    char *field = strrchr(name, '.');
+    if (field == NULL) {
+      continue;
+    }
+    *field++ = '\0';
+
+    perf_scenario *sc = find_scenario(set, name, true);
+    if (sc == NULL) {
+      break;
+    }
+    double value = atof(ordered[i]->value);
+    if (strcmp(field, "median") == 0) {
+      sc->median = value;
+    } else if (strcmp(field, "mad") == 0) {
+      sc->mad = value;
+    } else if (strcmp(field, "tolerance") == 0) {
+      sc->tolerance = value;
+    }
+  }
+
+  free_config_options(options);
+  return 0;
+}
+
+/// @brief Measure every scenario and store the results as the new baseline
+/// @param opts Shared options
+/// @param path Baseline file
+/// @return Error code
+int perf_write_baseline(const bench_options *opts, const char *path) {
+  perf_set current;
+  collect(opts, &current);
+
+  FILE *fp = fopen(path, "w");
+  if (fp == NULL) {
+    fprintf(stderr, "perf: cannot write %s\n", path);
+    return -1;
+  }
+  fprintf(fp, "# Performance baseline of make perf-check, regenerate with make perf-baseline.\n");
+  fprintf(fp, "# median and mad are per frame or per operation (ns or bytes), tolerance is the\n");
+  fprintf(fp, "# allowed relative increase over the median.\n");
+  for (int i = 0; i < current.count; i++) {
+    const perf_scenario *sc = &current.items[i];
+    fprintf(fp, "%s.median = %.1f\n", sc->name, sc->median);
+    fprintf(fp, "%s.mad = %.1f\n", sc->name, sc->mad);
+    fprintf(fp, "%s.tolerance = %.2f\n", sc->name, sc->tolerance);
+  }
+  fclose(fp);
+  fprintf(stderr, "perf: wrote %d scenarios to %s\n", current.count, path);
+  return 0;
+}
+
+/// @brief Allowed increase over the baseline median, the larger of the relative tolerance
+/// and the noise band of both runs
+static double regression_limit(const perf_scenario *base, const perf_scenario *cur) {
+  double sigma = PERF_MAD_TO_SIGMA * sqrt(base->mad * base->mad + cur->mad * cur->mad);
+  double noise = PERF_NOISE_SIGMAS * sigma;
+  double relative = base->tolerance * base->median;
+  return noise > relative ? noise : relative;
+}
+
+/// @brief Measure every scenario and compare it with the baseline
+/// @param opts Shared options
+/// @param path Baseline file
+/// @return Number of regressions, -1 if baseline cannot be read
+int perf_check(const bench_options *opts, const char *path) {
+  perf_set baseline;
+  if (load_baseline(path, &baseline) != 0) {
+    fprintf(stderr, "perf: cannot read baseline %s\n", path);
+    return -1;
+  }
+  perf_set current;
+  collect(opts, &current);
+
+  int regressions = 0;
+  printf("%-32s %12s %12s %9s %8s  %s\n", "scenario", "baseline", "current", "change", "limit",
+         "verdict");
+  for (int i = 0; i < baseline.count; i++) {
+    const perf_scenario *base = &baseline.items[i];
+    const perf_scenario *cur = find_scenario(&current, base->name, false);
+    if (cur == NULL) {
+      printf("%-32s %12.1f %12s %9s %8s  MISSING\n", base->name, base->median, "-", "-", "-");
+      regressions++;
+      continue;
+    }
+
+    double delta = cur->median - base->median;
+    double limit = regression_limit(base, cur);
+    double change = base->median > 0 ? 100.0 * delta / base->median : 0;
+    double limit_pct = base->median > 0 ? 100.0 * limit / base->median : 0;
+    const char *verdict = "ok";
+    if (delta > limit) {
+      verdict = "REGRESSION";
+      regressions++;
+    } else if (-delta > limit) {
+      verdict = "faster";
+    }
+    printf("%-32s %12.1f %12.1f %+8.1f%% %7.1f%%  %s\n", base->name, base->median, cur->median,
+           change, limit_pct, verdict);
+  }
+  for (int i = 0; i < current.count; i++) {
+    if (find_scenario(&baseline, current.items[i].name, false) == NULL) {
+      printf("%-32s %12s %12.1f %9s %8s  new\n", current.items[i].name, "-",
+             current.items[i].median, "-", "-");
+    }
+  }
+
+  if (regressions > 0) {
+    printf("perf-check: %d regression(s) against %s\n", regressions, path);
+  } else {
+    printf("perf-check: no regressions against %s\n", path);
+  }
+  return regressions;
+}
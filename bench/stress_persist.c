@@ -0,0 +1,271 @@
+// Copyright 2022 <Maros Varchola - mvarchdev>
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "flappybird/common_tools.h"
+#include "flappybird/game_stats.h"
+#include "flappybird/processing.h"
+
+/// @brief Persistence calls made by every instance in every round.
+#define STRESS_OPS 3
+/// @brief Level of the hall of fame entries, each round writes its own nickname.
+#define STRESS_LEVEL 1
+/// @brief Upper bound of simulated instances.
+#define STRESS_MAX_INSTANCES 256
+
+static const char *op_names[STRESS_OPS] = {"game_stats_save", "set_hall_of_fame",
+                                           "set_last_level"};
+
+/// @brief What one instance reports back to the parent.
+typedef struct stress_instance_result {
+  int failures[STRESS_OPS];
+  long long wall_ns;
+} stress_instance_result;
+
+static void result_path(char *buf, size_t size, int instance) {
+  snprintf(buf, size, "./instance_%d.lat", instance);
+}
+
+/// @brief Nickname unique to an instance and round, so every write lands on a key of its own
+static void stress_nickname(char *buf, size_t size, int instance, int round) {
+  snprintf(buf, size, "stress_%03d_%05d", instance, round);
+}
+
+/// @brief One simulated game instance, records a run and a save per round
+static int run_instance(int instance, int rounds, int start_fd) {
+  char ready = 0;
+  // Block until the parent releases every instance at once.
+  if (read(start_fd, &ready, 1) < 0) {
+    return EXIT_FAILURE;
+  }
+  close(start_fd);
+
+  long long *latency = calloc((size_t)rounds * STRESS_OPS, sizeof(*latency));
+  if (latency == NULL) {
+    return EXIT_FAILURE;
+  }
+  stress_instance_result result = {{0}, 0};
+  run_metrics metrics = {0};
+  metrics.jumps = 1;
+  metrics.pipes_passed = 1;
+
+  long long begin = timeInNanoseconds();
+  for (int round = 0; round < rounds; round++) {
+    char nickname[64] = {0};
+    stress_nickname(nickname, sizeof(nickname), instance, round);
+    long long *lat = &latency[round * STRESS_OPS];
+
+    long long start = timeInNanoseconds();
+    game_stats stats = game_stats_load();
+    game_stats_record_run(&stats, 1, &metrics);
+    result.failures[0] += game_stats_save(&stats) != 0;
+    lat[0] = timeInNanoseconds() - start;
+
+    start = timeInNanoseconds();
+    result.failures[1] += set_hall_of_fame(nickname, round + 1, STRESS_LEVEL) != 0;
+    lat[1] = timeInNanoseconds() - start;
+
+    start = timeInNanoseconds();
+    result.failures[2] += set_last_level(nickname, STRESS_LEVEL) != 0;
+    lat[2] = timeInNanoseconds() - start;
+  }
+  result.wall_ns = timeInNanoseconds() - begin;
+
+  char path[64] = {0};
+  result_path(path, sizeof(path), instance);
+  FILE *fp = fopen(path, "wb");
+  int status = EXIT_FAILURE;
+  if (fp != NULL) {
+    if (fwrite(&result, sizeof(result), 1, fp) == 1 &&
+        fwrite(latency, sizeof(*latency), (size_t)rounds * STRESS_OPS, fp) ==
+            (size_t)rounds * STRESS_OPS) {
+      status = EXIT_SUCCESS;
+    }
+    fclose(fp);
+  }
+  free(latency);
+  return status;
+}
+
+/// @brief Collect the latencies of one operation over every instance
+static int read_results(int instances, int rounds, double *per_op[STRESS_OPS],
+                        int failures[STRESS_OPS]) {
+  size_t count = (size_t)rounds * STRESS_OPS;
+  long long *latency = calloc(count, sizeof(*latency));
+  if (latency == NULL) {
+    return -1;
+  }
+  int err = 0;
+  for (int i = 0; i < instances && err == 0; i++) {
+    char path[64] = {0};
+    result_path(path, sizeof(path), i);
+    FILE *fp = fopen(path, "rb");
+    stress_instance_result result;
+    if (fp == NULL || fread(&result, sizeof(result), 1, fp) != 1 ||
+        fread(latency, sizeof(*latency), count, fp) != count) {
+      err = -1;
+    } else {
+      for (int op = 0; op < STRESS_OPS; op++) {
+        failures[op] += result.failures[op];
+        for (int round = 0; round < rounds; round++) {
+          per_op[op][i * rounds + round] = (double)latency[round * STRESS_OPS + op];
+        }
+      }
+    }
+    if (fp != NULL) {
+      fclose(fp);
+    }
+    remove(path);
+  }
+  free(latency);
+  return err;
+}
+
+/// @brief Count writes of unique keys that are not in the files after every instance is done
+static void count_lost(int instances, int rounds, int *lost_hof, int *lost_saves) {
+  *lost_hof = 0;
+  *lost_saves = 0;
+  for (int i = 0; i < instances; i++) {
+    for (int round = 0; round < rounds; round++) {
+      char nickname[64] = {0};
+      stress_nickname(nickname, sizeof(nickname), i, round);
+      *lost_hof += get_hall_of_fame(nickname, STRESS_LEVEL) != round + 1;
+      *lost_saves += get_last_level(nickname) != STRESS_LEVEL;
+    }
+  }
+}
+
+static void print_report(FILE *out, int instances, int rounds, long long wall_ns,
+                         double *per_op[STRESS_OPS], const int failures[STRESS_OPS]) {
+  int count = instances * rounds;
+  double wall_s = (double)wall_ns / 1e9;
+  game_stats stats = game_stats_load();
+  int lost_hof = 0;
+  int lost_saves = 0;
+  count_lost(instances, rounds, &lost_hof, &lost_saves);
+
+  fprintf(out, "{\n  \"suite\": \"persistence-stress\",\n  \"instances\": %d,\n", instances);
+  fprintf(out, "  \"rounds\": %d,\n  \"wall_s\": %.3f,\n  \"ops_per_sec\": %.1f,\n", rounds,
+          wall_s, wall_s > 0 ? (double)count * STRESS_OPS / wall_s : 0);
+  fprintf(out, "  \"operations\": [");
+  for (int op = 0; op < STRESS_OPS; op++) {
+    double *sorted = per_op[op];
+    qsort(sorted, (size_t)count, sizeof(sorted[0]), bench_compare_double);
+    fprintf(out, "%s\n    {\"name\": \"%s\", \"count\": %d, \"failures\": %d, ", op ? "," : "",
+            op_names[op], count, failures[op]);
+    fprintf(out, "\"p50_us\": %.1f, \"p90_us\": %.1f, \"p99_us\": %.1f, ",
+            bench_percentile(sorted, count, 50) / 1e3, bench_percentile(sorted, count, 90) / 1e3,
+            bench_percentile(sorted, count, 99) / 1e3);
+    fprintf(out, "\"p999_us\": %.1f, \"max_us\": %.1f}",
+            bench_percentile(sorted, count, 99.9) / 1e3, sorted[count - 1] / 1e3);
+  }
+  fprintf(out, "\n  ],\n  \"lost_updates\": {\"game_stats_total_runs\": %d, ",
+          count - stats.total_runs);
+  fprintf(out, "\"hall_of_fame\": %d, \"saves\": %d}\n}\n", lost_hof, lost_saves);
+}
+
+/// @brief Remove every file the instances may have left in the scratch directory
+static void clean_scratch(void) {
+  const char *files[] = {GAME_STATS_FILE, "./assets/hall_of_fame.conf", "./assets/saves.conf",
+                         "./stats_tmpfile", "./hoftmpfile", "./lvltmpfile"};
+  for (size_t i = 0; i < sizeof(files) / sizeof(files[0]); i++) {
+    remove(files[i]);
+  }
+  rmdir("./assets");
+}
+
+/// @brief Fork instances that persist runs against one shared assets directory at the same
+/// time and report throughput, latency percentiles and updates missing afterwards
+/// @param opts Shared options, the report goes to opts->out
+/// @param instances Number of concurrent instances
+/// @param rounds Runs recorded by each instance
+/// @return Error code
+int stress_persist(const bench_options *opts, int instances, int rounds) {
+  if (instances < 1 || instances > STRESS_MAX_INSTANCES || rounds < 1) {
+    fprintf(stderr, "stress: need 1..%d instances and at least one round\n",
+            STRESS_MAX_INSTANCES);
+    return -1;
+  }
+
+  char cwd[4096] = {0};
+  char dir[] = "/tmp/flappy_stress_XXXXXX";
+  if (getcwd(cwd, sizeof(cwd)) == NULL || mkdtemp(dir) == NULL || chdir(dir) != 0 ||
+      mkdir("./assets", 0755) != 0) {
+    fprintf(stderr, "stress: cannot prepare scratch directory\n");
+    return -1;
+  }
+
+  int start_pipe[2];
+  if (pipe(start_pipe) != 0) {
+    fprintf(stderr, "stress: cannot create start pipe\n");
+    clean_scratch();
+    if (chdir(cwd) == 0) {
+      rmdir(dir);
+    }
+    return -1;
+  }
+
+  fprintf(stderr, "stress: %d instances x %d rounds in %s\n", instances, rounds, dir);
+  pid_t pids[STRESS_MAX_INSTANCES];
+  int started = 0;
+  for (; started < instances; started++) {
+    pid_t pid = fork();
+    if (pid == 0) {
+      close(start_pipe[1]);
+      _exit(run_instance(started, rounds, start_pipe[0]));
+    } else if (pid < 0) {
+      fprintf(stderr, "stress: fork failed after %d instances\n", started);
+      break;
+    }
+    pids[started] = pid;
+  }
+
+  close(start_pipe[0]);
+  long long start = timeInNanoseconds();
+  close(start_pipe[1]);
+  int failed = started < instances;
+  for (int i = 0; i < started; i++) {
+    int status = 0;
+    waitpid(pids[i], &status, 0);
+    failed |= !WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS;
+  }
+  long long wall_ns = timeInNanoseconds() - start;
+
+  int err = -1;
+  double *per_op[STRESS_OPS] = {NULL};
+  int failures[STRESS_OPS] = {0};
+  size_t count = (size_t)instances * (size_t)rounds;
+  for (int op = 0; op < STRESS_OPS; op++) {
+    per_op[op] = calloc(count, sizeof(double));
+  }
+  if (!failed && per_op[0] && per_op[1] && per_op[2] &&
+      read_results(instances, rounds, per_op, failures) == 0) {
+    print_report(opts->out, instances, rounds, wall_ns, per_op, failures);
+    err = 0;
+  } else {
+    fprintf(stderr, "stress: an instance did not finish\n");
+  }
+  for (int op = 0; op < STRESS_OPS; op++) {
+    free(per_op[op]);
+  }
+
+  for (int i = 0; i < instances; i++) {
+    char path[64] = {0};
+    result_path(path, sizeof(path), i);
+    remove(path);
+  }
+  clean_scratch();
+  if (chdir(cwd) != 0) {
+    err = -1;
+  }
+  rmdir(dir);
+  return err;
+}
@@ -0,0 +1,80 @@
+// Copyright 2022 <Maros Varchola - mvarchdev>
+
+#ifndef FLAPPYBIRD_AGENT_API_H
+#define FLAPPYBIRD_AGENT_API_H
+
+// Interface of controller plugins. A plugin is a shared library that includes only this
+// header and exports a const agent_plugin_api named AGENT_PLUGIN_SYMBOL.
+
+/// @brief Version of the structs below, a plugin built against another version is rejected.
+#define AGENT_API_VERSION 1
+/// @brief Name of the exported agent_plugin_api.
+#define AGENT_PLUGIN_SYMBOL "flappy_agent_plugin"
+/// @brief Pipes ahead of the bird in each observation.
+#define AGENT_OBS_PIPES 3
+
+/// @brief Constants of the level being played, fixed for a whole run.
+typedef struct agent_level_info {
+  int levelnumber;
+  int max_lives;
+  /// Map size in characters, row 0 is the top.
+  int map_width;
+  int map_height;
+  /// Column of the bird. The cells around it that collide come from the loaded bird sprite,
+  /// whose frame depends on the vertical speed, so an agent must not assume a fixed shape.
+  int bird_x;
+  /// Gameplay time of one tick.
+  long long frame_ms;
+  /// Bird physics in m/s and m/s^2, meter_to_chars converts them to rows.
+  float gravity;
+  float jump_speed;
+  float meter_to_chars;
+  /// World speed in chars/s at the start and its increase per second.
+  float start_speed;
+  float speed_increase;
+} agent_level_info;
+
+/// @brief One pipe, columns and rows are inclusive.
+typedef struct agent_pipe_obs {
+  /// Columns the pipe collides in, end caps included.
+  int left;
+  int right;
+  /// First and last free row of the hole.
+  int gap_top;
+  int gap_bottom;
+} agent_pipe_obs;
+
+/// @brief Read-only view of the world, refilled in place every tick.
+typedef struct agent_observation {
+  agent_level_info level;
+  /// Ticks played since create.
+  long long tick;
+  long long clock_ms;
+  /// Bird row, fractional, and speed in m/s, positive is down.
+  float bird_position;
+  float bird_speed;
+  /// World speed in chars/s.
+  float world_speed;
+  int pipes_passed;
+  int collisions;
+  /// Nearest pipes the bird has not passed yet, ordered by distance.
+  int pipe_count;
+  agent_pipe_obs pipes[AGENT_OBS_PIPES];
+} agent_observation;
+
+/// @brief Decision of one tick.
+typedef enum agent_action { AGENT_ACTION_NONE, AGENT_ACTION_JUMP, AGENT_ACTION_QUIT } agent_action;
+
+/// @brief Entry points of a plugin.
+typedef struct agent_plugin_api {
+  int api_version;
+  const char *name;
+  /// Called before every run, returns the state passed to act or NULL on failure. Optional.
+  void *(*create)(const agent_level_info *info);
+  /// Called every tick, must not block.
+  agent_action (*act)(void *state, const agent_observation *obs);
+  /// Releases the state of create. Optional.
+  void (*destroy)(void *state);
+} agent_plugin_api;
+
+#endif  // FLAPPYBIRD_AGENT_API_H
@@ -0,0 +1,34 @@
+// Copyright 2022 <Maros Varchola - mvarchdev>
+
+#ifndef FLAPPYBIRD_AGENT_PLUGIN_H
+#define FLAPPYBIRD_AGENT_PLUGIN_H
+
+#include <stdbool.h>
+
+#include "flappybird/agent_api.h"
+#include "flappybird/rendering.h"
+#include "flappybird/sim.h"
+
+/// @brief Controller loaded from a shared library.
+typedef struct agent_plugin {
+  void *handle;
+  const agent_plugin_api *api;
+  /// Name the plugin reports, its path if it has none.
+  const char *name;
+  void *state;
+  bool has_state;
+  /// Reads the keyboard too, Q or E stops the run.
+  bool interactive;
+  long long jumps;
+  /// Refilled in place every tick, the plugin never sees game structures.
+  agent_observation obs;
+} agent_plugin;
+
+int agent_plugin_load(agent_plugin *agent, const char *path);
+int agent_plugin_begin(agent_plugin *agent, const level *inplvl, long long frame_ms);
+void agent_plugin_observe(agent_plugin *agent, const sim_state *sim);
+int agent_plugin_decide(agent_plugin *agent, const sim_state *sim);
+int agent_plugin_next_key(void *ctx, level_prompt prompt);
+void agent_plugin_unload(agent_plugin *agent);
+
+#endif  // FLAPPYBIRD_AGENT_PLUGIN_H
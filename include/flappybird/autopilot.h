@@ -0,0 +1,63 @@
+// Copyright 2022 <Maros Varchola - mvarchdev>
+
+#ifndef FLAPPYBIRD_AUTOPILOT_H
+#define FLAPPYBIRD_AUTOPILOT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "flappybird/rendering.h"
+#include "flappybird/sim.h"
+
+/// @brief Frames searched ahead, about 1.6 s at the shipped frame rate.
+#define AUTOPILOT_HORIZON 48
+/// @brief Bird states kept per searched frame.
+#define AUTOPILOT_BEAM 48
+/// @brief Slots of the transposition table, a power of two above twice the expanded states.
+#define AUTOPILOT_TT_SIZE 256
+/// @brief Quantization of transposition keys, states closer than this are merged.
+#define AUTOPILOT_POS_STEPS 8
+#define AUTOPILOT_SPEED_STEPS 4
+/// @brief States are ranked by where their speed carries them this many seconds later, so the
+/// beam keeps birds that are about to turn towards the hole.
+#define AUTOPILOT_LOOKAHEAD_S 0.3f
+
+/// @brief One searched bird state.
+typedef struct autopilot_node {
+  bird bird;
+  /// Action taken in the frame being decided, ' ' or EOF.
+  int first;
+  /// Distance of the projected position to the middle of the next pipe hole.
+  float cost;
+} autopilot_node;
+
+/// @brief Search counters.
+typedef struct autopilot_stats {
+  long long decisions;
+  long long nodes;
+  long long search_ns;
+} autopilot_stats;
+
+/// @brief Beam search player, decides jump or no jump every frame from the simulated future.
+typedef struct autopilot {
+  level lvl;
+  long long frame_ms;
+  /// Reads the keyboard too, Q or E stops the demo.
+  bool interactive;
+  autopilot_stats stats;
+  /// Rows where the bird collides, one mask per searched frame.
+  uint32_t blocked[AUTOPILOT_HORIZON];
+  /// Row the bird should aim for in each searched frame.
+  float target[AUTOPILOT_HORIZON];
+  autopilot_node beam[2][2 * AUTOPILOT_BEAM];
+  uint32_t tt_keys[AUTOPILOT_TT_SIZE];
+  uint32_t tt_stamps[AUTOPILOT_TT_SIZE];
+  uint32_t tt_stamp;
+} autopilot;
+
+void autopilot_init(autopilot *ap, const level *inplvl, long long frame_ms);
+int autopilot_decide(autopilot *ap, const sim_state *sim);
+int autopilot_next_key(void *ctx, level_prompt prompt);
+int autopilot_demo(int levelnum, const char *agent_path);
+
+#endif  // FLAPPYBIRD_AUTOPILOT_H
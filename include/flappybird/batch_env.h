@@ -0,0 +1,56 @@
+// Copyright 2022 <Maros Varchola - mvarchdev>
+
+#ifndef FLAPPYBIRD_BATCH_ENV_H
+#define FLAPPYBIRD_BATCH_ENV_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "flappybird/rendering.h"
+#include "flappybird/sim.h"
+
+/// @brief Pipes ahead of the bird in each observation.
+#define BATCH_OBS_PIPES 2
+/// @brief Floats per observation: bird row, bird speed, world speed, pipes seen, then per pipe
+/// its left and right column relative to the bird and the first and last free row.
+#define BATCH_OBS_SIZE (4 + 4 * BATCH_OBS_PIPES)
+/// @brief Upper bound of instances in one batch.
+#define BATCH_MAX_ENVS 65536
+/// @brief First word of the protocol header, "FBV1".
+#define BATCH_PROTOCOL_MAGIC 0x31564246u
+#define BATCH_PROTOCOL_VERSION 1
+/// @brief Action that jumps, every other byte lets the bird fall.
+#define BATCH_ACTION_JUMP 1
+
+/// @brief Options of the batch environment server.
+typedef struct batch_env_options {
+  int count;
+  int levelnum;
+  uint64_t seed;
+} batch_env_options;
+
+/// @brief Independent games stepped in lockstep. Every instance is one life, it resets itself
+/// right after its collision. Outputs are one array per field with one entry per instance.
+typedef struct batch_env {
+  int count;
+  level lvl;
+  long long frame_ms;
+  /// Draws the seed of every new episode.
+  prng seeds;
+  /// Pipes, random streams and bird of each instance.
+  sim_state *worlds;
+  /// Outputs of the last step, observations are count * BATCH_OBS_SIZE floats.
+  float *rewards;
+  uint8_t *dones;
+  float *obs;
+} batch_env;
+
+int batch_env_init(batch_env *env, const level *inplvl, int count, uint64_t seed,
+                   long long frame_ms, float gravity_constant);
+void batch_env_reset(batch_env *env, int index);
+void batch_env_step(batch_env *env, const uint8_t *actions);
+void batch_env_free(batch_env *env);
+int batch_env_parse_args(int argc, char *argv[], batch_env_options *opts);
+int run_batch_env(const batch_env_options *opts, FILE *in, FILE *out);
+
+#endif  // FLAPPYBIRD_BATCH_ENV_H
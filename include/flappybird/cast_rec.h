@@ -0,0 +1,44 @@
+// Copyright 2022 <Maros Varchola - mvarchdev>
+
+#ifndef FLAPPYBIRD_CAST_REC_H
+#define FLAPPYBIRD_CAST_REC_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+/// @brief Output collected before the game hands it to the writer thread.
+#define CAST_REC_FLUSH_BYTES (64 * 1024)
+/// @brief Longest time output stays with the game, keeps the file current on quiet screens.
+#define CAST_REC_FLUSH_NS 250000000LL
+/// @brief Size of each output buffer, allocated once. Output that does not fit while the writer
+/// thread is behind is dropped and counted, so the game never allocates or waits.
+#define CAST_REC_BUFFER_BYTES (1024 * 1024)
+/// @brief Compact mode: screens outside the gameplay loop do not mark their frames, a write
+/// after this much silence starts a new one.
+#define CAST_REC_IDLE_NS 100000000LL
+/// @brief Compact mode: unchanged cells up to this many are written again instead of skipped.
+#define CAST_REC_GAP_FILL 4
+/// @brief Screen size recorded if the size of the terminal cannot be read.
+#define CAST_REC_DEFAULT_ROWS 24
+#define CAST_REC_DEFAULT_COLS 80
+
+/// @brief What a recording has written.
+typedef struct cast_rec_stats {
+  unsigned long long events;
+  /// Terminal output the game produced.
+  unsigned long long bytes_in;
+  /// Bytes of event data in the file.
+  unsigned long long bytes_out;
+  /// Buffers passed to the writer thread.
+  unsigned long long handoffs;
+  /// Frames compact mode left out because the screen did not change.
+  unsigned long long skipped;
+  /// Terminal output lost because the writer thread fell behind.
+  unsigned long long dropped;
+} cast_rec_stats;
+
+int cast_rec_start(const char *path, bool compact);
+int cast_rec_stop(void);
+void cast_rec_print_report(FILE *out);
+
+#endif  // FLAPPYBIRD_CAST_REC_H
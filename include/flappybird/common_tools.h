@@ -3,8 +3,8 @@
 #ifndef FLAPPYBIRD_COMMON_TOOLS_H
 #define FLAPPYBIRD_COMMON_TOOLS_H
 
-unsigned int rand_gen(int min, int max);
 int msleep(long msec);
 long long timeInMilliseconds(void);
+long long timeInNanoseconds(void);
 
 #endif  // FLAPPYBIRD_COMMON_TOOLS_H
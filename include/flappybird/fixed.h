@@ -0,0 +1,21 @@
+// Copyright 2022 <Maros Varchola - mvarchdev>
+
+#ifndef FLAPPYBIRD_FIXED_H
+#define FLAPPYBIRD_FIXED_H
+
+#include <stdint.h>
+
+/// @brief Q16.16 fixed-point number. The physics run on it, so every compiler and optimization
+/// level computes the same positions and speeds.
+typedef int32_t fixed;
+
+#define FIXED_FRAC_BITS 16
+#define FIXED_ONE (1 << FIXED_FRAC_BITS)
+
+fixed fixed_from_int(int value);
+fixed fixed_from_double(double value);
+int fixed_to_int(fixed value);
+float fixed_to_float(fixed value);
+fixed fixed_scale(fixed value, long long num, long long den);
+
+#endif  // FLAPPYBIRD_FIXED_H
@@ -0,0 +1,77 @@
+// Copyright 2022 <Maros Varchola - mvarchdev>
+
+#ifndef FLAPPYBIRD_GAME_CONTEXT_H
+#define FLAPPYBIRD_GAME_CONTEXT_H
+
+#include <ncurses.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "flappybird/game_metrics.h"
+#include "flappybird/ghost.h"
+#include "flappybird/rendering.h"
+#include "flappybird/replay.h"
+#include "flappybird/rewind.h"
+#include "flappybird/sim.h"
+#include "flappybird/trajectory.h"
+
+/// @brief One game, played by run_level and drawn by the render functions. The game on the
+/// terminal and every server session have their own, nothing of a run is kept elsewhere.
+typedef struct game_context {
+  /// World of the run.
+  sim_state sim;
+  /// Window the map is drawn to, and the cell of the window the map starts at.
+  WINDOW *win;
+  int map_y;
+  int map_x;
+  /// Seed the random streams of sim were created from.
+  uint64_t seed;
+  /// Set when the seed was chosen by the player, every level then replays the same course.
+  bool seed_fixed;
+  bool rng_ready;
+  /// Seed the next run starts from instead of a new one.
+  bool next_run_seed_set;
+  uint64_t next_run_seed;
+  /// Recording of the current or last run.
+  replay run_replay;
+  /// Gameplay frames read in the current run.
+  long run_tick;
+  /// Cleared for runs kept without a replay, their memory stays flat however long they run.
+  bool run_recorded;
+  /// Collisions cost no life and the player can rewind.
+  bool practice_mode;
+  /// Collisions cost no life and the run is not recorded.
+  bool endless_mode;
+  /// The predicted flight of the bird is drawn ahead of it.
+  bool assist_mode;
+  /// Snapshots of the current life in practice mode, NULL for a game that has no practice.
+  rewind_ring *practice_ring;
+  /// Predicted flight of the bird in assist mode, NULL for a game that has no assist.
+  trajectory *assist_path;
+  /// Set when the player ended the last run in the middle of a life.
+  bool run_suspended;
+  int suspended_lives;
+  int suspended_score;
+  long suspended_tick;
+  size_t suspended_events;
+  /// Bird row of every frame of the current run, the ghost of a later run.
+  ghost_track run_ghost;
+  /// Cleared if the run did not start at its first frame.
+  bool run_ghost_complete;
+  /// Best run flown next to the live bird, NULL for none.
+  const ghost_track *shown_ghost;
+  /// Input, pacing and output of run_level.
+  level_driver driver;
+  /// Phase timings of the gameplay loop.
+  frame_profile profile;
+  /// Metrics of the last completed run.
+  run_metrics last_run_metrics;
+} game_context;
+
+/// @brief Game played on the terminal.
+extern game_context local_game;
+
+void game_context_init(game_context *ctx, float gravity_constant);
+
+#endif  // FLAPPYBIRD_GAME_CONTEXT_H
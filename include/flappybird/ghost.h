@@ -0,0 +1,55 @@
+// Copyright 2022 <Maros Varchola - mvarchdev>
+
+#ifndef FLAPPYBIRD_GHOST_H
+#define FLAPPYBIRD_GHOST_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/// @brief Magic bytes and format version at the start of a ghost file.
+#define GHOST_MAGIC "FBG1"
+/// @brief Directory with the best run of every player on every level.
+#define GHOST_DIR "./assets/ghosts"
+/// @brief Upper bound of a ghost file, two hours of play stay below.
+#define GHOST_MAX_BYTES (1 << 16)
+
+/// @brief Bird row of every frame of a run. Each frame is a 2-bit symbol for a row change of
+/// 0, +1 or -1, the fourth symbol escapes to an 8-bit zigzag change (a new life). Symbols are
+/// packed four to a byte, low bits first.
+typedef struct ghost_track {
+  int levelnum;
+  /// Seed of the course the run was played on.
+  uint64_t seed;
+  long long frame_ms;
+  int score;
+  long frames;
+  uint8_t *data;
+  /// Symbols written, the data holds (symbols + 3) / 4 bytes.
+  size_t symbols;
+  size_t capacity;
+  /// Row of the last recorded frame.
+  int last_row;
+} ghost_track;
+
+/// @brief Streaming decoder of a track, it keeps only its position and the current row.
+typedef struct ghost_reader {
+  const ghost_track *track;
+  size_t symbol;
+  long frame;
+  int row;
+} ghost_reader;
+
+int ghost_begin(ghost_track *track, int levelnum, uint64_t seed, long long frame_ms);
+int ghost_add(ghost_track *track, int row);
+void ghost_free(ghost_track *track);
+int ghost_save(const ghost_track *track, const char *path);
+int ghost_load(ghost_track *track, const char *path);
+int ghost_path(char *buf, size_t size, const char *nickname, int level);
+void ghost_reader_init(ghost_reader *rd, const ghost_track *track);
+bool ghost_reader_next(ghost_reader *rd, int *row);
+
+void set_level_ghost(const ghost_track *track);
+const ghost_track *get_last_ghost(void);
+
+#endif  // FLAPPYBIRD_GHOST_H
@@ -0,0 +1,68 @@
+// Copyright 2022 <Maros Varchola - mvarchdev>
+
+#ifndef FLAPPYBIRD_HEADLESS_H
+#define FLAPPYBIRD_HEADLESS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "flappybird/autopilot.h"
+#include "flappybird/game_metrics.h"
+#include "flappybird/rendering.h"
+#include "flappybird/term_io.h"
+#include "flappybird/vterm.h"
+
+/// @brief Default number of simulated frames.
+#define HEADLESS_DEFAULT_FRAMES 20000
+/// @brief Terminal type of the off-screen curses screen.
+#define HEADLESS_TERM_TYPE "xterm"
+
+/// @brief Options of the headless gameplay benchmark.
+typedef struct headless_options {
+  int levelnum;
+  uint64_t seed;
+  long frames;
+  render_backend renderer;
+  /// File with "<frame> <key>" lines, NULL jumps at a steady hover rhythm.
+  const char *script_path;
+  bool profile;
+  /// Feed the null renderer output into a virtual terminal.
+  bool vt;
+  /// Replay file the first run is saved to, NULL for none.
+  const char *record_path;
+  /// Let the beam search autopilot play instead of the script.
+  bool autopilot;
+  /// Controller plugin that plays instead of the script, NULL for none.
+  const char *agent_path;
+} headless_options;
+
+/// @brief Outcome of one headless play.
+typedef struct headless_result {
+  level lvl;
+  frame_profile profile;
+  long long wall_ns;
+  int runs;
+  run_metrics totals;
+  /// Terminal output written while playing.
+  term_io_counters output;
+  /// Virtual terminal parse cost and screen hashes, set with the vt option.
+  vterm_stats vt;
+  uint64_t vt_screen_hash;
+  uint64_t vt_frames_hash;
+  /// Search counters, set with the autopilot option.
+  autopilot_stats pilot;
+  /// Name of the controller plugin and the ticks it played, set with the agent option.
+  char agent_name[64];
+  long long agent_ticks;
+} headless_result;
+
+void headless_options_init(headless_options *opts);
+int headless_parse_args(int argc, char *argv[], headless_options *opts);
+void headless_print_usage(FILE *out, const char *argv0);
+int headless_begin(const headless_options *opts);
+int headless_play(const headless_options *opts, headless_result *result);
+void headless_end(const headless_options *opts);
+int run_headless(const headless_options *opts, FILE *report);
+
+#endif  // FLAPPYBIRD_HEADLESS_H
@@ -0,0 +1,29 @@
+// Copyright 2022 <Maros Varchola - mvarchdev>
+
+#ifndef FLAPPYBIRD_HOF_AUDIT_H
+#define FLAPPYBIRD_HOF_AUDIT_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "flappybird/replay.h"
+
+/// @brief Directory with the replay of every hall of fame entry.
+#define HOF_REPLAY_DIR "./assets/hof_replays"
+/// @brief Entries a worker takes from the queue at once.
+#define HOF_AUDIT_BATCH 64
+/// @brief Upper bound of audit threads.
+#define HOF_AUDIT_MAX_THREADS 256
+
+/// @brief Options of the hall of fame audit.
+typedef struct hof_audit_options {
+  /// Worker threads, 0 uses every online core.
+  int threads;
+} hof_audit_options;
+
+int hof_replay_path(char *buf, size_t size, const char *nickname, int level);
+int hof_save_replay(const char *nickname, int level, const replay *rp);
+int hof_audit_parse_args(int argc, char *argv[], hof_audit_options *opts);
+int run_hof_audit(const hof_audit_options *opts, FILE *report);
+
+#endif  // FLAPPYBIRD_HOF_AUDIT_H
@@ -0,0 +1,46 @@
+// Copyright 2022 <Maros Varchola - mvarchdev>
+
+#ifndef FLAPPYBIRD_MEM_STATS_H
+#define FLAPPYBIRD_MEM_STATS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/// @brief Environment variable that turns allocation tracking on.
+#define MEM_STATS_ENV "FLAPPYBIRD_MEMSTATS"
+
+/// @brief Subsystems heap allocations are attributed to.
+typedef enum mem_tag {
+  MEM_TAG_CONFIG,
+  MEM_TAG_HOF,
+  MEM_TAG_LEVELS,
+  MEM_TAG_RENDER,
+  MEM_TAG_COUNT
+} mem_tag;
+
+/// @brief Allocation counters of one subsystem.
+typedef struct mem_tag_stats {
+  unsigned long long allocations;
+  unsigned long long frees;
+  unsigned long long bytes_allocated;
+  long long live_bytes;
+  long long peak_live_bytes;
+} mem_tag_stats;
+
+void mem_stats_init_from_env(void);
+void mem_stats_set_enabled(bool enabled);
+bool mem_stats_enabled(void);
+mem_tag mem_stats_set_tag(mem_tag tag);
+void *mem_calloc(size_t count, size_t size);
+void mem_free(void *ptr);
+void mem_stats_count_growth(void);
+void mem_stats_enter_gameplay(void);
+void mem_stats_leave_gameplay(void);
+unsigned long long mem_stats_gameplay_allocations(void);
+mem_tag_stats mem_stats_get(mem_tag tag);
+const char *mem_stats_tag_name(mem_tag tag);
+long mem_stats_rss_kb(bool peak);
+void mem_stats_print_report(FILE *out);
+
+#endif  // FLAPPYBIRD_MEM_STATS_H
@@ -0,0 +1,59 @@
+// Copyright 2022 <Maros Varchola - mvarchdev>
+
+#ifndef FLAPPYBIRD_PARTY_H
+#define FLAPPYBIRD_PARTY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "flappybird/rendering.h"
+#include "flappybird/sim.h"
+
+/// @brief Players of one keyboard.
+#define PARTY_MIN_PLAYERS 2
+#define PARTY_MAX_PLAYERS 4
+/// @brief Jump keys in player order, far apart on the keyboard.
+#define PARTY_JUMP_KEYS " lam"
+/// @brief Gameplay time a crashed bird waits before it flies again.
+#define PARTY_RESPAWN_MS 1500
+/// @brief Longest HUD line.
+#define PARTY_HUD_LEN 64
+
+/// @brief One player of a party run.
+typedef struct party_player {
+  bird bird;
+  int lives;
+  int score;
+  int streak;
+  run_metrics metrics;
+  /// Set while the bird is in the air.
+  bool flying;
+  /// Clock the bird flies again after a crash, 0 once it is out of lives.
+  long long respawn_clock;
+} party_player;
+
+/// @brief Birds of 2 to 4 players flying through the pipes of one world. All birds share the
+/// bird column, so one set of collision rows computed from the pipes per frame serves them all.
+typedef struct party {
+  int players;
+  party_player player[PARTY_MAX_PLAYERS];
+  /// Crashes cost no life.
+  bool endless;
+  /// Collision rows of the bird column in the current frame.
+  uint32_t blocked;
+} party;
+
+void party_init(party *pt, int players, const bird *first, int lives, bool endless);
+int party_key_player(const party *pt, int ch);
+void party_jump(party *pt, int player);
+void party_move_birds(party *pt, const sim_state *sim, const level *inplvl);
+int party_collide(party *pt, const sim_state *sim);
+void party_score(party *pt, int passed_pipes);
+void party_resume(party *pt, sim_state *sim);
+bool party_over(const party *pt);
+int party_leader(const party *pt);
+void party_hud_line(const party *pt, int player, char *buf, size_t size);
+int run_party_level(game_context *ctx, level *inplvl, int players, party *pt, int *status);
+
+#endif  // FLAPPYBIRD_PARTY_H
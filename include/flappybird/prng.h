@@ -0,0 +1,38 @@
+// Copyright 2022 <Maros Varchola - mvarchdev>
+
+#ifndef FLAPPYBIRD_PRNG_H
+#define FLAPPYBIRD_PRNG_H
+
+#include <stdint.h>
+
+/// @brief xoshiro256** generator state, never all zero.
+typedef struct prng {
+  uint64_t s[4];
+} prng;
+
+/// @brief Independent random streams of one game session.
+typedef enum rng_stream {
+  RNG_STREAM_PIPE_HEIGHT,
+  RNG_STREAM_PIPE_WIDTH,
+  RNG_STREAM_PIPE_DISTANCE,
+  RNG_STREAM_EFFECTS,
+  RNG_STREAM_COUNT
+} rng_stream;
+
+/// @brief Random state of a session, every stream is 2^128 draws away from the next one.
+typedef struct rng_session {
+  uint64_t seed;
+  prng streams[RNG_STREAM_COUNT];
+} rng_session;
+
+void prng_seed(prng *rng, uint64_t seed);
+uint64_t prng_next(prng *rng);
+void prng_jump(prng *rng);
+void prng_long_jump(prng *rng);
+uint64_t prng_below(prng *rng, uint64_t bound);
+int prng_range(prng *rng, int min, int max);
+
+void rng_session_init(rng_session *session, uint64_t seed, unsigned int index);
+int rng_session_range(rng_session *session, rng_stream stream, int min, int max);
+
+#endif  // FLAPPYBIRD_PRNG_H
@@ -3,6 +3,17 @@
 #ifndef FLAPPYBIRD_PROCESSING_H
 #define FLAPPYBIRD_PROCESSING_H
 
+#include <stdbool.h>
+
+/// @brief Best score of every player on every level, keys are "<nickname>#lvl_<level>#".
+#define HALLOFFAME_FILE "./assets/hall_of_fame.conf"
+
 int run_game(void);
+void set_ghost_race(bool enabled);
+void set_party_players(int players);
+int get_last_level(const char *nickname);
+int set_last_level(const char *nickname, int level);
+int get_hall_of_fame(const char *nickname, int level);
+int set_hall_of_fame(const char *nickname, int score, int level);
 
 #endif  // FLAPPYBIRD_PROCESSING_H
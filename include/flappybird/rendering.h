@@ -5,10 +5,14 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
 
 #include "flappybird/confparser.h"
+#include "flappybird/fixed.h"
 #include "flappybird/game_metrics.h"
 #include "flappybird/game_stats.h"
+#include "flappybird/prng.h"
+#include "flappybird/replay.h"
 
 /// @brief Physics-to-render conversion coefficient (meters to characters).
 #define METERTOCHARS 0.5
@@ -20,6 +24,12 @@
 #define OUTERMARGIN 5
 #define BORDERWIDTH 1
 #define PIPEWIDTH 3
+/// @brief Pipehole end width
+#define PIPEHOLE_END_WIDTH 2
+/// @brief Pipehole end height
+#define PIPEHOLE_END_HEIGHT 1
+/// @brief Default bird x offset
+#define BIRDOFFX 30
 
 /// @brief Path to assets folder.
 #define ASSETS_FOLDER "./assets"
@@ -29,7 +39,7 @@
 #define SETTINGS_FILE SETTINGS_FOLDER "/settings.conf"
 
 /// @brief Menu item count.
-#define MENU_ITEM_COUNT 7
+#define MENU_ITEM_COUNT 8
 
 // Backward compatibility with existing identifier used across the codebase.
 #define menu_inem_n MENU_ITEM_COUNT
@@ -40,10 +50,12 @@ typedef struct fbpipe {
   int position;
   int upheight;
   int downheight;
-  long long last_time_moved;
   bool enabled;
 } fbpipe;
 
+/// @brief Maximum of piped that can be rendered at once
+#define MAX_PIPES 30
+
 /// @brief Struct to define one level.
 typedef struct level {
   int levelnumber;
@@ -53,6 +65,9 @@ typedef struct level {
   int pipe_color_body;
   float start_speed;
   float speed_increase;
+  /// World speed of endless runs, the level speeds if not set.
+  float endless_start_speed;
+  float endless_speed_increase;
   int minimum_space;
   int maximum_space;
   int minimum_width;
@@ -67,13 +82,14 @@ typedef struct level {
   bool loaded;
 } level;
 
-/// @brief Struct to define bird.
+/// @brief Struct to define bird, speeds in m/s and the row in chars.
 typedef struct bird {
-  float gravity;
-  float jump_speed;
+  fixed gravity;
+  fixed jump_speed;
   int colorbits;
-  float act_speed;
-  float act_position;
+  /// Vertical speed, negative while rising.
+  fixed act_speed;
+  fixed act_position;
   long long last_time_ms;
 } bird;
 
@@ -91,7 +107,55 @@ typedef struct render_settings {
   int fps;
 } render_settings;
 
+/// @brief Output used by the gameplay loop.
+typedef enum render_backend {
+  /// Draw to the curses screen.
+  RENDER_BACKEND_NCURSES,
+  /// Draw to an off-screen curses screen writing to /dev/null.
+  RENDER_BACKEND_NULL,
+  /// Skip drawing, collisions are computed from pipe geometry.
+  RENDER_BACKEND_NONE
+} render_backend;
+
+/// @brief Reason the gameplay loop asks for a key.
+typedef enum level_prompt {
+  /// Once per frame, ERR means no key.
+  LEVEL_PROMPT_NONE,
+  /// Game paused dialog, expects 'p' or 'e'.
+  LEVEL_PROMPT_PAUSED,
+  /// Collision dialog, expects 't' or 'e'.
+  LEVEL_PROMPT_COLLISION
+} level_prompt;
+
+/// @brief Replaces keyboard input and frame pacing of run_level.
+typedef struct level_driver {
+  /// Key source, NULL reads the keyboard.
+  int (*next_key)(void *ctx, level_prompt prompt);
+  void *ctx;
+  /// If false, frames and countdown run without sleeping.
+  bool realtime;
+  /// If true, phase timings are collected into the frame profile.
+  bool profile;
+  render_backend backend;
+} level_driver;
+
+/// @brief State of one game, defined in game_context.h.
+typedef struct game_context game_context;
+
+/// @brief Time spent in each phase of the gameplay loop.
+typedef struct frame_profile {
+  long long frames;
+  long long input_ns;
+  long long physics_ns;
+  long long render_ns;
+  long long collision_ns;
+  long long flush_ns;
+} frame_profile;
+
+short bits_to_native_color(int color);
+void init_colorpairs(void);
 int init_screen(void);
+int init_screen_term(const char *term_type, FILE *out, FILE *in);
 int render_borders(void);
 int render_header_text(int lines, int maxstring, char header_text[lines][maxstring]);
 int clear_header(bool full);
@@ -99,29 +163,49 @@ int clear_map_area(level *inplvl, bool full);
 int print_level_info(level *inplvl, int yoffset);
 int render_menu(int option_selected, const char nickname[]);
 int load_settings(void);
-fbpipe get_pipe(int x, level *inplvl, bool enable, int prevupheight);
-int render_pipe(fbpipe *inputp, level *inplvl);
-int render_bird(bird *inpb, int xpos, bool show_collision);
-bird get_bird(level *inplvl);
+fbpipe get_pipe(game_context *ctx, int x, level *inplvl, bool enable, int prevupheight);
+int render_pipe(game_context *ctx, fbpipe *inputp, level *inplvl);
+int render_bird(game_context *ctx, bird *inpb, int xpos, bool show_collision);
+bird get_bird(const game_context *ctx, level *inplvl);
 int print_header_options(int option_items_n, int maxstrlen,
                          char option_items[option_items_n][maxstrlen], int option_selected,
                          int ypos);
 int print_level_options(int option_selected);
-int move_pipes(const level *inplvl);
-int process_pipes(level *inplvl);
-int render_pipes(level *inplvl);
-int increase_speed(level *inplvl);
-bool bird_collision(bird *inpb, int xpos);
-int move_bird(bird *bird);
-int run_level(level *inplvl, int *status);
-int print_game_details(int actlives, int score, level *inplvl, bird *inpb);
+int move_pipes(game_context *ctx, const level *inplvl);
+int process_pipes(game_context *ctx, level *inplvl);
+int render_pipes(game_context *ctx, level *inplvl);
+int init_speed(game_context *ctx, level *inplvl);
+int increase_speed(game_context *ctx, level *inplvl);
+void clear_all_pipes(game_context *ctx);
+bool bird_hits_pipes(const game_context *ctx, const bird *inpb, int xpos);
+int move_bird(game_context *ctx, bird *bird);
+int run_level(game_context *ctx, level *inplvl, int *status);
+void set_level_driver(const level_driver *driver);
+void set_level_backend(render_backend backend);
+void set_practice_mode(bool enabled);
+bool practice_mode_enabled(void);
+void set_endless_mode(bool enabled);
+bool endless_mode_enabled(void);
+void set_assist_mode(bool enabled);
+const replay *get_last_replay(void);
+frame_profile get_frame_profile(void);
+void reset_frame_profile(void);
+long long game_clock_ms(void);
+long long frame_period_ms(void);
+void advance_game_clock(long long ms);
+void seed_game_rng(uint64_t seed, bool fixed);
+void set_next_run_seed(uint64_t seed);
+uint64_t get_game_seed(void);
+bool game_seed_is_fixed(void);
+int game_rand(rng_stream stream, int min, int max);
+int print_game_details(game_context *ctx, int actlives, int score, level *inplvl, bird *inpb);
 level load_level_file(int levelnum);
 int render_header_string(const char *header_text, int yoff, bool setcolor, bool cl_hdr);
 void turn_on_header_color(bool switchbgfg);
 void turn_off_header_color(bool switchbgfg);
 int render_about_page(int yoffset);
 bool render_hof(config_option_t hoff, int yoff, bool dofree, const char actnickname[64]);
-int render_bird_floating(level *inplvl, int degrees);
+int render_bird_floating(game_context *ctx, level *inplvl, int degrees);
 run_metrics get_last_run_metrics(void);
 int render_stats_page(const game_stats *stats, const run_metrics *last_run, const char *nickname,
                       int yoffset);
@@ -0,0 +1,60 @@
+// Copyright 2022 <Maros Varchola - mvarchdev>
+
+#ifndef FLAPPYBIRD_REPLAY_H
+#define FLAPPYBIRD_REPLAY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/// @brief Magic bytes and format version at the start of a replay file.
+#define REPLAY_MAGIC "FBR2"
+/// @brief Replay of the last run played from the menu.
+#define REPLAY_LAST_FILE "./assets/last_replay.fbr"
+/// @brief Upper bound of a replay file, a run with a key on every frame of an hour stays below.
+#define REPLAY_MAX_BYTES (1 << 20)
+
+/// @brief One key read by the gameplay loop or one of its dialogs.
+typedef struct replay_event {
+  long tick;
+  int key;
+} replay_event;
+
+/// @brief Everything needed to play a run again: the course comes from the seed, the rest
+/// from the keys.
+typedef struct replay {
+  int levelnum;
+  uint64_t seed;
+  long long frame_ms;
+  /// Gameplay frames of the run.
+  long ticks;
+  int score;
+  replay_event *events;
+  size_t count;
+  size_t capacity;
+} replay;
+
+/// @brief Options of replay playback.
+typedef struct replay_options {
+  const char *path;
+  /// Playback speed relative to real time.
+  double speed;
+  /// Simulate without rendering or pacing and print a JSON summary.
+  bool fast_forward;
+} replay_options;
+
+int replay_begin(replay *rp, int levelnum, uint64_t seed, long long frame_ms);
+int replay_add(replay *rp, long tick, int key);
+void replay_free(replay *rp);
+size_t replay_encode(const replay *rp, uint8_t *buf, size_t size);
+int replay_decode(replay *rp, const uint8_t *buf, size_t size);
+int replay_save(const replay *rp, const char *path);
+int replay_load(replay *rp, const char *path);
+
+int replay_parse_args(int argc, char *argv[], replay_options *opts);
+int play_replay(const replay_options *opts, FILE *report);
+int watch_replay(const char *path);
+int replay_render(const replay *rp, int *score);
+
+#endif  // FLAPPYBIRD_REPLAY_H
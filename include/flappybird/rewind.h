@@ -0,0 +1,38 @@
+// Copyright 2022 <Maros Varchola - mvarchdev>
+
+#ifndef FLAPPYBIRD_REWIND_H
+#define FLAPPYBIRD_REWIND_H
+
+#include <stdbool.h>
+
+#include "flappybird/sim.h"
+
+/// @brief Frames between two snapshots of practice mode.
+#define REWIND_SNAPSHOT_FRAMES 5
+/// @brief Snapshots kept, about 10 s of gameplay at the default frame rate.
+#define REWIND_SLOTS 64
+/// @brief Gameplay time one rewind goes back.
+#define REWIND_SECONDS 3
+
+/// @brief Everything a run needs to continue from one frame: the world with bird, pipes,
+/// speed and random streams, and the score. Plain data, so taking it is one copy.
+typedef struct game_snapshot {
+  sim_state sim;
+  int score;
+  /// Frame of the timeline the snapshot was taken at, before its key was read.
+  long frame;
+} game_snapshot;
+
+/// @brief Fixed ring of snapshots, the oldest is overwritten once it is full.
+typedef struct rewind_ring {
+  game_snapshot slots[REWIND_SLOTS];
+  /// Slot of the newest snapshot.
+  int newest;
+  int count;
+} rewind_ring;
+
+void rewind_reset(rewind_ring *ring);
+bool rewind_record(rewind_ring *ring, const sim_state *sim, int score, long frame);
+long rewind_restore(rewind_ring *ring, long target_frame, sim_state *sim, int *score);
+
+#endif  // FLAPPYBIRD_REWIND_H
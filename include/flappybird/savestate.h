@@ -0,0 +1,44 @@
+// Copyright 2022 <Maros Varchola - mvarchdev>
+
+#ifndef FLAPPYBIRD_SAVESTATE_H
+#define FLAPPYBIRD_SAVESTATE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "flappybird/replay.h"
+#include "flappybird/sim.h"
+
+/// @brief Magic bytes and format version at the start of a save-state file.
+#define SAVESTATE_MAGIC "FBS2"
+/// @brief Directory with the suspended run of every player.
+#define SAVESTATE_DIR "./assets/suspended"
+/// @brief Upper bound of a save-state file, the keys of the run make up most of it.
+#define SAVESTATE_MAX_BYTES (REPLAY_MAX_BYTES + 4096)
+
+/// @brief A run suspended in the middle of a frame. The world is taken before the key of that
+/// frame was handled, so the resumed run reads the next key for the same frame.
+typedef struct run_save {
+  int levelnum;
+  int lives;
+  int score;
+  /// Gameplay frames read before the suspended frame.
+  long tick;
+  sim_state sim;
+  /// Keys of the run so far, a finished resumed run keeps one replay from the start.
+  replay rp;
+} run_save;
+
+size_t savestate_encode(const run_save *save, uint8_t *buf, size_t size);
+int savestate_decode(run_save *save, const uint8_t *buf, size_t size);
+int savestate_save(const run_save *save, const char *path);
+int savestate_load(run_save *save, const char *path);
+void savestate_free(run_save *save);
+int savestate_path(char *buf, size_t size, const char *nickname);
+
+bool get_suspended_run(run_save *out);
+void end_suspended_run(void);
+int resume_level(game_context *ctx, level *inplvl, const run_save *save, int *status);
+
+#endif  // FLAPPYBIRD_SAVESTATE_H
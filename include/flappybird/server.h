@@ -0,0 +1,35 @@
+// Copyright 2022 <Maros Varchola - mvarchdev>
+
+#ifndef FLAPPYBIRD_SERVER_H
+#define FLAPPYBIRD_SERVER_H
+
+#include <stdio.h>
+
+#include "flappybird/rendering.h"
+
+/// @brief Sessions hosted when no limit is given.
+#define SERVER_DEFAULT_SESSIONS 256
+/// @brief Upper bound of the session limit.
+#define SERVER_MAX_SESSIONS 4096
+/// @brief Levels offered in the lobby, level_1 up to the first missing file.
+#define SERVER_MAX_LEVELS 9
+/// @brief Keys buffered per session between two frames.
+#define SERVER_KEY_QUEUE 16
+/// @brief Text screen of a session: header, top border, map rows, bottom border.
+#define SERVER_SCREEN_ROWS (MAPSIZEY + 3)
+#define SERVER_SCREEN_COLS (MAPSIZEX + 2)
+/// @brief Pending output per session, a client that falls further behind skips frames.
+#define SERVER_OUT_BUFFER 16384
+
+/// @brief Options of the multi-session server.
+typedef struct server_options {
+  const char *socket_path;
+  int max_sessions;
+} server_options;
+
+int server_parse_args(int argc, char *argv[], server_options *opts);
+int run_server(const server_options *opts, FILE *report);
+int client_parse_args(int argc, char *argv[], const char **socket_path);
+int run_client(const char *socket_path);
+
+#endif  // FLAPPYBIRD_SERVER_H
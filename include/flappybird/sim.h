@@ -0,0 +1,86 @@
+// Copyright 2022 <Maros Varchola - mvarchdev>
+
+#ifndef FLAPPYBIRD_SIM_H
+#define FLAPPYBIRD_SIM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "flappybird/fixed.h"
+#include "flappybird/game_metrics.h"
+#include "flappybird/prng.h"
+#include "flappybird/rendering.h"
+#include "flappybird/replay.h"
+
+/// @brief Gameplay time the world speed keeps rising in endless runs, it stays flat after.
+#define ENDLESS_RAMP_MS 180000
+/// @brief Course generated ahead of the right map edge in endless runs, one chunk at a time.
+#define ENDLESS_CHUNK_CHARS MAPSIZEX
+
+/// @brief Integer world coordinates of endless runs. Speed and distance are computed from
+/// whole numbers, so hours of play accumulate no rounding.
+typedef struct endless_world {
+  bool enabled;
+  /// World speed at the start of the run, in 1/1000 chars per s.
+  long long start_speed;
+  /// Speed gained per minute of gameplay, in 1/1000 chars per s.
+  long long speed_per_min;
+  /// Clock when the run started and of the last move, 0 before the first move.
+  long long start_clock;
+  long long last_clock;
+  /// Distance scrolled in 1/1000000 chars.
+  long long distance;
+} endless_world;
+
+/// @brief World state of one run. The physics functions touch nothing else, so runs on
+/// separate states can be simulated on separate threads.
+typedef struct sim_state {
+  fbpipe pipes[MAX_PIPES];
+  rng_session rng;
+  /// Gameplay clock in ms, 0 marks unset timestamps.
+  long long clock;
+  /// Clock of the last speed increase, 0 restarts the measurement.
+  long long last_speed_time;
+  /// Gameplay time the world speed has been rising for.
+  long long speed_ms;
+  /// World speed in chars/s.
+  fixed speed_chars;
+  /// Clock of the last world move, 0 restarts the measurement.
+  long long last_move_time;
+  /// Part of a char the world moved that the pipes did not move yet, in 1/1000 fixed units.
+  long long scroll;
+  float gravity_constant;
+  int score_streak;
+  int score_multiplier;
+  run_metrics metrics;
+  /// Bird of the current life.
+  bird bird;
+  endless_world endless;
+} sim_state;
+
+void sim_init(sim_state *sim, float gravity_constant);
+void sim_reset(sim_state *sim, const level *inplvl, uint64_t seed);
+void sim_start_endless(sim_state *sim, const level *inplvl);
+fixed sim_start_speed(const level *inplvl);
+long long sim_endless_chars(const sim_state *sim);
+void sim_clear_pipes(sim_state *sim);
+bird sim_get_bird(const sim_state *sim, const level *inplvl);
+void jump_bird(bird *inpb);
+int sim_move_bird(const sim_state *sim, bird *inpb);
+int bird_advance(bird *inpb, long long act_time);
+bool sim_pipe_covers_cell(const fbpipe *inputp, int y, int x);
+bool sim_bird_hits_pipes(const sim_state *sim, const bird *inpb, int xpos);
+uint32_t sim_blocked_rows(const sim_state *sim, int xpos);
+fbpipe sim_get_pipe(sim_state *sim, int x, const level *inplvl, bool enable, int prevupheight);
+int sim_move_pipes(sim_state *sim, const level *inplvl);
+int sim_process_pipes(sim_state *sim, const level *inplvl);
+int sim_increase_speed(sim_state *sim, const level *inplvl);
+int sim_streak_multiplier(int streak);
+int sim_score_pipes(sim_state *sim, int passed_pipes);
+void sim_collide(sim_state *sim);
+void sim_resume(sim_state *sim, bird *inpb);
+int sim_step(sim_state *sim, const level *inplvl, long long frame_ms);
+int sim_next_pipes(const sim_state *sim, const fbpipe **out, int max);
+int sim_run_replay(sim_state *sim, const level *inplvl, const replay *rp, int *score);
+
+#endif  // FLAPPYBIRD_SIM_H
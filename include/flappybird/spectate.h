@@ -0,0 +1,50 @@
+// Copyright 2022 <Maros Varchola - mvarchdev>
+
+#ifndef FLAPPYBIRD_SPECTATE_H
+#define FLAPPYBIRD_SPECTATE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/// @brief POSIX shared memory object the game publishes its screen to.
+#define SPECTATE_SHM_NAME "/flappy_bird_spectate"
+/// @brief First word of the shared memory, "FSP1".
+#define SPECTATE_MAGIC 0x31505346u
+#define SPECTATE_VERSION 1
+/// @brief Frames kept in the ring, a reader is only disturbed if the game laps it.
+#define SPECTATE_SLOTS 4
+/// @brief Largest screen that is mirrored, larger screens are cut.
+#define SPECTATE_MAX_ROWS 128
+#define SPECTATE_MAX_COLS 320
+
+/// @brief One screen in the ring. seq is odd while the game writes the slot.
+typedef struct spectate_slot {
+  _Atomic uint32_t seq;
+  uint16_t rows;
+  uint16_t cols;
+  uint64_t frame;
+  /// Curses cells row by row: character, attributes and color pair.
+  uint32_t cells[SPECTATE_MAX_ROWS * SPECTATE_MAX_COLS];
+} spectate_slot;
+
+/// @brief Layout of the shared memory object.
+typedef struct spectate_feed {
+  uint32_t magic;
+  uint32_t version;
+  /// Slot of the newest complete frame.
+  _Atomic uint32_t latest;
+  /// Cleared when the game exits.
+  _Atomic uint32_t live;
+  /// Frames published so far, only the game writes it.
+  uint64_t published;
+  spectate_slot slots[SPECTATE_SLOTS];
+} spectate_feed;
+
+void spectate_publish_frame(spectate_feed *feed);
+int spectate_publish_start(void);
+void spectate_publish_stop(void);
+bool spectate_read_latest(const spectate_feed *feed, spectate_slot *out);
+int run_spectator(void);
+
+#endif  // FLAPPYBIRD_SPECTATE_H
@@ -0,0 +1,67 @@
+// Copyright 2022 <Maros Varchola - mvarchdev>
+
+#ifndef FLAPPYBIRD_SPRITE_H
+#define FLAPPYBIRD_SPRITE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "flappybird/fixed.h"
+
+/// @brief Sprite of the bird, the built-in bird is used if it is missing or broken.
+#define BIRD_SPRITE_FILE "./assets/sprites/bird.sprite"
+/// @brief Largest sprite file read.
+#define SPRITE_MAX_BYTES 4096
+#define SPRITE_MAX_FRAMES 8
+#define SPRITE_MAX_ROWS 5
+#define SPRITE_MAX_COLS 16
+/// @brief Glyph runs of one frame, a row of SPRITE_MAX_COLS cells has at most half as many.
+#define SPRITE_MAX_RUNS (SPRITE_MAX_ROWS * SPRITE_MAX_COLS / 2)
+/// @brief Rows of a shape covering frames with different anchor rows.
+#define SPRITE_SHAPE_ROWS (2 * SPRITE_MAX_ROWS - 1)
+/// @brief Bit of an occupancy row that holds the bird column, bit b is column xpos + b - 15.
+#define SPRITE_ANCHOR_BIT 15
+/// @brief Cell of a sprite row that is not part of the bird.
+#define SPRITE_TRANSPARENT '.'
+
+/// @brief Collision shape, one occupancy mask per row.
+typedef struct sprite_shape {
+  /// Row of the first mask relative to the bird row, negative above it.
+  int top;
+  int rows;
+  uint32_t mask[SPRITE_SHAPE_ROWS];
+} sprite_shape;
+
+/// @brief Cells of one row next to each other, drawn with one call.
+typedef struct sprite_run {
+  int dy;
+  int dx;
+  int len;
+  char glyphs[SPRITE_MAX_COLS + 1];
+} sprite_run;
+
+/// @brief One picture of the bird.
+typedef struct sprite_frame {
+  /// Vertical speed the frame is used from in m/s, up to the one of the next frame.
+  fixed min_speed;
+  sprite_shape shape;
+  sprite_run runs[SPRITE_MAX_RUNS];
+  int run_count;
+} sprite_frame;
+
+/// @brief Frames of a sprite in order of their speed.
+typedef struct sprite_set {
+  sprite_frame frames[SPRITE_MAX_FRAMES];
+  int count;
+  /// Cells of all frames together, for planners that do not know the speed of a row.
+  sprite_shape any;
+} sprite_set;
+
+int sprite_parse(sprite_set *set, const char *text);
+int sprite_load(sprite_set *set, const char *path);
+const sprite_frame *sprite_pick(const sprite_set *set, fixed speed);
+const sprite_set *bird_sprite(void);
+void set_bird_sprite(const sprite_set *set);
+
+#endif  // FLAPPYBIRD_SPRITE_H
@@ -0,0 +1,60 @@
+// Copyright 2022 <Maros Varchola - mvarchdev>
+
+#ifndef FLAPPYBIRD_TERM_IO_H
+#define FLAPPYBIRD_TERM_IO_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+/// @brief Number of levels that get their own output counters.
+#define TERM_IO_MAX_LEVELS 16
+/// @brief Sinks that can receive the output at the same time.
+#define TERM_IO_MAX_SINKS 4
+
+/// @brief Screens that terminal output is attributed to.
+typedef enum term_io_screen {
+  TERM_IO_SCREEN_STARTUP,
+  TERM_IO_SCREEN_NICKNAME,
+  TERM_IO_SCREEN_MENU,
+  TERM_IO_SCREEN_LEVEL_SELECT,
+  TERM_IO_SCREEN_GAMEPLAY,
+  TERM_IO_SCREEN_HALL_OF_FAME,
+  TERM_IO_SCREEN_STATISTICS,
+  TERM_IO_SCREEN_ABOUT,
+  TERM_IO_SCREEN_COUNT
+} term_io_screen;
+
+/// @brief Accumulated terminal output counters.
+typedef struct term_io_counters {
+  unsigned long long bytes;
+  unsigned long long writes;
+  unsigned long long escapes;
+  unsigned long long frames;
+  unsigned long long max_frame_bytes;
+} term_io_counters;
+
+/// @brief Consumer of the bytes written to the terminal, e.g. a virtual terminal.
+typedef struct term_io_sink {
+  void (*write)(void *ctx, const char *data, size_t len);
+  /// Called after each accounted frame, may be NULL.
+  void (*end_frame)(void *ctx);
+  void *ctx;
+} term_io_sink;
+
+bool term_io_attach(int fd);
+bool term_io_available(void);
+bool term_io_add_sink(const term_io_sink *sink);
+void term_io_remove_sink(const void *ctx);
+void term_io_set_screen(term_io_screen screen);
+term_io_screen term_io_get_screen(void);
+void term_io_end_frame(void);
+void term_io_begin_level(int levelnum);
+void term_io_end_level(void);
+term_io_counters term_io_total(void);
+term_io_counters term_io_last_frame(void);
+term_io_counters term_io_screen_counters(term_io_screen screen);
+term_io_counters term_io_level_counters(int levelnum);
+const char *term_io_screen_name(term_io_screen screen);
+void term_io_print_report(FILE *out);
+
+#endif  // FLAPPYBIRD_TERM_IO_H
@@ -0,0 +1,66 @@
+// Copyright 2022 <Maros Varchola - mvarchdev>
+
+#ifndef FLAPPYBIRD_TRAJECTORY_H
+#define FLAPPYBIRD_TRAJECTORY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "flappybird/rendering.h"
+#include "flappybird/sim.h"
+
+/// @brief Gameplay time the arcs look ahead.
+#define TRAJECTORY_AHEAD_MS 1500
+/// @brief Upper bound of predicted frames, for low frame periods.
+#define TRAJECTORY_MAX_FRAMES 64
+
+/// @brief Work done by the predictor.
+typedef struct trajectory_stats {
+  long long updates;
+  /// Updates that stepped the predicted world and the glide arc by one frame.
+  long long extends;
+  /// Glide arcs simulated again because the bird did not follow them (a key was pressed).
+  long long glide_rebuilds;
+  /// Predicted worlds simulated again, at the start of a life and after a pause.
+  long long world_rebuilds;
+} trajectory_stats;
+
+/// @brief Predicted flight of the bird for the assist overlay. Frames are kept in rings that
+/// start at the current frame. Pipes do not depend on the bird, so a shadow world runs ahead
+/// by the whole horizon and each update steps it by one frame only. The glide arc (no key)
+/// stays valid while the bird follows it and also grows by one frame. Only the short jump arc
+/// is simulated every frame.
+typedef struct trajectory {
+  level lvl;
+  long long frame_ms;
+  int frames;
+  bool valid;
+  /// Ring slot of the current frame, frames in use start there.
+  int head;
+  /// Clock of the current frame.
+  long long clock;
+  /// World at the start of the frame after the last predicted one.
+  sim_state ahead;
+  /// Chars the shadow world moved since the last rebuild.
+  long long odometer;
+  /// Collision rows of each predicted frame.
+  uint32_t blocked[TRAJECTORY_MAX_FRAMES];
+  /// Odometer of each predicted frame, places the frame on the screen of the current one.
+  long long travel[TRAJECTORY_MAX_FRAMES];
+  /// Bird after each predicted frame without a key.
+  bird glide[TRAJECTORY_MAX_FRAMES];
+  /// Map cells of the arcs in frame order, up to the first collision.
+  int glide_x[TRAJECTORY_MAX_FRAMES];
+  int glide_y[TRAJECTORY_MAX_FRAMES];
+  int glide_len;
+  int jump_x[TRAJECTORY_MAX_FRAMES];
+  int jump_y[TRAJECTORY_MAX_FRAMES];
+  int jump_len;
+  trajectory_stats stats;
+} trajectory;
+
+void trajectory_init(trajectory *tr, const level *inplvl, long long frame_ms);
+void trajectory_reset(trajectory *tr);
+void trajectory_update(trajectory *tr, const sim_state *sim);
+
+#endif  // FLAPPYBIRD_TRAJECTORY_H
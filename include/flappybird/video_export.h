@@ -0,0 +1,27 @@
+// Copyright 2022 <Maros Varchola - mvarchdev>
+
+#ifndef FLAPPYBIRD_VIDEO_EXPORT_H
+#define FLAPPYBIRD_VIDEO_EXPORT_H
+
+#include <stdio.h>
+
+/// @brief Pixels of one terminal cell, the 8x8 font is drawn with doubled rows.
+#define VIDEO_CELL_WIDTH 8
+#define VIDEO_CELL_HEIGHT 16
+/// @brief Upper bound of rasterizer threads.
+#define VIDEO_MAX_THREADS 64
+/// @brief Frames in flight per rasterizer thread, bounds memory use.
+#define VIDEO_FRAMES_PER_THREAD 2
+
+/// @brief Options of the video export.
+typedef struct video_options {
+  const char *replay_path;
+  const char *output_path;
+  /// Rasterizer threads, 0 uses every online core.
+  int threads;
+} video_options;
+
+int video_parse_args(int argc, char *argv[], video_options *opts);
+int run_video_export(const video_options *opts, FILE *report);
+
+#endif  // FLAPPYBIRD_VIDEO_EXPORT_H
@@ -0,0 +1,101 @@
+// Copyright 2022 <Maros Varchola - mvarchdev>
+
+#ifndef FLAPPYBIRD_VTERM_H
+#define FLAPPYBIRD_VTERM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "flappybird/term_io.h"
+
+/// @brief Maximum numeric parameters of one control sequence.
+#define VTERM_MAX_PARAMS 16
+/// @brief Color value of the terminal default color.
+#define VTERM_DEFAULT_COLOR -1
+
+// Cell attribute bits.
+#define VTERM_ATTR_BOLD 0x01
+#define VTERM_ATTR_DIM 0x02
+#define VTERM_ATTR_UNDERLINE 0x04
+#define VTERM_ATTR_BLINK 0x08
+#define VTERM_ATTR_REVERSE 0x10
+#define VTERM_ATTR_INVISIBLE 0x20
+
+/// @brief One character cell of the virtual screen.
+typedef struct vterm_cell {
+  uint32_t ch;
+  int16_t fg;
+  int16_t bg;
+  uint8_t attrs;
+} vterm_cell;
+
+/// @brief What the virtual terminal has consumed.
+typedef struct vterm_stats {
+  unsigned long long bytes;
+  unsigned long long printed;
+  unsigned long long controls;
+  unsigned long long sequences;
+  /// Sequences that were parsed but have no effect on the cell grid.
+  unsigned long long ignored;
+  unsigned long long scrolls;
+  unsigned long long bells;
+  unsigned long long frames;
+  long long parse_ns;
+} vterm_stats;
+
+/// @brief Parser states.
+typedef enum vterm_state {
+  VTERM_STATE_GROUND,
+  VTERM_STATE_ESCAPE,
+  VTERM_STATE_CHARSET,
+  VTERM_STATE_CSI,
+  VTERM_STATE_STRING,
+  VTERM_STATE_STRING_ESCAPE
+} vterm_state;
+
+/// @brief In-process VT100/xterm emulator holding a cell grid.
+typedef struct vterm {
+  int rows;
+  int cols;
+  vterm_cell *cells;
+
+  int cur_y;
+  int cur_x;
+  bool wrap_pending;
+  bool autowrap;
+  bool insert_mode;
+  int scroll_top;
+  int scroll_bottom;
+  int saved_y;
+  int saved_x;
+  vterm_cell pen;
+  vterm_cell saved_pen;
+  uint32_t last_ch;
+
+  vterm_state state;
+  int params[VTERM_MAX_PARAMS];
+  int param_count;
+  char private_marker;
+  uint32_t utf8_ch;
+  int utf8_left;
+
+  vterm_stats stats;
+  /// Hash chain of the screen after each frame.
+  uint64_t frames_hash;
+} vterm;
+
+int vterm_init(vterm *vt, int rows, int cols);
+void vterm_free(vterm *vt);
+int vterm_resize(vterm *vt, int rows, int cols);
+void vterm_reset(vterm *vt);
+void vterm_feed(vterm *vt, const char *data, size_t len);
+void vterm_end_frame(vterm *vt);
+const vterm_cell *vterm_cell_at(const vterm *vt, int y, int x);
+uint64_t vterm_screen_hash(const vterm *vt);
+int vterm_row_text(const vterm *vt, int y, char *buf, size_t size);
+void vterm_dump(const vterm *vt, FILE *out);
+term_io_sink vterm_sink(vterm *vt);
+
+#endif  // FLAPPYBIRD_VTERM_H
@@ -0,0 +1,39 @@
+// Copyright 2022 <Maros Varchola - mvarchdev>
+
+// Example controller plugin, build with `make plugins` and play with
+// ./flappy_bird --autopilot 1 --agent ./build/plugins/hover_agent.so
+
+#include <stdlib.h>
+
+#include "flappybird/agent_api.h"
+
+/// @brief Seconds of fall the controller looks ahead before it jumps.
+#define HOVER_LOOKAHEAD_S 0.15f
+
+typedef struct hover_state {
+  agent_level_info level;
+} hover_state;
+
+static void *hover_create(const agent_level_info *info) {
+  hover_state *state = malloc(sizeof(*state));
+  if (state)
+    state->level = *info;
+  return state;
+}
+
+/// @brief Jump when the bird is about to fall below the middle of the next hole
+static agent_action hover_act(void *ctx, const agent_observation *obs) {
+  const hover_state *state = ctx;
+  float target = state->level.map_height / 2.0f;
+  if (obs->pipe_count > 0)
+    target = (obs->pipes[0].gap_top + obs->pipes[0].gap_bottom) / 2.0f + 1.0f;
+
+  float ahead = obs->bird_speed * state->level.meter_to_chars * HOVER_LOOKAHEAD_S;
+  return obs->bird_speed > 0 && obs->bird_position + ahead > target ? AGENT_ACTION_JUMP
+                                                                     : AGENT_ACTION_NONE;
+}
+
+static void hover_destroy(void *ctx) { free(ctx); }
+
+const agent_plugin_api flappy_agent_plugin = {AGENT_API_VERSION, "hover", hover_create, hover_act,
+                                              hover_destroy};
@@ -0,0 +1,139 @@
+// Copyright 2022 <Maros Varchola - mvarchdev>
+
+#include "flappybird/agent_plugin.h"
+
+#include <dlfcn.h>
+#include <ncurses.h>
+#include <string.h>
+
+#include "flappybird/game_context.h"
+
+/// @brief Open a controller plugin and check its interface version
+/// @param agent Plugin to fill
+/// @param path Path of the shared library, without a '/' the loader search path is used
+/// @return Error code
+int agent_plugin_load(agent_plugin *agent, const char *path) {
+  memset(agent, 0, sizeof(*agent));
+  agent->handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+  if (agent->handle == NULL) {
+    fprintf(stderr, "Cannot load agent %s: %s\n", path, dlerror());
+    return -1;
+  }
+  agent->api = dlsym(agent->handle, AGENT_PLUGIN_SYMBOL);
+  if (agent->api == NULL || agent->api->act == NULL) {
+    fprintf(stderr, "Agent %s does not export " AGENT_PLUGIN_SYMBOL ".\n", path);
+    agent_plugin_unload(agent);
+    return -1;
+  }
+  if (agent->api->api_version != AGENT_API_VERSION) {
+    fprintf(stderr, "Agent %s uses interface version %d, expected %d.\n", path,
+            agent->api->api_version, AGENT_API_VERSION);
+    agent_plugin_unload(agent);
+    return -1;
+  }
+  agent->name = agent->api->name ? agent->api->name : path;
+  return 0;
+}
+
+static void release_state(agent_plugin *agent) {
+  if (agent->has_state && agent->api->destroy)
+    agent->api->destroy(agent->state);
+  agent->state = NULL;
+  agent->has_state = false;
+}
+
+/// @brief Start a controller on a level, the previous controller state is released
+/// @param agent Loaded plugin
+/// @param inplvl Level to play
+/// @param frame_ms Gameplay time of one frame
+/// @return Error code, -1 if the plugin could not create its state
+int agent_plugin_begin(agent_plugin *agent, const level *inplvl, long long frame_ms) {
+  release_state(agent);
+  memset(&agent->obs, 0, sizeof(agent->obs));
+  agent->jumps = 0;
+
+  agent_level_info *info = &agent->obs.level;
+  bird tmpb = sim_get_bird(&local_game.sim, inplvl);
+  info->levelnumber = inplvl->levelnumber;
+  info->max_lives = inplvl->max_lives;
+  info->map_width = MAPSIZEX;
+  info->map_height = MAPSIZEY;
+  info->bird_x = BIRDOFFX;
+  info->frame_ms = frame_ms;
+  info->gravity = fixed_to_float(tmpb.gravity);
+  info->jump_speed = fixed_to_float(tmpb.jump_speed);
+  info->meter_to_chars = METERTOCHARS;
+  info->start_speed = inplvl->start_speed;
+  info->speed_increase = inplvl->speed_increase;
+
+  if (agent->api->create) {
+    agent->state = agent->api->create(info);
+    if (agent->state == NULL)
+      return -1;
+    agent->has_state = true;
+  }
+  return 0;
+}
+
+/// @brief Refill the observation from a world, touches no memory outside the plugin struct
+/// @param agent Started plugin
+/// @param sim World at the start of the frame
+void agent_plugin_observe(agent_plugin *agent, const sim_state *sim) {
+  agent_observation *obs = &agent->obs;
+  obs->clock_ms = sim->clock;
+  obs->bird_position = fixed_to_float(sim->bird.act_position);
+  obs->bird_speed = fixed_to_float(sim->bird.act_speed);
+  obs->world_speed = fixed_to_float(sim->speed_chars);
+  obs->pipes_passed = sim->metrics.pipes_passed;
+  obs->collisions = sim->metrics.collisions;
+
+  const fbpipe *next[AGENT_OBS_PIPES];
+  obs->pipe_count = sim_next_pipes(sim, next, AGENT_OBS_PIPES);
+  for (int i = 0; i < obs->pipe_count; i++) {
+    obs->pipes[i].left = next[i]->position - PIPEHOLE_END_WIDTH;
+    obs->pipes[i].right = next[i]->position + next[i]->pipewidth + 1 + PIPEHOLE_END_WIDTH;
+    obs->pipes[i].gap_top = next[i]->upheight + PIPEHOLE_END_HEIGHT + 1;
+    obs->pipes[i].gap_bottom = MAPSIZEY - next[i]->downheight - PIPEHOLE_END_HEIGHT - 2;
+  }
+}
+
+/// @brief Ask the plugin for the action of the current frame
+/// @param agent Started plugin
+/// @param sim World at the start of the frame, before the key is read
+/// @return ' ' to jump, 'e' to end the run, ERR for no key
+int agent_plugin_decide(agent_plugin *agent, const sim_state *sim) {
+  agent_plugin_observe(agent, sim);
+  agent_action action = agent->api->act(agent->state, &agent->obs);
+  agent->obs.tick++;
+  if (action == AGENT_ACTION_JUMP) {
+    agent->jumps++;
+    return ' ';
+  }
+  return action == AGENT_ACTION_QUIT ? 'e' : ERR;
+}
+
+/// @brief Key source of run_level driven by a plugin, continues after collisions
+int agent_plugin_next_key(void *ctx, level_prompt prompt) {
+  agent_plugin *agent = ctx;
+  if (prompt == LEVEL_PROMPT_PAUSED)
+    return 'p';
+  if (prompt == LEVEL_PROMPT_COLLISION)
+    return 't';
+  if (agent->interactive) {
+    int ch = getch();
+    if (ch == 'q' || ch == 'Q' || ch == 'e' || ch == 'E')
+      return 'e';
+  }
+  return agent_plugin_decide(agent, &local_game.sim);
+}
+
+/// @brief Release the controller state and close the library
+/// @param agent Plugin, may be partially loaded
+void agent_plugin_unload(agent_plugin *agent) {
+  if (agent->api)
+    release_state(agent);
+  if (agent->handle)
+    dlclose(agent->handle);
+  agent->handle = NULL;
+  agent->api = NULL;
+}
@@ -0,0 +1,225 @@
+// Copyright 2022 <Maros Varchola - mvarchdev>
+
+#include "flappybird/autopilot.h"
+
+#include <math.h>
+#include <ncurses.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "flappybird/agent_plugin.h"
+#include "flappybird/common_tools.h"
+#include "flappybird/game_context.h"
+
+/// @brief Prepare a player for a level
+/// @param ap Autopilot
+/// @param inplvl Level to play, copied
+/// @param frame_ms Gameplay time of one frame
+void autopilot_init(autopilot *ap, const level *inplvl, long long frame_ms) {
+  memset(ap, 0, sizeof(*ap));
+  ap->lvl = *inplvl;
+  ap->frame_ms = frame_ms;
+}
+
+/// @brief Middle of the hole of the first pipe the bird has not passed yet
+static float target_row(const sim_state *world) {
+  const fbpipe *next = NULL;
+  for (int i = 0; i < MAX_PIPES; i++) {
+    const fbpipe *pipe = &world->pipes[i];
+    if (!pipe->enabled || pipe->position + pipe->pipewidth + 1 + PIPEHOLE_END_WIDTH < BIRDOFFX - 2)
+      continue;
+    if (!next || pipe->position < next->position)
+      next = pipe;
+  }
+  if (!next)
+    return MAPSIZEY / 2.0f;
+  return (next->upheight + (MAPSIZEY - next->downheight)) / 2.0f;
+}
+
+/// @brief Insert a state into the transposition table of the current frame
+/// @return False if a state with the same quantized height and speed is already there
+static bool tt_insert(autopilot *ap, const bird *inpb) {
+  uint32_t pos = (uint32_t)fixed_to_int(inpb->act_position * AUTOPILOT_POS_STEPS);
+  uint32_t speed = (uint32_t)fixed_to_int(inpb->act_speed * AUTOPILOT_SPEED_STEPS);
+  uint32_t key = (pos << 16) ^ (speed & 0xffff);
+  uint32_t slot = (key * 2654435761u) & (AUTOPILOT_TT_SIZE - 1);
+  while (ap->tt_stamps[slot] == ap->tt_stamp) {
+    if (ap->tt_keys[slot] == key)
+      return false;
+    slot = (slot + 1) & (AUTOPILOT_TT_SIZE - 1);
+  }
+  ap->tt_stamps[slot] = ap->tt_stamp;
+  ap->tt_keys[slot] = key;
+  return true;
+}
+
+static void tt_clear(autopilot *ap) {
+  if (++ap->tt_stamp == 0) {
+    memset(ap->tt_stamps, 0, sizeof(ap->tt_stamps));
+    ap->tt_stamp = 1;
+  }
+}
+
+static int compare_nodes(const void *a, const void *b) {
+  const autopilot_node *lhs = a;
+  const autopilot_node *rhs = b;
+  return (lhs->cost > rhs->cost) - (lhs->cost < rhs->cost);
+}
+
+/// @brief Pick the action of the current frame by a beam search over bird states. Pipes do
+/// not depend on the bird, so the future world is simulated once and every searched state is
+/// checked against the collision rows of its frame.
+/// @param ap Autopilot
+/// @param sim World at the start of the frame, before the key is read
+/// @return ' ' to jump, EOF to let the bird fall
+int autopilot_decide(autopilot *ap, const sim_state *sim) {
+  long long start = timeInNanoseconds();
+  sim_state world = *sim;
+  for (int k = 0; k < AUTOPILOT_HORIZON; k++) {
+    ap->blocked[k] = sim_blocked_rows(&world, BIRDOFFX);
+    ap->target[k] = target_row(&world);
+    sim_move_pipes(&world, &ap->lvl);
+    sim_process_pipes(&world, &ap->lvl);
+    sim_increase_speed(&world, &ap->lvl);
+    world.clock += ap->frame_ms;
+  }
+
+  const int actions[2] = {EOF, ' '};
+  autopilot_node *cur = ap->beam[0];
+  cur[0].bird = sim->bird;
+  cur[0].first = EOF;
+  int count = 1;
+  int decision = EOF;
+  for (int k = 0; k < AUTOPILOT_HORIZON; k++) {
+    autopilot_node *next = ap->beam[(k + 1) & 1];
+    long long clock = sim->clock + k * ap->frame_ms;
+    int expanded = 0;
+    tt_clear(ap);
+    for (int i = 0; i < count; i++) {
+      for (int a = 0; a < 2; a++) {
+        autopilot_node node = cur[i];
+        if (actions[a] == ' ')
+          jump_bird(&node.bird);
+        bird_advance(&node.bird, clock);
+        ap->stats.nodes++;
+        if (ap->blocked[k] & (1u << fixed_to_int(node.bird.act_position)) ||
+            !tt_insert(ap, &node.bird))
+          continue;
+        node.first = k == 0 ? actions[a] : cur[i].first;
+        float ahead = fixed_to_float(node.bird.act_speed) * METERTOCHARS * AUTOPILOT_LOOKAHEAD_S;
+        node.cost = fabsf(fixed_to_float(node.bird.act_position) + ahead - ap->target[k]);
+        next[expanded++] = node;
+      }
+    }
+    // No state survives this frame, keep the action that survived longest.
+    if (expanded == 0)
+      break;
+    qsort(next, (size_t)expanded, sizeof(next[0]), compare_nodes);
+    count = expanded < AUTOPILOT_BEAM ? expanded : AUTOPILOT_BEAM;
+    cur = next;
+    decision = cur[0].first;
+  }
+
+  ap->stats.decisions++;
+  ap->stats.search_ns += timeInNanoseconds() - start;
+  return decision;
+}
+
+/// @brief Key source of run_level, jumps when the search says so and continues after
+/// collisions
+int autopilot_next_key(void *ctx, level_prompt prompt) {
+  autopilot *ap = ctx;
+  if (prompt == LEVEL_PROMPT_PAUSED)
+    return 'p';
+  if (prompt == LEVEL_PROMPT_COLLISION)
+    return 't';
+  if (ap->interactive) {
+    int ch = getch();
+    if (ch == 'q' || ch == 'Q' || ch == 'e' || ch == 'E')
+      return 'e';
+  }
+  return autopilot_decide(ap, &local_game.sim);
+}
+
+/// @brief Play a level on screen with a bot as the key source and print the start of the
+/// JSON report
+/// @return Score, -1 if the screen cannot be initialized
+static int run_demo(level *inplvl, const level_driver *driver, const char *name) {
+  if (init_screen() != 0) {
+    fprintf(stderr, "Failed to initialize screen.\n");
+    return -1;
+  }
+  set_level_driver(driver);
+  int status = 0;
+  int score = run_level(&local_game, inplvl, &status);
+  set_level_driver(NULL);
+
+  char message[80] = {0};
+  snprintf(message, sizeof(message), "%s scored %d on level %d.", name, score,
+           inplvl->levelnumber);
+  render_header_string(message, 0, true, true);
+  refresh();
+  msleep(1500);
+  endwin();
+
+  run_metrics metrics = get_last_run_metrics();
+  printf("{\n  \"mode\": \"autopilot\",\n  \"level\": %d,\n  \"score\": %d,\n",
+         inplvl->levelnumber, score);
+  printf("  \"pipes_passed\": %d,\n  \"collisions\": %d,\n  \"jumps\": %d", metrics.pipes_passed,
+         metrics.collisions, metrics.jumps);
+  return score;
+}
+
+/// @brief Let a controller plugin play a level in the terminal in real time
+static int agent_demo(level *inplvl, const char *agent_path) {
+  agent_plugin agent;
+  if (agent_plugin_load(&agent, agent_path) != 0)
+    return -1;
+  if (agent_plugin_begin(&agent, inplvl, frame_period_ms()) != 0) {
+    fprintf(stderr, "Agent %s failed to start.\n", agent_path);
+    agent_plugin_unload(&agent);
+    return -1;
+  }
+  agent.interactive = true;
+  level_driver driver = {agent_plugin_next_key, &agent, true, false, RENDER_BACKEND_NCURSES};
+  int score = run_demo(inplvl, &driver, agent.name);
+  if (score >= 0)
+    printf(",\n  \"agent\": \"%s\",\n  \"ticks\": %lld\n}\n", agent.name, agent.obs.tick);
+  agent_plugin_unload(&agent);
+  return score >= 0 ? 0 : -1;
+}
+
+/// @brief Let the autopilot or a controller plugin play a level in the terminal in real time,
+/// attract mode
+/// @param levelnum Level number
+/// @param agent_path Controller plugin to play with, NULL for the built-in search
+/// @return Error code
+int autopilot_demo(int levelnum, const char *agent_path) {
+  if (load_settings() != 0 || frame_period_ms() <= 0) {
+    fprintf(stderr, "Cannot load settings.\n");
+    return -1;
+  }
+  level lvl = load_level_file(levelnum);
+  if (!lvl.loaded) {
+    fprintf(stderr, "Level %d not found in " ASSETS_FOLDER "/levels.\n", levelnum);
+    return -1;
+  }
+  if (agent_path)
+    return agent_demo(&lvl, agent_path);
+
+  autopilot *ap = malloc(sizeof(*ap));
+  if (ap == NULL)
+    return -1;
+  autopilot_init(ap, &lvl, frame_period_ms());
+  ap->interactive = true;
+  level_driver driver = {autopilot_next_key, ap, true, false, RENDER_BACKEND_NCURSES};
+  int score = run_demo(&lvl, &driver, "Autopilot");
+  if (score >= 0) {
+    const autopilot_stats *stats = &ap->stats;
+    printf(",\n  \"decisions\": %lld,\n  \"nodes\": %lld,\n  \"nodes_per_sec\": %.0f\n}\n",
+           stats->decisions, stats->nodes,
+           stats->search_ns > 0 ? (double)stats->nodes * 1e9 / (double)stats->search_ns : 0);
+  }
+  free(ap);
+  return score >= 0 ? 0 : -1;
+}
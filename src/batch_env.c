@@ -0,0 +1,193 @@
+// Copyright 2022 <Maros Varchola - mvarchdev>
+
+#include "flappybird/batch_env.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "flappybird/game_context.h"
+
+/// @brief Stream buffer of the protocol, large enough for one step of a few thousand instances.
+#define BATCH_IO_BUFFER (1 << 20)
+
+/// @brief Write the observation of one instance into its slot of the shared buffer
+static void write_obs(batch_env *env, int index) {
+  const sim_state *world = &env->worlds[index];
+  float *obs = &env->obs[(size_t)index * BATCH_OBS_SIZE];
+  const fbpipe *next[BATCH_OBS_PIPES];
+  int count = sim_next_pipes(world, next, BATCH_OBS_PIPES);
+  obs[0] = fixed_to_float(world->bird.act_position);
+  obs[1] = fixed_to_float(world->bird.act_speed);
+  obs[2] = fixed_to_float(world->speed_chars);
+  obs[3] = (float)count;
+  for (int i = 0; i < BATCH_OBS_PIPES; i++) {
+    float *pipe = &obs[4 + 4 * i];
+    // A missing pipe is a free map far ahead.
+    if (i >= count) {
+      pipe[0] = pipe[1] = MAPSIZEX;
+      pipe[2] = 0;
+      pipe[3] = MAPSIZEY - 1;
+      continue;
+    }
+    pipe[0] = next[i]->position - PIPEHOLE_END_WIDTH - BIRDOFFX;
+    pipe[1] = next[i]->position + next[i]->pipewidth + 1 + PIPEHOLE_END_WIDTH - BIRDOFFX;
+    pipe[2] = next[i]->upheight + PIPEHOLE_END_HEIGHT + 1;
+    pipe[3] = MAPSIZEY - next[i]->downheight - PIPEHOLE_END_HEIGHT - 2;
+  }
+}
+
+/// @brief Allocate a batch and start an episode on every instance
+/// @param env Batch to fill
+/// @param inplvl Level every instance plays, copied
+/// @param count Number of instances
+/// @param seed Seed of the episode seeds
+/// @param frame_ms Gameplay time of one step
+/// @param gravity_constant Gravity constant of the settings
+/// @return Error code
+int batch_env_init(batch_env *env, const level *inplvl, int count, uint64_t seed,
+                   long long frame_ms, float gravity_constant) {
+  memset(env, 0, sizeof(*env));
+  if (count <= 0 || count > BATCH_MAX_ENVS)
+    return -1;
+  env->count = count;
+  env->lvl = *inplvl;
+  env->frame_ms = frame_ms;
+  prng_seed(&env->seeds, seed);
+
+  size_t n = (size_t)count;
+  env->worlds = calloc(n, sizeof(*env->worlds));
+  env->rewards = calloc(n, sizeof(*env->rewards));
+  env->dones = calloc(n, sizeof(*env->dones));
+  env->obs = calloc(n * BATCH_OBS_SIZE, sizeof(*env->obs));
+  if (!env->worlds || !env->rewards || !env->dones || !env->obs) {
+    batch_env_free(env);
+    return -1;
+  }
+  for (int i = 0; i < count; i++) {
+    sim_init(&env->worlds[i], gravity_constant);
+    batch_env_reset(env, i);
+  }
+  return 0;
+}
+
+/// @brief Start a new episode on one instance in place, nothing is allocated
+/// @param env Batch
+/// @param index Instance
+void batch_env_reset(batch_env *env, int index) {
+  sim_state *world = &env->worlds[index];
+  sim_reset(world, &env->lvl, prng_next(&env->seeds));
+  world->bird = sim_get_bird(world, &env->lvl);
+  write_obs(env, index);
+}
+
+/// @brief Advance every instance by one frame. The reward is the score of the frame, -1 on a
+/// collision, after which the instance is done and its observation is the start of the next
+/// episode.
+/// @param env Batch
+/// @param actions One byte per instance, BATCH_ACTION_JUMP jumps
+void batch_env_step(batch_env *env, const uint8_t *actions) {
+  for (int i = 0; i < env->count; i++) {
+    sim_state *world = &env->worlds[i];
+    if (actions[i] == BATCH_ACTION_JUMP) {
+      jump_bird(&world->bird);
+      world->metrics.jumps++;
+    }
+    int points = sim_step(world, &env->lvl, env->frame_ms);
+    env->dones[i] = points < 0;
+    env->rewards[i] = points < 0 ? -1.0f : (float)points;
+    if (points < 0)
+      batch_env_reset(env, i);
+    else
+      write_obs(env, i);
+  }
+}
+
+/// @brief Release the arrays of a batch
+/// @param env Batch
+void batch_env_free(batch_env *env) {
+  free(env->worlds);
+  free(env->rewards);
+  free(env->dones);
+  free(env->obs);
+  memset(env, 0, sizeof(*env));
+}
+
+/// @brief Parse batch environment arguments
+/// @param argc Argument count
+/// @param argv Arguments
+/// @param opts Options to fill
+/// @return 0 on success, -1 if the arguments are not a batch environment
+int batch_env_parse_args(int argc, char *argv[], batch_env_options *opts) {
+  memset(opts, 0, sizeof(*opts));
+  opts->levelnum = 1;
+  opts->seed = 1;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--batch-env") == 0 && i + 1 < argc) {
+      opts->count = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--level") == 0 && i + 1 < argc) {
+      opts->levelnum = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+      opts->seed = strtoull(argv[++i], NULL, 10);
+    } else {
+      return -1;
+    }
+  }
+  return opts->count > 0 && opts->count <= BATCH_MAX_ENVS ? 0 : -1;
+}
+
+static bool write_step(const batch_env *env, FILE *out) {
+  size_t n = (size_t)env->count;
+  return fwrite(env->rewards, sizeof(float), n, out) == n &&
+         fwrite(env->dones, 1, n, out) == n &&
+         fwrite(env->obs, sizeof(float), n * BATCH_OBS_SIZE, out) == n * BATCH_OBS_SIZE &&
+         fflush(out) == 0;
+}
+
+/// @brief Serve a batch over binary streams in host byte order. The header is four uint32
+/// (magic, version, instances, floats per observation) followed by the first observations.
+/// Every step reads one action byte per instance and answers with the rewards (float), done
+/// flags (uint8) and observations of all instances. End of input stops the server.
+/// @param opts Batch options
+/// @param in Action stream
+/// @param out Result stream
+/// @return Error code
+int run_batch_env(const batch_env_options *opts, FILE *in, FILE *out) {
+  setvbuf(in, NULL, _IOFBF, BATCH_IO_BUFFER);
+  setvbuf(out, NULL, _IOFBF, BATCH_IO_BUFFER);
+  if (load_settings() != 0 || frame_period_ms() <= 0) {
+    fprintf(stderr, "Cannot load settings.\n");
+    return -1;
+  }
+  level lvl = load_level_file(opts->levelnum);
+  if (!lvl.loaded) {
+    fprintf(stderr, "Level %d not found in " ASSETS_FOLDER "/levels.\n", opts->levelnum);
+    return -1;
+  }
+
+  batch_env env;
+  uint8_t *actions = malloc((size_t)opts->count);
+  if (actions == NULL || batch_env_init(&env, &lvl, opts->count, opts->seed, frame_period_ms(),
+                                        local_game.sim.gravity_constant) != 0) {
+    fprintf(stderr, "Cannot allocate %d instances.\n", opts->count);
+    free(actions);
+    return -1;
+  }
+
+  uint32_t header[4] = {BATCH_PROTOCOL_MAGIC, BATCH_PROTOCOL_VERSION, (uint32_t)env.count,
+                        BATCH_OBS_SIZE};
+  bool ok = fwrite(header, sizeof(header), 1, out) == 1 &&
+            fwrite(env.obs, sizeof(float), (size_t)env.count * BATCH_OBS_SIZE, out) ==
+                (size_t)env.count * BATCH_OBS_SIZE &&
+            fflush(out) == 0;
+  while (ok && fread(actions, 1, (size_t)env.count, in) == (size_t)env.count) {
+    batch_env_step(&env, actions);
+    ok = write_step(&env, out);
+  }
+  if (!ok)
+    fprintf(stderr, "Cannot write batch results.\n");
+
+  batch_env_free(&env);
+  free(actions);
+  return ok ? 0 : -1;
+}
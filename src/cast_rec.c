@@ -0,0 +1,496 @@
+// Copyright 2022 <Maros Varchola - mvarchdev>
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "flappybird/cast_rec.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "flappybird/common_tools.h"
+#include "flappybird/term_io.h"
+#include "flappybird/vterm.h"
+
+/// @brief Start of every event in a buffer, followed by len bytes of terminal output. An event
+/// without output marks the end of a frame.
+typedef struct cast_event {
+  long long time_ns;
+  size_t len;
+} cast_event;
+
+typedef struct cast_buffer {
+  char *data;
+  size_t len;
+  size_t cap;
+} cast_buffer;
+
+/// @brief The game appends to active. A full active buffer is swapped with an empty pending
+/// one, the writer thread swaps pending with writing and encodes it. Only the swaps take the
+/// lock, so the game never waits for the file.
+typedef struct cast_recorder {
+  FILE *out;
+  const char *path;
+  /// Set by cast_rec_start and only read afterwards, by the game and the writer thread.
+  bool compact;
+  long long start_ns;
+  long long handoff_ns;
+  int rows;
+  int cols;
+  cast_buffer buffers[3];
+  cast_buffer *active;
+  cast_buffer *pending;
+  cast_buffer *writing;
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  bool stop;
+  bool header_done;
+  /// Compact mode: screen after the output so far and the screen the file has drawn.
+  vterm vt;
+  vterm_cell *shown;
+  cast_buffer diff;
+  bool cleared;
+  bool frame_open;
+  long long frame_ns;
+  long long last_write_ns;
+  cast_rec_stats stats;
+} cast_recorder;
+
+static cast_recorder g_rec;
+static bool g_recording = false;
+
+static bool buffer_reserve(cast_buffer *buf, size_t extra) {
+  if (buf->len + extra <= buf->cap)
+    return true;
+  size_t cap = buf->cap ? buf->cap * 2 : CAST_REC_FLUSH_BYTES * 2;
+  while (cap < buf->len + extra) cap *= 2;
+  char *data = realloc(buf->data, cap);
+  if (data == NULL)
+    return false;
+  buf->data = data;
+  buf->cap = cap;
+  return true;
+}
+
+static void buffer_append(cast_buffer *buf, const void *data, size_t len) {
+  if (!buffer_reserve(buf, len))
+    return;
+  memcpy(buf->data + buf->len, data, len);
+  buf->len += len;
+}
+
+static void swap_buffers(cast_buffer **a, cast_buffer **b) {
+  cast_buffer *tmp = *a;
+  *a = *b;
+  *b = tmp;
+}
+
+/// @brief Size of the terminal the game is about to draw to, curses starts with the same size
+static void terminal_size(int *rows, int *cols) {
+  struct winsize ws;
+  if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_row > 0 && ws.ws_col > 0) {
+    *rows = ws.ws_row;
+    *cols = ws.ws_col;
+  } else {
+    *rows = CAST_REC_DEFAULT_ROWS;
+    *cols = CAST_REC_DEFAULT_COLS;
+  }
+}
+
+/// @brief Pass the active buffer to the writer if it has taken the previous one, otherwise
+/// keep collecting
+static void handoff(cast_recorder *rec) {
+  pthread_mutex_lock(&rec->lock);
+  if (rec->pending->len == 0) {
+    swap_buffers(&rec->active, &rec->pending);
+    rec->stats.handoffs++;
+    pthread_cond_signal(&rec->wake);
+  }
+  pthread_mutex_unlock(&rec->lock);
+  rec->handoff_ns = timeInNanoseconds();
+}
+
+/// @brief Copy an event into the active buffer, it is dropped if the buffer is full
+/// @return False if the event was dropped
+static bool record_event(cast_recorder *rec, const char *data, size_t len) {
+  if (rec->active->len + sizeof(cast_event) + len > rec->active->cap)
+    return false;
+  cast_event ev = {timeInNanoseconds() - rec->start_ns, len};
+  buffer_append(rec->active, &ev, sizeof(ev));
+  if (len > 0)
+    buffer_append(rec->active, data, len);
+  return true;
+}
+
+static void record_write(void *ctx, const char *data, size_t len) {
+  cast_recorder *rec = ctx;
+  if (len == 0)
+    return;
+  if (record_event(rec, data, len))
+    rec->stats.bytes_in += len;
+  else
+    rec->stats.dropped += len;
+  if (rec->active->len >= CAST_REC_FLUSH_BYTES)
+    handoff(rec);
+}
+
+static void record_end_frame(void *ctx) {
+  cast_recorder *rec = ctx;
+  if (rec->compact)
+    record_event(rec, NULL, 0);
+  if (rec->active->len > 0 && timeInNanoseconds() - rec->handoff_ns >= CAST_REC_FLUSH_NS)
+    handoff(rec);
+}
+
+/// @brief Write a JSON string body, control characters are escaped
+static void write_json_string(FILE *out, const char *data, size_t len) {
+  size_t plain = 0;
+  for (size_t i = 0; i < len; i++) {
+    unsigned char c = (unsigned char)data[i];
+    if (c >= 0x20 && c != '"' && c != '\\' && c != 0x7f)
+      continue;
+    fwrite(data + plain, 1, i - plain, out);
+    plain = i + 1;
+    if (c == '"' || c == '\\')
+      fprintf(out, "\\%c", c);
+    else if (c == '\n')
+      fputs("\\n", out);
+    else if (c == '\r')
+      fputs("\\r", out);
+    else
+      fprintf(out, "\\u%04x", c);
+  }
+  fwrite(data + plain, 1, len - plain, out);
+}
+
+static void write_header(cast_recorder *rec) {
+  const char *term = getenv("TERM");
+  fprintf(rec->out, "{\"version\": 2, \"width\": %d, \"height\": %d, \"timestamp\": %lld",
+          rec->cols, rec->rows, (long long)time(NULL));
+  if (term) {
+    fputs(", \"env\": {\"TERM\": \"", rec->out);
+    write_json_string(rec->out, term, strlen(term));
+    fputs("\"}", rec->out);
+  }
+  fputs("}\n", rec->out);
+  rec->header_done = true;
+}
+
+static void write_event(cast_recorder *rec, long long time_ns, const char *data, size_t len) {
+  fprintf(rec->out, rec->compact ? "[%.3f, \"o\", \"" : "[%.6f, \"o\", \"", time_ns / 1e9);
+  write_json_string(rec->out, data, len);
+  fputs("\"]\n", rec->out);
+  rec->stats.events++;
+  rec->stats.bytes_out += len;
+}
+
+/// @brief Cells look the same on screen. Only the background of a plain space is visible.
+static bool same_look(const vterm_cell *a, const vterm_cell *b) {
+  const uint8_t visible = VTERM_ATTR_UNDERLINE | VTERM_ATTR_REVERSE;
+  if (a->ch == ' ' && b->ch == ' ' && !(a->attrs & visible) && !(b->attrs & visible))
+    return a->bg == b->bg;
+  return a->ch == b->ch && a->fg == b->fg && a->bg == b->bg && a->attrs == b->attrs;
+}
+
+static bool same_pen(const vterm_cell *a, const vterm_cell *b) {
+  return a->fg == b->fg && a->bg == b->bg && a->attrs == b->attrs;
+}
+
+static int add_code(char *sgr, int len, int code) {
+  return len + snprintf(sgr + len, 48 - (size_t)len, len > 2 ? ";%d" : "%d", code);
+}
+
+static int add_color(char *sgr, int len, int color, int base, int bright_base) {
+  if (color == VTERM_DEFAULT_COLOR)
+    return add_code(sgr, len, base + 9);
+  if (color < 8)
+    return add_code(sgr, len, base + color);
+  if (color < 16)
+    return add_code(sgr, len, bright_base + color - 8);
+  len = add_code(sgr, len, base + 8);
+  len = add_code(sgr, len, 5);
+  return add_code(sgr, len, color);
+}
+
+/// @brief Switch the pen, only the colors that changed unless the attributes changed
+static void append_pen(cast_buffer *buf, const vterm_cell *cell, const vterm_cell *prev) {
+  static const struct {
+    uint8_t bit;
+    int code;
+  } attrs[] = {{VTERM_ATTR_BOLD, 1},  {VTERM_ATTR_DIM, 2},     {VTERM_ATTR_UNDERLINE, 4},
+               {VTERM_ATTR_BLINK, 5}, {VTERM_ATTR_REVERSE, 7}, {VTERM_ATTR_INVISIBLE, 8}};
+  char sgr[48] = "\x1b[";
+  int len = 2;
+  bool full = prev == NULL || prev->attrs != cell->attrs;
+  if (full) {
+    len = add_code(sgr, len, 0);
+    for (size_t i = 0; i < sizeof(attrs) / sizeof(attrs[0]); i++)
+      if (cell->attrs & attrs[i].bit)
+        len = add_code(sgr, len, attrs[i].code);
+  }
+  if ((full && cell->fg != VTERM_DEFAULT_COLOR) || (!full && cell->fg != prev->fg))
+    len = add_color(sgr, len, cell->fg, 30, 90);
+  if ((full && cell->bg != VTERM_DEFAULT_COLOR) || (!full && cell->bg != prev->bg))
+    len = add_color(sgr, len, cell->bg, 40, 100);
+  sgr[len++] = 'm';
+  buffer_append(buf, sgr, (size_t)len);
+}
+
+static void append_char(cast_buffer *buf, uint32_t ch) {
+  char utf8[4];
+  size_t len = 0;
+  if (ch < 0x20)
+    ch = ' ';
+  if (ch < 0x80) {
+    utf8[len++] = (char)ch;
+  } else if (ch < 0x800) {
+    utf8[len++] = (char)(0xc0 | (ch >> 6));
+    utf8[len++] = (char)(0x80 | (ch & 0x3f));
+  } else if (ch < 0x10000) {
+    utf8[len++] = (char)(0xe0 | (ch >> 12));
+    utf8[len++] = (char)(0x80 | ((ch >> 6) & 0x3f));
+    utf8[len++] = (char)(0x80 | (ch & 0x3f));
+  } else {
+    utf8[len++] = (char)(0xf0 | (ch >> 18));
+    utf8[len++] = (char)(0x80 | ((ch >> 12) & 0x3f));
+    utf8[len++] = (char)(0x80 | ((ch >> 6) & 0x3f));
+    utf8[len++] = (char)(0x80 | (ch & 0x3f));
+  }
+  buffer_append(buf, utf8, len);
+}
+
+/// @brief True if the cells between the cursor and x can be written again with the current
+/// pen, which is shorter than moving the cursor over them
+static bool can_fill_gap(const vterm *vt, int y, int from_x, int to_x, const vterm_cell *pen) {
+  if (pen == NULL || to_x - from_x > CAST_REC_GAP_FILL)
+    return false;
+  for (int x = from_x; x < to_x; x++)
+    if (!same_pen(vterm_cell_at(vt, y, x), pen))
+      return false;
+  return true;
+}
+
+/// @brief Clear the player screen with the most common background, blank cells of that
+/// background are then already drawn
+static void clear_screen(cast_recorder *rec) {
+  int counts[257] = {0};
+  int cells = rec->vt.rows * rec->vt.cols;
+  for (int i = 0; i < cells; i++) counts[rec->vt.cells[i].bg + 1]++;
+  int bg = 0;
+  for (int i = 1; i < 257; i++)
+    if (counts[i] > counts[bg])
+      bg = i;
+  vterm_cell blank = {' ', VTERM_DEFAULT_COLOR, (int16_t)(bg - 1), 0};
+  for (int i = 0; i < cells; i++) rec->shown[i] = blank;
+  buffer_append(&rec->diff, "\x1b[?25l", 6);
+  append_pen(&rec->diff, &blank, NULL);
+  buffer_append(&rec->diff, "\x1b[H\x1b[2J", 7);
+  rec->cleared = true;
+}
+
+/// @brief Encode the cells that changed since the last frame as cursor moves, pen changes
+/// and characters
+static void encode_diff(cast_recorder *rec) {
+  cast_buffer *diff = &rec->diff;
+  diff->len = 0;
+  if (!rec->cleared)
+    clear_screen(rec);
+  const vterm_cell *pen = NULL;
+  int cur_y = -1;
+  int cur_x = -1;
+  char move[24];
+  for (int y = 0; y < rec->vt.rows; y++)
+    for (int x = 0; x < rec->vt.cols; x++) {
+      const vterm_cell *cell = vterm_cell_at(&rec->vt, y, x);
+      vterm_cell *shown = &rec->shown[y * rec->vt.cols + x];
+      if (same_look(cell, shown))
+        continue;
+      if (y == cur_y && x >= cur_x && can_fill_gap(&rec->vt, y, cur_x, x, pen)) {
+        for (int gap = cur_x; gap < x; gap++)
+          append_char(diff, vterm_cell_at(&rec->vt, y, gap)->ch);
+      } else if (y == cur_y && x != cur_x) {
+        buffer_append(diff, move, (size_t)snprintf(move, sizeof(move), "\x1b[%dG", x + 1));
+      } else if (y != cur_y || x != cur_x) {
+        buffer_append(diff, move,
+                      (size_t)snprintf(move, sizeof(move), "\x1b[%d;%dH", y + 1, x + 1));
+      }
+      if (pen == NULL || !same_pen(pen, cell))
+        append_pen(diff, cell, pen);
+      append_char(diff, cell->ch);
+      *shown = *cell;
+      pen = shown;
+      cur_y = y;
+      cur_x = x + 1;
+    }
+}
+
+static bool compact_begin(cast_recorder *rec) {
+  if (vterm_init(&rec->vt, rec->rows, rec->cols) != 0)
+    return false;
+  rec->shown = malloc(sizeof(*rec->shown) * (size_t)rec->rows * (size_t)rec->cols);
+  return rec->shown != NULL;
+}
+
+/// @brief Free the buffers and the compact screens of a recorder
+static void release(cast_recorder *rec) {
+  for (int i = 0; i < 3; i++) free(rec->buffers[i].data);
+  free(rec->diff.data);
+  free(rec->shown);
+  vterm_free(&rec->vt);
+}
+
+/// @brief Compact mode: write one event with the changes of the frame fed so far
+static void flush_frame(cast_recorder *rec) {
+  if (!rec->frame_open)
+    return;
+  rec->frame_open = false;
+  encode_diff(rec);
+  if (rec->diff.len > 0)
+    write_event(rec, rec->frame_ns, rec->diff.data, rec->diff.len);
+  else
+    rec->stats.skipped++;
+}
+
+static void write_events(cast_recorder *rec, const cast_buffer *buf) {
+  size_t pos = 0;
+  while (pos + sizeof(cast_event) <= buf->len) {
+    cast_event ev;
+    memcpy(&ev, buf->data + pos, sizeof(ev));
+    const char *data = buf->data + pos + sizeof(ev);
+    pos += sizeof(ev) + ev.len;
+    if (!rec->compact) {
+      write_event(rec, ev.time_ns, data, ev.len);
+      continue;
+    }
+    // curses flushes a refresh in several writes, the end_frame marker closes the frame.
+    if (ev.len == 0 || (rec->frame_open && ev.time_ns - rec->last_write_ns > CAST_REC_IDLE_NS))
+      flush_frame(rec);
+    if (ev.len == 0)
+      continue;
+    if (!rec->frame_open)
+      rec->frame_ns = ev.time_ns;
+    rec->frame_open = true;
+    rec->last_write_ns = ev.time_ns;
+    vterm_feed(&rec->vt, data, ev.len);
+  }
+}
+
+static void *writer_main(void *arg) {
+  cast_recorder *rec = arg;
+  pthread_mutex_lock(&rec->lock);
+  while (true) {
+    while (rec->pending->len == 0 && !rec->stop) pthread_cond_wait(&rec->wake, &rec->lock);
+    if (rec->pending->len == 0)
+      break;
+    swap_buffers(&rec->pending, &rec->writing);
+    pthread_mutex_unlock(&rec->lock);
+
+    if (!rec->header_done)
+      write_header(rec);
+    write_events(rec, rec->writing);
+    rec->writing->len = 0;
+    pthread_mutex_lock(&rec->lock);
+  }
+  pthread_mutex_unlock(&rec->lock);
+  if (rec->compact)
+    flush_frame(rec);
+  return NULL;
+}
+
+/// @brief Record the terminal output from now on as an asciicast v2 file. The game only copies
+/// the bytes, a writer thread encodes and writes them.
+/// @param path File to write
+/// @param compact If true, events hold the changed cells of each frame instead of the raw
+/// output, frames that change nothing are left out
+/// @return Error code
+int cast_rec_start(const char *path, bool compact) {
+  if (g_recording)
+    return -1;
+  memset(&g_rec, 0, sizeof(g_rec));
+  g_rec.out = fopen(path, "w");
+  if (g_rec.out == NULL) {
+    fprintf(stderr, "Cannot write recording %s.\n", path);
+    return -1;
+  }
+  g_rec.path = path;
+  terminal_size(&g_rec.rows, &g_rec.cols);
+  g_rec.active = &g_rec.buffers[0];
+  g_rec.pending = &g_rec.buffers[1];
+  g_rec.writing = &g_rec.buffers[2];
+  for (int i = 0; i < 3; i++) {
+    if (!buffer_reserve(&g_rec.buffers[i], CAST_REC_BUFFER_BYTES)) {
+      release(&g_rec);
+      fclose(g_rec.out);
+      fprintf(stderr, "Cannot allocate the recording buffers.\n");
+      return -1;
+    }
+  }
+  // Without the screens of compact mode the raw output is recorded.
+  g_rec.compact = compact && compact_begin(&g_rec);
+  g_rec.start_ns = timeInNanoseconds();
+  g_rec.handoff_ns = g_rec.start_ns;
+  pthread_mutex_init(&g_rec.lock, NULL);
+  pthread_cond_init(&g_rec.wake, NULL);
+  term_io_sink sink = {record_write, record_end_frame, &g_rec};
+  if (pthread_create(&g_rec.thread, NULL, writer_main, &g_rec) != 0) {
+    release(&g_rec);
+    pthread_mutex_destroy(&g_rec.lock);
+    pthread_cond_destroy(&g_rec.wake);
+    fclose(g_rec.out);
+    fprintf(stderr, "Cannot start the recording writer.\n");
+    return -1;
+  }
+  g_recording = true;
+  if (!term_io_add_sink(&sink)) {
+    cast_rec_stop();
+    return -1;
+  }
+  return 0;
+}
+
+/// @brief Write the rest of the recording and close the file
+/// @return Error code
+int cast_rec_stop(void) {
+  if (!g_recording)
+    return 0;
+  term_io_remove_sink(&g_rec);
+  pthread_mutex_lock(&g_rec.lock);
+  if (g_rec.pending->len == 0)
+    swap_buffers(&g_rec.active, &g_rec.pending);
+  else
+    buffer_append(g_rec.pending, g_rec.active->data, g_rec.active->len);
+  g_rec.stop = true;
+  pthread_cond_signal(&g_rec.wake);
+  pthread_mutex_unlock(&g_rec.lock);
+  pthread_join(g_rec.thread, NULL);
+
+  if (!g_rec.header_done)
+    write_header(&g_rec);
+  int err = ferror(g_rec.out) | fclose(g_rec.out);
+  if (err)
+    fprintf(stderr, "Cannot write recording %s.\n", g_rec.path);
+  release(&g_rec);
+  pthread_mutex_destroy(&g_rec.lock);
+  pthread_cond_destroy(&g_rec.wake);
+  g_recording = false;
+  return err ? -1 : 0;
+}
+
+/// @brief Print what the last recording wrote
+/// @param out Stream to print to
+void cast_rec_print_report(FILE *out) {
+  if (g_rec.path == NULL)
+    return;
+  fprintf(out, "Recording %s: %llu events, %llu B output, %llu B written", g_rec.path,
+          g_rec.stats.events, g_rec.stats.bytes_in, g_rec.stats.bytes_out);
+  if (g_rec.compact)
+    fprintf(out, " as frame diffs, %llu unchanged frames left out", g_rec.stats.skipped);
+  if (g_rec.stats.dropped > 0)
+    fprintf(out, ", %llu B dropped while the writer was behind", g_rec.stats.dropped);
+  fputc('\n', out);
+}
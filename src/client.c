@@ -0,0 +1,98 @@
+// Copyright 2022 <Maros Varchola - mvarchdev>
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "flappybird/server.h"
+
+/// @brief Parse client arguments
+/// @param argc Argument count
+/// @param argv Arguments
+/// @param socket_path Set to the server socket
+/// @return 0 on success, -1 if the arguments are not a client
+int client_parse_args(int argc, char *argv[], const char **socket_path) {
+  if (argc != 3 || strcmp(argv[1], "--connect") != 0)
+    return -1;
+  *socket_path = argv[2];
+  return 0;
+}
+
+/// @brief Copy everything readable from one descriptor to another
+/// @return False on end of input or error
+static bool forward(int from, int to) {
+  char buf[4096];
+  ssize_t n = read(from, buf, sizeof(buf));
+  if (n < 0)
+    return errno == EINTR || errno == EAGAIN;
+  if (n == 0)
+    return false;
+  for (ssize_t done = 0; done < n;) {
+    ssize_t w = write(to, buf + done, (size_t)(n - done));
+    if (w < 0 && errno != EINTR)
+      return false;
+    if (w > 0)
+      done += w;
+  }
+  return true;
+}
+
+/// @brief Play on a server as a thin terminal: keys go to the server unchanged, the screen
+/// the server sends goes to the terminal unchanged
+/// @param socket_path Server socket
+/// @return Error code
+int run_client(const char *socket_path) {
+  struct sockaddr_un addr = {.sun_family = AF_UNIX};
+  if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+    fprintf(stderr, "Socket path %s is too long.\n", socket_path);
+    return -1;
+  }
+  snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", socket_path);
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+    fprintf(stderr, "Cannot connect to %s: %s\n", socket_path, strerror(errno));
+    if (fd >= 0)
+      close(fd);
+    return -1;
+  }
+
+  struct termios saved;
+  bool raw = isatty(STDIN_FILENO) && tcgetattr(STDIN_FILENO, &saved) == 0;
+  if (raw) {
+    struct termios mode = saved;
+    mode.c_lflag &= ~(tcflag_t)(ICANON | ECHO | ISIG);
+    mode.c_iflag &= ~(tcflag_t)(IXON | ICRNL);
+    mode.c_cc[VMIN] = 1;
+    mode.c_cc[VTIME] = 0;
+    tcsetattr(STDIN_FILENO, TCSANOW, &mode);
+  }
+
+  struct pollfd fds[2] = {{.fd = STDIN_FILENO, .events = POLLIN}, {.fd = fd, .events = POLLIN}};
+  bool open = true;
+  while (open) {
+    if (poll(fds, 2, -1) < 0) {
+      open = errno == EINTR;
+      continue;
+    }
+    if (fds[1].revents & (POLLIN | POLLHUP | POLLERR))
+      open = forward(fd, STDOUT_FILENO);
+    if (open && (fds[0].revents & (POLLIN | POLLHUP)))
+      open = forward(STDIN_FILENO, fd);
+  }
+
+  if (raw)
+    tcsetattr(STDIN_FILENO, TCSANOW, &saved);
+  // Leave the alternate screen even if the server went away without restoring it.
+  static const char restore[] = "\x1b[?25h\x1b[?1049l";
+  if (write(STDOUT_FILENO, restore, sizeof(restore) - 1) < 0)
+    fprintf(stderr, "Cannot restore the terminal.\n");
+  close(fd);
+  return 0;
+}
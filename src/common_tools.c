@@ -1,18 +1,13 @@
 // Copyright 2022 <Maros Varchola - mvarchdev>
 
+#define _POSIX_C_SOURCE 200809L
+
 #include "flappybird/common_tools.h"
 
 #include <errno.h>
-#include <stdlib.h>
 #include <sys/time.h>
 #include <time.h>
 
-/// @brief Will return random integer based on min max definitions
-/// @param min Minimum number that should return
-/// @param max Maximum number that should return
-/// @return Random number based on min max definition
-unsigned int rand_gen(int min, int max) { return min + (rand() % ((max + 1) - min)); }
-
 /// @brief Sleep for the requested number of milliseconds
 /// @param msec how long it should block
 /// @return Error code
@@ -43,3 +38,12 @@ long long timeInMilliseconds(void) {
   gettimeofday(&tv, NULL);
   return (((long long)tv.tv_sec) * 1000) + (tv.tv_usec / 1000);
 }
+
+/// @brief Get monotonic time in ns, for measuring durations
+/// @return Monotonic clock reading in nanoseconds
+long long timeInNanoseconds(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (((long long)ts.tv_sec) * 1000000000LL) + ts.tv_nsec;
+}
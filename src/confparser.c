@@ -8,6 +8,8 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "flappybird/mem_stats.h"
+
 static char *ltrim(char *str) {
   while (*str != '\0' && isspace((unsigned char)(*str))) {
     str++;
@@ -81,7 +83,7 @@ config_option_t read_config_file(const char *path) {
       continue;
     }
 
-    config_option_t option = calloc(1, sizeof(config_option));
+    config_option_t option = mem_calloc(1, sizeof(config_option));
     if (option == NULL) {
       free_config_options(last_option);
       fclose(fp);
@@ -101,7 +103,7 @@ config_option_t read_config_file(const char *path) {
 void free_config_options(config_option_t options) {
   while (options != NULL) {
     config_option_t previous = options->prev;
-    free(options);
+    mem_free(options);
     options = previous;
   }
 }
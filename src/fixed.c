@@ -0,0 +1,40 @@
+// Copyright 2022 <Maros Varchola - mvarchdev>
+
+#include "flappybird/fixed.h"
+
+#include <math.h>
+
+/// @brief Convert a whole number
+/// @param value Whole number
+/// @return Fixed-point value
+fixed fixed_from_int(int value) { return (fixed)(value * FIXED_ONE); }
+
+/// @brief Convert a value read from a config file, done once when a level or bird is set up
+/// @details Scaling by a power of two is exact and llround rounds half away from zero, so the
+/// result does not depend on the build.
+/// @param value Value
+/// @return Nearest fixed-point value
+fixed fixed_from_double(double value) { return (fixed)llround(value * FIXED_ONE); }
+
+/// @brief Round down to a whole number, also for negative values
+/// @param value Fixed-point value
+/// @return Largest whole number not above value
+int fixed_to_int(fixed value) {
+  if (value >= 0)
+    return value / FIXED_ONE;
+  return -((-(long long)value + FIXED_ONE - 1) / FIXED_ONE);
+}
+
+/// @brief Convert for display and observations, never fed back into the physics
+/// @param value Fixed-point value
+/// @return Value as float
+float fixed_to_float(fixed value) { return (float)value / FIXED_ONE; }
+
+/// @brief Multiply by a fraction in 64-bit integers, rounded toward zero
+/// @param value Fixed-point value
+/// @param num Numerator
+/// @param den Denominator, not zero
+/// @return value * num / den
+fixed fixed_scale(fixed value, long long num, long long den) {
+  return (fixed)((long long)value * num / den);
+}
@@ -0,0 +1,251 @@
+// Copyright 2022 <Maros Varchola - mvarchdev>
+
+#include "flappybird/ghost.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+/// @brief Bytes of the magic.
+#define GHOST_MAGIC_LEN 4
+/// @brief Symbols of the 2-bit alphabet.
+#define GHOST_SYM_SAME 0
+#define GHOST_SYM_DOWN 1
+#define GHOST_SYM_UP 2
+#define GHOST_SYM_ESCAPE 3
+/// @brief Symbols of the zigzag change after an escape.
+#define GHOST_ESCAPE_SYMBOLS 4
+/// @brief Largest row change one escape holds.
+#define GHOST_MAX_JUMP 127
+/// @brief Longest LEB128 encoding of a 64-bit value.
+#define GHOST_VARINT_MAX_BYTES 10
+/// @brief Longest header, magic and six varints.
+#define GHOST_HEADER_MAX_BYTES (GHOST_MAGIC_LEN + 6 * GHOST_VARINT_MAX_BYTES)
+/// @brief Packed symbols a ghost file can hold whatever its header, ghost_load reads no more
+/// than GHOST_MAX_BYTES.
+#define GHOST_DATA_MAX_BYTES (GHOST_MAX_BYTES - GHOST_HEADER_MAX_BYTES)
+
+/// @brief Start recording a run, the data buffer of a previous recording is reused. It is
+/// reserved here for the longest track a file can hold and never grows while recording.
+/// @param track Track
+/// @param levelnum Level number
+/// @param seed Seed of the course
+/// @param frame_ms Gameplay time of one frame
+/// @return Error code
+int ghost_begin(ghost_track *track, int levelnum, uint64_t seed, long long frame_ms) {
+  track->levelnum = levelnum;
+  track->seed = seed;
+  track->frame_ms = frame_ms;
+  track->score = 0;
+  track->frames = 0;
+  track->symbols = 0;
+  track->last_row = 0;
+  if (track->capacity < GHOST_DATA_MAX_BYTES) {
+    uint8_t *grown = realloc(track->data, GHOST_DATA_MAX_BYTES);
+    if (grown == NULL)
+      return -1;
+    track->data = grown;
+    track->capacity = GHOST_DATA_MAX_BYTES;
+  }
+  return 0;
+}
+
+static int put_symbol(ghost_track *track, int symbol) {
+  size_t byte = track->symbols / 4;
+  if (byte >= GHOST_DATA_MAX_BYTES)
+    return -1;
+  int shift = (int)(track->symbols % 4) * 2;
+  if (shift == 0)
+    track->data[byte] = 0;
+  track->data[byte] |= (uint8_t)(symbol << shift);
+  track->symbols++;
+  return 0;
+}
+
+static int get_symbol(const ghost_track *track, size_t symbol) {
+  return (track->data[symbol / 4] >> ((symbol % 4) * 2)) & 3;
+}
+
+/// @brief Append the bird row of one frame
+/// @param track Track
+/// @param row Row of the bird, changes larger than GHOST_MAX_JUMP are cut
+/// @return Error code, -1 once the track is as long as a ghost file can hold
+int ghost_add(ghost_track *track, int row) {
+  int delta = row - track->last_row;
+  if (delta > GHOST_MAX_JUMP)
+    delta = GHOST_MAX_JUMP;
+  if (delta < -GHOST_MAX_JUMP)
+    delta = -GHOST_MAX_JUMP;
+
+  int err = 0;
+  if (delta == 0) {
+    err = put_symbol(track, GHOST_SYM_SAME);
+  } else if (delta == 1) {
+    err = put_symbol(track, GHOST_SYM_DOWN);
+  } else if (delta == -1) {
+    err = put_symbol(track, GHOST_SYM_UP);
+  } else {
+    unsigned int zigzag = delta > 0 ? (unsigned int)delta * 2 : (unsigned int)-delta * 2 - 1;
+    err = put_symbol(track, GHOST_SYM_ESCAPE);
+    for (int i = 0; i < GHOST_ESCAPE_SYMBOLS && err == 0; i++)
+      err = put_symbol(track, (int)(zigzag >> (2 * i)) & 3);
+  }
+  if (err != 0)
+    return -1;
+  track->last_row += delta;
+  track->frames++;
+  return 0;
+}
+
+void ghost_free(ghost_track *track) {
+  free(track->data);
+  memset(track, 0, sizeof(*track));
+}
+
+/// @brief Start decoding a track from its first frame
+/// @param rd Reader
+/// @param track Track, must outlive the reader
+void ghost_reader_init(ghost_reader *rd, const ghost_track *track) {
+  rd->track = track;
+  rd->symbol = 0;
+  rd->frame = 0;
+  rd->row = 0;
+}
+
+/// @brief Decode the row of the next frame
+/// @param rd Reader
+/// @param row Set to the row of the frame
+/// @return False once every frame was read
+bool ghost_reader_next(ghost_reader *rd, int *row) {
+  const ghost_track *track = rd->track;
+  if (rd->frame >= track->frames || rd->symbol >= track->symbols)
+    return false;
+  int symbol = get_symbol(track, rd->symbol++);
+  if (symbol == GHOST_SYM_DOWN) {
+    rd->row++;
+  } else if (symbol == GHOST_SYM_UP) {
+    rd->row--;
+  } else if (symbol == GHOST_SYM_ESCAPE) {
+    if (track->symbols - rd->symbol < GHOST_ESCAPE_SYMBOLS)
+      return false;
+    unsigned int zigzag = 0;
+    for (int i = 0; i < GHOST_ESCAPE_SYMBOLS; i++)
+      zigzag |= (unsigned int)get_symbol(track, rd->symbol++) << (2 * i);
+    rd->row += zigzag & 1 ? -(int)((zigzag + 1) / 2) : (int)(zigzag / 2);
+  }
+  rd->frame++;
+  *row = rd->row;
+  return true;
+}
+
+static size_t put_varint(uint8_t *buf, size_t size, size_t pos, uint64_t value) {
+  do {
+    uint8_t byte = value & 0x7f;
+    value >>= 7;
+    if (value)
+      byte |= 0x80;
+    if (pos < size)
+      buf[pos] = byte;
+    pos++;
+  } while (value);
+  return pos;
+}
+
+static int get_varint(const uint8_t *buf, size_t size, size_t *pos, uint64_t *value) {
+  *value = 0;
+  for (int shift = 0; shift < 7 * GHOST_VARINT_MAX_BYTES; shift += 7) {
+    if (*pos >= size)
+      return -1;
+    uint8_t byte = buf[(*pos)++];
+    *value |= (uint64_t)(byte & 0x7f) << shift;
+    if (!(byte & 0x80))
+      return 0;
+  }
+  return -1;
+}
+
+/// @brief Write a ghost file: magic, header varints, then the packed symbols
+/// @param track Track
+/// @param path File path
+/// @return Error code, -1 without writing if ghost_load could not read the file back
+int ghost_save(const ghost_track *track, const char *path) {
+  uint8_t header[GHOST_HEADER_MAX_BYTES];
+  memcpy(header, GHOST_MAGIC, GHOST_MAGIC_LEN);
+  size_t pos = GHOST_MAGIC_LEN;
+  pos = put_varint(header, sizeof(header), pos, (uint64_t)track->levelnum);
+  pos = put_varint(header, sizeof(header), pos, track->seed);
+  pos = put_varint(header, sizeof(header), pos, (uint64_t)track->frame_ms);
+  pos = put_varint(header, sizeof(header), pos, (uint64_t)track->score);
+  pos = put_varint(header, sizeof(header), pos, (uint64_t)track->frames);
+  pos = put_varint(header, sizeof(header), pos, track->symbols);
+
+  size_t bytes = (track->symbols + 3) / 4;
+  if (pos + bytes > GHOST_MAX_BYTES)
+    return -1;
+  FILE *fp = fopen(path, "wb");
+  if (fp == NULL)
+    return -1;
+  bool ok = fwrite(header, 1, pos, fp) == pos && fwrite(track->data, 1, bytes, fp) == bytes;
+  return fclose(fp) == 0 && ok ? 0 : -1;
+}
+
+/// @brief Read a ghost file
+/// @param track Track to fill, free it with ghost_free
+/// @param path File path
+/// @return Error code
+int ghost_load(ghost_track *track, const char *path) {
+  memset(track, 0, sizeof(*track));
+  FILE *fp = fopen(path, "rb");
+  if (fp == NULL)
+    return -1;
+  uint8_t *buf = malloc(GHOST_MAX_BYTES);
+  size_t size = buf ? fread(buf, 1, GHOST_MAX_BYTES, fp) : 0;
+  fclose(fp);
+  if (size < GHOST_MAGIC_LEN || memcmp(buf, GHOST_MAGIC, GHOST_MAGIC_LEN) != 0) {
+    free(buf);
+    return -1;
+  }
+
+  size_t pos = GHOST_MAGIC_LEN;
+  uint64_t header[6] = {0};
+  int err = 0;
+  for (int i = 0; i < 6 && err == 0; i++) err = get_varint(buf, size, &pos, &header[i]);
+  if (err != 0 || header[5] == 0 || (header[5] + 3) / 4 != size - pos) {
+    free(buf);
+    return -1;
+  }
+  track->levelnum = (int)header[0];
+  track->seed = header[1];
+  track->frame_ms = (long long)header[2];
+  track->score = (int)header[3];
+  track->frames = (long)header[4];
+  track->symbols = header[5];
+  track->capacity = size - pos;
+  // The symbols are moved to the front, the buffer then belongs to the track.
+  memmove(buf, buf + pos, track->capacity);
+  track->data = buf;
+  return 0;
+}
+
+/// @brief Build the ghost path of a player on a level and create its directory, the nickname
+/// is hex encoded like in hall of fame replay names
+/// @param buf Output buffer
+/// @param size Size of the output buffer
+/// @param nickname Player nickname
+/// @param level Level number
+/// @return Error code, -1 if the buffer is too small
+int ghost_path(char *buf, size_t size, const char *nickname, int level) {
+  if (mkdir(GHOST_DIR, 0755) != 0 && errno != EEXIST)
+    return -1;
+  int pos = snprintf(buf, size, "%s/lvl_%d_", GHOST_DIR, level);
+  if (pos < 0)
+    return -1;
+  for (const unsigned char *ch = (const unsigned char *)nickname; *ch; ch++) {
+    if ((size_t)pos + 2 >= size)
+      return -1;
+    pos += snprintf(buf + pos, size - (size_t)pos, "%02x", *ch);
+  }
+  return (size_t)snprintf(buf + pos, size - (size_t)pos, ".fbg") < size - (size_t)pos ? 0 : -1;
+}
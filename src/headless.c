@@ -0,0 +1,414 @@
+// Copyright 2022 <Maros Varchola - mvarchdev>
+
+#include "flappybird/headless.h"
+
+#include <math.h>
+#include <ncurses.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "flappybird/agent_plugin.h"
+#include "flappybird/audio.h"
+#include "flappybird/common_tools.h"
+#include "flappybird/game_context.h"
+#include "flappybird/term_io.h"
+
+/// @brief One scripted key press.
+typedef struct script_event {
+  long frame;
+  int key;
+} script_event;
+
+/// @brief Scripted input source of the headless benchmark.
+typedef struct input_script {
+  script_event *events;
+  size_t count;
+  size_t next;
+  /// Jump period of the built-in script, used when there are no events.
+  long jump_every;
+  long frame;
+  long frames;
+  /// Plays every frame when set, events and jump period are ignored.
+  autopilot *pilot;
+  /// Controller plugin, plays every frame like the autopilot.
+  agent_plugin *agent;
+} input_script;
+
+static const char *renderer_names[] = {"ncurses", "null", "none"};
+
+void headless_options_init(headless_options *opts) {
+  memset(opts, 0, sizeof(*opts));
+  opts->levelnum = 1;
+  opts->seed = 1;
+  opts->frames = HEADLESS_DEFAULT_FRAMES;
+  opts->renderer = RENDER_BACKEND_NULL;
+  opts->profile = true;
+}
+
+static int parse_renderer(const char *name, render_backend *out) {
+  for (int i = 0; i < (int)(sizeof(renderer_names) / sizeof(renderer_names[0])); i++) {
+    if (strcmp(name, renderer_names[i]) == 0) {
+      *out = (render_backend)i;
+      return 0;
+    }
+  }
+  return -1;
+}
+
+/// @brief Parse headless benchmark arguments
+/// @param argc Argument count
+/// @param argv Arguments
+/// @param opts Options to fill
+/// @return 0 on success, -1 on unknown argument or missing --bench
+int headless_parse_args(int argc, char *argv[], headless_options *opts) {
+  headless_options_init(opts);
+  bool bench = false;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--bench") == 0) {
+      bench = true;
+    } else if (strcmp(argv[i], "--level") == 0 && i + 1 < argc) {
+      opts->levelnum = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+      opts->seed = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+      opts->frames = atol(argv[++i]);
+    } else if (strcmp(argv[i], "--renderer") == 0 && i + 1 < argc) {
+      if (parse_renderer(argv[++i], &opts->renderer) != 0)
+        return -1;
+    } else if (strcmp(argv[i], "--script") == 0 && i + 1 < argc) {
+      opts->script_path = argv[++i];
+    } else if (strcmp(argv[i], "--no-profile") == 0) {
+      opts->profile = false;
+    } else if (strcmp(argv[i], "--vt") == 0) {
+      opts->vt = true;
+    } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+      opts->record_path = argv[++i];
+    } else if (strcmp(argv[i], "--autopilot") == 0) {
+      opts->autopilot = true;
+    } else if (strcmp(argv[i], "--agent") == 0 && i + 1 < argc) {
+      opts->agent_path = argv[++i];
+    } else {
+      return -1;
+    }
+  }
+  if (opts->vt && opts->renderer != RENDER_BACKEND_NULL)
+    return -1;
+  if (opts->autopilot && opts->agent_path)
+    return -1;
+  return bench && opts->frames > 0 ? 0 : -1;
+}
+
+void headless_print_usage(FILE *out, const char *argv0) {
+  fprintf(out,
+          "Usage: %s --bench [--level N] [--seed S] [--frames F] [--renderer none|ncurses|null]\n"
+          "       [--script FILE] [--no-profile] [--vt] [--record FILE]\n"
+          "       [--autopilot | --agent FILE]\n"
+          "Plays F frames of a level from scripted input without sleeping and prints JSON.\n"
+          "Script lines are \"<frame> <key>\", key is a character or 'space'.\n"
+          "--vt parses the null renderer output with a virtual terminal and reports the\n"
+          "final screen hash, a hash of every frame and the parse cost.\n"
+          "--record saves the first run as a replay for --replay.\n"
+          "--autopilot plays with the beam search bot and reports its search rate.\n"
+          "--agent plays with a controller plugin, see include/flappybird/agent_api.h.\n",
+          argv0);
+}
+
+static int compare_events(const void *a, const void *b) {
+  const script_event *lhs = a;
+  const script_event *rhs = b;
+  return (lhs->frame > rhs->frame) - (lhs->frame < rhs->frame);
+}
+
+/// @brief Load "<frame> <key>" lines, empty lines and lines starting with '#' are skipped
+static int load_script(const char *path, input_script *script) {
+  FILE *fp = fopen(path, "r");
+  if (fp == NULL)
+    return -1;
+
+  size_t capacity = 0;
+  char line[128] = {0};
+  while (fgets(line, sizeof(line), fp) != NULL) {
+    long frame = 0;
+    char key[32] = {0};
+    if (line[0] == '#' || sscanf(line, "%ld %31s", &frame, key) != 2)
+      continue;
+
+    if (script->count == capacity) {
+      capacity = capacity ? capacity * 2 : 64;
+      script_event *grown = realloc(script->events, capacity * sizeof(*grown));
+      if (grown == NULL) {
+        fclose(fp);
+        return -1;
+      }
+      script->events = grown;
+    }
+    script->events[script->count].frame = frame;
+    script->events[script->count].key = strcmp(key, "space") == 0 ? ' ' : key[0];
+    script->count++;
+  }
+  fclose(fp);
+
+  if (script->count > 0)
+    qsort(script->events, script->count, sizeof(script->events[0]), compare_events);
+  return 0;
+}
+
+/// @brief Key source of run_level, ends the run once the frame budget is spent
+static int script_next_key(void *ctx, level_prompt prompt) {
+  input_script *script = ctx;
+  if (prompt == LEVEL_PROMPT_PAUSED)
+    return 'p';
+  if (script->frame >= script->frames)
+    return 'e';
+  if (prompt == LEVEL_PROMPT_COLLISION)
+    return 't';
+
+  long frame = script->frame++;
+  if (script->pilot)
+    return autopilot_decide(script->pilot, &local_game.sim);
+  if (script->agent)
+    return agent_plugin_decide(script->agent, &local_game.sim);
+  if (script->events == NULL)
+    return frame % script->jump_every == 0 ? ' ' : ERR;
+
+  while (script->next < script->count && script->events[script->next].frame < frame)
+    script->next++;
+  if (script->next < script->count && script->events[script->next].frame == frame)
+    return script->events[script->next++].key;
+  return ERR;
+}
+
+/// @brief Jump period that keeps the bird at a steady height, jump speed is reached again
+/// after 2 * jump_speed / gravity seconds
+static long hover_period(level *inplvl) {
+  bird tmpb = get_bird(&local_game, inplvl);
+  if (tmpb.gravity <= 0)
+    return 1;
+  double seconds = 2.0 * tmpb.jump_speed / tmpb.gravity;
+  long frames = lround(seconds * 1000.0 / (double)frame_period_ms());
+  return frames > 0 ? frames : 1;
+}
+
+/// @brief Off-screen streams of the null renderer
+static FILE *null_out = NULL;
+static FILE *null_in = NULL;
+/// @brief Virtual terminal fed with the null renderer output
+static vterm null_vt;
+static bool null_vt_ready = false;
+
+static void close_null_streams(void) {
+  if (null_out)
+    fclose(null_out);
+  if (null_in)
+    fclose(null_in);
+  null_out = NULL;
+  null_in = NULL;
+  if (null_vt_ready) {
+    term_io_remove_sink(&null_vt);
+    vterm_free(&null_vt);
+  }
+  null_vt_ready = false;
+}
+
+/// @brief Open the renderer of the options, shared by all following headless_play calls
+/// @param opts Benchmark options
+/// @return Error code
+int headless_begin(const headless_options *opts) {
+  int err = 0;
+  if (opts->renderer == RENDER_BACKEND_NCURSES) {
+    err = init_screen();
+  } else if (opts->renderer == RENDER_BACKEND_NONE) {
+    err = load_settings();
+  } else {
+    null_out = fopen("/dev/null", "w");
+    null_in = fopen("/dev/null", "r");
+    err = null_out && null_in ? init_screen_term(HEADLESS_TERM_TYPE, null_out, null_in) : -1;
+  }
+  if (err != 0) {
+    fprintf(stderr, "Cannot initialize %s renderer.\n", renderer_names[opts->renderer]);
+    close_null_streams();
+    return -1;
+  }
+  if (opts->vt) {
+    if (vterm_init(&null_vt, LINES, COLS) != 0) {
+      fprintf(stderr, "Cannot initialize virtual terminal.\n");
+      headless_end(opts);
+      return -1;
+    }
+    null_vt_ready = true;
+    term_io_sink sink = vterm_sink(&null_vt);
+    term_io_add_sink(&sink);
+    // The screen was drawn before the sink existed, repaint it so the grid starts complete.
+    clearok(stdscr, TRUE);
+    refresh();
+  }
+  audio_set_enabled(false);
+  return 0;
+}
+
+/// @brief Close the renderer opened by headless_begin
+/// @param opts Benchmark options
+void headless_end(const headless_options *opts) {
+  if (opts->renderer != RENDER_BACKEND_NONE)
+    endwin();
+  close_null_streams();
+}
+
+/// @brief Play a level from scripted input as fast as possible, needs headless_begin
+/// @param opts Benchmark options
+/// @param result Output of the play
+/// @return Error code
+int headless_play(const headless_options *opts, headless_result *result) {
+  memset(result, 0, sizeof(*result));
+  result->lvl = load_level_file(opts->levelnum);
+  if (!result->lvl.loaded) {
+    fprintf(stderr, "Level %d not found in " ASSETS_FOLDER "/levels.\n", opts->levelnum);
+    return -1;
+  }
+
+  input_script script = {0};
+  script.frames = opts->frames;
+  if (opts->script_path && load_script(opts->script_path, &script) != 0) {
+    fprintf(stderr, "Cannot read input script %s.\n", opts->script_path);
+    free(script.events);
+    return -1;
+  }
+  script.jump_every = hover_period(&result->lvl);
+  if (opts->autopilot) {
+    script.pilot = malloc(sizeof(*script.pilot));
+    if (script.pilot == NULL) {
+      free(script.events);
+      return -1;
+    }
+    autopilot_init(script.pilot, &result->lvl, frame_period_ms());
+  }
+  agent_plugin agent;
+  if (opts->agent_path) {
+    if (agent_plugin_load(&agent, opts->agent_path) != 0) {
+      free(script.pilot);
+      free(script.events);
+      return -1;
+    }
+    if (agent_plugin_begin(&agent, &result->lvl, frame_period_ms()) != 0) {
+      fprintf(stderr, "Agent %s failed to start.\n", opts->agent_path);
+      agent_plugin_unload(&agent);
+      free(script.pilot);
+      free(script.events);
+      return -1;
+    }
+    script.agent = &agent;
+  }
+
+  level_driver driver = {script_next_key, &script, false, opts->profile, opts->renderer};
+  set_level_driver(&driver);
+  reset_frame_profile();
+  seed_game_rng(opts->seed, true);
+  if (null_vt_ready) {
+    memset(&null_vt.stats, 0, sizeof(null_vt.stats));
+    null_vt.frames_hash = 0;
+  }
+
+  term_io_counters before = term_io_total();
+  long long start = timeInNanoseconds();
+  while (script.frame < script.frames) {
+    int status = 0;
+    run_level(&local_game, &result->lvl, &status);
+    if (opts->record_path && result->runs == 0 &&
+        replay_save(get_last_replay(), opts->record_path) != 0)
+      fprintf(stderr, "Cannot write replay %s.\n", opts->record_path);
+    run_metrics last = get_last_run_metrics();
+    result->totals.pipes_passed += last.pipes_passed;
+    result->totals.collisions += last.collisions;
+    result->runs++;
+  }
+  result->wall_ns = timeInNanoseconds() - start;
+
+  term_io_counters after = term_io_total();
+  result->output.bytes = after.bytes - before.bytes;
+  result->output.writes = after.writes - before.writes;
+  result->output.escapes = after.escapes - before.escapes;
+  result->profile = get_frame_profile();
+  if (null_vt_ready) {
+    result->vt = null_vt.stats;
+    result->vt_screen_hash = vterm_screen_hash(&null_vt);
+    result->vt_frames_hash = null_vt.frames_hash;
+  }
+
+  if (script.pilot)
+    result->pilot = script.pilot->stats;
+  if (script.agent) {
+    snprintf(result->agent_name, sizeof(result->agent_name), "%s", agent.name);
+    result->agent_ticks = agent.obs.tick;
+    agent_plugin_unload(&agent);
+  }
+
+  set_level_driver(NULL);
+  free(script.pilot);
+  free(script.events);
+  return 0;
+}
+
+static double per_frame(long long total, long long frames) {
+  return frames > 0 ? (double)total / (double)frames : 0;
+}
+
+static void print_report(FILE *report, const headless_options *opts, const headless_result *res) {
+  const frame_profile *prof = &res->profile;
+  double wall_s = (double)res->wall_ns / 1e9;
+  double simulated_s = (double)prof->frames * (double)frame_period_ms() / 1000.0;
+  fprintf(report, "{\n  \"mode\": \"headless\",\n  \"level\": %d,\n  \"level_name\": \"%s\",\n",
+          opts->levelnum, res->lvl.levelname);
+  fprintf(report, "  \"seed\": %llu,\n  \"renderer\": \"%s\",\n  \"frames\": %lld,\n",
+          (unsigned long long)opts->seed, renderer_names[opts->renderer], prof->frames);
+  fprintf(report, "  \"runs\": %d,\n  \"pipes_passed\": %d,\n  \"collisions\": %d,\n", res->runs,
+          res->totals.pipes_passed, res->totals.collisions);
+  fprintf(report, "  \"wall_s\": %.6f,\n  \"simulated_s\": %.3f,\n", wall_s, simulated_s);
+  fprintf(report, "  \"frames_per_sec\": %.1f,\n  \"realtime_factor\": %.1f,\n",
+          wall_s > 0 ? (double)prof->frames / wall_s : 0, wall_s > 0 ? simulated_s / wall_s : 0);
+  fprintf(report, "  \"frame_ns\": %.1f,\n", per_frame(res->wall_ns, prof->frames));
+  if (opts->profile) {
+    fprintf(report, "  \"phase_ns_per_frame\": {\"input\": %.1f, \"physics\": %.1f, ",
+            per_frame(prof->input_ns, prof->frames), per_frame(prof->physics_ns, prof->frames));
+    fprintf(report, "\"render\": %.1f, \"collision\": %.1f, \"flush\": %.1f},\n",
+            per_frame(prof->render_ns, prof->frames), per_frame(prof->collision_ns, prof->frames),
+            per_frame(prof->flush_ns, prof->frames));
+  }
+  fprintf(report, "  \"bytes\": %llu,\n  \"bytes_per_frame\": %.1f,\n", res->output.bytes,
+          per_frame((long long)res->output.bytes, prof->frames));
+  fprintf(report, "  \"writes\": %llu,\n  \"escapes\": %llu", res->output.writes,
+          res->output.escapes);
+  if (opts->vt) {
+    fprintf(report, ",\n  \"vt\": {\"screen_hash\": \"%016llx\", \"frames_hash\": \"%016llx\", ",
+            (unsigned long long)res->vt_screen_hash, (unsigned long long)res->vt_frames_hash);
+    fprintf(report, "\"frames\": %llu, \"printed\": %llu, \"sequences\": %llu, ",
+            res->vt.frames, res->vt.printed, res->vt.sequences);
+    fprintf(report, "\"parse_ns_per_frame\": %.1f}", per_frame(res->vt.parse_ns, prof->frames));
+  }
+  if (opts->autopilot) {
+    const autopilot_stats *pilot = &res->pilot;
+    fprintf(report, ",\n  \"autopilot\": {\"decisions\": %lld, \"nodes\": %lld, ", pilot->decisions,
+            pilot->nodes);
+    fprintf(report, "\"nodes_per_sec\": %.0f, \"search_ns_per_decision\": %.1f}",
+            pilot->search_ns > 0 ? (double)pilot->nodes * 1e9 / (double)pilot->search_ns : 0,
+            per_frame(pilot->search_ns, pilot->decisions));
+  }
+  if (opts->agent_path)
+    fprintf(report, ",\n  \"agent\": {\"name\": \"%s\", \"ticks\": %lld}", res->agent_name,
+            res->agent_ticks);
+  fprintf(report, "\n}\n");
+}
+
+/// @brief Play a level from scripted input as fast as possible and report frame costs
+/// @param opts Benchmark options
+/// @param report Stream the JSON report is written to
+/// @return Error code
+int run_headless(const headless_options *opts, FILE *report) {
+  if (headless_begin(opts) != 0)
+    return -1;
+  headless_result result;
+  int err = headless_play(opts, &result);
+  headless_end(opts);
+  if (err == 0)
+    print_report(report, opts, &result);
+  return err;
+}
@@ -0,0 +1,308 @@
+// Copyright 2022 <Maros Varchola - mvarchdev>
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "flappybird/hof_audit.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "flappybird/common_tools.h"
+#include "flappybird/confparser.h"
+#include "flappybird/game_context.h"
+#include "flappybird/processing.h"
+#include "flappybird/rendering.h"
+#include "flappybird/sim.h"
+
+/// @brief Outcome of re-simulating one entry.
+typedef enum hof_verdict {
+  HOF_VERIFIED,
+  HOF_NO_LEVEL,
+  HOF_NO_REPLAY,
+  HOF_WRONG_LEVEL,
+  HOF_FRAME_PERIOD,
+  HOF_SCORE_MISMATCH
+} hof_verdict;
+
+static const char *verdict_names[] = {"verified",    "no_level",     "no_replay",
+                                      "wrong_level", "frame_period", "score_mismatch"};
+
+/// @brief One hall of fame entry and its verdict.
+typedef struct hof_entry {
+  char nickname[CONFIG_ARG_MAX_BYTES];
+  int levelnum;
+  int score;
+  /// Index into the level cache, -1 if the level file does not exist.
+  int level_index;
+  int recorded;
+  int simulated;
+  hof_verdict verdict;
+} hof_entry;
+
+/// @brief Work queue shared by the audit threads, workers take batches of entries.
+typedef struct hof_audit_queue {
+  pthread_mutex_t lock;
+  hof_entry *entries;
+  size_t count;
+  size_t next;
+  const level *levels;
+  long long frame_ms;
+  float gravity_constant;
+} hof_audit_queue;
+
+/// @brief Build the replay path of an entry, the nickname is hex encoded so any nickname is a
+/// valid file name
+/// @param buf Output buffer
+/// @param size Size of the output buffer
+/// @param nickname Player nickname
+/// @param level Level number
+/// @return Error code, -1 if the buffer is too small
+int hof_replay_path(char *buf, size_t size, const char *nickname, int level) {
+  int pos = snprintf(buf, size, "%s/lvl_%d_", HOF_REPLAY_DIR, level);
+  if (pos < 0)
+    return -1;
+  for (const unsigned char *ch = (const unsigned char *)nickname; *ch; ch++) {
+    if ((size_t)pos + 2 >= size)
+      return -1;
+    pos += snprintf(buf + pos, size - (size_t)pos, "%02x", *ch);
+  }
+  return (size_t)snprintf(buf + pos, size - (size_t)pos, ".fbr") < size - (size_t)pos ? 0 : -1;
+}
+
+/// @brief Store the replay of a new hall of fame entry next to the score
+/// @param nickname Player nickname
+/// @param level Level number
+/// @param rp Replay of the run that set the score
+/// @return Error code
+int hof_save_replay(const char *nickname, int level, const replay *rp) {
+  char path[512] = {0};
+  if (hof_replay_path(path, sizeof(path), nickname, level) != 0)
+    return -1;
+  if (mkdir(HOF_REPLAY_DIR, 0755) != 0 && errno != EEXIST)
+    return -1;
+  return replay_save(rp, path);
+}
+
+/// @brief Parse hall of fame audit arguments
+/// @param argc Argument count
+/// @param argv Arguments
+/// @param opts Options to fill
+/// @return 0 on success, -1 if the arguments are not an audit
+int hof_audit_parse_args(int argc, char *argv[], hof_audit_options *opts) {
+  memset(opts, 0, sizeof(*opts));
+  bool audit = false;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--audit-hof") == 0) {
+      audit = true;
+    } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+      opts->threads = atoi(argv[++i]);
+    } else {
+      return -1;
+    }
+  }
+  return audit && opts->threads >= 0 ? 0 : -1;
+}
+
+/// @brief Split a hall of fame key "<nickname>#lvl_<level>#", nicknames may contain '#'
+static int parse_hof_key(const char *key, hof_entry *entry) {
+  const char *marker = NULL;
+  for (const char *found = strstr(key, "#lvl_"); found; found = strstr(found + 1, "#lvl_"))
+    marker = found;
+  size_t len = strlen(key);
+  if (!marker || len == 0 || key[len - 1] != '#')
+    return -1;
+  snprintf(entry->nickname, sizeof(entry->nickname), "%.*s", (int)(marker - key), key);
+  entry->levelnum = atoi(marker + strlen("#lvl_"));
+  return 0;
+}
+
+/// @brief Levels the entries refer to, each loaded once before the workers start.
+typedef struct level_cache {
+  level *levels;
+  size_t count;
+} level_cache;
+
+/// @brief Find or load a level, missing levels are cached too
+/// @return Index of the level, -1 if it does not exist
+static int cached_level(level_cache *cache, int levelnum) {
+  size_t i = 0;
+  while (i < cache->count && cache->levels[i].levelnumber != levelnum) i++;
+  if (i == cache->count) {
+    level *grown = realloc(cache->levels, (cache->count + 1) * sizeof(*grown));
+    if (grown == NULL)
+      return -1;
+    cache->levels = grown;
+    cache->levels[cache->count++] = load_level_file(levelnum);
+  }
+  return cache->levels[i].loaded ? (int)i : -1;
+}
+
+/// @brief Read every entry of the hall of fame in file order
+/// @return Number of entries, -1 on allocation failure
+static long read_entries(hof_entry **entries, level_cache *cache) {
+  config_option_t hof = read_config_file(HALLOFFAME_FILE);
+  size_t count = 0;
+  for (config_option_t opt = hof; opt; opt = opt->prev) count++;
+
+  *entries = calloc(count ? count : 1, sizeof(**entries));
+  if (*entries == NULL) {
+    free_config_options(hof);
+    return -1;
+  }
+  // The parser links entries from the last line backwards.
+  size_t filled = count;
+  for (config_option_t opt = hof; opt; opt = opt->prev) {
+    hof_entry *entry = &(*entries)[--filled];
+    if (parse_hof_key(opt->key, entry) != 0)
+      entry->levelnum = -1;
+    entry->score = atoi(opt->value);
+    entry->level_index = entry->levelnum > 0 ? cached_level(cache, entry->levelnum) : -1;
+    entry->recorded = -1;
+    entry->simulated = -1;
+  }
+  free_config_options(hof);
+  return (long)count;
+}
+
+/// @brief Re-simulate one entry from its replay, touches only the entry and a local state
+static void audit_entry(const hof_audit_queue *queue, hof_entry *entry) {
+  if (entry->level_index < 0) {
+    entry->verdict = HOF_NO_LEVEL;
+    return;
+  }
+  char path[512] = {0};
+  replay rp;
+  if (hof_replay_path(path, sizeof(path), entry->nickname, entry->levelnum) != 0 ||
+      replay_load(&rp, path) != 0) {
+    entry->verdict = HOF_NO_REPLAY;
+    return;
+  }
+
+  entry->recorded = rp.score;
+  if (rp.levelnum != entry->levelnum) {
+    entry->verdict = HOF_WRONG_LEVEL;
+  } else if (rp.frame_ms != queue->frame_ms) {
+    entry->verdict = HOF_FRAME_PERIOD;
+  } else {
+    sim_state sim;
+    sim_init(&sim, queue->gravity_constant);
+    sim_run_replay(&sim, &queue->levels[entry->level_index], &rp, &entry->simulated);
+    entry->verdict = entry->simulated == entry->score ? HOF_VERIFIED : HOF_SCORE_MISMATCH;
+  }
+  replay_free(&rp);
+}
+
+static void *audit_worker(void *arg) {
+  hof_audit_queue *queue = arg;
+  while (true) {
+    pthread_mutex_lock(&queue->lock);
+    size_t begin = queue->next;
+    size_t end = begin + HOF_AUDIT_BATCH < queue->count ? begin + HOF_AUDIT_BATCH : queue->count;
+    queue->next = end;
+    pthread_mutex_unlock(&queue->lock);
+    if (begin == end)
+      return NULL;
+    for (size_t i = begin; i < end; i++) audit_entry(queue, &queue->entries[i]);
+  }
+}
+
+/// @brief Audit threads to start, never more than there are batches
+static int audit_thread_count(const hof_audit_options *opts, size_t count) {
+  long threads = opts->threads > 0 ? opts->threads : sysconf(_SC_NPROCESSORS_ONLN);
+  long batches = (long)((count + HOF_AUDIT_BATCH - 1) / HOF_AUDIT_BATCH);
+  if (threads > batches)
+    threads = batches;
+  if (threads > HOF_AUDIT_MAX_THREADS)
+    threads = HOF_AUDIT_MAX_THREADS;
+  return threads < 1 ? 1 : (int)threads;
+}
+
+static void print_json_string(FILE *out, const char *str) {
+  fputc('"', out);
+  for (const unsigned char *ch = (const unsigned char *)str; *ch; ch++) {
+    if (*ch == '"' || *ch == '\\')
+      fprintf(out, "\\%c", *ch);
+    else if (*ch < 0x20)
+      fprintf(out, "\\u%04x", *ch);
+    else
+      fputc(*ch, out);
+  }
+  fputc('"', out);
+}
+
+static void print_report(FILE *out, const hof_entry *entries, size_t count, int threads,
+                         long long wall_ns) {
+  size_t verified = 0;
+  for (size_t i = 0; i < count; i++) verified += entries[i].verdict == HOF_VERIFIED;
+  double wall_s = (double)wall_ns / 1e9;
+
+  fprintf(out, "{\n  \"mode\": \"hof-audit\",\n  \"entries\": %zu,\n  \"threads\": %d,\n", count,
+          threads);
+  fprintf(out, "  \"verified\": %zu,\n  \"flagged\": %zu,\n", verified, count - verified);
+  fprintf(out, "  \"wall_s\": %.6f,\n  \"entries_per_sec\": %.1f,\n", wall_s,
+          wall_s > 0 ? (double)count / wall_s : 0);
+  fprintf(out, "  \"flagged_entries\": [");
+  bool first = true;
+  for (size_t i = 0; i < count; i++) {
+    const hof_entry *entry = &entries[i];
+    if (entry->verdict == HOF_VERIFIED)
+      continue;
+    fprintf(out, "%s\n    {\"nickname\": ", first ? "" : ",");
+    print_json_string(out, entry->nickname);
+    fprintf(out, ", \"level\": %d, \"stored\": %d, \"recorded\": %d, \"simulated\": %d, ",
+            entry->levelnum, entry->score, entry->recorded, entry->simulated);
+    fprintf(out, "\"reason\": \"%s\"}", verdict_names[entry->verdict]);
+    first = false;
+  }
+  fprintf(out, "%s]\n}\n", first ? "" : "\n  ");
+}
+
+/// @brief Re-simulate every hall of fame entry from its stored replay on a pool of threads and
+/// report entries whose score the replay does not reproduce
+/// @param opts Audit options
+/// @param report Stream the JSON report is written to
+/// @return 0 if every entry is verified, 1 if any is flagged, -1 on error
+int run_hof_audit(const hof_audit_options *opts, FILE *report) {
+  if (load_settings() != 0 || frame_period_ms() <= 0) {
+    fprintf(stderr, "Cannot load settings.\n");
+    return -1;
+  }
+
+  level_cache cache = {NULL, 0};
+  hof_entry *entries = NULL;
+  long count = read_entries(&entries, &cache);
+  if (count < 0) {
+    fprintf(stderr, "Cannot read the hall of fame.\n");
+    free(cache.levels);
+    return -1;
+  }
+
+  hof_audit_queue queue = {PTHREAD_MUTEX_INITIALIZER, entries, (size_t)count, 0, cache.levels,
+                           frame_period_ms(), local_game.sim.gravity_constant};
+  int threads = audit_thread_count(opts, queue.count);
+  pthread_t workers[HOF_AUDIT_MAX_THREADS];
+  long long start = timeInNanoseconds();
+  int started = 0;
+  for (; started < threads; started++) {
+    if (pthread_create(&workers[started], NULL, audit_worker, &queue) != 0)
+      break;
+  }
+  // With no thread started the caller works through the queue alone.
+  if (started == 0)
+    audit_worker(&queue);
+  for (int i = 0; i < started; i++) pthread_join(workers[i], NULL);
+  long long wall_ns = timeInNanoseconds() - start;
+
+  print_report(report, entries, queue.count, started ? started : 1, wall_ns);
+  int err = 0;
+  for (size_t i = 0; i < queue.count && err == 0; i++) err = entries[i].verdict != HOF_VERIFIED;
+  pthread_mutex_destroy(&queue.lock);
+  free(entries);
+  free(cache.levels);
+  return err;
+}
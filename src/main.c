@@ -1,21 +1,189 @@
 // Copyright 2022 <Maros Varchola - mvarchdev>
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <ncurses.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
+#include "flappybird/autopilot.h"
+#include "flappybird/batch_env.h"
+#include "flappybird/cast_rec.h"
+#include "flappybird/headless.h"
+#include "flappybird/hof_audit.h"
+#include "flappybird/mem_stats.h"
+#include "flappybird/party.h"
 #include "flappybird/processing.h"
 #include "flappybird/rendering.h"
+#include "flappybird/replay.h"
+#include "flappybird/server.h"
+#include "flappybird/spectate.h"
+#include "flappybird/term_io.h"
+#include "flappybird/video_export.h"
+
+/// @brief Seed of the daily challenge, the UTC date as YYYYMMDD
+static uint64_t daily_seed(void) {
+  time_t now = time(NULL);
+  struct tm utc;
+  if (gmtime_r(&now, &utc) == NULL)
+    return 0;
+  return (uint64_t)(utc.tm_year + 1900) * 10000 + (uint64_t)(utc.tm_mon + 1) * 100 +
+         (uint64_t)utc.tm_mday;
+}
+
+/// @brief Parse the options of interactive play
+/// @param demo_level Set to the level of --autopilot N, 0 without it
+/// @param agent_path Set to the controller plugin of --agent FILE, NULL without it
+/// @param broadcast Set if --broadcast asks to publish the screen to spectators
+/// @param cast_path Set to the asciicast file of --record FILE, NULL without it
+/// @param cast_compact Set if --compact asks to record frame diffs
+/// @return 0 on success, -1 if the arguments are not play options
+static int parse_play_args(int argc, char *argv[], int *demo_level, const char **agent_path,
+                           bool *broadcast, const char **cast_path, bool *cast_compact) {
+  *demo_level = 0;
+  *agent_path = NULL;
+  *broadcast = false;
+  *cast_path = NULL;
+  *cast_compact = false;
+  bool party = false;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--autopilot") == 0 && i + 1 < argc) {
+      *demo_level = atoi(argv[++i]);
+      if (*demo_level <= 0)
+        return -1;
+    } else if (strcmp(argv[i], "--agent") == 0 && i + 1 < argc) {
+      *agent_path = argv[++i];
+    } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+      seed_game_rng(strtoull(argv[++i], NULL, 10), true);
+    } else if (strcmp(argv[i], "--daily") == 0) {
+      seed_game_rng(daily_seed(), true);
+    } else if (strcmp(argv[i], "--ghost") == 0) {
+      set_ghost_race(true);
+    } else if (strcmp(argv[i], "--practice") == 0) {
+      set_practice_mode(true);
+    } else if (strcmp(argv[i], "--players") == 0 && i + 1 < argc) {
+      int players = atoi(argv[++i]);
+      if (players < 1 || players > PARTY_MAX_PLAYERS)
+        return -1;
+      set_party_players(players);
+      party = players > 1;
+    } else if (strcmp(argv[i], "--endless") == 0) {
+      set_endless_mode(true);
+    } else if (strcmp(argv[i], "--assist") == 0) {
+      set_assist_mode(true);
+    } else if (strcmp(argv[i], "--broadcast") == 0) {
+      *broadcast = true;
+    } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+      *cast_path = argv[++i];
+    } else if (strcmp(argv[i], "--compact") == 0) {
+      *cast_compact = true;
+    } else {
+      return -1;
+    }
+  }
+  if (*cast_compact && *cast_path == NULL)
+    return -1;
+  if (practice_mode_enabled() && (*demo_level != 0 || endless_mode_enabled() || party))
+    return -1;
+  if (party && *demo_level != 0)
+    return -1;
+  return *agent_path && *demo_level == 0 ? -1 : 0;
+}
+
+int main(int argc, char *argv[]) {
+  mem_stats_init_from_env();
+  seed_game_rng((uint64_t)time(NULL), false);
+  replay_options replay_opts;
+  hof_audit_options audit_opts;
+  video_options video_opts;
+  batch_env_options batch_opts;
+  server_options server_opts;
+  const char *socket_path = NULL;
+  int demo_level = 0;
+  const char *agent_path = NULL;
+  bool broadcast = false;
+  const char *cast_path = NULL;
+  bool cast_compact = false;
+  if (argc == 2 && strcmp(argv[1], "--spectate") == 0) {
+    return run_spectator() == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+  } else if (replay_parse_args(argc, argv, &replay_opts) == 0) {
+    return play_replay(&replay_opts, stdout) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+  } else if (hof_audit_parse_args(argc, argv, &audit_opts) == 0) {
+    return run_hof_audit(&audit_opts, stdout) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+  } else if (video_parse_args(argc, argv, &video_opts) == 0) {
+    return run_video_export(&video_opts, stdout) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+  } else if (batch_env_parse_args(argc, argv, &batch_opts) == 0) {
+    return run_batch_env(&batch_opts, stdin, stdout) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+  } else if (server_parse_args(argc, argv, &server_opts) == 0) {
+    return run_server(&server_opts, stdout) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+  } else if (client_parse_args(argc, argv, &socket_path) == 0) {
+    return run_client(socket_path) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+  } else if (parse_play_args(argc, argv, &demo_level, &agent_path, &broadcast, &cast_path,
+                             &cast_compact) != 0) {
+    headless_options opts;
+    if (headless_parse_args(argc, argv, &opts) != 0) {
+      fprintf(stderr,
+              "Usage: %s [--seed S | --daily] [--ghost] [--assist] [--endless] [--players N]\n"
+              "       [--practice | --autopilot LEVEL [--agent FILE]] [--broadcast]\n"
+              "       [--record FILE.cast [--compact]]\n",
+              argv[0]);
+      fprintf(stderr, "       %s --replay FILE [--speed X] [--fast-forward]\n", argv[0]);
+      fprintf(stderr, "       %s --audit-hof [--threads N]\n", argv[0]);
+      fprintf(stderr, "       %s --export-video REPLAY --output FILE.y4m [--threads N]\n",
+              argv[0]);
+      fprintf(stderr, "       %s --batch-env N [--level L] [--seed S]\n", argv[0]);
+      fprintf(stderr, "       %s --serve SOCKET [--max-sessions N]\n", argv[0]);
+      fprintf(stderr, "       %s --connect SOCKET\n", argv[0]);
+      fprintf(stderr, "       %s --spectate\n", argv[0]);
+      fprintf(stderr,
+              "Every level plays the same course for the same seed, --daily uses the date.\n");
+      fprintf(stderr, "--ghost plays the course of your best run with its ghost next to you.\n");
+      fprintf(stderr, "--practice plays without lives, R rewinds a few seconds to retry.\n");
+      fprintf(stderr, "--endless plays until you end the run, crashes cost no life.\n");
+      fprintf(stderr, "--players 2-4 share one keyboard, jump keys are space, L, A and M.\n");
+      fprintf(stderr, "--assist draws where the bird flies with and without a jump now.\n");
+      fprintf(stderr, "--autopilot lets the bot play a level on screen until Q or E, --agent\n"
+                      "replaces the bot with a controller plugin (.so).\n");
+      fprintf(stderr, "--batch-env steps N games per request over a binary stdin/stdout protocol,\n"
+                      "see include/flappybird/batch_env.h.\n");
+      fprintf(stderr, "--broadcast mirrors the screen to shared memory, --spectate shows it\n"
+                      "live in another terminal.\n");
+      fprintf(stderr, "--record writes the session as an asciicast v2 file, --compact stores\n"
+                      "frame diffs instead of the raw output.\n");
+      fprintf(stderr, "--export-video renders a replay into an uncompressed Y4M video.\n");
+      fprintf(stderr, "--serve hosts games for --connect clients on a Unix socket until Ctrl+C.\n");
+      headless_print_usage(stderr, argv[0]);
+      return EXIT_FAILURE;
+    }
+    return run_headless(&opts, stdout) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+  } else if (broadcast && spectate_publish_start() != 0) {
+    return EXIT_FAILURE;
+  } else if (cast_path && cast_rec_start(cast_path, cast_compact) != 0) {
+    spectate_publish_stop();
+    return EXIT_FAILURE;
+  } else if (demo_level > 0) {
+    int err = autopilot_demo(demo_level, agent_path);
+    spectate_publish_stop();
+    err |= cast_rec_stop();
+    cast_rec_print_report(stdout);
+    return err == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
 
-int main(void) {
-  srand((unsigned int)time(NULL));
   if (init_screen() != 0) {
+    spectate_publish_stop();
+    cast_rec_stop();
     fprintf(stderr, "Failed to initialize screen.\n");
     return EXIT_FAILURE;
   }
 
   run_game();
   endwin();
+  spectate_publish_stop();
+  cast_rec_stop();
+  cast_rec_print_report(stdout);
+  term_io_print_report(stdout);
+  mem_stats_print_report(stdout);
   return EXIT_SUCCESS;
 }
@@ -0,0 +1,193 @@
+// Copyright 2022 <Maros Varchola - mvarchdev>
+
+#include "flappybird/mem_stats.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "flappybird/term_io.h"
+
+/// @brief Process status file with resident set size lines.
+#define PROC_STATUS_FILE "/proc/self/status"
+
+/// @brief Bookkeeping stored in front of every tracked block.
+typedef union mem_header {
+  struct {
+    size_t size;
+    mem_tag tag;
+  } info;
+  max_align_t align;
+} mem_header;
+
+static bool g_enabled = false;
+static mem_tag g_tag = MEM_TAG_CONFIG;
+static int g_gameplay_depth = 0;
+static unsigned long long g_gameplay_allocations = 0;
+static mem_tag_stats g_tags[MEM_TAG_COUNT] = {{0}};
+static unsigned long long g_screen_allocations[TERM_IO_SCREEN_COUNT] = {0};
+
+static const char *g_tag_names[MEM_TAG_COUNT] = {"config", "hof", "levels", "render"};
+
+/// @brief Enable tracking if MEM_STATS_ENV is set to a non-zero value
+void mem_stats_init_from_env(void) {
+  const char *value = getenv(MEM_STATS_ENV);
+  mem_stats_set_enabled(value != NULL && atoi(value) != 0);
+}
+
+void mem_stats_set_enabled(bool enabled) { g_enabled = enabled; }
+
+bool mem_stats_enabled(void) { return g_enabled; }
+
+/// @brief Attribute following allocations to a subsystem
+/// @param tag Subsystem tag
+/// @return Previously active tag, to be restored by the caller
+mem_tag mem_stats_set_tag(mem_tag tag) {
+  mem_tag previous = g_tag;
+  if (tag >= 0 && tag < MEM_TAG_COUNT) {
+    g_tag = tag;
+  }
+  return previous;
+}
+
+/// @brief Counting replacement for calloc()
+/// @param count Number of elements
+/// @param size Size of one element
+/// @return Zeroed block or NULL
+void *mem_calloc(size_t count, size_t size) {
+  if (size != 0 && count > (SIZE_MAX - sizeof(mem_header)) / size) {
+    return NULL;
+  }
+
+  size_t bytes = count * size;
+  mem_header *header = calloc(1, sizeof(mem_header) + bytes);
+  if (header == NULL) {
+    return NULL;
+  }
+  header->info.size = bytes;
+  header->info.tag = g_tag;
+
+  if (g_enabled) {
+    mem_tag_stats *stats = &g_tags[g_tag];
+    stats->allocations++;
+    stats->bytes_allocated += bytes;
+    stats->live_bytes += (long long)bytes;
+    if (stats->live_bytes > stats->peak_live_bytes) {
+      stats->peak_live_bytes = stats->live_bytes;
+    }
+    g_screen_allocations[term_io_get_screen()]++;
+    if (g_gameplay_depth > 0) {
+      g_gameplay_allocations++;
+    }
+  }
+
+  return header + 1;
+}
+
+/// @brief Counting replacement for free(), only for blocks from mem_calloc()
+/// @param ptr Block to release
+void mem_free(void *ptr) {
+  if (ptr == NULL) {
+    return;
+  }
+
+  mem_header *header = (mem_header *)ptr - 1;
+  if (g_enabled) {
+    mem_tag_stats *stats = &g_tags[header->info.tag];
+    stats->frees++;
+    stats->live_bytes -= (long long)header->info.size;
+  }
+  free(header);
+}
+
+/// @brief Count a buffer grown with plain realloc(), it is not attributed to a tag but still
+/// shows up as an allocation inside the gameplay loop
+void mem_stats_count_growth(void) {
+  if (g_enabled && g_gameplay_depth > 0) {
+    g_gameplay_allocations++;
+  }
+}
+
+void mem_stats_enter_gameplay(void) { g_gameplay_depth++; }
+
+void mem_stats_leave_gameplay(void) {
+  if (g_gameplay_depth > 0) {
+    g_gameplay_depth--;
+  }
+}
+
+unsigned long long mem_stats_gameplay_allocations(void) { return g_gameplay_allocations; }
+
+mem_tag_stats mem_stats_get(mem_tag tag) {
+  mem_tag_stats empty = {0};
+  if (tag < 0 || tag >= MEM_TAG_COUNT) {
+    return empty;
+  }
+  return g_tags[tag];
+}
+
+const char *mem_stats_tag_name(mem_tag tag) {
+  if (tag < 0 || tag >= MEM_TAG_COUNT) {
+    return "unknown";
+  }
+  return g_tag_names[tag];
+}
+
+/// @brief Read resident set size of this process
+/// @param peak If true, peak (VmHWM) is returned, else current (VmRSS)
+/// @return Size in kB, -1 if not available
+long mem_stats_rss_kb(bool peak) {
+  FILE *fp = fopen(PROC_STATUS_FILE, "r");
+  if (fp == NULL) {
+    return -1;
+  }
+
+  const char *key = peak ? "VmHWM:" : "VmRSS:";
+  size_t key_len = strlen(key);
+  long value = -1;
+  char line[128] = {0};
+  while (fgets(line, sizeof(line), fp) != NULL) {
+    if (strncmp(line, key, key_len) == 0) {
+      value = strtol(line + key_len, NULL, 10);
+      break;
+    }
+  }
+
+  fclose(fp);
+  return value;
+}
+
+/// @brief Print memory report
+/// @param out Stream to print to
+void mem_stats_print_report(FILE *out) {
+  if (out == NULL) {
+    return;
+  }
+
+  fprintf(out, "Memory report\n");
+  if (!g_enabled) {
+    fprintf(out, "  allocation tracking is off (set %s=1 to enable)\n", MEM_STATS_ENV);
+  } else {
+    fprintf(out, "  %-8s %10s %10s %14s %12s %12s\n", "tag", "allocs", "frees", "bytes", "live",
+            "peak live");
+    for (int i = 0; i < MEM_TAG_COUNT; i++) {
+      fprintf(out, "  %-8s %10llu %10llu %14llu %12lld %12lld\n", g_tag_names[i],
+              g_tags[i].allocations, g_tags[i].frees, g_tags[i].bytes_allocated,
+              g_tags[i].live_bytes, g_tags[i].peak_live_bytes);
+    }
+    fprintf(out, "Allocations per screen:\n");
+    for (int i = 0; i < TERM_IO_SCREEN_COUNT; i++) {
+      if (g_screen_allocations[i] > 0) {
+        fprintf(out, "  %-14s %10llu\n", term_io_screen_name((term_io_screen)i),
+                g_screen_allocations[i]);
+      }
+    }
+    fprintf(out, "Allocations inside gameplay loop: %llu\n", g_gameplay_allocations);
+  }
+
+  long peak_rss = mem_stats_rss_kb(true);
+  long rss = mem_stats_rss_kb(false);
+  if (peak_rss >= 0) {
+    fprintf(out, "Peak RSS: %ld kB (current %ld kB)\n", peak_rss, rss);
+  }
+}
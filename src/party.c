@@ -0,0 +1,165 @@
+// Copyright 2022 <Maros Varchola - mvarchdev>
+
+#include "flappybird/party.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/// @brief Start a party run, every bird starts like the first one
+/// @param pt Party
+/// @param players Number of players, clamped to PARTY_MIN_PLAYERS..PARTY_MAX_PLAYERS
+/// @param first Bird of a new life
+/// @param lives Lives of every player
+/// @param endless True if crashes cost no life
+void party_init(party *pt, int players, const bird *first, int lives, bool endless) {
+  memset(pt, 0, sizeof(*pt));
+  if (players < PARTY_MIN_PLAYERS)
+    players = PARTY_MIN_PLAYERS;
+  if (players > PARTY_MAX_PLAYERS)
+    players = PARTY_MAX_PLAYERS;
+  pt->players = players;
+  pt->endless = endless;
+  for (int i = 0; i < players; i++) {
+    party_player *pl = &pt->player[i];
+    pl->bird = *first;
+    pl->lives = lives;
+    pl->flying = true;
+    pl->metrics.highest_multiplier = 1;
+  }
+}
+
+/// @brief Find the player a key belongs to
+/// @param pt Party
+/// @param ch Key
+/// @return Player index, -1 if the key is no jump key of this party
+int party_key_player(const party *pt, int ch) {
+  const char *keys = PARTY_JUMP_KEYS;
+  for (int i = 0; i < pt->players; i++)
+    if (ch == keys[i])
+      return i;
+  return -1;
+}
+
+/// @brief Jump with the bird of a player if it is in the air
+/// @param pt Party
+/// @param player Player index
+void party_jump(party *pt, int player) {
+  party_player *pl = &pt->player[player];
+  if (!pl->flying)
+    return;
+  jump_bird(&pl->bird);
+  pl->metrics.jumps++;
+}
+
+/// @brief Move the flying birds to the clock and let crashed birds back in once their wait
+/// is over and the middle of the column is free
+/// @param pt Party
+/// @param sim World of the frame, pipes not moved yet
+/// @param inplvl Level
+void party_move_birds(party *pt, const sim_state *sim, const level *inplvl) {
+  pt->blocked = sim_blocked_rows(sim, BIRDOFFX);
+  for (int i = 0; i < pt->players; i++) {
+    party_player *pl = &pt->player[i];
+    if (pl->flying) {
+      bird_advance(&pl->bird, sim->clock);
+      continue;
+    }
+    if (pl->respawn_clock == 0 || sim->clock < pl->respawn_clock)
+      continue;
+    bird fresh = sim_get_bird(sim, inplvl);
+    if (pt->blocked & (1u << fixed_to_int(fresh.act_position)))
+      continue;
+    fresh.colorbits = pl->bird.colorbits;
+    pl->bird = fresh;
+    pl->flying = true;
+    pl->respawn_clock = 0;
+  }
+}
+
+/// @brief Check every flying bird against the collision rows of the frame
+/// @param pt Party
+/// @param sim World of the frame
+/// @return Bit i is set if the bird of player i crashed
+int party_collide(party *pt, const sim_state *sim) {
+  int crashed = 0;
+  for (int i = 0; i < pt->players; i++) {
+    party_player *pl = &pt->player[i];
+    if (!pl->flying || !(pt->blocked & (1u << fixed_to_int(pl->bird.act_position))))
+      continue;
+    crashed |= 1 << i;
+    pl->flying = false;
+    pl->streak = 0;
+    pl->metrics.collisions++;
+    if (!pt->endless)
+      pl->lives--;
+    pl->respawn_clock = pt->endless || pl->lives > 0 ? sim->clock + PARTY_RESPAWN_MS : 0;
+  }
+  return crashed;
+}
+
+/// @brief Score the pipes the bird column passed for every bird in the air
+/// @param pt Party
+/// @param passed_pipes Pipes passed in the frame
+void party_score(party *pt, int passed_pipes) {
+  if (passed_pipes <= 0)
+    return;
+  for (int i = 0; i < pt->players; i++) {
+    party_player *pl = &pt->player[i];
+    if (!pl->flying)
+      continue;
+    pl->streak += passed_pipes;
+    int multiplier = sim_streak_multiplier(pl->streak);
+    pl->score += passed_pipes * multiplier;
+    pl->metrics.pipes_passed += passed_pipes;
+    if (multiplier > pl->metrics.highest_multiplier)
+      pl->metrics.highest_multiplier = multiplier;
+    if (pl->streak > pl->metrics.highest_streak)
+      pl->metrics.highest_streak = pl->streak;
+  }
+}
+
+/// @brief Continue after a pause without moving the birds or the world by the paused time
+/// @param pt Party
+/// @param sim World
+void party_resume(party *pt, sim_state *sim) {
+  for (int i = 0; i < pt->players; i++) sim_resume(sim, &pt->player[i].bird);
+}
+
+/// @brief Check if every player is out of lives
+/// @param pt Party
+/// @return True when the run is over
+bool party_over(const party *pt) {
+  for (int i = 0; i < pt->players; i++)
+    if (pt->player[i].flying || pt->player[i].respawn_clock != 0)
+      return false;
+  return true;
+}
+
+/// @brief Find the player with the best score, the earlier player wins ties
+/// @param pt Party
+/// @return Player index
+int party_leader(const party *pt) {
+  int leader = 0;
+  for (int i = 1; i < pt->players; i++)
+    if (pt->player[i].score > pt->player[leader].score)
+      leader = i;
+  return leader;
+}
+
+/// @brief Format the HUD line of a player
+/// @param pt Party
+/// @param player Player index
+/// @param buf Output buffer
+/// @param size Size of the output buffer
+void party_hud_line(const party *pt, int player, char *buf, size_t size) {
+  const party_player *pl = &pt->player[player];
+  char key[8] = "space";
+  if (PARTY_JUMP_KEYS[player] != ' ')
+    snprintf(key, sizeof(key), "%c", PARTY_JUMP_KEYS[player]);
+  char lives[16] = "endless";
+  if (!pt->endless)
+    snprintf(lives, sizeof(lives), "%d", pl->lives);
+  const char *state = pl->flying ? "" : pl->respawn_clock ? " | crashed" : " | out";
+  snprintf(buf, size, "P%d [%s]: score %d | x%d | lives %s%s", player + 1, key, pl->score,
+           sim_streak_multiplier(pl->streak), lives, state);
+}
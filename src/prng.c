@@ -0,0 +1,142 @@
+// Copyright 2022 <Maros Varchola - mvarchdev>
+
+#include "flappybird/prng.h"
+
+#include <stddef.h>
+
+static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+/// @brief splitmix64 step, spreads a plain seed over the whole state
+static uint64_t splitmix64(uint64_t *x) {
+  uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+/// @brief Seed a generator, any seed including 0 gives a valid state
+/// @param rng Generator
+/// @param seed Seed
+void prng_seed(prng *rng, uint64_t seed) {
+  for (int i = 0; i < 4; i++) {
+    rng->s[i] = splitmix64(&seed);
+  }
+}
+
+/// @brief Next 64 random bits (xoshiro256**)
+/// @param rng Generator
+/// @return Random value
+uint64_t prng_next(prng *rng) {
+  uint64_t *s = rng->s;
+  uint64_t result = rotl(s[1] * 5, 7) * 9;
+  uint64_t t = s[1] << 17;
+
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = rotl(s[3], 45);
+
+  return result;
+}
+
+static void apply_jump(prng *rng, const uint64_t jump[4]) {
+  uint64_t s[4] = {0};
+  for (int i = 0; i < 4; i++) {
+    for (int b = 0; b < 64; b++) {
+      if (jump[i] & (1ULL << b)) {
+        for (int j = 0; j < 4; j++) {
+          s[j] ^= rng->s[j];
+        }
+      }
+      prng_next(rng);
+    }
+  }
+  for (int j = 0; j < 4; j++) {
+    rng->s[j] = s[j];
+  }
+}
+
+/// @brief Advance the generator by 2^128 draws, gives 2^128 non-overlapping streams
+/// @param rng Generator
+void prng_jump(prng *rng) {
+  static const uint64_t jump[4] = {0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL,
+                                   0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL};
+  apply_jump(rng, jump);
+}
+
+/// @brief Advance the generator by 2^192 draws, separates sessions that each use prng_jump
+/// @param rng Generator
+void prng_long_jump(prng *rng) {
+  static const uint64_t jump[4] = {0x76e15d3efefdcbbfULL, 0xc5004e441c522fb3ULL,
+                                   0x77710069854ee241ULL, 0x39109bb02acbe635ULL};
+  apply_jump(rng, jump);
+}
+
+/// @brief Uniform value in 0..bound-1 without modulo bias (Lemire's multiply and reject)
+/// @param rng Generator
+/// @param bound Exclusive upper bound, 0 returns 0
+/// @return Random value
+uint64_t prng_below(prng *rng, uint64_t bound) {
+  if (bound == 0) {
+    return 0;
+  }
+  // 64x64 multiply split into 32-bit halves to stay within C11.
+  uint64_t threshold = (0 - bound) % bound;
+  for (;;) {
+    uint64_t x = prng_next(rng);
+    uint64_t x_lo = x & 0xffffffffULL, x_hi = x >> 32;
+    uint64_t b_lo = bound & 0xffffffffULL, b_hi = bound >> 32;
+    uint64_t lo_lo = x_lo * b_lo;
+    uint64_t hi_lo = x_hi * b_lo;
+    uint64_t lo_hi = x_lo * b_hi;
+    uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xffffffffULL) + lo_hi;
+    uint64_t low = (cross << 32) | (lo_lo & 0xffffffffULL);
+    if (low >= threshold) {
+      return x_hi * b_hi + (hi_lo >> 32) + (cross >> 32);
+    }
+  }
+}
+
+/// @brief Uniform integer in min..max, both inclusive
+/// @param rng Generator
+/// @param min Minimum
+/// @param max Maximum, min is returned if it is smaller than min
+/// @return Random number
+int prng_range(prng *rng, int min, int max) {
+  if (max <= min) {
+    return min;
+  }
+  uint64_t span = (uint64_t)((int64_t)max - (int64_t)min) + 1;
+  return (int)((int64_t)min + (int64_t)prng_below(rng, span));
+}
+
+/// @brief Seed every stream of a session
+/// @param session Session
+/// @param seed Seed of the session
+/// @param index Parallel simulations with the same seed and different indexes draw
+/// non-overlapping sequences
+void rng_session_init(rng_session *session, uint64_t seed, unsigned int index) {
+  prng base;
+  prng_seed(&base, seed);
+  for (unsigned int i = 0; i < index; i++) {
+    prng_long_jump(&base);
+  }
+
+  session->seed = seed;
+  for (int i = 0; i < RNG_STREAM_COUNT; i++) {
+    session->streams[i] = base;
+    prng_jump(&base);
+  }
+}
+
+/// @brief Uniform integer in min..max from one stream of a session
+/// @param session Session
+/// @param stream Stream to draw from
+/// @param min Minimum
+/// @param max Maximum
+/// @return Random number
+int rng_session_range(rng_session *session, rng_stream stream, int min, int max) {
+  return prng_range(&session->streams[stream], min, max);
+}
@@ -11,13 +11,24 @@
 
 #include "flappybird/audio.h"
 #include "flappybird/common_tools.h"
+#include "flappybird/game_context.h"
 #include "flappybird/game_stats.h"
+#include "flappybird/ghost.h"
+#include "flappybird/hof_audit.h"
+#include "flappybird/mem_stats.h"
+#include "flappybird/party.h"
 #include "flappybird/rendering.h"
+#include "flappybird/replay.h"
+#include "flappybird/savestate.h"
+#include "flappybird/term_io.h"
 
 #define SAVES_FILE "./assets/saves.conf"
-#define HALLOFFAME_FILE "./assets/hall_of_fame.conf"
 
 static char active_nickname[64] = {0};
+/// @brief Set if runs take the course of the player's best run so its ghost flies along
+static bool ghost_race = false;
+/// @brief Birds of a party run on one keyboard, 1 plays alone
+static int party_players = 1;
 static game_stats persistent_stats = {0};
 
 static int safe_tolower(int ch) {
@@ -27,25 +38,144 @@ static int safe_tolower(int ch) {
   return tolower((unsigned char)ch);
 }
 
-static int get_last_level(const char *nickname) { return get_int_key_value(SAVES_FILE, nickname); }
+/// @brief Read the last level a player reached
+/// @param nickname Player nickname
+/// @return Level number, -1 if the player has no save
+int get_last_level(const char *nickname) { return get_int_key_value(SAVES_FILE, nickname); }
 
-static int set_last_level(const char *nickname, int level) {
+/// @brief Store the last level a player reached
+/// @param nickname Player nickname
+/// @param level Level number
+/// @return Error code
+int set_last_level(const char *nickname, int level) {
   return set_int_key_value("./lvltmpfile", SAVES_FILE, nickname, level);
 }
 
-static int get_hall_of_fame(const char *nickname, int level) {
+/// @brief Read the best score of a player on a level
+/// @param nickname Player nickname
+/// @param level Level number
+/// @return Score, -1 if there is none
+int get_hall_of_fame(const char *nickname, int level) {
   char key[120] = {0};
   snprintf(key, sizeof(key), "%s#lvl_%d#", nickname, level);
-  return get_int_key_value(HALLOFFAME_FILE, key);
+  mem_tag prev_tag = mem_stats_set_tag(MEM_TAG_HOF);
+  int score = get_int_key_value(HALLOFFAME_FILE, key);
+  mem_stats_set_tag(prev_tag);
+  return score;
 }
 
-static int set_hall_of_fame(const char *nickname, int score, int level) {
+/// @brief Store the best score of a player on a level
+/// @param nickname Player nickname
+/// @param score Score
+/// @param level Level number
+/// @return Error code
+int set_hall_of_fame(const char *nickname, int score, int level) {
   char key[120] = {0};
   snprintf(key, sizeof(key), "%s#lvl_%d#", nickname, level);
   return set_int_key_value("./hoftmpfile", HALLOFFAME_FILE, key, score);
 }
 
-static int process_run_level(level *input_level) {
+/// @brief Store the run the player just ended in the middle of a life
+/// @return True if a suspended run was saved
+static bool save_suspended_run(void) {
+  run_save save;
+  char path[512] = {0};
+  if (!get_suspended_run(&save) || savestate_path(path, sizeof(path), active_nickname) != 0)
+    return false;
+  return savestate_save(&save, path) == 0;
+}
+
+/// @brief Ask a player who ended a run in the middle of a life whether to keep it for later or
+/// to end it there, an ended run counts for the statistics and the hall of fame
+/// @return True to keep the run
+static bool keep_suspended_run(void) {
+  render_header_string("Keep this run to continue later (press 'k') or end it (press 'e') ?", -1,
+                       true, true);
+  refresh();
+  flushinp();
+  timeout(-1);
+  while (true) {
+    int ch = safe_tolower(getch());
+    if (ch == 'k')
+      return true;
+    else if (ch == 'e')
+      return false;
+  }
+}
+
+/// @brief Load and remove the suspended run of the player, it can be resumed once
+/// @param save Filled with the run, free it with savestate_free
+/// @return True if there was a run that fits the current settings
+static bool take_suspended_run(run_save *save) {
+  char path[512] = {0};
+  if (savestate_path(path, sizeof(path), active_nickname) != 0 ||
+      savestate_load(save, path) != 0)
+    return false;
+  remove(path);
+  if (save->rp.frame_ms == frame_period_ms())
+    return true;
+  savestate_free(save);
+  return false;
+}
+
+/// @brief Load the best run of the player on a level and show it as a ghost
+/// @param best Filled with the ghost, free it with ghost_free
+/// @return True if there is a ghost
+static bool start_ghost(int levelnum, const run_save *resume, ghost_track *best) {
+  char path[512] = {0};
+  if (resume != NULL || ghost_path(path, sizeof(path), active_nickname, levelnum) != 0 ||
+      ghost_load(best, path) != 0)
+    return false;
+  if (ghost_race)
+    set_next_run_seed(best->seed);
+  set_level_ghost(best);
+  return true;
+}
+
+/// @brief Keep the last run as the ghost of the level if it beat the best one
+/// @param best Best run so far, NULL if there is none
+static void keep_best_ghost(int levelnum, int score, const ghost_track *best) {
+  const ghost_track *run = get_last_ghost();
+  char path[512] = {0};
+  if (run == NULL || score <= 0 || (best != NULL && score <= best->score))
+    return;
+  if (ghost_path(path, sizeof(path), active_nickname, levelnum) == 0)
+    ghost_save(run, path);
+}
+
+/// @brief Play a party run and show who won, party scores are no records so nothing is saved
+static int process_party_level(level *input_level) {
+  static party pt;
+  int status = 0;
+  term_io_set_screen(TERM_IO_SCREEN_GAMEPLAY);
+  term_io_begin_level(input_level->levelnumber);
+  int score = run_party_level(&local_game, input_level, party_players, &pt, &status);
+  term_io_end_level();
+
+  char message[160] = {0};
+  int pos = snprintf(message, sizeof(message), "PARTY OVER! P%d wins with %d (",
+                     party_leader(&pt) + 1, score);
+  for (int i = 0; i < pt.players && pos > 0 && (size_t)pos < sizeof(message); i++)
+    pos += snprintf(message + pos, sizeof(message) - (size_t)pos, "%sP%d %d", i ? ", " : "",
+                    i + 1, pt.player[i].score);
+  if (pos > 0 && (size_t)pos < sizeof(message))
+    snprintf(message + pos, sizeof(message) - (size_t)pos, ").");
+  render_header_string(message, -1, true, true);
+  refresh();
+  msleep(2500);
+  flushinp();
+  return score;
+}
+
+/// @brief Race the ghost of the best run on its course in the next runs
+/// @param enabled True to race
+void set_ghost_race(bool enabled) { ghost_race = enabled; }
+
+/// @brief Play the next runs with several birds on one keyboard
+/// @param players Number of players, 1 plays alone
+void set_party_players(int players) { party_players = players; }
+
+static int process_run_level(level *input_level, const run_save *resume) {
   if (input_level == NULL) {
     return -1;
   }
@@ -61,9 +191,46 @@ static int process_run_level(level *input_level) {
     return -1;
   }
 
+  if (party_players > 1)
+    return process_party_level(input_level);
+
   int status = 0;
   set_last_level(active_nickname, input_level->levelnumber);
-  int score = run_level(input_level, &status);
+  term_io_set_screen(TERM_IO_SCREEN_GAMEPLAY);
+  term_io_begin_level(input_level->levelnumber);
+  ghost_track best;
+  bool have_best = start_ghost(input_level->levelnumber, resume, &best);
+  int score = resume ? resume_level(&local_game, input_level, resume, &status)
+                     : run_level(&local_game, input_level, &status);
+  term_io_end_level();
+  run_save suspended;
+  if (get_suspended_run(&suspended) && !keep_suspended_run())
+    end_suspended_run();
+  set_level_ghost(NULL);
+  keep_best_ghost(input_level->levelnumber, score, have_best ? &best : NULL);
+  if (have_best)
+    ghost_free(&best);
+  if (practice_mode_enabled() || endless_mode_enabled()) {
+    // Replays play with lives and these scores are no records, so nothing is saved.
+    char message[128] = {0};
+    snprintf(message, sizeof(message), "%s OVER! %s score: %d (level %d).",
+             practice_mode_enabled() ? "PRACTICE" : "ENDLESS RUN", active_nickname, score,
+             input_level->levelnumber);
+    render_header_string(message, -1, true, true);
+    refresh();
+    msleep(1700);
+    flushinp();
+    return score;
+  }
+  if (save_suspended_run()) {
+    render_header_string("RUN SUSPENDED! Continue it with 'Start (where you ended)'.", -1, true,
+                         true);
+    refresh();
+    msleep(1700);
+    flushinp();
+    return score;
+  }
+  replay_save(get_last_replay(), REPLAY_LAST_FILE);
 
   run_metrics metrics = get_last_run_metrics();
   game_stats_record_run(&persistent_stats, score, &metrics);
@@ -75,6 +242,7 @@ static int process_run_level(level *input_level) {
     snprintf(message, sizeof(message), "GAME OVER! NEW HIGH SCORE! %s scored %d (level %d).",
              active_nickname, score, input_level->levelnumber);
     set_hall_of_fame(active_nickname, score, input_level->levelnumber);
+    hof_save_replay(active_nickname, input_level->levelnumber, get_last_replay());
     audio_play(AUDIO_EVENT_HIGH_SCORE);
   } else {
     snprintf(message, sizeof(message), "GAME OVER! %s score: %d (pipes: %d, jumps: %d)",
@@ -96,6 +264,7 @@ static int select_level_dialog(void) {
   int degrees = 0;
 
   keypad(stdscr, true);
+  term_io_set_screen(TERM_IO_SCREEN_LEVEL_SELECT);
   while (true) {
     bool redraw = false;
     level level_preview = load_level_file(selected_level);
@@ -107,7 +276,7 @@ static int select_level_dialog(void) {
     timeout(0);
 
     while (true) {
-      degrees = render_bird_floating(&level_preview, degrees);
+      degrees = render_bird_floating(&local_game, &level_preview, degrees);
       int ch = getch();
       switch (ch) {
         case KEY_RIGHT:
@@ -172,11 +341,13 @@ static int show_about_page(void) {
   int scroll = 0;
   timeout(-1);
   keypad(stdscr, true);
+  term_io_set_screen(TERM_IO_SCREEN_ABOUT);
   render_header_string("About page: arrows to scroll, B to go back", 1, true, true);
 
   while (true) {
     int max_scroll = render_about_page(scroll);
     refresh();
+    term_io_end_frame();
     flushinp();
     int ch = getch();
 
@@ -204,12 +375,16 @@ static int show_hof(void) {
   int scroll = 0;
   timeout(-1);
   keypad(stdscr, true);
+  term_io_set_screen(TERM_IO_SCREEN_HALL_OF_FAME);
   render_header_string("Hall of fame: arrows to scroll, B to go back", 1, true, true);
 
+  mem_tag prev_tag = mem_stats_set_tag(MEM_TAG_HOF);
   config_option_t hof = read_config_file(HALLOFFAME_FILE);
+  mem_stats_set_tag(prev_tag);
   while (true) {
     bool scroll_allowed = render_hof(hof, scroll, false, active_nickname);
     refresh();
+    term_io_end_frame();
     flushinp();
 
     int ch = getch();
@@ -238,12 +413,14 @@ static int show_statistics_page(void) {
   int scroll = 0;
   timeout(-1);
   keypad(stdscr, true);
+  term_io_set_screen(TERM_IO_SCREEN_STATISTICS);
   render_header_string("Statistics: arrows to scroll, B to go back", 1, true, true);
 
   while (true) {
     run_metrics last_run = get_last_run_metrics();
     int max_scroll = render_stats_page(&persistent_stats, &last_run, active_nickname, scroll);
     refresh();
+    term_io_end_frame();
     flushinp();
 
     int ch = getch();
@@ -267,7 +444,19 @@ static int show_statistics_page(void) {
   }
 }
 
+static void show_last_replay(void) {
+  term_io_set_screen(TERM_IO_SCREEN_GAMEPLAY);
+  const char *message = "Replay finished.";
+  if (watch_replay(REPLAY_LAST_FILE) != 0)
+    message = "No replay yet, play a level first.";
+  render_header_string(message, 0, true, true);
+  refresh();
+  msleep(1300);
+  flushinp();
+}
+
 static void request_nickname(void) {
+  term_io_set_screen(TERM_IO_SCREEN_NICKNAME);
   while (true) {
     render_header_string("Please write your nickname (max 63 chars): ", 1, true, true);
     refresh();
@@ -298,6 +487,14 @@ static void request_nickname(void) {
 static int process_option(int option) {
   switch (option) {
     case 0: {
+      run_save resume;
+      // A suspended run has one bird, it waits for the next solo game.
+      if (party_players == 1 && take_suspended_run(&resume)) {
+        level loaded_level = load_level_file(resume.levelnum);
+        process_run_level(&loaded_level, &resume);
+        savestate_free(&resume);
+        break;
+      }
       int last_level = get_last_level(active_nickname);
       if (last_level > 0) {
         level loaded_level = load_level_file(last_level);
@@ -308,7 +505,7 @@ static int process_option(int option) {
           flushinp();
           set_last_level(active_nickname, 1);
         } else {
-          process_run_level(&loaded_level);
+          process_run_level(&loaded_level, NULL);
         }
       } else {
         render_header_string("First run detected. Starting level 1.", 0, true, true);
@@ -316,7 +513,7 @@ static int process_option(int option) {
         msleep(1300);
         flushinp();
         level loaded_level = load_level_file(1);
-        process_run_level(&loaded_level);
+        process_run_level(&loaded_level, NULL);
       }
       break;
     }
@@ -324,7 +521,7 @@ static int process_option(int option) {
       int selected_level = select_level_dialog();
       if (selected_level > 0) {
         level loaded_level = load_level_file(selected_level);
-        process_run_level(&loaded_level);
+        process_run_level(&loaded_level, NULL);
       }
       break;
     }
@@ -340,6 +537,9 @@ static int process_option(int option) {
     case 5:
       show_about_page();
       break;
+    case 6:
+      show_last_replay();
+      break;
     default:
       break;
   }
@@ -351,8 +551,10 @@ static int run_menu(void) {
 
   while (true) {
     keypad(stdscr, true);
+    term_io_set_screen(TERM_IO_SCREEN_MENU);
     render_menu(selected_option, active_nickname);
     refresh();
+    term_io_end_frame();
     flushinp();
     timeout(-1);
 
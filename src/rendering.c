@@ -1,5 +1,7 @@
 // Copyright 2022 <Maros Varchola - mvarchdev>
 
+#define _XOPEN_SOURCE 700
+
 #include "flappybird/rendering.h"
 
 #include <ctype.h>
@@ -13,6 +15,16 @@
 
 #include "flappybird/audio.h"
 #include "flappybird/common_tools.h"
+#include "flappybird/game_context.h"
+#include "flappybird/ghost.h"
+#include "flappybird/mem_stats.h"
+#include "flappybird/party.h"
+#include "flappybird/rewind.h"
+#include "flappybird/savestate.h"
+#include "flappybird/sim.h"
+#include "flappybird/sprite.h"
+#include "flappybird/term_io.h"
+#include "flappybird/trajectory.h"
 
 /// @brief Up left border character
 #define UPLEFTBORDER '#'
@@ -39,43 +51,40 @@
 #define PIPEBODY '#'
 /// @brief End-of-pipe character
 #define PIPEEND '*'
-/// @brief Pipehole end width
-#define PIPEHOLE_END_WIDTH 2
-/// @brief Pipehole end height
-#define PIPEHOLE_END_HEIGHT 1
-
-/// @brief Default bird x offset
-#define BIRDOFFX 30
-
 /// @brief Maximal header string for game details
-#define MAXHEADERSTRING 40
+#define MAXHEADERSTRING 64
 /// @brief Maximum lines shown in stats/about pages.
-#define MAX_PAGE_LINES 40
+#define MAX_PAGE_LINES 64
 /// @brief Maximum line length for generic render pages.
 #define MAX_PAGE_LINE_LEN 120
+/// @brief Level name chars shown in the party HUD, a longer name is clipped so the keys fit.
+#define PARTY_HUD_NAME_LEN (PARTY_HUD_LEN - (int)sizeof("Party on  | Pause: p | End: e"))
 /// @brief Banner files used in the menu page.
 #define MENU_TITLE_BANNER ASSETS_FOLDER "/name_banner.txt"
 #define MENU_WELCOME_BANNER ASSETS_FOLDER "/welcome_banner.txt"
 
-/// @brief Maximum of piped that can be rendered at once
-#define MAX_PIPES 30
-
-/// @brief Variable to save pipes to render
-fbpipe pipe_array[MAX_PIPES] = {0};
-
 /// @brief Loaded settings for screen
 screen act_screen = {0};
 /// @brief Loaded render settings
 render_settings act_rndsett = {0};
 
-/// @brief Speed in chars/s
-float act_speed_chars = 0;
-
-/// @brief Variable for computing speed increase
-long long last_time = 0;
+/// @brief Practice snapshots and assist prediction of the local game. Only it offers these
+/// modes, so server sessions do not carry the buffers.
+static rewind_ring local_practice_ring;
+static trajectory local_assist_path;
+
+/// @brief Default driver, keyboard input paced in real time
+static const level_driver default_driver = {NULL, NULL, true, false, RENDER_BACKEND_NCURSES};
+
+/// @brief Game played on the terminal, its window is set by init_screen_term
+game_context local_game = {
+    .sim = {.clock = 1, .gravity_constant = 9.8, .score_multiplier = 1},
+    .run_recorded = true,
+    .practice_ring = &local_practice_ring,
+    .assist_path = &local_assist_path,
+    .driver = {NULL, NULL, true, false, RENDER_BACKEND_NCURSES},
+};
 
-/// @brief Gravity constant
-float gravity_constant = 9.8;
 /// @brief If no gravity multiply is set, then default will be used
 float def_grav_multiply = 1;
 /// @brief Default speed increase
@@ -106,23 +115,16 @@ char menu_items[menu_inem_n + 1][menu_item_maxstrlen] = {
     "Show hall of fame",
     "Show statistics",
     "About",
+    "Replay",
     "Exit",
 };
 
-/// @brief Metrics captured for currently running session.
-run_metrics active_run_metrics = {0};
-/// @brief Metrics from last completed run.
-run_metrics last_run_metrics = {0};
-/// @brief Dynamic scoring streak for multiplier progression.
-int score_streak = 0;
-/// @brief Dynamic scoring multiplier.
-int score_multiplier = 1;
-
 // Internal forward declarations used by helper routines.
 void setcolor_bits(int fg, int bg);
 void unsetcolor_bits(int fg, int bg);
+void wsetcolor_bits(WINDOW *win, int fg, int bg);
+void wunsetcolor_bits(WINDOW *win, int fg, int bg);
 int bitscolor_bg_to_fg(int bg);
-short bits_to_native_color(int color);
 short opposit_col(short col);
 int native_to_bitscolor(short color, bool bold);
 
@@ -136,31 +138,79 @@ static int safe_tolower(int ch) {
   return tolower((unsigned char)ch);
 }
 
-static void reset_active_run_metrics(void) {
-  memset(&active_run_metrics, 0, sizeof(active_run_metrics));
-  score_streak = 0;
-  score_multiplier = 1;
-  active_run_metrics.highest_multiplier = 1;
+static void finalize_run_metrics(game_context *ctx) { ctx->last_run_metrics = ctx->sim.metrics; }
+
+static bool rendering_enabled(const game_context *ctx) {
+  return ctx->driver.backend != RENDER_BACKEND_NONE;
 }
 
-static void finalize_run_metrics(void) { last_run_metrics = active_run_metrics; }
+/// @brief Sleep only when the driver of the game is paced in real time
+static void pace_sleep(const game_context *ctx, long msec) {
+  if (ctx->driver.realtime)
+    msleep(msec);
+}
+
+/// @brief Sleep until the next frame deadline, a missed deadline is not caught up
+static void wait_frame_deadline(long long *deadline, long long frame_ms) {
+  *deadline += frame_ms;
+  long long now = timeInMilliseconds();
+  if (*deadline > now)
+    msleep(*deadline - now);
+  else
+    *deadline = now;
+}
 
-static int calc_multiplier_from_streak(int streak) {
-  int multiplier = 1 + (streak / 5);
-  if (multiplier > 4) {
-    multiplier = 4;
+/// @brief Read a key of the gameplay loop or its dialogs and add it to the replay of the run
+static int read_level_key(game_context *ctx, level_prompt prompt) {
+  const level_driver *drv = &ctx->driver;
+  int ch = drv->next_key ? drv->next_key(drv->ctx, prompt) : getch();
+  if (ch != ERR && ctx->run_recorded)
+    replay_add(&ctx->run_replay, ctx->run_tick, ch);
+  if (prompt == LEVEL_PROMPT_NONE)
+    ctx->run_tick++;
+  return ch;
+}
+
+/// @brief Pick the seed of a run, a fixed seed gives every level a course of its own that is
+/// the same on every run
+static uint64_t pick_run_seed(game_context *ctx) {
+  if (ctx->next_run_seed_set) {
+    ctx->next_run_seed_set = false;
+    return ctx->next_run_seed;
   }
-  return multiplier;
+  return ctx->seed_fixed ? ctx->seed : prng_next(&ctx->sim.rng.streams[RNG_STREAM_EFFECTS]);
+}
+
+/// @brief Seed the random streams of a game
+/// @param ctx Game
+/// @param seed Seed
+/// @param fixed True if every level should start from this seed again, for shared courses
+static void seed_context_rng(game_context *ctx, uint64_t seed, bool fixed) {
+  ctx->seed = seed;
+  ctx->seed_fixed = fixed;
+  rng_session_init(&ctx->sim.rng, seed, 0);
+  ctx->rng_ready = true;
 }
 
-static void play_countdown(level *inplvl) {
+/// @brief Add time since mark to a profile phase and move the mark
+static void profile_lap(game_context *ctx, long long *phase_ns, long long *mark) {
+  if (!ctx->driver.profile)
+    return;
+  long long now = timeInNanoseconds();
+  *phase_ns += now - *mark;
+  *mark = now;
+}
+
+static void play_countdown(game_context *ctx, level *inplvl) {
+  if (!rendering_enabled(ctx))
+    return;
   const char *steps[] = {"Get Ready", "3", "2", "1", "GO!"};
   for (size_t i = 0; i < sizeof(steps) / sizeof(steps[0]); i++) {
     render_header_string(steps[i], -1, true, true);
     clear_map_area(inplvl, true);
     refresh();
     audio_play(AUDIO_EVENT_COUNTDOWN);
-    msleep(i == 0 ? 450 : 300);
+    pace_sleep(ctx, i == 0 ? 450 : 300);
   }
 }
 
@@ -236,26 +286,38 @@ int get_col_pairnum(int fg, int bg) {
   return (B | bbb | ffff);
 }
 
-/// @brief Sets the actual terminal color based on uniqe colorpair
+/// @brief Sets the color of a window based on uniqe colorpair
+/// @param win Window to draw with the color
 /// @param fg Foreground color bits
 /// @param bg Background color bits
-void setcolor_bits(int fg, int bg) {
-  attron(COLOR_PAIR(get_col_pairnum(fg, bg)));
+void wsetcolor_bits(WINDOW *win, int fg, int bg) {
+  wattron(win, COLOR_PAIR(get_col_pairnum(fg, bg)));
   if (is_bold_bits(fg)) {
-    attron(A_BOLD);
+    wattron(win, A_BOLD);
   }
 }
 
-/// @brief Sets the actual terminal color based on uniqe colorpair
+/// @brief Unsets the color of a window based on uniqe colorpair
+/// @param win Window drawn with the color
 /// @param fg Foreground color bits
 /// @param bg Background color bits
-void unsetcolor_bits(int fg, int bg) {
-  attroff(COLOR_PAIR(get_col_pairnum(fg, bg)));
+void wunsetcolor_bits(WINDOW *win, int fg, int bg) {
+  wattroff(win, COLOR_PAIR(get_col_pairnum(fg, bg)));
   if (is_bold_bits(fg)) {
-    attroff(A_BOLD);
+    wattroff(win, A_BOLD);
   }
 }
 
+/// @brief Sets the actual terminal color based on uniqe colorpair
+/// @param fg Foreground color bits
+/// @param bg Background color bits
+void setcolor_bits(int fg, int bg) { wsetcolor_bits(stdscr, fg, bg); }
+
+/// @brief Sets the actual terminal color based on uniqe colorpair
+/// @param fg Foreground color bits
+/// @param bg Background color bits
+void unsetcolor_bits(int fg, int bg) { wunsetcolor_bits(stdscr, fg, bg); }
+
 /// @brief Returns if input colorname/string indicates intensity bit set
 /// @param colname String with colorname
 /// @return True, if it is with intensity set
@@ -420,9 +482,23 @@ void init_colorpairs(void) {
 
 /// @brief Will initialize screen and compute base offsets and sizes
 /// @return Error code
-int init_screen(void) {
+int init_screen(void) { return init_screen_term(NULL, stdout, stdin); }
+
+/// @brief Will initialize screen on given streams and compute base offsets and sizes
+/// @param term_type Terminal type, NULL to use $TERM
+/// @param out Stream the screen is written to
+/// @param in Stream keyboard input is read from
+/// @return Error code
+int init_screen_term(const char *term_type, FILE *out, FILE *in) {
+  if (!out || !in)
+    return -1;
+
   load_settings();
-  initscr();
+  term_io_attach(fileno(out));
+  SCREEN *scr = newterm(term_type, out, in);
+  if (!scr)
+    return -1;
+  set_term(scr);
   curs_set(0);
   start_color();
   init_colorpairs();
@@ -438,6 +514,9 @@ int init_screen(void) {
   headeroffsy = OUTERMARGIN + BORDERWIDTH + act_screen.header_padding;
 
   headersizex = MAPSIZEX - 2 * act_screen.header_padding;
+  local_game.win = stdscr;
+  local_game.map_y = mapoffsy;
+  local_game.map_x = mapoffsx;
 
   act_screen.header_width =
       xsize - (OUTERMARGIN * 2) - (BORDERWIDTH * 2) - (act_screen.header_padding * 2);
@@ -449,28 +528,14 @@ int init_screen(void) {
   return 0;
 }
 
-/// @brief Change speed of bird based jump speed
-/// @param inpb Bird struct pointer to use
-void jump_bird(bird *inpb) {
-  if (!inpb)
-    return;
-
-  if (inpb->act_speed < 0) {
-    if ((inpb->act_speed - inpb->jump_speed) < -1.5 * inpb->jump_speed)
-      inpb->act_speed = -1.5 * inpb->jump_speed;
-    else
-      inpb->act_speed -= inpb->jump_speed;
-  } else
-    inpb->act_speed = -inpb->jump_speed;
-}
-
 /// @brief Will print actual running game details to the header area
+/// @param ctx Game
 /// @param actlives Actual lives
 /// @param score Actual score
 /// @param inplvl Level struct pointer
 /// @param inpb Bird struct pointer
 /// @return Error code
-int print_game_details(int actlives, int score, level *inplvl, bird *inpb) {
+int print_game_details(game_context *ctx, int actlives, int score, level *inplvl, bird *inpb) {
   if (!inplvl || !inpb)
     return -1;
 
@@ -478,24 +543,38 @@ int print_game_details(int actlives, int score, level *inplvl, bird *inpb) {
   char headerinp[8][MAXHEADERSTRING] = {0};
   sprintf(headerinp[i++], "Level name: %s", inplvl->levelname);
   sprintf(headerinp[i++], "Score: %d", score);
-  sprintf(headerinp[i++], "Lives [Actual / Max]: %d / %d", actlives, inplvl->max_lives);
-  sprintf(headerinp[i++], "Speed: %.3f [char/s]", act_speed_chars);
-  sprintf(headerinp[i++], "Bird speed: %.3f [char/s]", inpb->act_speed);
-  sprintf(headerinp[i++], "Streak: %d | Multiplier: x%d", score_streak, score_multiplier);
+  if (ctx->practice_mode)
+    sprintf(headerinp[i++], "Practice: crashes cost no life, r rewinds %d s", REWIND_SECONDS);
+  else if (ctx->endless_mode)
+    sprintf(headerinp[i++], "Endless: %d crashes | %lld chars flown", ctx->sim.metrics.collisions,
+            sim_endless_chars(&ctx->sim));
+  else
+    sprintf(headerinp[i++], "Lives [Actual / Max]: %d / %d", actlives, inplvl->max_lives);
+  sprintf(headerinp[i++], "Speed: %.3f [char/s]", fixed_to_float(ctx->sim.speed_chars));
+  sprintf(headerinp[i++], "Bird speed: %.3f [char/s]", fixed_to_float(inpb->act_speed));
+  sprintf(headerinp[i++], "Streak: %d | Multiplier: x%d", ctx->sim.score_streak,
+          ctx->sim.score_multiplier);
   sprintf(headerinp[i++], "Jump: space | Pause: p | End game: e");
-  sprintf(headerinp[i++], "Hint: keep a streak to raise score multiplier");
+  if (ctx->seed_fixed)
+    sprintf(headerinp[i++], "Seed: %llu (same course every run)", (unsigned long long)ctx->seed);
+  else if (ctx->assist_mode)
+    sprintf(headerinp[i++], "Assist: . falls without a jump, + jumps now");
+  else
+    sprintf(headerinp[i++], "Hint: keep a streak to raise score multiplier");
   return render_header_text(8, MAXHEADERSTRING, headerinp);
 }
 
 /// @brief Game paused dialog
+/// @param ctx Game
 /// @return Error code
-int game_paused_dialog(void) {
+int game_paused_dialog(game_context *ctx) {
   char headerinp[1][60] = {0};
   sprintf(headerinp[0], "GAME PAUSED - PRESS 'p' TO CONTINUE OR 'e' TO END GAME");
-  render_header_text(1, 60, headerinp);
+  if (rendering_enabled(ctx))
+    render_header_text(1, 60, headerinp);
   timeout(-1);
   while (true) {
-    int ch = getch();
+    int ch = read_level_key(ctx, LEVEL_PROMPT_PAUSED);
     if (ch == EOF)
       continue;
     else if (safe_tolower(ch) == 'p')
@@ -505,33 +584,29 @@ int game_paused_dialog(void) {
   }
 }
 
-/// @brief Force set of lastms rendered variable for enabled pipes
-/// @param timems Time to set in ms
-void update_last_ms_pipes(long long timems) {
-  for (int i = 0; i < MAX_PIPES; i++) {
-    if (!pipe_array[i].enabled)
-      continue;
-    pipe_array[i].last_time_moved = timems;
-  }
-}
-
 /// @brief Collision dialog
+/// @param ctx Game
 /// @param actlives Actual lives
 /// @param score Actual score
 /// @return
-int colision_dialog(int actlives, int score) {
+int colision_dialog(game_context *ctx, int actlives, int score) {
   char headerinp[4][90] = {0};
-  sprintf(headerinp[0],
-          "BANG! You crashed into the pipe or you fell down, you have %d more "
-          "lives left.",
-          actlives);
+  if (ctx->endless_mode)
+    sprintf(headerinp[0], "BANG! Crash %d of this endless run, the course goes on.",
+            ctx->sim.metrics.collisions);
+  else
+    sprintf(headerinp[0],
+            "BANG! You crashed into the pipe or you fell down, you have %d more "
+            "lives left.",
+            actlives);
   sprintf(headerinp[1], "YOUR ACTUAL SCORE IS: %d", score);
 
   sprintf(headerinp[3], "Do you want to try again (press 't') or end the game (press 'e') ?");
-  render_header_text(4, 90, headerinp);
+  if (rendering_enabled(ctx))
+    render_header_text(4, 90, headerinp);
   timeout(-1);
   while (true) {
-    int ch = getch();
+    int ch = read_level_key(ctx, LEVEL_PROMPT_COLLISION);
     if (ch == EOF)
       continue;
     else if (safe_tolower(ch) == 't')
@@ -541,114 +616,606 @@ int colision_dialog(int actlives, int score) {
   }
 }
 
-/// @brief Will disable all enabled pipes
-void clear_all_pipes(void) {
-  for (int i = 0; i < MAX_PIPES; i++)
-    if (pipe_array[i].enabled)
-      pipe_array[i].enabled = false;
+/// @brief Remember where the player ended the run, the world stays in the game
+static void suspend_run(game_context *ctx, int actlives, int score, long frame_tick,
+                        size_t frame_events) {
+  ctx->run_suspended = !ctx->practice_mode && !ctx->endless_mode;
+  ctx->suspended_lives = actlives;
+  ctx->suspended_score = score;
+  ctx->suspended_tick = frame_tick;
+  ctx->suspended_events = frame_events;
 }
 
-/// @brief Function to run level
-/// @param inplvl Pointer to level to use
-/// @param status Pointer to status output
-/// @return Score
-int run_level(level *inplvl, int *status) {
+/// @brief Draw the ghost bird dimmed into the free cells around its row. It goes behind pipes
+/// and is drawn before the live bird, which covers it.
+/// @param ctx Game drawn to
+/// @param row Map row of the ghost
+/// @param colorbits Colors of the live bird, the ghost drops the intensity bit
+static void render_ghost(game_context *ctx, int row, int colorbits) {
+  // The ghost only keeps its row, it is drawn with the frame of a level flight.
+  const sprite_frame *frame = sprite_pick(bird_sprite(), 0);
+  int fg = colorbits & 7;
+  int bg = bitscolor_bg_to_fg(colorbits);
+  wsetcolor_bits(ctx->win, fg, bg);
+  wattron(ctx->win, A_DIM);
+  for (int i = 0; i < frame->run_count; i++) {
+    const sprite_run *run = &frame->runs[i];
+    int y = row + run->dy;
+    if (y < 0 || y >= MAPSIZEY)
+      continue;
+    for (int c = 0; c < run->len; c++) {
+      int x = ctx->map_x + BIRDOFFX + run->dx + c;
+      if ((mvwinch(ctx->win, ctx->map_y + y, x) & 255) == ' ')
+        mvwaddch(ctx->win, ctx->map_y + y, x, (unsigned char)run->glyphs[c]);
+    }
+  }
+  wattroff(ctx->win, A_DIM);
+  wunsetcolor_bits(ctx->win, fg, bg);
+}
+
+/// @brief Draw the arcs of assist mode into the empty cells of the map
+/// @param ctx Game drawn to
+/// @param tr Prediction of the frame
+/// @param colorbits Color of the bird
+static void render_trajectory(game_context *ctx, const trajectory *tr, int colorbits) {
+  int fg = colorbits & 7;
+  int bg = bitscolor_bg_to_fg(colorbits);
+  wsetcolor_bits(ctx->win, fg, bg);
+  for (int arc = 0; arc < 2; arc++) {
+    const int *xs = arc ? tr->jump_x : tr->glide_x;
+    const int *ys = arc ? tr->jump_y : tr->glide_y;
+    int len = arc ? tr->jump_len : tr->glide_len;
+    attr_t attr = arc ? A_BOLD : A_DIM;
+    wattron(ctx->win, attr);
+    for (int k = 0; k < len; k++) {
+      int y = ctx->map_y + ys[k];
+      int x = ctx->map_x + xs[k];
+      if (xs[k] >= MAPSIZEX || (mvwinch(ctx->win, y, x) & 255) != ' ')
+        continue;
+      mvwaddch(ctx->win, y, x, arc ? '+' : '.');
+    }
+    wattroff(ctx->win, attr);
+  }
+  wunsetcolor_bits(ctx->win, fg, bg);
+}
+
+/// @brief Collision dialog of practice mode
+/// @param ctx Game
+/// @param score Actual score
+/// @return 1 to end the game, 0 to rewind
+static int practice_collision_dialog(game_context *ctx, int score) {
+  char headerinp[4][90] = {0};
+  sprintf(headerinp[0], "BANG! Practice run, no life lost.");
+  sprintf(headerinp[1], "YOUR ACTUAL SCORE IS: %d", score);
+  sprintf(headerinp[3], "Rewind %d seconds (press 'r' or 't') or end the game (press 'e') ?",
+          REWIND_SECONDS);
+  if (rendering_enabled(ctx))
+    render_header_text(4, 90, headerinp);
+  timeout(-1);
+  while (true) {
+    int ch = safe_tolower(read_level_key(ctx, LEVEL_PROMPT_COLLISION));
+    if (ch == 'r' || ch == 't')
+      return 0;
+    else if (ch == 'e')
+      return 1;
+  }
+}
+
+/// @brief Go back REWIND_SECONDS of gameplay in practice mode
+/// @param ctx Game
+/// @param frame Frame of the timeline, set to the frame of the restored snapshot
+/// @param score Score, set to the score of the restored snapshot
+static void rewind_practice(game_context *ctx, long *frame, int *score) {
+  long frames_back = REWIND_SECONDS * 1000 / frame_period_ms();
+  long restored = rewind_restore(ctx->practice_ring, *frame - frames_back, &ctx->sim, score);
+  if (restored >= 0)
+    *frame = restored;
+}
+
+/// @brief Start a run, or continue a suspended one
+/// @param ctx Game
+/// @param resume Suspended run, NULL for a new run
+static void begin_run(game_context *ctx, level *inplvl, const run_save *resume) {
+  ctx->run_recorded = !ctx->endless_mode;
+  if (resume == NULL) {
+    if (!ctx->rng_ready)
+      seed_context_rng(ctx, 0, false);
+    uint64_t run_seed = pick_run_seed(ctx);
+    sim_reset(&ctx->sim, inplvl, run_seed);
+    if (ctx->endless_mode)
+      sim_start_endless(&ctx->sim, inplvl);
+    if (replay_begin(&ctx->run_replay, inplvl->levelnumber, run_seed, frame_period_ms()) != 0)
+      ctx->run_recorded = false;
+    ctx->run_ghost_complete =
+        !ctx->practice_mode && !ctx->endless_mode &&
+        ghost_begin(&ctx->run_ghost, inplvl->levelnumber, run_seed, frame_period_ms()) == 0;
+    ctx->run_tick = 0;
+    return;
+  }
+  ctx->run_ghost_complete = false;
+  ctx->sim = resume->sim;
+  if (replay_begin(&ctx->run_replay, inplvl->levelnumber, resume->rp.seed,
+                   resume->rp.frame_ms) != 0)
+    ctx->run_recorded = false;
+  for (size_t i = 0; i < resume->rp.count; i++)
+    replay_add(&ctx->run_replay, resume->rp.events[i].tick, resume->rp.events[i].key);
+  ctx->run_tick = resume->tick;
+}
+
+/// @brief Gameplay loop of run_level and resume_level
+static int play_level(game_context *ctx, level *inplvl, int *status, const run_save *resume) {
   if (!inplvl)
     return -1;
 
-  int actlives = inplvl->max_lives, score = 0;
-  act_speed_chars = inplvl->start_speed * METERTOCHARS;
+  int actlives = resume ? resume->lives : inplvl->max_lives;
+  int score = resume ? resume->score : 0;
   int statustmp = 0;
-  bird usebird;
+  bird *usebird = &ctx->sim.bird;
   if (!status)
     status = &statustmp;
-  reset_active_run_metrics();
-
+  begin_run(ctx, inplvl, resume);
+  mem_stats_enter_gameplay();
+  ctx->run_suspended = false;
+  ghost_reader ghost_rd;
+  const ghost_track *shown = ctx->shown_ghost;
+  bool ghost_shown = shown && ctx->run_ghost_complete && shown->seed == ctx->run_replay.seed &&
+                     shown->frame_ms == ctx->run_replay.frame_ms;
+  if (ghost_shown)
+    ghost_reader_init(&ghost_rd, shown);
+
+  long long frame_ms = frame_period_ms();
+  bool assisted = ctx->assist_mode && ctx->assist_path && rendering_enabled(ctx);
+  if (assisted)
+    trajectory_init(ctx->assist_path, inplvl, frame_ms);
+  // Frames of the current life, a rewind takes it back together with the world.
+  long frame = 0;
+  // The world carries over after a rewind and into a resumed run.
+  bool keep_world = resume != NULL;
   while (actlives != 0) {
-    clear_all_pipes();
-    usebird = get_bird(inplvl);
-    last_time = 0;
-    play_countdown(inplvl);
+    if (!keep_world) {
+      sim_clear_pipes(&ctx->sim);
+      *usebird = get_bird(ctx, inplvl);
+      ctx->sim.last_speed_time = 0;
+      if (ctx->practice_ring)
+        rewind_reset(ctx->practice_ring);
+      frame = 0;
+    }
+    keep_world = false;
+    if (assisted)
+      trajectory_reset(ctx->assist_path);
+    bool rewind_now = false;
+    play_countdown(ctx, inplvl);
 
     timeout(0);
+    long long deadline = timeInMilliseconds();
     while (true) {
-      int ch = getch();
+      long long mark = ctx->driver.profile ? timeInNanoseconds() : 0;
+      if (ctx->practice_mode)
+        rewind_record(ctx->practice_ring, &ctx->sim, score, frame);
+      // A suspend keeps the world of this frame and drops the key that ended it.
+      long frame_tick = ctx->run_tick;
+      size_t frame_events = ctx->run_replay.count;
+      int ch = read_level_key(ctx, LEVEL_PROMPT_NONE);
       if (ch != EOF) {
         if (ch == ' ') {
-          jump_bird(&usebird);
-          active_run_metrics.jumps++;
+          jump_bird(usebird);
+          ctx->sim.metrics.jumps++;
           audio_play(AUDIO_EVENT_JUMP);
         } else if (safe_tolower(ch) == 'e') {
           *status = 1;
+          suspend_run(ctx, actlives, score, frame_tick, frame_events);
           break;
         } else if (safe_tolower(ch) == 'p') {
-          active_run_metrics.pauses++;
-          if (game_paused_dialog() == 1) {
+          ctx->sim.metrics.pauses++;
+          if (game_paused_dialog(ctx) == 1) {
             *status = 1;
+            suspend_run(ctx, actlives, score, frame_tick, frame_events);
             break;
           }
           timeout(0);
-          usebird.last_time_ms = timeInMilliseconds();
-          update_last_ms_pipes(usebird.last_time_ms);
-          last_time = 0;
-        } else if (safe_tolower(ch) == 'h') {
+          sim_resume(&ctx->sim, usebird);
+          if (assisted)
+            trajectory_reset(ctx->assist_path);
+          deadline = timeInMilliseconds();
+        } else if (safe_tolower(ch) == 'r' && ctx->practice_mode) {
+          rewind_now = true;
+          break;
+        } else if (safe_tolower(ch) == 'h' && rendering_enabled(ctx)) {
           render_header_string("Tip: maintain streaks to increase score multiplier.", 0, true,
                                true);
           refresh();
-          msleep(650);
+          pace_sleep(ctx, 650);
         }
         flushinp();
       }
-      print_game_details(actlives, score, inplvl, &usebird);
-      move_bird(&usebird);
-      clear_map_area(inplvl, true);
-      render_pipes(inplvl);
-      if (bird_collision(&usebird, BIRDOFFX) || usebird.act_position >= MAPSIZEY - 1) {
-        active_run_metrics.collisions++;
-        score_streak = 0;
-        score_multiplier = 1;
+      ctx->profile.frames++;
+      profile_lap(ctx, &ctx->profile.input_ns, &mark);
+
+      if (rendering_enabled(ctx)) {
+        print_game_details(ctx, actlives, score, inplvl, usebird);
+        profile_lap(ctx, &ctx->profile.render_ns, &mark);
+      }
+      if (assisted)
+        trajectory_update(ctx->assist_path, &ctx->sim);
+      move_bird(ctx, usebird);
+      // A run longer than a ghost file can hold is not kept as a ghost.
+      if (ctx->run_ghost_complete &&
+          ghost_add(&ctx->run_ghost, fixed_to_int(usebird->act_position)) != 0)
+        ctx->run_ghost_complete = false;
+      int ghost_row = 0;
+      bool ghost_alive = ghost_shown && ghost_reader_next(&ghost_rd, &ghost_row);
+      profile_lap(ctx, &ctx->profile.physics_ns, &mark);
+
+      if (rendering_enabled(ctx)) {
+        clear_map_area(inplvl, true);
+        render_pipes(ctx, inplvl);
+        profile_lap(ctx, &ctx->profile.render_ns, &mark);
+      }
+      bool collided = bird_hits_pipes(ctx, usebird, BIRDOFFX) ||
+                      usebird->act_position >= fixed_from_int(MAPSIZEY - 1);
+      profile_lap(ctx, &ctx->profile.collision_ns, &mark);
+      if (collided) {
+        sim_collide(&ctx->sim);
         audio_play(AUDIO_EVENT_COLLISION);
         break;
       }
 
-      render_bird(&usebird, BIRDOFFX, false);
-      int passed_pipes = move_pipes(inplvl);
-      if (passed_pipes > 0) {
-        active_run_metrics.pipes_passed += passed_pipes;
-        score_streak += passed_pipes;
-        score_multiplier = calc_multiplier_from_streak(score_streak);
-        if (score_multiplier > active_run_metrics.highest_multiplier) {
-          active_run_metrics.highest_multiplier = score_multiplier;
-        }
-        if (score_streak > active_run_metrics.highest_streak) {
-          active_run_metrics.highest_streak = score_streak;
-        }
-        score += passed_pipes * score_multiplier;
+      if (rendering_enabled(ctx)) {
+        if (assisted)
+          render_trajectory(ctx, ctx->assist_path, usebird->colorbits);
+        if (ghost_alive)
+          render_ghost(ctx, ghost_row, usebird->colorbits);
+        render_bird(ctx, usebird, BIRDOFFX, false);
+        profile_lap(ctx, &ctx->profile.render_ns, &mark);
+      }
+      int points = sim_score_pipes(&ctx->sim, move_pipes(ctx, inplvl));
+      if (points > 0) {
+        score += points;
         audio_play(AUDIO_EVENT_PIPE_PASSED);
       }
-      process_pipes(inplvl);
-      increase_speed(inplvl);
-      refresh();
+      process_pipes(ctx, inplvl);
+      increase_speed(ctx, inplvl);
+      profile_lap(ctx, &ctx->profile.physics_ns, &mark);
+
+      if (rendering_enabled(ctx)) {
+        refresh();
+        term_io_end_frame();
+        profile_lap(ctx, &ctx->profile.flush_ns, &mark);
+      }
 
-      msleep(1000 / act_rndsett.fps);
+      ctx->sim.clock += frame_ms;
+      frame++;
+      if (ctx->driver.realtime)
+        wait_frame_deadline(&deadline, frame_ms);
     }
     if (*status == 1)
       break;
-    actlives--;
-    render_bird(&usebird, BIRDOFFX, true);
+    if (ctx->practice_mode) {
+      if (!rewind_now && rendering_enabled(ctx))
+        render_bird(ctx, usebird, BIRDOFFX, true);
+      if (!rewind_now && practice_collision_dialog(ctx, score) == 1) {
+        *status = 1;
+        break;
+      }
+      flushinp();
+      rewind_practice(ctx, &frame, &score);
+      keep_world = true;
+      continue;
+    }
+    if (!ctx->endless_mode)
+      actlives--;
+    if (rendering_enabled(ctx))
+      render_bird(ctx, usebird, BIRDOFFX, true);
     if (actlives > 0)
-      if (colision_dialog(actlives, score) == 1) {
+      if (colision_dialog(ctx, actlives, score) == 1) {
         *status = 1;
         break;
       }
   }
 
+  mem_stats_leave_gameplay();
   flushinp();
   timeout(-1);
-  finalize_run_metrics();
+  finalize_run_metrics(ctx);
+  ctx->run_replay.ticks = ctx->run_tick;
+  ctx->run_replay.score = score;
+  ctx->run_ghost.score = score;
   return score;
 }
 
+/// @brief HUD lines last drawn in a party run, a line is drawn again only when it changes
+static char party_hud[PARTY_MAX_PLAYERS + 1][PARTY_HUD_LEN];
+
+/// @brief Draw the lines of the party HUD that changed since the last frame, each player in
+/// the color of their bird
+static void print_party_hud(const party *pt, const level *inplvl) {
+  char line[PARTY_HUD_LEN] = {0};
+  for (int i = 0; i <= pt->players; i++) {
+    if (i == 0)
+      snprintf(line, sizeof(line), "Party on %.*s | Pause: p | End: e", PARTY_HUD_NAME_LEN,
+               inplvl->levelname);
+    else
+      party_hud_line(pt, i - 1, line, sizeof(line));
+    if (strcmp(line, party_hud[i]) == 0)
+      continue;
+    memcpy(party_hud[i], line, sizeof(line));
+    int colorbits = i == 0 ? act_screen.header_color : pt->player[i - 1].bird.colorbits;
+    setcolor_bits(colorbits, bitscolor_bg_to_fg(colorbits));
+    mvprintw(headeroffsy + i, headeroffsx, "%-*s", PARTY_HUD_LEN - 1, line);
+    unsetcolor_bits(colorbits, bitscolor_bg_to_fg(colorbits));
+  }
+}
+
+/// @brief Forget the drawn HUD after the header was used for something else
+static void reset_party_hud(const game_context *ctx) {
+  memset(party_hud, 0, sizeof(party_hud));
+  if (rendering_enabled(ctx))
+    clear_header(true);
+}
+
+/// @brief Give every bird of a party a color of its own that stands out from the background
+static void color_party_birds(party *pt, const level *inplvl) {
+  static const short palette[] = {COLOR_RED,  COLOR_GREEN,  COLOR_MAGENTA,
+                                  COLOR_CYAN, COLOR_YELLOW, COLOR_WHITE};
+  int bg = inplvl->bgcolor & (7 << 4);
+  short used[PARTY_MAX_PLAYERS + 1] = {bits_to_native_color(bitscolor_bg_to_fg(bg)),
+                                       bits_to_native_color(pt->player[0].bird.colorbits & 7)};
+  int count = 2;
+  size_t next = 0;
+  for (int i = 1; i < pt->players && next < sizeof(palette) / sizeof(palette[0]); i++) {
+    bool taken = true;
+    while (taken && next < sizeof(palette) / sizeof(palette[0])) {
+      taken = false;
+      for (int u = 0; u < count; u++) taken = taken || used[u] == palette[next];
+      if (taken)
+        next++;
+    }
+    if (next == sizeof(palette) / sizeof(palette[0]))
+      break;
+    used[count++] = palette[next];
+    pt->player[i].bird.colorbits = native_to_bitscolor(palette[next++], true) | bg;
+  }
+}
+
+/// @brief Play a level with the birds of 2 to 4 players on one keyboard. The world, its pipes
+/// and its collision rows are computed once per frame for all birds.
+/// @param ctx Game
+/// @param inplvl Level
+/// @param players Number of players
+/// @param pt Filled with the players, their scores stay there after the run
+/// @param status Set to 1 if the run was ended with 'e'
+/// @return Best score
+int run_party_level(game_context *ctx, level *inplvl, int players, party *pt, int *status) {
+  int statustmp = 0;
+  if (!inplvl || !pt)
+    return -1;
+  if (!status)
+    status = &statustmp;
+  mem_stats_enter_gameplay();
+  if (!ctx->rng_ready)
+    seed_context_rng(ctx, 0, false);
+  sim_reset(&ctx->sim, inplvl, pick_run_seed(ctx));
+  if (ctx->endless_mode)
+    sim_start_endless(&ctx->sim, inplvl);
+  // Replays and ghosts hold one bird, party runs keep neither.
+  ctx->run_recorded = false;
+  ctx->run_ghost_complete = false;
+  ctx->run_suspended = false;
+  bird first = get_bird(ctx, inplvl);
+  party_init(pt, players, &first, inplvl->max_lives, ctx->endless_mode);
+  color_party_birds(pt, inplvl);
+
+  long long frame_ms = frame_period_ms();
+  play_countdown(ctx, inplvl);
+  reset_party_hud(ctx);
+  timeout(0);
+  long long deadline = timeInMilliseconds();
+  while (!party_over(pt) && *status == 0) {
+    // Players share the keyboard, so every key queued in the frame is handled.
+    int ch = EOF;
+    for (int n = 0; n < PARTY_MAX_PLAYERS * 2 && *status == 0 &&
+                    (ch = read_level_key(ctx, LEVEL_PROMPT_NONE)) != EOF;
+         n++) {
+      int player = party_key_player(pt, ch);
+      if (player >= 0) {
+        party_jump(pt, player);
+        audio_play(AUDIO_EVENT_JUMP);
+      } else if (safe_tolower(ch) == 'e') {
+        *status = 1;
+      } else if (safe_tolower(ch) == 'p') {
+        *status = game_paused_dialog(ctx);
+        timeout(0);
+        party_resume(pt, &ctx->sim);
+        reset_party_hud(ctx);
+        deadline = timeInMilliseconds();
+      }
+    }
+    if (*status != 0)
+      break;
+
+    if (rendering_enabled(ctx))
+      print_party_hud(pt, inplvl);
+    party_move_birds(pt, &ctx->sim, inplvl);
+    int crashed = party_collide(pt, &ctx->sim);
+    if (crashed)
+      audio_play(AUDIO_EVENT_COLLISION);
+
+    if (rendering_enabled(ctx)) {
+      clear_map_area(inplvl, true);
+      render_pipes(ctx, inplvl);
+      for (int i = 0; i < pt->players; i++)
+        if (pt->player[i].flying || crashed & (1 << i))
+          render_bird(ctx, &pt->player[i].bird, BIRDOFFX, crashed & (1 << i));
+    }
+    int passed = move_pipes(ctx, inplvl);
+    party_score(pt, passed);
+    if (passed > 0)
+      audio_play(AUDIO_EVENT_PIPE_PASSED);
+    process_pipes(ctx, inplvl);
+    increase_speed(ctx, inplvl);
+
+    if (rendering_enabled(ctx)) {
+      refresh();
+      term_io_end_frame();
+    }
+    ctx->sim.clock += frame_ms;
+    if (ctx->driver.realtime)
+      wait_frame_deadline(&deadline, frame_ms);
+  }
+
+  mem_stats_leave_gameplay();
+  flushinp();
+  timeout(-1);
+  ctx->run_recorded = true;
+  return pt->player[party_leader(pt)].score;
+}
+
+/// @brief Function to run level
+/// @param ctx Game the run is played in
+/// @param inplvl Pointer to level to use
+/// @param status Pointer to status output
+/// @return Score
+int run_level(game_context *ctx, level *inplvl, int *status) {
+  return play_level(ctx, inplvl, status, NULL);
+}
+
+/// @brief Continue a suspended run from the frame it was suspended in
+/// @param ctx Game the run is played in
+/// @param inplvl Level of the run
+/// @param save Suspended run
+/// @param status Pointer to status output
+/// @return Score of the whole run
+int resume_level(game_context *ctx, level *inplvl, const run_save *save, int *status) {
+  return play_level(ctx, inplvl, status, save);
+}
+
+/// @brief Start a game with no run yet, drawn nowhere until its window is set
+/// @param ctx Game to fill
+/// @param gravity_constant Gravity of its world
+void game_context_init(game_context *ctx, float gravity_constant) {
+  memset(ctx, 0, sizeof(*ctx));
+  sim_init(&ctx->sim, gravity_constant);
+  ctx->run_recorded = true;
+  ctx->driver = default_driver;
+}
+
+/// @brief Fly a ghost next to the bird in the next runs played on its course
+/// @param track Ghost, must stay valid while it is set, NULL removes it
+void set_level_ghost(const ghost_track *track) { local_game.shown_ghost = track; }
+
+/// @brief Get the bird rows of the last run
+/// @return Ghost of the run, NULL if the run was resumed, suspended or a practice run
+const ghost_track *get_last_ghost(void) {
+  return local_game.run_ghost_complete && !local_game.run_suspended ? &local_game.run_ghost : NULL;
+}
+
+/// @brief Start the next run on a given course instead of a new one, used to race a ghost
+/// @param seed Seed of the course
+void set_next_run_seed(uint64_t seed) {
+  local_game.next_run_seed = seed;
+  local_game.next_run_seed_set = true;
+}
+
+/// @brief Get the last run if the player ended it in the middle of a life
+/// @param out Filled with the world at the start of the suspended frame. Its replay borrows
+/// the events of the last run and must not be freed.
+/// @return True if the last run was suspended
+bool get_suspended_run(run_save *out) {
+  if (!local_game.run_suspended)
+    return false;
+  out->levelnum = local_game.run_replay.levelnum;
+  out->lives = local_game.suspended_lives;
+  out->score = local_game.suspended_score;
+  out->tick = local_game.suspended_tick;
+  out->sim = local_game.sim;
+  out->rp = local_game.run_replay;
+  out->rp.count = local_game.suspended_events;
+  out->rp.ticks = local_game.suspended_tick;
+  return true;
+}
+
+/// @brief End the last run where the player stopped instead of keeping it to resume
+void end_suspended_run(void) { local_game.run_suspended = false; }
+
+/// @brief Replace keyboard input, pacing or output of run_level
+/// @param driver Driver to copy, NULL restores keyboard input paced in real time
+void set_level_driver(const level_driver *driver) {
+  local_game.driver = driver ? *driver : default_driver;
+}
+
+/// @brief Turn practice mode on or off for the next runs
+/// @param enabled True for practice runs with rewind instead of lives
+void set_practice_mode(bool enabled) { local_game.practice_mode = enabled; }
+
+/// @brief Turn endless mode on or off for the next runs
+/// @param enabled True for runs that only end when the player ends them
+void set_endless_mode(bool enabled) { local_game.endless_mode = enabled; }
+
+/// @brief Check if runs are played in endless mode
+/// @return True in endless mode
+bool endless_mode_enabled(void) { return local_game.endless_mode; }
+
+/// @brief Turn assist mode on or off for the next runs
+/// @param enabled True to draw the predicted flight of the bird
+void set_assist_mode(bool enabled) { local_game.assist_mode = enabled; }
+
+/// @brief Check if runs are played in practice mode
+/// @return True in practice mode
+bool practice_mode_enabled(void) { return local_game.practice_mode; }
+
+/// @brief Switch rendering of the running level on or off
+/// @param backend Backend to use from the next frame on
+void set_level_backend(render_backend backend) { local_game.driver.backend = backend; }
+
+/// @brief Get the recording of the last run
+/// @return Replay, valid until the next run starts
+const replay *get_last_replay(void) { return &local_game.run_replay; }
+
+/// @brief Get phase timings collected since the last reset
+/// @return Frame profile
+frame_profile get_frame_profile(void) { return local_game.profile; }
+
+/// @brief Reset phase timings
+void reset_frame_profile(void) { memset(&local_game.profile, 0, sizeof(local_game.profile)); }
+
+/// @brief Get the gameplay clock, physics is computed from this clock only
+/// @return Gameplay time in ms
+long long game_clock_ms(void) { return local_game.sim.clock; }
+
+/// @brief Get gameplay time simulated by one frame
+/// @return Frame period in ms
+long long frame_period_ms(void) { return 1000 / act_rndsett.fps; }
+
+/// @brief Advance the gameplay clock
+/// @param ms Time to add in ms
+void advance_game_clock(long long ms) { local_game.sim.clock += ms; }
+
+/// @brief Seed the random streams of pipe generation
+/// @param seed Seed
+/// @param fixed True if every level should start from this seed again, for shared courses
+void seed_game_rng(uint64_t seed, bool fixed) {
+  seed_context_rng(&local_game, seed, fixed);
+}
+
+/// @brief Get the seed of the random streams
+/// @return Seed
+uint64_t get_game_seed(void) { return local_game.seed; }
+
+/// @brief Check if the seed was chosen by the player
+/// @return True if levels replay the same course
+bool game_seed_is_fixed(void) { return local_game.seed_fixed; }
+
+/// @brief Draw a uniform integer from one random stream of the game
+/// @param stream Stream to draw from
+/// @param min Minimum
+/// @param max Maximum
+/// @return Random number
+int game_rand(rng_stream stream, int min, int max) {
+  if (!local_game.rng_ready)
+    seed_context_rng(&local_game, 0, false);
+  return rng_session_range(&local_game.sim.rng, stream, min, max);
+}
+
 /// @brief Will render all borders
 /// @return Error code
 int render_borders(void) {
@@ -849,6 +1416,13 @@ int render_about_page(int yoffset) {
                           "There is more! Scroll down! (arrows up/down)");
 }
 
+static void format_output_line(char line[MAX_PAGE_LINE_LEN], const char *label,
+                               const term_io_counters *counters) {
+  unsigned long long per_frame = counters->frames > 0 ? counters->bytes / counters->frames : 0;
+  snprintf(line, MAX_PAGE_LINE_LEN, "%s: %llu B, %llu writes, %llu escapes, %llu B/frame", label,
+           counters->bytes, counters->writes, counters->escapes, per_frame);
+}
+
 int render_stats_page(const game_stats *stats, const run_metrics *last_run, const char *nickname,
                       int yoffset) {
   if (stats == NULL || last_run == NULL || nickname == NULL) {
@@ -885,69 +1459,66 @@ int render_stats_page(const game_stats *stats, const run_metrics *last_run, cons
     snprintf(lines[lineidx++], MAX_PAGE_LINE_LEN, "Average score per run: 0.00");
   }
 
+  lines[lineidx++][0] = '\0';
+  snprintf(lines[lineidx++], MAX_PAGE_LINE_LEN, "=== Terminal output (this session) ===");
+  if (!term_io_available()) {
+    snprintf(lines[lineidx++], MAX_PAGE_LINE_LEN, "Output accounting is not available here.");
+  } else {
+    term_io_counters total = term_io_total();
+    format_output_line(lines[lineidx++], "Total", &total);
+    for (int i = 0; i < TERM_IO_SCREEN_COUNT && lineidx < MAX_PAGE_LINES; i++) {
+      term_io_counters screen_out = term_io_screen_counters((term_io_screen)i);
+      if (screen_out.bytes > 0) {
+        format_output_line(lines[lineidx++], term_io_screen_name((term_io_screen)i), &screen_out);
+      }
+    }
+    for (int i = 1; i <= TERM_IO_MAX_LEVELS && lineidx < MAX_PAGE_LINES; i++) {
+      term_io_counters level_out = term_io_level_counters(i);
+      if (level_out.bytes > 0) {
+        char label[32] = {0};
+        snprintf(label, sizeof(label), "Level %d", i);
+        format_output_line(lines[lineidx++], label, &level_out);
+      }
+    }
+  }
+
+  lines[lineidx++][0] = '\0';
+  snprintf(lines[lineidx++], MAX_PAGE_LINE_LEN, "=== Memory ===");
+  if (mem_stats_enabled()) {
+    for (int i = 0; i < MEM_TAG_COUNT && lineidx < MAX_PAGE_LINES; i++) {
+      mem_tag_stats tag_stats = mem_stats_get((mem_tag)i);
+      snprintf(lines[lineidx++], MAX_PAGE_LINE_LEN,
+               "%s: %llu allocs, %llu frees, %llu B total, %lld B live, %lld B peak",
+               mem_stats_tag_name((mem_tag)i), tag_stats.allocations, tag_stats.frees,
+               tag_stats.bytes_allocated, tag_stats.live_bytes, tag_stats.peak_live_bytes);
+    }
+    if (lineidx < MAX_PAGE_LINES) {
+      snprintf(lines[lineidx++], MAX_PAGE_LINE_LEN, "Allocations inside gameplay loop: %llu",
+               mem_stats_gameplay_allocations());
+    }
+  } else {
+    snprintf(lines[lineidx++], MAX_PAGE_LINE_LEN, "Allocation tracking is off (%s=1 enables it).",
+             MEM_STATS_ENV);
+  }
+  if (lineidx < MAX_PAGE_LINES) {
+    snprintf(lines[lineidx++], MAX_PAGE_LINE_LEN, "Peak RSS: %ld kB (current %ld kB)",
+             mem_stats_rss_kb(true), mem_stats_rss_kb(false));
+  }
+
   return render_text_page(lines, lineidx, yoffset, "There is more! Scroll down! (arrows up/down)");
 }
 
-/// @brief Get random pipe based on level
+/// @brief Generate pipe from the random streams of a game
+/// @param ctx Game
 /// @param x x offset
 /// @param inplvl Level struct pointer to use
 /// @param enable If enable pipe
 /// @param prevupheight Height of previous pipe
 /// @return Generated pipe struct
-fbpipe get_pipe(int x, level *inplvl, bool enable, int prevupheight) {
-  fbpipe newpipe = {0};
-
-  if (!inplvl)
-    return newpipe;
-
-  newpipe.pipewidth = rand_gen(inplvl->minimum_width, inplvl->maximum_width);
-
-  int holeheight = rand_gen(inplvl->minimum_space, inplvl->maximum_space);
-  int full_allowed_height = MAPSIZEY - ((PIPEHOLE_END_HEIGHT + 1) * 2) - holeheight;
-
-  int minheight = 1, maxheight = full_allowed_height - 1;
-
-  if (prevupheight > 0) {
-    int useinterval = rand_gen(0, 1);
-    if (useinterval == 0) {
-      if (prevupheight - inplvl->maximum_distance_space <= 0)
-        useinterval = 1;
-    } else if (prevupheight + inplvl->minimum_distance_space >= full_allowed_height - 1)
-      useinterval = 0;
-
-    if (useinterval == 0) {
-      minheight = prevupheight - inplvl->maximum_distance_space;
-      maxheight = prevupheight - inplvl->minimum_distance_space;
-    } else {
-      minheight = prevupheight + inplvl->minimum_distance_space;
-      maxheight = prevupheight + inplvl->maximum_distance_space;
-    }
-
-    if (minheight <= 0)
-      minheight = 1;
-    else if (minheight >= full_allowed_height - 1)
-      minheight = full_allowed_height - 1;
-
-    if (maxheight >= full_allowed_height - 1)
-      maxheight = full_allowed_height - 1;
-    else if (maxheight <= 0)
-      maxheight = minheight;
-  }
-
-  if (minheight == maxheight)
-    newpipe.upheight = prevupheight;
-  else
-    newpipe.upheight = rand_gen(minheight, maxheight);
-
-  newpipe.downheight = full_allowed_height - newpipe.upheight;
-
-  while (newpipe.downheight < 1) newpipe.downheight++;
-
-  newpipe.position = x;
-  newpipe.enabled = enable;
-  newpipe.last_time_moved = timeInMilliseconds();
-
-  return newpipe;
+fbpipe get_pipe(game_context *ctx, int x, level *inplvl, bool enable, int prevupheight) {
+  if (!ctx->rng_ready)
+    seed_context_rng(ctx, 0, false);
+  return sim_get_pipe(&ctx->sim, x, inplvl, enable, prevupheight);
 }
 
 /// @brief Checks if coordinates are in map area
@@ -961,136 +1532,115 @@ bool check_in_map_ok(int y, int x) {
 }
 
 /// @brief Add character to map area
+/// @param ctx Game drawn to
 /// @param y y coordinate
 /// @param x x coordinate
 /// @param inp Character to add
 /// @return Error code
-int addch_maparea(int y, int x, const chtype inp) {
+int addch_maparea(game_context *ctx, int y, int x, const chtype inp) {
   if (check_in_map_ok(y, x))
-    return mvaddch(mapoffsy + y, mapoffsx + x, inp);
+    return mvwaddch(ctx->win, ctx->map_y + y, ctx->map_x + x, inp);
 
   return 0;
 }
 
 /// @brief Add character to pipe border
+/// @param ctx Game drawn to
 /// @param y y coordinate
 /// @param x x coordinate
 /// @param inp Character to use
 /// @param inplvl level struct pointer to use
 /// @return Error code
-int addch_pipe_border(int y, int x, const chtype inp, level *inplvl) {
+int addch_pipe_border(game_context *ctx, int y, int x, const chtype inp, level *inplvl) {
   if (!inplvl)
     return -1;
 
-  unsetcolor_bits(inplvl->pipe_color_body, bitscolor_bg_to_fg(inplvl->pipe_color_body));
-  setcolor_bits(inplvl->pipe_color_brd, bitscolor_bg_to_fg(inplvl->pipe_color_brd));
-  return addch_maparea(y, x, inp);
+  wunsetcolor_bits(ctx->win, inplvl->pipe_color_body, bitscolor_bg_to_fg(inplvl->pipe_color_body));
+  wsetcolor_bits(ctx->win, inplvl->pipe_color_brd, bitscolor_bg_to_fg(inplvl->pipe_color_brd));
+  return addch_maparea(ctx, y, x, inp);
 }
 
 /// @brief Add character to pipe body
+/// @param ctx Game drawn to
 /// @param y y coordinate
 /// @param x x coordinate
 /// @param inp Character to use
 /// @param inplvl level struct pointer to use
 /// @return Error code
-int addch_pipe_body(int y, int x, const chtype inp, level *inplvl) {
+int addch_pipe_body(game_context *ctx, int y, int x, const chtype inp, level *inplvl) {
   if (!inplvl)
     return -1;
 
-  unsetcolor_bits(inplvl->pipe_color_brd, bitscolor_bg_to_fg(inplvl->pipe_color_brd));
-  setcolor_bits(inplvl->pipe_color_body, bitscolor_bg_to_fg(inplvl->pipe_color_body));
-  return addch_maparea(y, x, inp);
+  wunsetcolor_bits(ctx->win, inplvl->pipe_color_brd, bitscolor_bg_to_fg(inplvl->pipe_color_brd));
+  wsetcolor_bits(ctx->win, inplvl->pipe_color_body, bitscolor_bg_to_fg(inplvl->pipe_color_body));
+  return addch_maparea(ctx, y, x, inp);
 }
 
 /// @brief Will render bird normally, except there is collision, then it will
 /// switch fg and bg color
+/// @param win Window to draw to
 /// @param y y coordinate
 /// @param x x coordinate
 /// @param inpch Character to add
 /// @param inpb Bird struct to use
 /// @param showcol If true, then collision will be checked and printed
-void render_bird_collision(int y, int x, chtype inpch, bird *inpb, bool showcol) {
+void render_bird_collision(WINDOW *win, int y, int x, chtype inpch, bird *inpb, bool showcol) {
   if (!showcol) {
-    mvaddch(y, x, inpch);
+    mvwaddch(win, y, x, inpch);
     return;
   }
 
-  if ((mvinch(y, x) & 255) != ' ')
-    setcolor_bits(bitscolor_bg_to_fg(inpb->colorbits), inpb->colorbits);
-  mvaddch(y, x, inpch);
-  if ((mvinch(y, x) & 255) != ' ') {
-    unsetcolor_bits(bitscolor_bg_to_fg(inpb->colorbits), inpb->colorbits);
-    setcolor_bits(inpb->colorbits, bitscolor_bg_to_fg(inpb->colorbits));
+  if ((mvwinch(win, y, x) & 255) != ' ')
+    wsetcolor_bits(win, bitscolor_bg_to_fg(inpb->colorbits), inpb->colorbits);
+  mvwaddch(win, y, x, inpch);
+  if ((mvwinch(win, y, x) & 255) != ' ') {
+    wunsetcolor_bits(win, bitscolor_bg_to_fg(inpb->colorbits), inpb->colorbits);
+    wsetcolor_bits(win, inpb->colorbits, bitscolor_bg_to_fg(inpb->colorbits));
   }
 }
 
 /// @brief Will render bird in map area
+/// @param ctx Game drawn to
 /// @param inpb Bird structure pointer to use
 /// @param xpos x position where bird should be rendered
 /// @param show_collision If true, will render also collision
 /// @return Error code
-int render_bird(bird *inpb, int xpos, bool show_collision) {
-  int xcenter = mapoffsx + xpos;
-  int ycenter = mapoffsy + inpb->act_position;
-
-  setcolor_bits(inpb->colorbits, bitscolor_bg_to_fg(inpb->colorbits));
-  if (ycenter - 1 >= mapoffsy && ycenter - 1 < (mapoffsy + MAPSIZEY))
-    render_bird_collision(ycenter - 1, xcenter, '\\', inpb, show_collision);
-
-  if (ycenter >= mapoffsy && ycenter < (mapoffsy + MAPSIZEY)) {
-    render_bird_collision(ycenter, xcenter - 2, '|', inpb, show_collision);
-    render_bird_collision(ycenter, xcenter + 3, '|', inpb, show_collision);
-    render_bird_collision(ycenter, xcenter + 2, '*', inpb, show_collision);
-    for (size_t i = 0; i < 3; i++)
-      render_bird_collision(ycenter, xcenter - 1 + i, '#', inpb, show_collision);
+int render_bird(game_context *ctx, bird *inpb, int xpos, bool show_collision) {
+  const sprite_frame *frame = sprite_pick(bird_sprite(), inpb->act_speed);
+  int xcenter = ctx->map_x + xpos;
+  int row = fixed_to_int(inpb->act_position);
+
+  wsetcolor_bits(ctx->win, inpb->colorbits, bitscolor_bg_to_fg(inpb->colorbits));
+  for (int i = 0; i < frame->run_count; i++) {
+    const sprite_run *run = &frame->runs[i];
+    int y = row + run->dy;
+    if (y < 0 || y >= MAPSIZEY)
+      continue;
+    if (!show_collision) {
+      mvwaddnstr(ctx->win, ctx->map_y + y, xcenter + run->dx, run->glyphs, run->len);
+      continue;
+    }
+    for (int c = 0; c < run->len; c++)
+      render_bird_collision(ctx->win, ctx->map_y + y, xcenter + run->dx + c,
+                            (unsigned char)run->glyphs[c], inpb, show_collision);
   }
-  if (ycenter + 1 >= mapoffsy && ycenter + 1 < (mapoffsy + MAPSIZEY))
-    render_bird_collision(ycenter + 1, xcenter, '/', inpb, show_collision);
 
-  unsetcolor_bits(inpb->colorbits, bitscolor_bg_to_fg(inpb->colorbits));
+  wunsetcolor_bits(ctx->win, inpb->colorbits, bitscolor_bg_to_fg(inpb->colorbits));
   return 0;
 }
 
 /// @brief Process/Move bird
+/// @param ctx Game of the bird
 /// @param bird Bird structure pointer to use
 /// @return Error code
-int move_bird(bird *bird) {
-  if (!bird)
-    return -1;
-
-  if (bird->last_time_ms == 0) {
-    bird->last_time_ms = timeInMilliseconds();
-    return 0;
-  }
-
-  long long act_time = timeInMilliseconds();
-  long long diff_time = act_time - bird->last_time_ms;
-  float seconds = ((float)diff_time / 1000);
-  float next_pos = bird->act_position + (bird->act_speed * METERTOCHARS) * seconds;
-  if (next_pos >= MAPSIZEY) {
-    bird->last_time_ms = act_time;
-    bird->act_speed = 0;
-    bird->act_position = MAPSIZEY - 1;
-    return 0;
-  } else if (next_pos <= 0) {
-    bird->last_time_ms = act_time;
-    bird->act_speed = bird->gravity * seconds;
-    bird->act_position = 0;
-    return 0;
-  }
-
-  bird->act_position = next_pos;
-  bird->act_speed += bird->gravity * seconds;
-  bird->last_time_ms = act_time;
-
-  return 0;
-}
+int move_bird(game_context *ctx, bird *bird) { return sim_move_bird(&ctx->sim, bird); }
 
 /// @brief Will render single pipe
+/// @param ctx Game drawn to
 /// @param inputp Pipe struct pointer
 /// @param inplvl Level struct pointer
 /// @return Error code
-int render_pipe(fbpipe *inputp, level *inplvl) {
+int render_pipe(game_context *ctx, fbpipe *inputp, level *inplvl) {
   if (!inputp || !inplvl)
     return -1;
 
@@ -1099,21 +1649,21 @@ int render_pipe(fbpipe *inputp, level *inplvl) {
 
   // RENDER UPPER PIPE
   for (int y = 0; y < inputp->upheight && inputp->position < MAPSIZEX; y++) {
-    addch_pipe_border(y, inputp->position, PIPEHORI, inplvl);
+    addch_pipe_border(ctx, y, inputp->position, PIPEHORI, inplvl);
     for (int x = 0; x < inputp->pipewidth && inputp->position + x + 1 < MAPSIZEX; x++)
-      addch_pipe_body(y, inputp->position + x + 1, PIPEBODY, inplvl);
+      addch_pipe_body(ctx, y, inputp->position + x + 1, PIPEBODY, inplvl);
     if ((inputp->position + inputp->pipewidth + 1) < MAPSIZEX)
-      addch_pipe_border(y, inputp->position + inputp->pipewidth + 1, PIPEHORI, inplvl);
+      addch_pipe_border(ctx, y, inputp->position + inputp->pipewidth + 1, PIPEHORI, inplvl);
   }
 
   // first layer turn border
   for (int i = 0; i < PIPEHOLE_END_WIDTH && (inputp->position - PIPEHOLE_END_WIDTH + i) < MAPSIZEX;
        i++)
-    addch_pipe_border(inputp->upheight - 1, inputp->position - PIPEHOLE_END_WIDTH + i, PIPEVERT,
-                      inplvl);
+    addch_pipe_border(ctx, inputp->upheight - 1, inputp->position - PIPEHOLE_END_WIDTH + i,
+                      PIPEVERT, inplvl);
   for (int i = 0;
        i < PIPEHOLE_END_WIDTH && (inputp->position + 1 + inputp->pipewidth + 1 + i) < MAPSIZEX; i++)
-    addch_pipe_border(inputp->upheight - 1, inputp->position + 1 + inputp->pipewidth + 1 + i,
+    addch_pipe_border(ctx, inputp->upheight - 1, inputp->position + 1 + inputp->pipewidth + 1 + i,
                       PIPEVERT, inplvl);
 
   // second layer turn border and body
@@ -1121,32 +1671,32 @@ int render_pipe(fbpipe *inputp, level *inplvl) {
        i < inputp->pipewidth + 2 + PIPEHOLE_END_WIDTH * 2 && (inputp->position - 2 + i) < MAPSIZEX;
        i++) {
     if (i == 0 || i == inputp->pipewidth + 1 + PIPEHOLE_END_WIDTH * 2)
-      addch_pipe_border(inputp->upheight, inputp->position - 2 + i, PIPEHORI, inplvl);
+      addch_pipe_border(ctx, inputp->upheight, inputp->position - 2 + i, PIPEHORI, inplvl);
     else
-      addch_pipe_body(inputp->upheight, inputp->position - 2 + i, PIPEBODY, inplvl);
+      addch_pipe_body(ctx, inputp->upheight, inputp->position - 2 + i, PIPEBODY, inplvl);
 
     // third/last layer turn border
-    addch_pipe_border(inputp->upheight + 1, inputp->position - 2 + i, PIPEEND, inplvl);
+    addch_pipe_border(ctx, inputp->upheight + 1, inputp->position - 2 + i, PIPEEND, inplvl);
   }
 
   // RENDER DOWN PIPE
   for (int y = 0; y < inputp->downheight && inputp->position < MAPSIZEX; y++) {
-    addch_pipe_border(MAPSIZEY - 1 - y, inputp->position, PIPEHORI, inplvl);
+    addch_pipe_border(ctx, MAPSIZEY - 1 - y, inputp->position, PIPEHORI, inplvl);
     for (int x = 0; x < inputp->pipewidth && inputp->position + x + 1 < MAPSIZEX; x++)
-      addch_pipe_body(MAPSIZEY - 1 - y, inputp->position + x + 1, PIPEBODY, inplvl);
+      addch_pipe_body(ctx, MAPSIZEY - 1 - y, inputp->position + x + 1, PIPEBODY, inplvl);
     if ((inputp->position + inputp->pipewidth + 1) < MAPSIZEX)
-      addch_pipe_border(MAPSIZEY - 1 - y, inputp->position + inputp->pipewidth + 1, PIPEHORI,
+      addch_pipe_border(ctx, MAPSIZEY - 1 - y, inputp->position + inputp->pipewidth + 1, PIPEHORI,
                         inplvl);
   }
 
   // first layer turn border
   for (int i = 0; i < PIPEHOLE_END_WIDTH && (inputp->position - PIPEHOLE_END_WIDTH + i) < MAPSIZEX;
        i++)
-    addch_pipe_border(MAPSIZEY - 1 - inputp->downheight + 1,
+    addch_pipe_border(ctx, MAPSIZEY - 1 - inputp->downheight + 1,
                       inputp->position - PIPEHOLE_END_WIDTH + i, '-', inplvl);
   for (int i = 0;
        i < PIPEHOLE_END_WIDTH && (inputp->position + 1 + inputp->pipewidth + 1 + i) < MAPSIZEX; i++)
-    addch_pipe_border(MAPSIZEY - 1 - inputp->downheight + 1,
+    addch_pipe_border(ctx, MAPSIZEY - 1 - inputp->downheight + 1,
                       inputp->position + 1 + inputp->pipewidth + 1 + i, '-', inplvl);
 
   // second layer turn border and body
@@ -1154,33 +1704,34 @@ int render_pipe(fbpipe *inputp, level *inplvl) {
        i < inputp->pipewidth + 2 + PIPEHOLE_END_WIDTH * 2 && (inputp->position - 2 + i) < MAPSIZEX;
        i++) {
     if (i == 0 || i == inputp->pipewidth + 1 + PIPEHOLE_END_WIDTH * 2)
-      addch_pipe_border(MAPSIZEY - 1 - inputp->downheight, inputp->position - 2 + i, PIPEHORI,
+      addch_pipe_border(ctx, MAPSIZEY - 1 - inputp->downheight, inputp->position - 2 + i, PIPEHORI,
                         inplvl);
     else
-      addch_pipe_body(MAPSIZEY - 1 - inputp->downheight, inputp->position - 2 + i, PIPEBODY,
+      addch_pipe_body(ctx, MAPSIZEY - 1 - inputp->downheight, inputp->position - 2 + i, PIPEBODY,
                       inplvl);
 
     // third/last layer turn border
-    addch_pipe_border(MAPSIZEY - 1 - inputp->downheight - 1, inputp->position - 2 + i, PIPEEND,
+    addch_pipe_border(ctx, MAPSIZEY - 1 - inputp->downheight - 1, inputp->position - 2 + i, PIPEEND,
                       inplvl);
   }
 
-  unsetcolor_bits(inplvl->pipe_color_brd, bitscolor_bg_to_fg(inplvl->pipe_color_brd));
-  unsetcolor_bits(inplvl->pipe_color_body, bitscolor_bg_to_fg(inplvl->pipe_color_body));
+  wunsetcolor_bits(ctx->win, inplvl->pipe_color_brd, bitscolor_bg_to_fg(inplvl->pipe_color_brd));
+  wunsetcolor_bits(ctx->win, inplvl->pipe_color_body, bitscolor_bg_to_fg(inplvl->pipe_color_body));
 
   return 0;
 }
 
 /// @brief Will render pipes
+/// @param ctx Game drawn to
 /// @param inplvl Pointer to input level
 /// @return Errcode
-int render_pipes(level *inplvl) {
+int render_pipes(game_context *ctx, level *inplvl) {
   if (!inplvl)
     return -1;
 
   for (int i = 0; i < MAX_PIPES; i++)
-    if (pipe_array[i].enabled)
-      render_pipe(&pipe_array[i], inplvl);
+    if (ctx->sim.pipes[i].enabled)
+      render_pipe(ctx, &ctx->sim.pipes[i], inplvl);
 
   return 0;
 }
@@ -1278,7 +1829,8 @@ int print_level_info(level *inplvl, int yoffset) {
     sprintf(lvlinfo[lineidx++], "Gravity multiplier: %.3f (DEFAULT)", def_grav_multiply);
   }
 
-  sprintf(lvlinfo[lineidx++], "Gravity %.3f [m/s^2]", gravity_constant * inplvl->gravity_multiply);
+  sprintf(lvlinfo[lineidx++], "Gravity %.3f [m/s^2]",
+          local_game.sim.gravity_constant * inplvl->gravity_multiply);
   sprintf(lvlinfo[lineidx++], "Jump speed: %.3f [m/s]", inplvl->jump_speed);
   sprintf(lvlinfo[lineidx++], "Max lives: %d", inplvl->max_lives);
 
@@ -1287,9 +1839,9 @@ int print_level_info(level *inplvl, int yoffset) {
   setcolor_bits(bgoppcolor, bitscolor_bg_to_fg(inplvl->bgcolor));
   clear_map_area(NULL, true);
 
-  fbpipe tmpp = get_pipe(4 * (MAPSIZEX / 5), inplvl, false, -1);
+  fbpipe tmpp = get_pipe(&local_game, 4 * (MAPSIZEX / 5), inplvl, false, -1);
 
-  render_pipe(&tmpp, inplvl);
+  render_pipe(&local_game, &tmpp, inplvl);
 
   int lineidxcounter = yoffset, i = 0;
   for (; lineidxcounter < lineidx && i < MAPSIZEY - 1; i = i + 2) {
@@ -1308,13 +1860,14 @@ int print_level_info(level *inplvl, int yoffset) {
 }
 
 /// @brief Support function to render bird floating based on actual degree
+/// @param ctx Game drawn to
 /// @param inplvl Level struct pointer to use
 /// @param degrees Degress to use to compute
 /// @return Error code
-int render_bird_floating(level *inplvl, int degrees) {
+int render_bird_floating(game_context *ctx, level *inplvl, int degrees) {
   if (!inplvl)
     return -1;
-  bird tmpb = get_bird(inplvl);
+  bird tmpb = get_bird(ctx, inplvl);
   double rad = ((2 * M_PI) / 360) * degrees;
 
   double beforerad = ((2 * M_PI) / 360) * (degrees - 2);
@@ -1323,23 +1876,25 @@ int render_bird_floating(level *inplvl, int degrees) {
   if (beforeposy > 0)
     beforeposy--;
 
-  setcolor_bits(inplvl->bgcolor, bitscolor_bg_to_fg(inplvl->bgcolor));
+  wsetcolor_bits(ctx->win, inplvl->bgcolor, bitscolor_bg_to_fg(inplvl->bgcolor));
   for (int x = 0; x < 6; x++)
-    for (int y = 0; y < 3; y++) mvaddch(mapoffsy + beforeposy + y, mapoffsx + beforeposx + x, ' ');
-  unsetcolor_bits(inplvl->bgcolor, bitscolor_bg_to_fg(inplvl->bgcolor));
+    for (int y = 0; y < 3; y++)
+      mvwaddch(ctx->win, ctx->map_y + beforeposy + y, ctx->map_x + beforeposx + x, ' ');
+  wunsetcolor_bits(ctx->win, inplvl->bgcolor, bitscolor_bg_to_fg(inplvl->bgcolor));
 
-  tmpb.act_position = (MAPSIZEY / 2) + (6 * sin(rad));
-  render_bird(&tmpb, 3 * (MAPSIZEX / 5), false);
+  tmpb.act_position = fixed_from_double((MAPSIZEY / 2) + (6 * sin(rad)));
+  render_bird(ctx, &tmpb, 3 * (MAPSIZEX / 5), false);
   if (degrees + 2 >= 360)
     degrees = -2;
 
   refresh();
+  term_io_end_frame();
   msleep(1000 / act_rndsett.fps);
 
   return degrees + 2;
 }
 
-run_metrics get_last_run_metrics(void) { return last_run_metrics; }
+run_metrics get_last_run_metrics(void) { return local_game.last_run_metrics; }
 
 /// @brief Will render hall of fame
 /// @param hoff Data pointer to use
@@ -1405,7 +1960,7 @@ bool render_hof(config_option_t hoff, int yoff, bool dofree, const char actnickn
 
     if (dofree) {
       prev = hoff->prev;
-      free(hoff);
+      mem_free(hoff);
       hoff = prev;
     } else
       hoff = hoff->prev;
@@ -1420,206 +1975,72 @@ bool render_hof(config_option_t hoff, int yoff, bool dofree, const char actnickn
 }
 
 /// @brief Generate bird based on level
+/// @param ctx Game of the bird
 /// @param inplvl Level struct pointer to use
 /// @return Generated bird structure
-bird get_bird(level *inplvl) {
-  bird tmpbird = {0};
+bird get_bird(const game_context *ctx, level *inplvl) {
+  bird tmpbird = sim_get_bird(&ctx->sim, inplvl);
   if (!inplvl)
     return tmpbird;
 
-  tmpbird.act_speed = 0;
-  tmpbird.act_position = (int)(MAPSIZEY / 2);
   // Set color of bird that is exact oposite of background color, to be more
   // seen
-
   tmpbird.colorbits =
       native_to_bitscolor(opposit_col(bits_to_native_color(bitscolor_bg_to_fg(inplvl->bgcolor))),
                           true) |
       (inplvl->bgcolor & (7 << 4));
-  tmpbird.gravity = gravity_constant * inplvl->gravity_multiply;
-  tmpbird.jump_speed = inplvl->jump_speed;
-  tmpbird.last_time_ms = timeInMilliseconds();
-
   return tmpbird;
 }
 
-/// @brief Function is checking collision between input bird and array of pipes,
-/// run before bird render!
-/// @param inbird Input bird pointer that needs to be checked
+/// @brief Function is checking collision between input bird and array of pipes, computed from
+/// pipe geometry, so it does not depend on what is drawn
+/// @param ctx Game of the bird
+/// @param inpb Input bird pointer that needs to be checked
 /// @param xpos x map offset for bird
 /// @return true if there is collision
-bool bird_collision(bird *inpb, int xpos) {
-  if (!inpb)
-    return false;
-  int xcenter = mapoffsx + xpos;
-  int ycenter = mapoffsy + inpb->act_position;
-
-  if (ycenter - 1 >= mapoffsy && ycenter - 1 < (mapoffsy + MAPSIZEY))
-    if ((mvinch(ycenter - 1, xcenter) & 255) != ' ')
-      return true;
-
-  if (ycenter >= mapoffsy && ycenter < (mapoffsy + MAPSIZEY)) {
-    if ((mvinch(ycenter, xcenter - 2) & 255) != ' ')
-      return true;
-    if ((mvinch(ycenter, xcenter + 3) & 255) != ' ')
-      return true;
-    if ((mvinch(ycenter, xcenter + 2) & 255) != ' ')
-      return true;
-
-    for (int i = 0; i < 3; i++)
-      if ((mvinch(ycenter, xcenter - 1 + i) & 255) != ' ')
-        return true;
-  }
-
-  if (ycenter + 1 >= mapoffsy && ycenter + 1 < (mapoffsy + MAPSIZEY))
-    if ((mvinch(ycenter + 1, xcenter) & 255) != ' ')
-      return true;
-
-  return false;
-}
-
-/// @brief Will get most away pipe (with biggest x coordinate)
-/// @return Pointer to pipe
-fbpipe *get_most_away_pipe(void) {
-  int xpos = -1;
-  fbpipe *retpipe = NULL;
-  bool first = true;
-  for (int i = 0; i < MAX_PIPES; i++) {
-    if (!pipe_array[i].enabled)
-      continue;
-
-    if (first) {
-      xpos = pipe_array[i].position;
-      retpipe = &pipe_array[i];
-      first = false;
-    } else if (pipe_array[i].position > xpos) {
-      retpipe = &pipe_array[i];
-      xpos = pipe_array[i].position;
-    }
-  }
-  return retpipe;
-}
-
-/// @brief Will get least away pipe (with lowest x coordinate)
-/// @return Pointer to pipe
-fbpipe *get_least_away_pipe(void) {
-  int xpos = -1;
-  fbpipe *retpipe = NULL;
-  bool first = true;
-  for (int i = 0; i < MAX_PIPES; i++) {
-    if (!pipe_array[i].enabled)
-      continue;
-
-    if (first) {
-      xpos = pipe_array[i].position;
-      retpipe = &pipe_array[i];
-      first = false;
-    } else if (pipe_array[i].position < xpos) {
-      retpipe = &pipe_array[i];
-      xpos = pipe_array[i].position;
-    }
-  }
-
-  return retpipe;
+bool bird_hits_pipes(const game_context *ctx, const bird *inpb, int xpos) {
+  return sim_bird_hits_pipes(&ctx->sim, inpb, xpos);
 }
 
 /// @brief Will init speed based on level
+/// @param ctx Game
 /// @param inplvl level struct pointer to use
 /// @return Error code
-int init_speed(level *inplvl) {
+int init_speed(game_context *ctx, level *inplvl) {
   if (!inplvl)
     return -1;
-  act_speed_chars = METERTOCHARS * inplvl->start_speed;
+  ctx->sim.speed_chars = sim_start_speed(inplvl);
   return 0;
 }
 
 /// @brief Increase speed based on last updated time variable
+/// @param ctx Game
 /// @param inplvl level struct pointer to use
 /// @return Error code
-int increase_speed(level *inplvl) {
-  if (!inplvl)
-    return -1;
-  if (last_time == 0) {
-    last_time = timeInMilliseconds();
-    return 0;
-  }
-
-  long long act_time = timeInMilliseconds();
-  long long timediff = act_time - last_time;
-  act_speed_chars +=
-      (float)(METERTOCHARS * (inplvl->speed_increase / (float)60)) * ((float)timediff / 1000);
-  last_time = timeInMilliseconds();
-  return 0;
+int increase_speed(game_context *ctx, level *inplvl) {
+  return sim_increase_speed(&ctx->sim, inplvl);
 }
 
-/// @brief Get any free pipe slot
-/// @return Pointer to free pipe slot
-fbpipe *get_free_pipe_slot(void) {
-  for (int i = 0; i < MAX_PIPES; i++)
-    if (!pipe_array[i].enabled)
-      return &pipe_array[i];
-
-  return NULL;
-}
+/// @brief Will disable all enabled pipes
+/// @param ctx Game
+void clear_all_pipes(game_context *ctx) { sim_clear_pipes(&ctx->sim); }
 
 /// @brief Function to proccess/move pipes/world
+/// @param ctx Game
 /// @param inplvl
 /// @return How many pipes has bird came accross
-int move_pipes(const level *inplvl) {
-  if (!inplvl)
-    return -1;
-
-  long long act_time = timeInMilliseconds();
-  int counter = 0;
-
-  for (int i = 0; i < MAX_PIPES; i++) {
-    if (pipe_array[i].last_time_moved <= 0) {
-      pipe_array[i].last_time_moved = act_time;
-      continue;
-    }
-
-    long long timediff = (act_time - pipe_array[i].last_time_moved);
-    if (!pipe_array[i].enabled)
-      continue;
-
-    int posbef = pipe_array[i].position + 1 + pipe_array[i].pipewidth + PIPEHOLE_END_WIDTH;
-
-    if ((act_speed_chars * ((float)timediff / (float)1000)) >= 1) {
-      pipe_array[i].position -= (int)(act_speed_chars * ((float)timediff / (float)1000));
-      pipe_array[i].last_time_moved = act_time;
-    }
-
-    int posaf = pipe_array[i].position + 1 + pipe_array[i].pipewidth + PIPEHOLE_END_WIDTH;
-    if (posbef > BIRDOFFX && (posaf < BIRDOFFX || posaf == BIRDOFFX))
-      counter++;
-  }
-
-  return counter;
+int move_pipes(game_context *ctx, const level *inplvl) {
+  return sim_move_pipes(&ctx->sim, inplvl);
 }
 
 /// @brief Process pipes (Generate new one if there is need)
+/// @param ctx Game
 /// @param inplvl level struct pointer to use
 /// @return Error code
-int process_pipes(level *inplvl) {
-  if (!inplvl)
-    return -1;
-
-  fbpipe *mostaway = get_most_away_pipe();
-  fbpipe *leastaway = get_least_away_pipe();
-
-  if (leastaway && leastaway->position + 1 + leastaway->pipewidth + PIPEHOLE_END_WIDTH < 0)
-    leastaway->enabled = false;
-
-  fbpipe *freepipe = get_free_pipe_slot();
-  if (freepipe) {
-    if (!mostaway)
-      *freepipe = get_pipe(MAPSIZEX - 1 + PIPEHOLE_END_WIDTH, inplvl, true, -1);
-    else if (mostaway->position + PIPEHOLE_END_WIDTH < MAPSIZEX)
-      *freepipe = get_pipe(mostaway->position + mostaway->pipewidth + 1 + PIPEHOLE_END_WIDTH +
-                               rand_gen(inplvl->minimum_distance, inplvl->maximum_distance),
-                           inplvl, true, mostaway->upheight);
-  }
-  return 0;
+int process_pipes(game_context *ctx, level *inplvl) {
+  if (!ctx->rng_ready)
+    seed_context_rng(ctx, 0, false);
+  return sim_process_pipes(&ctx->sim, inplvl);
 }
 
 /// @brief Will load level file based on level numner
@@ -1628,7 +2049,9 @@ int process_pipes(level *inplvl) {
 level load_level_file(int levelnum) {
   char levelname[30] = {0};
   sprintf(levelname, "./assets/levels/level_%d.conf", levelnum);
+  mem_tag prev_tag = mem_stats_set_tag(MEM_TAG_LEVELS);
   config_option_t options = read_config_file(levelname);
+  mem_stats_set_tag(prev_tag);
   level tmplevel = {0};
   tmplevel.levelnumber = levelnum;
 
@@ -1661,6 +2084,10 @@ level load_level_file(int levelnum) {
       tmplevel.start_speed = atof(options->value);
     else if (strcmp(options->key, "speed_increase") == 0)
       tmplevel.speed_increase = atof(options->value);
+    else if (strcmp(options->key, "endless_start_speed") == 0)
+      tmplevel.endless_start_speed = atof(options->value);
+    else if (strcmp(options->key, "endless_speed_increase") == 0)
+      tmplevel.endless_speed_increase = atof(options->value);
     else if (strcmp(options->key, "minimum_space") == 0)
       tmplevel.minimum_space = atoi(options->value);
     else if (strcmp(options->key, "maximum_space") == 0)
@@ -1687,7 +2114,7 @@ level load_level_file(int levelnum) {
       strcpy(tmplevel.levelname, options->value);
 
     config_option_t prev = options->prev;
-    free(options);
+    mem_free(options);
     options = prev;
   }
 
@@ -1697,6 +2124,12 @@ level load_level_file(int levelnum) {
   if (tmplevel.speed_increase == 0) {
     tmplevel.speed_increase = def_speed_incr;
   }
+  if (tmplevel.endless_start_speed == 0) {
+    tmplevel.endless_start_speed = tmplevel.start_speed;
+  }
+  if (tmplevel.endless_speed_increase == 0) {
+    tmplevel.endless_speed_increase = tmplevel.speed_increase;
+  }
 
   return tmplevel;
 }
@@ -1706,8 +2139,11 @@ level load_level_file(int levelnum) {
 int load_settings(void) {
   audio_set_enabled(true);
   audio_set_mode("beep");
+  char sprite_path[256] = BIRD_SPRITE_FILE;
 
+  mem_tag prev_tag = mem_stats_set_tag(MEM_TAG_RENDER);
   config_option_t options = read_config_file(SETTINGS_FILE);
+  mem_stats_set_tag(prev_tag);
   while (options != NULL) {
     if (strcmp(options->key, "bordercolor_fg") == 0)
       act_screen.border_color =
@@ -1730,7 +2166,7 @@ int load_settings(void) {
     else if (strcmp(options->key, "fps") == 0)
       act_rndsett.fps = atoi(options->value);
     else if (strcmp(options->key, "gravity_constant") == 0)
-      gravity_constant = atof(options->value);
+      local_game.sim.gravity_constant = atof(options->value);
     else if (strcmp(options->key, "default_gravity_multiplier") == 0)
       def_grav_multiply = atof(options->value);
     else if (strcmp(options->key, "default_speed_increase_per_minute") == 0)
@@ -1739,10 +2175,16 @@ int load_settings(void) {
       audio_set_enabled(atoi(options->value) != 0);
     else if (strcmp(options->key, "sound_mode") == 0)
       audio_set_mode(options->value);
+    else if (strcmp(options->key, "bird_sprite") == 0)
+      snprintf(sprite_path, sizeof(sprite_path), "%s", options->value);
 
     config_option_t prev = options->prev;
-    free(options);
+    mem_free(options);
     options = prev;
   }
+
+  // A missing or broken sprite file keeps the built-in bird.
+  static sprite_set loaded_sprite;
+  set_bird_sprite(sprite_load(&loaded_sprite, sprite_path) == 0 ? &loaded_sprite : NULL);
   return 0;
 }
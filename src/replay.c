@@ -0,0 +1,392 @@
+// Copyright 2022 <Maros Varchola - mvarchdev>
+
+#include "flappybird/replay.h"
+
+#include <ncurses.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "flappybird/audio.h"
+#include "flappybird/common_tools.h"
+#include "flappybird/game_context.h"
+#include "flappybird/mem_stats.h"
+#include "flappybird/rendering.h"
+
+/// @brief Bytes of the fixed part of the header.
+#define REPLAY_MAGIC_LEN 4
+/// @brief Longest LEB128 encoding of a 64-bit value.
+#define VARINT_MAX_BYTES 10
+/// @brief Playback speed limits of the + and - keys.
+#define REPLAY_MIN_SPEED 0.125
+#define REPLAY_MAX_SPEED 16.0
+/// @brief Events reserved before a run starts, a key every few frames of half an hour.
+#define REPLAY_RESERVE_EVENTS 8192
+
+static int reserve_events(replay *rp, size_t capacity) {
+  if (capacity <= rp->capacity)
+    return 0;
+  replay_event *grown = realloc(rp->events, capacity * sizeof(*grown));
+  if (grown == NULL)
+    return -1;
+  rp->events = grown;
+  rp->capacity = capacity;
+  return 0;
+}
+
+/// @brief Start recording a run, the event buffer of a previous recording is reused. It is
+/// reserved here, so the gameplay loop only grows it for very long runs.
+/// @param rp Replay
+/// @param levelnum Level number
+/// @param seed Seed the course is generated from
+/// @param frame_ms Gameplay time of one frame
+/// @return Error code
+int replay_begin(replay *rp, int levelnum, uint64_t seed, long long frame_ms) {
+  rp->levelnum = levelnum;
+  rp->seed = seed;
+  rp->frame_ms = frame_ms;
+  rp->ticks = 0;
+  rp->score = 0;
+  rp->count = 0;
+  return reserve_events(rp, REPLAY_RESERVE_EVENTS);
+}
+
+/// @brief Append a key read at a tick, ticks must not decrease
+/// @param rp Replay
+/// @param tick Gameplay frame the key was read in
+/// @param key Key
+/// @return Error code
+int replay_add(replay *rp, long tick, int key) {
+  if (rp->count == rp->capacity) {
+    if (reserve_events(rp, rp->capacity ? rp->capacity * 2 : 256) != 0)
+      return -1;
+    mem_stats_count_growth();
+  }
+  rp->events[rp->count].tick = tick;
+  rp->events[rp->count].key = key;
+  rp->count++;
+  return 0;
+}
+
+void replay_free(replay *rp) {
+  free(rp->events);
+  memset(rp, 0, sizeof(*rp));
+}
+
+static size_t put_varint(uint8_t *buf, size_t size, size_t pos, uint64_t value) {
+  do {
+    uint8_t byte = value & 0x7f;
+    value >>= 7;
+    if (value)
+      byte |= 0x80;
+    if (pos < size)
+      buf[pos] = byte;
+    pos++;
+  } while (value);
+  return pos;
+}
+
+static int get_varint(const uint8_t *buf, size_t size, size_t *pos, uint64_t *value) {
+  *value = 0;
+  for (int shift = 0; shift < 7 * VARINT_MAX_BYTES; shift += 7) {
+    if (*pos >= size)
+      return -1;
+    uint8_t byte = buf[(*pos)++];
+    *value |= (uint64_t)(byte & 0x7f) << shift;
+    if (!(byte & 0x80))
+      return 0;
+  }
+  return -1;
+}
+
+/// @brief Encode a replay: magic, header varints, then per event the tick delta and the key
+/// @param rp Replay
+/// @param buf Output buffer, may be NULL to get the size only
+/// @param size Size of the output buffer
+/// @return Encoded size, larger than size if the buffer is too small
+size_t replay_encode(const replay *rp, uint8_t *buf, size_t size) {
+  size_t pos = 0;
+  for (; pos < REPLAY_MAGIC_LEN; pos++) {
+    if (pos < size)
+      buf[pos] = (uint8_t)REPLAY_MAGIC[pos];
+  }
+  pos = put_varint(buf, size, pos, (uint64_t)rp->levelnum);
+  pos = put_varint(buf, size, pos, rp->seed);
+  pos = put_varint(buf, size, pos, (uint64_t)rp->frame_ms);
+  pos = put_varint(buf, size, pos, (uint64_t)rp->ticks);
+  pos = put_varint(buf, size, pos, (uint64_t)rp->score);
+  pos = put_varint(buf, size, pos, rp->count);
+
+  long prev = 0;
+  for (size_t i = 0; i < rp->count; i++) {
+    pos = put_varint(buf, size, pos, (uint64_t)(rp->events[i].tick - prev));
+    pos = put_varint(buf, size, pos, (uint64_t)rp->events[i].key);
+    prev = rp->events[i].tick;
+  }
+  return pos;
+}
+
+/// @brief Decode a replay produced by replay_encode
+/// @param rp Replay to fill, free it with replay_free
+/// @param buf Encoded replay
+/// @param size Size of the encoded replay
+/// @return Error code
+int replay_decode(replay *rp, const uint8_t *buf, size_t size) {
+  memset(rp, 0, sizeof(*rp));
+  if (size < REPLAY_MAGIC_LEN || memcmp(buf, REPLAY_MAGIC, REPLAY_MAGIC_LEN) != 0)
+    return -1;
+
+  size_t pos = REPLAY_MAGIC_LEN;
+  uint64_t header[6] = {0};
+  for (int i = 0; i < 6; i++) {
+    if (get_varint(buf, size, &pos, &header[i]) != 0)
+      return -1;
+  }
+  // Every event takes at least two bytes, a larger count is a corrupt file.
+  if (header[5] > (size - pos) / 2)
+    return -1;
+  rp->levelnum = (int)header[0];
+  rp->seed = header[1];
+  rp->frame_ms = (long long)header[2];
+  rp->ticks = (long)header[3];
+  rp->score = (int)header[4];
+
+  long tick = 0;
+  for (uint64_t i = 0; i < header[5]; i++) {
+    uint64_t delta = 0;
+    uint64_t key = 0;
+    if (get_varint(buf, size, &pos, &delta) != 0 || get_varint(buf, size, &pos, &key) != 0 ||
+        replay_add(rp, tick + (long)delta, (int)key) != 0) {
+      replay_free(rp);
+      return -1;
+    }
+    tick += (long)delta;
+  }
+  return 0;
+}
+
+/// @brief Write a replay file
+/// @param rp Replay
+/// @param path File path
+/// @return Error code
+int replay_save(const replay *rp, const char *path) {
+  size_t size = replay_encode(rp, NULL, 0);
+  uint8_t *buf = malloc(size);
+  if (buf == NULL)
+    return -1;
+  replay_encode(rp, buf, size);
+
+  int err = -1;
+  FILE *fp = fopen(path, "wb");
+  if (fp != NULL) {
+    err = fwrite(buf, 1, size, fp) == size ? 0 : -1;
+    fclose(fp);
+  }
+  free(buf);
+  return err;
+}
+
+/// @brief Read a replay file
+/// @param rp Replay to fill, free it with replay_free
+/// @param path File path
+/// @return Error code
+int replay_load(replay *rp, const char *path) {
+  memset(rp, 0, sizeof(*rp));
+  FILE *fp = fopen(path, "rb");
+  if (fp == NULL)
+    return -1;
+  // Size the buffer by the file, an audit loads thousands of replays of a few hundred bytes.
+  long length = fseek(fp, 0, SEEK_END) == 0 ? ftell(fp) : -1;
+  uint8_t *buf = NULL;
+  if (length <= 0 || length > REPLAY_MAX_BYTES || fseek(fp, 0, SEEK_SET) != 0 ||
+      (buf = malloc((size_t)length)) == NULL) {
+    fclose(fp);
+    return -1;
+  }
+  size_t size = fread(buf, 1, (size_t)length, fp);
+  fclose(fp);
+  int err = replay_decode(rp, buf, size);
+  free(buf);
+  return err;
+}
+
+/// @brief Parse replay playback arguments
+/// @param argc Argument count
+/// @param argv Arguments
+/// @param opts Options to fill
+/// @return 0 on success, -1 if the arguments are not a replay playback
+int replay_parse_args(int argc, char *argv[], replay_options *opts) {
+  memset(opts, 0, sizeof(*opts));
+  opts->speed = 1.0;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+      opts->path = argv[++i];
+    } else if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc) {
+      opts->speed = atof(argv[++i]);
+    } else if (strcmp(argv[i], "--fast-forward") == 0) {
+      opts->fast_forward = true;
+    } else {
+      return -1;
+    }
+  }
+  return opts->path && opts->speed > 0 ? 0 : -1;
+}
+
+/// @brief State of a replay that drives run_level.
+typedef struct replay_player {
+  const replay *rp;
+  size_t next;
+  long tick;
+  /// Watched in a terminal, keys control speed and fast forward.
+  bool interactive;
+  bool fast_forward;
+  double speed;
+  long long deadline_ns;
+} replay_player;
+
+static void toggle_fast_forward(replay_player *player) {
+  player->fast_forward = !player->fast_forward;
+  if (player->fast_forward) {
+    render_header_string("Fast forward - press F to watch, Q to stop", 0, true, true);
+    refresh();
+  }
+  set_level_backend(player->fast_forward ? RENDER_BACKEND_NONE : RENDER_BACKEND_NCURSES);
+  player->deadline_ns = timeInNanoseconds();
+}
+
+/// @brief Handle playback keys and sleep until the frame is due at the current speed
+/// @return True if playback should stop
+static bool watch_controls(replay_player *player) {
+  int ch = getch();
+  if (ch == '+' && player->speed < REPLAY_MAX_SPEED) {
+    player->speed *= 2;
+  } else if (ch == '-' && player->speed > REPLAY_MIN_SPEED) {
+    player->speed /= 2;
+  } else if (ch == 'f' || ch == 'F') {
+    toggle_fast_forward(player);
+  } else if (ch == 'q' || ch == 'Q') {
+    return true;
+  }
+  if (player->fast_forward)
+    return false;
+
+  player->deadline_ns += (long long)((double)player->rp->frame_ms * 1e6 / player->speed);
+  long long now = timeInNanoseconds();
+  if (player->deadline_ns > now)
+    msleep((long)((player->deadline_ns - now) / 1000000));
+  else
+    player->deadline_ns = now;
+  return false;
+}
+
+/// @brief Key source of run_level, returns the recorded keys at their ticks
+static int replay_next_key(void *ctx, level_prompt prompt) {
+  replay_player *player = ctx;
+  const replay *rp = player->rp;
+  if (prompt == LEVEL_PROMPT_NONE) {
+    if (player->interactive && watch_controls(player))
+      return 'e';
+    if (player->tick >= rp->ticks)
+      return 'e';
+    long tick = player->tick++;
+    if (player->next < rp->count && rp->events[player->next].tick == tick)
+      return rp->events[player->next++].key;
+    return ERR;
+  }
+  // Dialog keys were read between two frames, they carry the tick of the next frame.
+  if (player->next < rp->count && rp->events[player->next].tick == player->tick)
+    return rp->events[player->next++].key;
+  return 'e';
+}
+
+/// @brief Run the recorded level with the recorded seed and keys
+static int replay_run(const replay *rp, replay_player *player, render_backend backend,
+                      int *score) {
+  level lvl = load_level_file(rp->levelnum);
+  if (!lvl.loaded) {
+    fprintf(stderr, "Level %d of the replay not found.\n", rp->levelnum);
+    return -1;
+  }
+  if (rp->frame_ms != frame_period_ms()) {
+    fprintf(stderr, "Replay was recorded at %lld ms per frame, settings give %lld.\n",
+            rp->frame_ms, frame_period_ms());
+    return -1;
+  }
+
+  level_driver driver = {replay_next_key, player, false, false, backend};
+  set_level_driver(&driver);
+  seed_game_rng(rp->seed, true);
+  player->deadline_ns = timeInNanoseconds();
+  int status = 0;
+  *score = run_level(&local_game, &lvl, &status);
+  set_level_driver(NULL);
+  return 0;
+}
+
+/// @brief Play a replay file, in the terminal or fast forward without rendering
+/// @param opts Playback options
+/// @param report Stream the fast forward summary is written to
+/// @return Error code
+int play_replay(const replay_options *opts, FILE *report) {
+  replay rp;
+  if (replay_load(&rp, opts->path) != 0) {
+    fprintf(stderr, "Cannot read replay %s.\n", opts->path);
+    return -1;
+  }
+
+  replay_player player = {&rp, 0, 0, !opts->fast_forward, opts->fast_forward, opts->speed, 0};
+  int err = 0;
+  int score = 0;
+  long long start = timeInNanoseconds();
+  if (opts->fast_forward) {
+    err = load_settings();
+    audio_set_enabled(false);
+    if (err == 0)
+      err = replay_run(&rp, &player, RENDER_BACKEND_NONE, &score);
+  } else if (init_screen() != 0) {
+    fprintf(stderr, "Failed to initialize screen.\n");
+    err = -1;
+  } else {
+    err = replay_run(&rp, &player, RENDER_BACKEND_NCURSES, &score);
+    endwin();
+  }
+  long long wall_ns = timeInNanoseconds() - start;
+
+  if (err == 0 && opts->fast_forward) {
+    run_metrics metrics = get_last_run_metrics();
+    fprintf(report, "{\n  \"mode\": \"replay\",\n  \"level\": %d,\n  \"seed\": %llu,\n",
+            rp.levelnum, (unsigned long long)rp.seed);
+    fprintf(report, "  \"ticks\": %ld,\n  \"events\": %zu,\n  \"bytes\": %zu,\n", rp.ticks,
+            rp.count, replay_encode(&rp, NULL, 0));
+    fprintf(report, "  \"score\": %d,\n  \"recorded_score\": %d,\n  \"matches\": %s,\n", score,
+            rp.score, score == rp.score ? "true" : "false");
+    fprintf(report, "  \"pipes_passed\": %d,\n  \"collisions\": %d,\n  \"jumps\": %d,\n",
+            metrics.pipes_passed, metrics.collisions, metrics.jumps);
+    fprintf(report, "  \"wall_s\": %.6f\n}\n", (double)wall_ns / 1e9);
+  }
+  replay_free(&rp);
+  return err;
+}
+
+/// @brief Play a replay at full speed on the already initialized screen without pacing or
+/// playback keys, every frame is drawn
+/// @param rp Loaded replay
+/// @param score Score the run reached
+/// @return Error code
+int replay_render(const replay *rp, int *score) {
+  replay_player player = {rp, 0, 0, false, false, 1.0, 0};
+  return replay_run(rp, &player, RENDER_BACKEND_NULL, score);
+}
+
+/// @brief Watch a replay on the already initialized screen, used by the menu
+/// @param path Replay file
+/// @return Error code, -1 if there is no replay
+int watch_replay(const char *path) {
+  replay rp;
+  if (replay_load(&rp, path) != 0)
+    return -1;
+  replay_player player = {&rp, 0, 0, true, false, 1.0, 0};
+  int score = 0;
+  int err = replay_run(&rp, &player, RENDER_BACKEND_NCURSES, &score);
+  replay_free(&rp);
+  return err;
+}
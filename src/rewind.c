@@ -0,0 +1,54 @@
+// Copyright 2022 <Maros Varchola - mvarchdev>
+
+#include "flappybird/rewind.h"
+
+/// @brief Drop every snapshot, used when a new life starts
+/// @param ring Ring
+void rewind_reset(rewind_ring *ring) {
+  ring->newest = REWIND_SLOTS - 1;
+  ring->count = 0;
+}
+
+/// @brief Take a snapshot if the frame is due, called at the start of every frame
+/// @param ring Ring
+/// @param sim World at the start of the frame
+/// @param score Score at the start of the frame
+/// @param frame Frame of the timeline
+/// @return True if a snapshot was taken
+bool rewind_record(rewind_ring *ring, const sim_state *sim, int score, long frame) {
+  if (frame % REWIND_SNAPSHOT_FRAMES != 0)
+    return false;
+  if (ring->count > 0 && ring->slots[ring->newest].frame == frame)
+    return false;
+  ring->newest = (ring->newest + 1) % REWIND_SLOTS;
+  if (ring->count < REWIND_SLOTS)
+    ring->count++;
+  game_snapshot *snap = &ring->slots[ring->newest];
+  snap->sim = *sim;
+  snap->score = score;
+  snap->frame = frame;
+  return true;
+}
+
+/// @brief Go back to the newest snapshot at or before a frame, or to the oldest one kept.
+/// Newer snapshots are dropped, the restored one stays so the next rewind can start from it.
+/// Run metrics are not rewound, they count everything that was played.
+/// @param ring Ring
+/// @param target_frame Frame to go back to
+/// @param sim World to overwrite
+/// @param score Score to overwrite
+/// @return Frame of the restored snapshot, -1 if the ring is empty
+long rewind_restore(rewind_ring *ring, long target_frame, sim_state *sim, int *score) {
+  if (ring->count == 0)
+    return -1;
+  while (ring->count > 1 && ring->slots[ring->newest].frame > target_frame) {
+    ring->newest = (ring->newest + REWIND_SLOTS - 1) % REWIND_SLOTS;
+    ring->count--;
+  }
+  const game_snapshot *snap = &ring->slots[ring->newest];
+  run_metrics metrics = sim->metrics;
+  *sim = snap->sim;
+  sim->metrics = metrics;
+  *score = snap->score;
+  return snap->frame;
+}
@@ -0,0 +1,267 @@
+// Copyright 2022 <Maros Varchola - mvarchdev>
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "flappybird/savestate.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/// @brief Bytes of the magic.
+#define SAVESTATE_MAGIC_LEN 4
+
+/// @brief Write an unsigned value of 1 to 8 bytes, little endian
+static size_t put_uint(uint8_t *buf, size_t size, size_t pos, uint64_t value, int bytes) {
+  for (int i = 0; i < bytes; i++, pos++) {
+    if (pos < size)
+      buf[pos] = (uint8_t)(value >> (8 * i));
+  }
+  return pos;
+}
+
+static size_t put_float(uint8_t *buf, size_t size, size_t pos, float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return put_uint(buf, size, pos, bits, 4);
+}
+
+/// @brief Cursor over an encoded save-state, a read past the end sets the error flag.
+typedef struct save_reader {
+  const uint8_t *buf;
+  size_t size;
+  size_t pos;
+  bool failed;
+} save_reader;
+
+static uint64_t get_uint(save_reader *rd, int bytes) {
+  if (rd->size - rd->pos < (size_t)bytes) {
+    rd->failed = true;
+    return 0;
+  }
+  uint64_t value = 0;
+  for (int i = 0; i < bytes; i++) value |= (uint64_t)rd->buf[rd->pos++] << (8 * i);
+  return value;
+}
+
+static int32_t get_int32(save_reader *rd) { return (int32_t)(uint32_t)get_uint(rd, 4); }
+
+static float get_float(save_reader *rd) {
+  uint32_t bits = (uint32_t)get_uint(rd, 4);
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+/// @brief Encode a save-state: fixed-width header, world and bird, the random streams, the
+/// enabled pipes with their slots, then the replay of the run
+/// @param save Save-state
+/// @param buf Output buffer, may be NULL to get the size only
+/// @param size Size of the output buffer
+/// @return Encoded size, larger than size if the buffer is too small
+size_t savestate_encode(const run_save *save, uint8_t *buf, size_t size) {
+  size_t pos = 0;
+  for (; pos < SAVESTATE_MAGIC_LEN; pos++) {
+    if (pos < size)
+      buf[pos] = (uint8_t)SAVESTATE_MAGIC[pos];
+  }
+  const sim_state *sim = &save->sim;
+  pos = put_uint(buf, size, pos, (uint32_t)save->levelnum, 4);
+  pos = put_uint(buf, size, pos, (uint32_t)save->lives, 4);
+  pos = put_uint(buf, size, pos, (uint32_t)save->score, 4);
+  pos = put_uint(buf, size, pos, (uint64_t)save->tick, 8);
+
+  pos = put_uint(buf, size, pos, (uint64_t)sim->clock, 8);
+  pos = put_uint(buf, size, pos, (uint64_t)sim->last_speed_time, 8);
+  pos = put_uint(buf, size, pos, (uint64_t)sim->speed_ms, 8);
+  pos = put_uint(buf, size, pos, (uint32_t)sim->speed_chars, 4);
+  pos = put_uint(buf, size, pos, (uint64_t)sim->last_move_time, 8);
+  pos = put_uint(buf, size, pos, (uint64_t)sim->scroll, 8);
+  pos = put_float(buf, size, pos, sim->gravity_constant);
+  pos = put_uint(buf, size, pos, (uint32_t)sim->score_streak, 4);
+  pos = put_uint(buf, size, pos, (uint32_t)sim->score_multiplier, 4);
+  const run_metrics *m = &sim->metrics;
+  int metrics[] = {m->jumps,  m->collisions,     m->pipes_passed,
+                   m->pauses, m->highest_streak, m->highest_multiplier};
+  for (size_t i = 0; i < sizeof(metrics) / sizeof(metrics[0]); i++)
+    pos = put_uint(buf, size, pos, (uint32_t)metrics[i], 4);
+
+  const bird *b = &sim->bird;
+  pos = put_uint(buf, size, pos, (uint32_t)b->gravity, 4);
+  pos = put_uint(buf, size, pos, (uint32_t)b->jump_speed, 4);
+  pos = put_uint(buf, size, pos, (uint32_t)b->colorbits, 4);
+  pos = put_uint(buf, size, pos, (uint32_t)b->act_speed, 4);
+  pos = put_uint(buf, size, pos, (uint32_t)b->act_position, 4);
+  pos = put_uint(buf, size, pos, (uint64_t)b->last_time_ms, 8);
+
+  pos = put_uint(buf, size, pos, sim->rng.seed, 8);
+  for (int s = 0; s < RNG_STREAM_COUNT; s++)
+    for (int i = 0; i < 4; i++) pos = put_uint(buf, size, pos, sim->rng.streams[s].s[i], 8);
+
+  int enabled = 0;
+  for (int i = 0; i < MAX_PIPES; i++) enabled += sim->pipes[i].enabled;
+  pos = put_uint(buf, size, pos, (uint64_t)enabled, 1);
+  for (int i = 0; i < MAX_PIPES; i++) {
+    const fbpipe *p = &sim->pipes[i];
+    if (!p->enabled)
+      continue;
+    pos = put_uint(buf, size, pos, (uint64_t)i, 1);
+    pos = put_uint(buf, size, pos, (uint32_t)p->pipewidth, 4);
+    pos = put_uint(buf, size, pos, (uint32_t)p->position, 4);
+    pos = put_uint(buf, size, pos, (uint32_t)p->upheight, 4);
+    pos = put_uint(buf, size, pos, (uint32_t)p->downheight, 4);
+  }
+
+  size_t replay_size = replay_encode(&save->rp, NULL, 0);
+  pos = put_uint(buf, size, pos, replay_size, 4);
+  if (pos <= size && replay_size <= size - pos)
+    replay_encode(&save->rp, buf + pos, replay_size);
+  return pos + replay_size;
+}
+
+/// @brief Decode a save-state produced by savestate_encode
+/// @param save Save-state to fill, free it with savestate_free
+/// @param buf Encoded save-state
+/// @param size Size of the encoded save-state
+/// @return Error code
+int savestate_decode(run_save *save, const uint8_t *buf, size_t size) {
+  memset(save, 0, sizeof(*save));
+  if (size < SAVESTATE_MAGIC_LEN || memcmp(buf, SAVESTATE_MAGIC, SAVESTATE_MAGIC_LEN) != 0)
+    return -1;
+
+  save_reader rd = {buf, size, SAVESTATE_MAGIC_LEN, false};
+  sim_state *sim = &save->sim;
+  save->levelnum = get_int32(&rd);
+  save->lives = get_int32(&rd);
+  save->score = get_int32(&rd);
+  save->tick = (long)get_uint(&rd, 8);
+
+  sim->clock = (long long)get_uint(&rd, 8);
+  sim->last_speed_time = (long long)get_uint(&rd, 8);
+  sim->speed_ms = (long long)get_uint(&rd, 8);
+  sim->speed_chars = get_int32(&rd);
+  sim->last_move_time = (long long)get_uint(&rd, 8);
+  sim->scroll = (long long)get_uint(&rd, 8);
+  sim->gravity_constant = get_float(&rd);
+  sim->score_streak = get_int32(&rd);
+  sim->score_multiplier = get_int32(&rd);
+  run_metrics *m = &sim->metrics;
+  m->jumps = get_int32(&rd);
+  m->collisions = get_int32(&rd);
+  m->pipes_passed = get_int32(&rd);
+  m->pauses = get_int32(&rd);
+  m->highest_streak = get_int32(&rd);
+  m->highest_multiplier = get_int32(&rd);
+
+  bird *b = &sim->bird;
+  b->gravity = get_int32(&rd);
+  b->jump_speed = get_int32(&rd);
+  b->colorbits = get_int32(&rd);
+  b->act_speed = get_int32(&rd);
+  b->act_position = get_int32(&rd);
+  b->last_time_ms = (long long)get_uint(&rd, 8);
+
+  sim->rng.seed = get_uint(&rd, 8);
+  for (int s = 0; s < RNG_STREAM_COUNT; s++)
+    for (int i = 0; i < 4; i++) sim->rng.streams[s].s[i] = get_uint(&rd, 8);
+
+  int enabled = (int)get_uint(&rd, 1);
+  for (int n = 0; n < enabled && !rd.failed; n++) {
+    uint64_t slot = get_uint(&rd, 1);
+    if (slot >= MAX_PIPES || sim->pipes[slot].enabled)
+      return -1;
+    fbpipe *p = &sim->pipes[slot];
+    p->pipewidth = get_int32(&rd);
+    p->position = get_int32(&rd);
+    p->upheight = get_int32(&rd);
+    p->downheight = get_int32(&rd);
+    p->enabled = true;
+  }
+
+  size_t replay_size = (size_t)get_uint(&rd, 4);
+  if (rd.failed || replay_size != size - rd.pos || save->lives <= 0)
+    return -1;
+  return replay_decode(&save->rp, buf + rd.pos, replay_size);
+}
+
+/// @brief Write a save-state file in one write to a temporary file that replaces the old one,
+/// so a crash leaves either the old or the new file
+/// @param save Save-state
+/// @param path File path
+/// @return Error code
+int savestate_save(const run_save *save, const char *path) {
+  size_t size = savestate_encode(save, NULL, 0);
+  uint8_t *buf = malloc(size);
+  if (buf == NULL)
+    return -1;
+  savestate_encode(save, buf, size);
+
+  char tmp_path[512] = {0};
+  int err = -1;
+  if ((size_t)snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path) < sizeof(tmp_path)) {
+    FILE *fp = fopen(tmp_path, "wb");
+    if (fp != NULL) {
+      bool written = fwrite(buf, 1, size, fp) == size && fflush(fp) == 0 && fsync(fileno(fp)) == 0;
+      err = fclose(fp) == 0 && written ? 0 : -1;
+      if (err == 0)
+        err = rename(tmp_path, path);
+      if (err != 0)
+        remove(tmp_path);
+    }
+  }
+  free(buf);
+  return err;
+}
+
+/// @brief Read a save-state file
+/// @param save Save-state to fill, free it with savestate_free
+/// @param path File path
+/// @return Error code
+int savestate_load(run_save *save, const char *path) {
+  memset(save, 0, sizeof(*save));
+  FILE *fp = fopen(path, "rb");
+  if (fp == NULL)
+    return -1;
+  long length = fseek(fp, 0, SEEK_END) == 0 ? ftell(fp) : -1;
+  uint8_t *buf = NULL;
+  if (length <= 0 || length > SAVESTATE_MAX_BYTES || fseek(fp, 0, SEEK_SET) != 0 ||
+      (buf = malloc((size_t)length)) == NULL) {
+    fclose(fp);
+    return -1;
+  }
+  size_t size = fread(buf, 1, (size_t)length, fp);
+  fclose(fp);
+  int err = savestate_decode(save, buf, size);
+  free(buf);
+  if (err != 0)
+    savestate_free(save);
+  return err;
+}
+
+void savestate_free(run_save *save) {
+  replay_free(&save->rp);
+  memset(save, 0, sizeof(*save));
+}
+
+/// @brief Build the save-state path of a player and create its directory, the nickname is hex
+/// encoded like in hall of fame replay names
+/// @param buf Output buffer
+/// @param size Size of the output buffer
+/// @param nickname Player nickname
+/// @return Error code, -1 if the buffer is too small
+int savestate_path(char *buf, size_t size, const char *nickname) {
+  if (mkdir(SAVESTATE_DIR, 0755) != 0 && errno != EEXIST)
+    return -1;
+  int pos = snprintf(buf, size, "%s/", SAVESTATE_DIR);
+  if (pos < 0)
+    return -1;
+  for (const unsigned char *ch = (const unsigned char *)nickname; *ch; ch++) {
+    if ((size_t)pos + 2 >= size)
+      return -1;
+    pos += snprintf(buf + pos, size - (size_t)pos, "%02x", *ch);
+  }
+  return (size_t)snprintf(buf + pos, size - (size_t)pos, ".fbs") < size - (size_t)pos ? 0 : -1;
+}
@@ -0,0 +1,629 @@
+// Copyright 2022 <Maros Varchola - mvarchdev>
+
+#define _GNU_SOURCE
+
+#include "flappybird/server.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/timerfd.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "flappybird/common_tools.h"
+#include "flappybird/game_context.h"
+#include "flappybird/sim.h"
+#include "flappybird/sprite.h"
+
+/// @brief Time a crashed bird stays on screen before the next life.
+#define SERVER_CRASH_MS 1000
+/// @brief Events taken from epoll at once.
+#define SERVER_EVENTS 256
+/// @brief Epoll tags of the listening socket and the frame timer. Sessions use their index in
+/// the low half and the generation of the slot in the high half.
+#define SERVER_TAG_LISTEN UINT64_MAX
+#define SERVER_TAG_TIMER (UINT64_MAX - 1)
+/// @brief Terminal type of the off-screen curses screen the sessions are drawn on.
+#define SERVER_TERM_TYPE "xterm"
+
+typedef enum session_phase {
+  SESSION_LOBBY,
+  SESSION_PLAYING,
+  SESSION_PAUSED,
+  SESSION_CRASHED,
+  SESSION_OVER
+} session_phase;
+
+/// @brief One connected player, everything a game needs lives here.
+typedef struct game_session {
+  int fd;
+  session_phase phase;
+  int level_index;
+  int lives;
+  int score;
+  long long wait_ms;
+  /// World of the game, drawn by the shared renderer into the map window of the server.
+  game_context game;
+  unsigned char keys[SERVER_KEY_QUEUE];
+  int key_count;
+  /// Quit was pressed, the session closes after this frame.
+  bool closing;
+  /// Screen of the current frame and the screen the client shows.
+  char screen[SERVER_SCREEN_ROWS][SERVER_SCREEN_COLS];
+  char shown[SERVER_SCREEN_ROWS][SERVER_SCREEN_COLS];
+  bool repaint;
+  char out[SERVER_OUT_BUFFER];
+  size_t out_len;
+  size_t out_sent;
+  bool want_write;
+  /// Next unused slot while this one is unused.
+  int next_free;
+  /// Bumped when the slot is closed, events queued for the old client no longer match.
+  uint32_t generation;
+} game_session;
+
+/// @brief Reactor state, sessions are a fixed pool with a free list.
+typedef struct game_server {
+  int epfd;
+  int listen_fd;
+  int timer_fd;
+  /// Off-screen curses screen and the map window every session is drawn into in turn.
+  SCREEN *screen;
+  FILE *screen_out;
+  FILE *screen_in;
+  WINDOW *map;
+  game_session *sessions;
+  int max_sessions;
+  int free_head;
+  int active;
+  level levels[SERVER_MAX_LEVELS];
+  int level_count;
+  long long frame_ms;
+  float gravity_constant;
+  prng seeds;
+  long long accepted;
+  long long rejected;
+  int peak;
+  long long ticks;
+  long long late_ticks;
+  long long busy_ticks;
+  long long session_frames;
+  long long tick_ns;
+  unsigned long long bytes;
+} game_server;
+
+static volatile sig_atomic_t server_stop = 0;
+
+static void request_stop(int sig) { server_stop = 1; }
+
+/// @brief Parse server arguments
+/// @param argc Argument count
+/// @param argv Arguments
+/// @param opts Options to fill
+/// @return 0 on success, -1 if the arguments are not a server
+int server_parse_args(int argc, char *argv[], server_options *opts) {
+  memset(opts, 0, sizeof(*opts));
+  opts->max_sessions = SERVER_DEFAULT_SESSIONS;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+      opts->socket_path = argv[++i];
+    } else if (strcmp(argv[i], "--max-sessions") == 0 && i + 1 < argc) {
+      opts->max_sessions = atoi(argv[++i]);
+    } else {
+      return -1;
+    }
+  }
+  if (opts->socket_path == NULL || opts->max_sessions <= 0 ||
+      opts->max_sessions > SERVER_MAX_SESSIONS)
+    return -1;
+  return 0;
+}
+
+static void put(game_session *s, int y, int x, char ch) {
+  if (y >= 0 && y < MAPSIZEY && x >= 0 && x < MAPSIZEX)
+    s->screen[y + 2][x + 1] = ch;
+}
+
+/// @brief Write text into a screen row, clipped to the map
+static void put_text(game_session *s, int y, int x, const char *text) {
+  for (; *text; text++, x++) put(s, y, x, *text);
+}
+
+/// @brief Write text centered in a map row
+static void put_center(game_session *s, int y, const char *text) {
+  put_text(s, y, (MAPSIZEX - (int)strlen(text)) / 2, text);
+}
+
+/// @brief Take the map the shared renderer drew into the text screen of a session
+static void take_map(const game_server *srv, game_session *s) {
+  chtype row[MAPSIZEX + 1];
+  for (int y = 0; y < MAPSIZEY; y++) {
+    mvwinchnstr(srv->map, y, 0, row, MAPSIZEX);
+    for (int x = 0; x < MAPSIZEX; x++) s->screen[y + 2][x + 1] = (char)(row[x] & A_CHARTEXT);
+  }
+}
+
+static void draw_lobby(const game_server *srv, game_session *s) {
+  char line[MAPSIZEX + 1] = {0};
+  put_center(s, 3, "F L A P P Y   B I R D");
+  put_center(s, 5, "Choose a level");
+  for (int i = 0; i < srv->level_count; i++) {
+    snprintf(line, sizeof(line), "%d  %-30s", i + 1, srv->levels[i].levelname);
+    put_center(s, 7 + i, line);
+  }
+  snprintf(line, sizeof(line), "Press 1-%d to play. Space jumps, P pauses, Q quits.",
+           srv->level_count);
+  put_center(s, 9 + srv->level_count, line);
+}
+
+/// @brief Build the text screen of a session
+static void draw_session(game_server *srv, game_session *s) {
+  memset(s->screen, ' ', sizeof(s->screen));
+  for (int x = 0; x < SERVER_SCREEN_COLS; x++) {
+    s->screen[1][x] = '-';
+    s->screen[SERVER_SCREEN_ROWS - 1][x] = '-';
+  }
+  for (int y = 2; y < SERVER_SCREEN_ROWS - 1; y++) {
+    s->screen[y][0] = '|';
+    s->screen[y][SERVER_SCREEN_COLS - 1] = '|';
+  }
+
+  char header[SERVER_SCREEN_COLS + 1] = {0};
+  if (s->phase == SESSION_LOBBY) {
+    snprintf(header, sizeof(header), " Flappy Bird server, %d players online", srv->active);
+    memcpy(s->screen[0], header, strlen(header));
+    draw_lobby(srv, s);
+    return;
+  }
+
+  level *lvl = &srv->levels[s->level_index];
+  snprintf(header, sizeof(header), " %s | Score: %d | Lives: %d | x%d | %d players online",
+           lvl->levelname, s->score, s->lives, s->game.sim.score_multiplier, srv->active);
+  memcpy(s->screen[0], header, strlen(header));
+  werase(srv->map);
+  render_pipes(&s->game, lvl);
+  render_bird(&s->game, &s->game.sim.bird, BIRDOFFX, false);
+  take_map(srv, s);
+
+  char message[MAPSIZEX + 1] = {0};
+  if (s->phase == SESSION_PAUSED) {
+    put_center(s, MAPSIZEY / 2, " Paused, press P to continue ");
+  } else if (s->phase == SESSION_CRASHED) {
+    snprintf(message, sizeof(message), " Crashed! %d %s left ", s->lives,
+             s->lives == 1 ? "life" : "lives");
+    put_center(s, MAPSIZEY / 2, message);
+  } else if (s->phase == SESSION_OVER) {
+    snprintf(message, sizeof(message), " Game over, score %d. Space: lobby, Q: quit ", s->score);
+    put_center(s, MAPSIZEY / 2, message);
+  }
+}
+
+static void start_life(const game_server *srv, game_session *s) {
+  sim_clear_pipes(&s->game.sim);
+  s->game.sim.bird = sim_get_bird(&s->game.sim, &srv->levels[s->level_index]);
+  s->game.sim.last_speed_time = 0;
+  s->phase = SESSION_PLAYING;
+}
+
+static void start_run(game_server *srv, game_session *s) {
+  const level *lvl = &srv->levels[s->level_index];
+  sim_reset(&s->game.sim, lvl, prng_next(&srv->seeds));
+  s->lives = lvl->max_lives;
+  s->score = 0;
+  start_life(srv, s);
+}
+
+/// @brief Apply the keys of a frame and advance the game by one frame
+static void session_tick(game_server *srv, game_session *s) {
+  bool jump = false;
+  for (int i = 0; i < s->key_count; i++) {
+    int ch = tolower(s->keys[i]);
+    if (ch == 'q') {
+      s->closing = true;
+    } else if (s->phase == SESSION_LOBBY && ch >= '1' && ch < '1' + srv->level_count) {
+      s->level_index = ch - '1';
+      start_run(srv, s);
+    } else if (s->phase == SESSION_PLAYING && ch == ' ') {
+      jump = true;
+    } else if (s->phase == SESSION_PLAYING && ch == 'p') {
+      s->phase = SESSION_PAUSED;
+      s->game.sim.metrics.pauses++;
+    } else if (s->phase == SESSION_PAUSED && (ch == 'p' || ch == ' ')) {
+      sim_resume(&s->game.sim, &s->game.sim.bird);
+      s->phase = SESSION_PLAYING;
+    } else if (s->phase == SESSION_OVER && (ch == ' ' || ch == '\r' || ch == '\n')) {
+      s->phase = SESSION_LOBBY;
+    }
+  }
+  s->key_count = 0;
+
+  if (s->phase == SESSION_PLAYING) {
+    // One jump per frame like run_level, extra presses of the frame are dropped.
+    if (jump) {
+      jump_bird(&s->game.sim.bird);
+      s->game.sim.metrics.jumps++;
+    }
+    int points = sim_step(&s->game.sim, &srv->levels[s->level_index], srv->frame_ms);
+    if (points < 0) {
+      s->lives--;
+      s->phase = s->lives > 0 ? SESSION_CRASHED : SESSION_OVER;
+      s->wait_ms = SERVER_CRASH_MS;
+    } else {
+      s->score += points;
+    }
+  } else if (s->phase == SESSION_CRASHED) {
+    s->wait_ms -= srv->frame_ms;
+    if (s->wait_ms <= 0)
+      start_life(srv, s);
+  }
+}
+
+static void append(game_session *s, const char *data, size_t len) {
+  memcpy(s->out + s->out_len, data, len);
+  s->out_len += len;
+}
+
+/// @brief Queue the rows that changed since the last frame the client got. A client that has
+/// not taken the previous frame yet skips this one, the next diff covers both.
+static void queue_frame(game_session *s) {
+  if (s->out_sent < s->out_len)
+    return;
+  s->out_len = 0;
+  s->out_sent = 0;
+  char move[32] = {0};
+  for (int row = 0; row < SERVER_SCREEN_ROWS; row++) {
+    const char *now = s->screen[row];
+    const char *old = s->shown[row];
+    int first = 0;
+    int last = SERVER_SCREEN_COLS - 1;
+    if (!s->repaint) {
+      while (first <= last && now[first] == old[first]) first++;
+      if (first > last)
+        continue;
+      while (now[last] == old[last]) last--;
+    }
+    int len = snprintf(move, sizeof(move), "\x1b[%d;%dH", row + 1, first + 1);
+    append(s, move, (size_t)len);
+    append(s, now + first, (size_t)(last - first + 1));
+  }
+  memcpy(s->shown, s->screen, sizeof(s->shown));
+  s->repaint = false;
+}
+
+static uint64_t session_tag(const game_server *srv, const game_session *s) {
+  return (uint64_t)s->generation << 32 | (uint64_t)(s - srv->sessions);
+}
+
+static int watch_session(game_server *srv, game_session *s, uint32_t events) {
+  struct epoll_event ev = {.events = events, .data.u64 = session_tag(srv, s)};
+  return epoll_ctl(srv->epfd, EPOLL_CTL_MOD, s->fd, &ev);
+}
+
+/// @brief Send pending output without blocking, waits for EPOLLOUT when the socket is full
+/// @return False if the connection is broken
+static bool flush_session(game_server *srv, game_session *s) {
+  while (s->out_sent < s->out_len) {
+    ssize_t n = send(s->fd, s->out + s->out_sent, s->out_len - s->out_sent, MSG_NOSIGNAL);
+    if (n > 0) {
+      s->out_sent += (size_t)n;
+      srv->bytes += (unsigned long long)n;
+    } else if (n < 0 && errno == EINTR) {
+      continue;
+    } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      if (!s->want_write && watch_session(srv, s, EPOLLIN | EPOLLOUT | EPOLLRDHUP) == 0)
+        s->want_write = true;
+      return true;
+    } else {
+      return false;
+    }
+  }
+  if (s->want_write && watch_session(srv, s, EPOLLIN | EPOLLRDHUP) == 0)
+    s->want_write = false;
+  return true;
+}
+
+static void close_session(game_server *srv, game_session *s) {
+  close(s->fd);
+  s->fd = -1;
+  s->generation++;
+  s->next_free = srv->free_head;
+  srv->free_head = (int)(s - srv->sessions);
+  srv->active--;
+}
+
+/// @brief Restore the client terminal and close the session
+static void end_session(game_server *srv, game_session *s) {
+  static const char restore[] = "\x1b[2J\x1b[H\x1b[?25h\x1b[?1049l";
+  if (s->out_sent == s->out_len) {
+    s->out_len = 0;
+    s->out_sent = 0;
+  }
+  if (s->out_len + sizeof(restore) - 1 <= sizeof(s->out))
+    append(s, restore, sizeof(restore) - 1);
+  // Best effort, the client restores its terminal on hangup anyway.
+  send(s->fd, s->out + s->out_sent, s->out_len - s->out_sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+  close_session(srv, s);
+}
+
+static void accept_sessions(game_server *srv) {
+  while (true) {
+    int fd = accept4(srv->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0)
+      return;
+    if (srv->free_head < 0) {
+      static const char full[] = "Server full, try again later.\r\n";
+      send(fd, full, sizeof(full) - 1, MSG_NOSIGNAL | MSG_DONTWAIT);
+      close(fd);
+      srv->rejected++;
+      continue;
+    }
+
+    int index = srv->free_head;
+    game_session *s = &srv->sessions[index];
+    srv->free_head = s->next_free;
+    uint32_t generation = s->generation;
+    memset(s, 0, sizeof(*s));
+    s->generation = generation;
+    s->fd = fd;
+    s->repaint = true;
+    game_context_init(&s->game, srv->gravity_constant);
+    s->game.win = srv->map;
+    struct epoll_event ev = {.events = EPOLLIN | EPOLLRDHUP, .data.u64 = session_tag(srv, s)};
+    if (epoll_ctl(srv->epfd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+      srv->active++;
+      close_session(srv, s);
+      continue;
+    }
+    srv->active++;
+    srv->accepted++;
+    if (srv->active > srv->peak)
+      srv->peak = srv->active;
+    static const char init[] = "\x1b[?1049h\x1b[?25l\x1b[2J";
+    append(s, init, sizeof(init) - 1);
+  }
+}
+
+/// @brief Take the keys a client sent, keys beyond the queue of a frame are dropped
+/// @return False if the client hung up
+static bool read_keys(game_session *s) {
+  unsigned char buf[64];
+  while (true) {
+    ssize_t n = recv(s->fd, buf, sizeof(buf), 0);
+    if (n == 0)
+      return false;
+    if (n < 0)
+      return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    for (ssize_t i = 0; i < n && s->key_count < SERVER_KEY_QUEUE; i++)
+      s->keys[s->key_count++] = buf[i];
+  }
+}
+
+/// @brief Advance, draw and send every session
+static void server_tick(game_server *srv) {
+  srv->ticks++;
+  if (srv->active == 0)
+    return;
+  long long start = timeInNanoseconds();
+  for (int i = 0; i < srv->max_sessions; i++) {
+    game_session *s = &srv->sessions[i];
+    if (s->fd < 0)
+      continue;
+    session_tick(srv, s);
+    if (s->closing) {
+      end_session(srv, s);
+      continue;
+    }
+    draw_session(srv, s);
+    queue_frame(s);
+    srv->session_frames++;
+    if (!flush_session(srv, s))
+      close_session(srv, s);
+  }
+  srv->busy_ticks++;
+  srv->tick_ns += timeInNanoseconds() - start;
+}
+
+/// @brief Bind the listening socket, a stale socket file nobody listens on is replaced
+static int open_listener(const char *path) {
+  struct sockaddr_un addr = {.sun_family = AF_UNIX};
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    fprintf(stderr, "Socket path %s is too long.\n", path);
+    return -1;
+  }
+  snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+
+  struct stat st;
+  if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+    int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (probe >= 0 && connect(probe, (struct sockaddr *)&addr, sizeof(addr)) != 0 &&
+        errno == ECONNREFUSED)
+      unlink(path);
+    if (probe >= 0)
+      close(probe);
+  }
+
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+    return -1;
+  if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, SOMAXCONN) != 0) {
+    fprintf(stderr, "Cannot listen on %s: %s\n", path, strerror(errno));
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+static int open_timer(long long frame_ms) {
+  int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (fd < 0)
+    return -1;
+  struct timespec period = {(time_t)(frame_ms / 1000), (long)(frame_ms % 1000) * 1000000L};
+  struct itimerspec spec = {period, period};
+  if (timerfd_settime(fd, 0, &spec, NULL) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+/// @brief Open the off-screen curses screen and the map window the sessions are drawn into
+static int open_map(game_server *srv) {
+  srv->screen_out = fopen("/dev/null", "w");
+  srv->screen_in = fopen("/dev/null", "r");
+  if (srv->screen_out == NULL || srv->screen_in == NULL)
+    return -1;
+  srv->screen = newterm(SERVER_TERM_TYPE, srv->screen_out, srv->screen_in);
+  if (srv->screen == NULL)
+    return -1;
+  set_term(srv->screen);
+  srv->map = newpad(MAPSIZEY, MAPSIZEX);
+  return srv->map ? 0 : -1;
+}
+
+static void close_map(game_server *srv) {
+  if (srv->map)
+    delwin(srv->map);
+  if (srv->screen) {
+    endwin();
+    delscreen(srv->screen);
+  }
+  if (srv->screen_out)
+    fclose(srv->screen_out);
+  if (srv->screen_in)
+    fclose(srv->screen_in);
+}
+
+static int watch_fd(int epfd, int fd, uint64_t tag) {
+  struct epoll_event ev = {.events = EPOLLIN, .data.u64 = tag};
+  return epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+static void handle_event(game_server *srv, const struct epoll_event *ev) {
+  if (ev->data.u64 == SERVER_TAG_LISTEN) {
+    accept_sessions(srv);
+    return;
+  }
+  if (ev->data.u64 == SERVER_TAG_TIMER) {
+    uint64_t expirations = 0;
+    if (read(srv->timer_fd, &expirations, sizeof(expirations)) != sizeof(expirations))
+      return;
+    // A late reactor plays one frame per wakeup, the games slow down instead of jumping.
+    if (expirations > 1)
+      srv->late_ticks += (long long)(expirations - 1);
+    server_tick(srv);
+    return;
+  }
+
+  // A slot closed and reused earlier in this batch still has events of its old client queued.
+  game_session *s = &srv->sessions[(uint32_t)ev->data.u64];
+  if (s->fd < 0 || s->generation != (uint32_t)(ev->data.u64 >> 32))
+    return;
+  bool alive = !(ev->events & (EPOLLERR | EPOLLHUP));
+  if (alive && (ev->events & (EPOLLIN | EPOLLRDHUP)))
+    alive = read_keys(s);
+  if (alive && (ev->events & EPOLLOUT))
+    alive = flush_session(srv, s);
+  if (!alive)
+    close_session(srv, s);
+}
+
+static void print_report(const game_server *srv, FILE *out) {
+  fprintf(out, "{\n  \"mode\": \"server\",\n  \"sessions_served\": %lld,\n", srv->accepted);
+  fprintf(out, "  \"sessions_rejected\": %lld,\n  \"peak_sessions\": %d,\n", srv->rejected,
+          srv->peak);
+  fprintf(out, "  \"session_bytes\": %zu,\n  \"ticks\": %lld,\n  \"late_ticks\": %lld,\n",
+          sizeof(game_session), srv->ticks, srv->late_ticks);
+  fprintf(out, "  \"session_frames\": %lld,\n  \"bytes_sent\": %llu,\n", srv->session_frames,
+          srv->bytes);
+  fprintf(out, "  \"tick_us\": %.1f,\n  \"session_frame_ns\": %.1f\n}\n",
+          srv->busy_ticks ? (double)srv->tick_ns / 1e3 / (double)srv->busy_ticks : 0,
+          srv->session_frames ? (double)srv->tick_ns / (double)srv->session_frames : 0);
+}
+
+/// @brief Open the levels offered in the lobby
+static int load_levels(game_server *srv) {
+  while (srv->level_count < SERVER_MAX_LEVELS) {
+    level lvl = load_level_file(srv->level_count + 1);
+    if (!lvl.loaded)
+      break;
+    srv->levels[srv->level_count++] = lvl;
+  }
+  return srv->level_count > 0 ? 0 : -1;
+}
+
+/// @brief Host game sessions for terminal clients on a Unix socket. One epoll reactor accepts
+/// clients, reads their keys and plays every session one frame per timer tick. Runs until
+/// SIGINT or SIGTERM.
+/// @param opts Server options
+/// @param report Stream the JSON report is written to on shutdown
+/// @return Error code
+int run_server(const server_options *opts, FILE *report) {
+  game_server srv;
+  memset(&srv, 0, sizeof(srv));
+  srv.epfd = srv.listen_fd = srv.timer_fd = -1;
+  if (load_settings() != 0 || frame_period_ms() <= 0 || load_levels(&srv) != 0) {
+    fprintf(stderr, "Cannot load settings or levels.\n");
+    return -1;
+  }
+  srv.frame_ms = frame_period_ms();
+  srv.gravity_constant = local_game.sim.gravity_constant;
+  prng_seed(&srv.seeds, (uint64_t)timeInNanoseconds());
+
+  srv.max_sessions = opts->max_sessions;
+  srv.sessions = calloc((size_t)srv.max_sessions, sizeof(*srv.sessions));
+  if (srv.sessions == NULL)
+    return -1;
+  srv.free_head = -1;
+  for (int i = srv.max_sessions - 1; i >= 0; i--) {
+    srv.sessions[i].fd = -1;
+    srv.sessions[i].next_free = srv.free_head;
+    srv.free_head = i;
+  }
+
+  srv.epfd = epoll_create1(EPOLL_CLOEXEC);
+  srv.listen_fd = open_listener(opts->socket_path);
+  srv.timer_fd = open_timer(srv.frame_ms);
+  int err = open_map(&srv) != 0 || srv.epfd < 0 || srv.listen_fd < 0 || srv.timer_fd < 0 ||
+            watch_fd(srv.epfd, srv.listen_fd, SERVER_TAG_LISTEN) != 0 ||
+            watch_fd(srv.epfd, srv.timer_fd, SERVER_TAG_TIMER) != 0;
+
+  struct sigaction stop = {0};
+  stop.sa_handler = request_stop;
+  sigaction(SIGINT, &stop, NULL);
+  sigaction(SIGTERM, &stop, NULL);
+  if (!err)
+    fprintf(stderr, "Serving on %s, up to %d sessions.\n", opts->socket_path, srv.max_sessions);
+
+  struct epoll_event events[SERVER_EVENTS];
+  while (!err && !server_stop) {
+    int n = epoll_wait(srv.epfd, events, SERVER_EVENTS, -1);
+    if (n < 0 && errno != EINTR)
+      err = 1;
+    for (int i = 0; i < n; i++) handle_event(&srv, &events[i]);
+  }
+
+  for (int i = 0; i < srv.max_sessions; i++)
+    if (srv.sessions[i].fd >= 0)
+      end_session(&srv, &srv.sessions[i]);
+  if (srv.listen_fd >= 0) {
+    close(srv.listen_fd);
+    unlink(opts->socket_path);
+  }
+  if (srv.timer_fd >= 0)
+    close(srv.timer_fd);
+  if (srv.epfd >= 0)
+    close(srv.epfd);
+  close_map(&srv);
+  free(srv.sessions);
+  if (!err)
+    print_report(&srv, report);
+  return err ? -1 : 0;
+}
@@ -0,0 +1,669 @@
+// Copyright 2022 <Maros Varchola - mvarchdev>
+
+#include "flappybird/sim.h"
+
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "flappybird/sprite.h"
+
+/// @brief Fixed-point chars per meter, exact since METERTOCHARS is a power of two.
+#define METERTOCHARS_FIXED ((long long)(METERTOCHARS * FIXED_ONE))
+/// @brief Remainder units of one char of world scroll.
+#define SCROLL_CHAR_UNITS ((long long)FIXED_ONE * 1000)
+
+/// @brief Key of a frame without input, same value as curses ERR.
+#define SIM_NO_KEY EOF
+
+static int sim_tolower(int ch) {
+  if (ch < 0 || ch > 255)
+    return ch;
+  return tolower((unsigned char)ch);
+}
+
+/// @brief Score multiplier of a streak of passed pipes
+/// @param streak Pipes passed since the last collision
+/// @return Multiplier, 1 to 4
+int sim_streak_multiplier(int streak) {
+  int multiplier = 1 + (streak / 5);
+  if (multiplier > 4)
+    multiplier = 4;
+  return multiplier;
+}
+
+/// @brief Prepare an empty world with the clock at its start
+/// @param sim State
+/// @param gravity_constant Gravity constant of the settings
+void sim_init(sim_state *sim, float gravity_constant) {
+  memset(sim, 0, sizeof(*sim));
+  sim->clock = 1;
+  sim->gravity_constant = gravity_constant;
+  sim->score_multiplier = 1;
+}
+
+/// @brief Start a run of a level, the clock keeps running
+/// @param sim State
+/// @param inplvl Level
+/// @param seed Seed of the run, every level gets a course of its own from it
+void sim_reset(sim_state *sim, const level *inplvl, uint64_t seed) {
+  rng_session_init(&sim->rng, seed ^ ((uint64_t)inplvl->levelnumber << 32), 0);
+  sim_clear_pipes(sim);
+  sim->speed_chars = sim_start_speed(inplvl);
+  sim->last_speed_time = 0;
+  sim->speed_ms = 0;
+  sim->score_streak = 0;
+  sim->score_multiplier = 1;
+  memset(&sim->metrics, 0, sizeof(sim->metrics));
+  sim->metrics.highest_multiplier = 1;
+  memset(&sim->endless, 0, sizeof(sim->endless));
+}
+
+/// @brief Turn a freshly reset run into an endless run, call it right after sim_reset
+/// @param sim State
+/// @param inplvl Level, its speeds are converted to whole 1/1000 chars per s once
+void sim_start_endless(sim_state *sim, const level *inplvl) {
+  endless_world *world = &sim->endless;
+  world->enabled = true;
+  world->start_speed = llround(METERTOCHARS * inplvl->endless_start_speed * 1000);
+  world->speed_per_min = llround(METERTOCHARS * inplvl->endless_speed_increase * 1000);
+  world->start_clock = sim->clock;
+  world->last_clock = 0;
+  world->distance = 0;
+  sim->speed_chars = fixed_scale(FIXED_ONE, world->start_speed, 1000);
+}
+
+/// @brief World speed at the start of a level
+/// @param inplvl Level
+/// @return Speed in chars/s
+fixed sim_start_speed(const level *inplvl) {
+  return fixed_from_double(METERTOCHARS * inplvl->start_speed);
+}
+
+/// @brief World speed of an endless run, computed from the time played so far
+static long long endless_speed(const sim_state *sim) {
+  const endless_world *world = &sim->endless;
+  long long played = sim->clock - world->start_clock;
+  if (played > ENDLESS_RAMP_MS)
+    played = ENDLESS_RAMP_MS;
+  return world->start_speed + world->speed_per_min * played / 60000;
+}
+
+/// @brief Get the distance an endless run scrolled
+/// @param sim State
+/// @return Whole chars scrolled since the run started
+long long sim_endless_chars(const sim_state *sim) { return sim->endless.distance / 1000000; }
+
+/// @brief Will disable all enabled pipes
+/// @param sim State
+void sim_clear_pipes(sim_state *sim) {
+  for (int i = 0; i < MAX_PIPES; i++)
+    sim->pipes[i].enabled = false;
+  sim->last_move_time = 0;
+  sim->scroll = 0;
+}
+
+/// @brief Generate bird based on level, without its color
+/// @param sim State
+/// @param inplvl Level struct pointer to use
+/// @return Generated bird structure
+bird sim_get_bird(const sim_state *sim, const level *inplvl) {
+  bird tmpbird = {0};
+  if (!inplvl)
+    return tmpbird;
+
+  tmpbird.act_speed = 0;
+  tmpbird.act_position = fixed_from_int(MAPSIZEY / 2);
+  // Both factors are floats, so their product is exact in a double.
+  tmpbird.gravity = fixed_from_double((double)sim->gravity_constant * inplvl->gravity_multiply);
+  tmpbird.jump_speed = fixed_from_double(inplvl->jump_speed);
+  tmpbird.last_time_ms = sim->clock;
+  return tmpbird;
+}
+
+/// @brief Change speed of bird based jump speed
+/// @param inpb Bird struct pointer to use
+void jump_bird(bird *inpb) {
+  if (!inpb)
+    return;
+
+  fixed max_rise = -(inpb->jump_speed * 3 / 2);
+  if (inpb->act_speed < 0) {
+    if ((inpb->act_speed - inpb->jump_speed) < max_rise)
+      inpb->act_speed = max_rise;
+    else
+      inpb->act_speed -= inpb->jump_speed;
+  } else
+    inpb->act_speed = -inpb->jump_speed;
+}
+
+/// @brief Process/Move bird
+/// @param sim State
+/// @param inpb Bird structure pointer to use
+/// @return Error code
+int sim_move_bird(const sim_state *sim, bird *inpb) { return bird_advance(inpb, sim->clock); }
+
+/// @brief Move bird to a point of the gameplay clock
+/// @param inpb Bird structure pointer to use
+/// @param act_time Gameplay clock in ms
+/// @return Error code
+int bird_advance(bird *inpb, long long act_time) {
+  if (!inpb)
+    return -1;
+
+  if (inpb->last_time_ms == 0) {
+    inpb->last_time_ms = act_time;
+    return 0;
+  }
+
+  // Whole ms in 64-bit integers, rounded toward zero the same way by every build.
+  long long diff_time = act_time - inpb->last_time_ms;
+  fixed gained = fixed_scale(inpb->gravity, diff_time, 1000);
+  long long next_pos = inpb->act_position + (long long)inpb->act_speed * METERTOCHARS_FIXED *
+                                                diff_time / ((long long)FIXED_ONE * 1000);
+  if (next_pos >= fixed_from_int(MAPSIZEY)) {
+    inpb->last_time_ms = act_time;
+    inpb->act_speed = 0;
+    inpb->act_position = fixed_from_int(MAPSIZEY - 1);
+    return 0;
+  } else if (next_pos <= 0) {
+    inpb->last_time_ms = act_time;
+    inpb->act_speed = gained;
+    inpb->act_position = 0;
+    return 0;
+  }
+
+  inpb->act_position = (fixed)next_pos;
+  inpb->act_speed += gained;
+  inpb->last_time_ms = act_time;
+
+  return 0;
+}
+
+/// @brief Check if pipe covers map cell, follows the shape drawn by render_pipe
+/// @param inputp Pipe struct pointer
+/// @param y y map coordinate
+/// @param x x map coordinate
+/// @return True if cell is part of pipe
+bool sim_pipe_covers_cell(const fbpipe *inputp, int y, int x) {
+  int body_left = inputp->position;
+  int body_right = inputp->position + inputp->pipewidth + 1;
+  bool upper_end = y >= inputp->upheight - 1 && y <= inputp->upheight + 1;
+  bool lower_end = y >= MAPSIZEY - 2 - inputp->downheight && y <= MAPSIZEY - inputp->downheight;
+  if ((upper_end || lower_end) && x >= body_left - PIPEHOLE_END_WIDTH &&
+      x <= body_right + PIPEHOLE_END_WIDTH)
+    return true;
+
+  bool body = y < inputp->upheight || y >= MAPSIZEY - inputp->downheight;
+  return body && x >= body_left && x <= body_right;
+}
+
+/// @brief Check if a pipe reaches into the occupancy window of a bird
+/// @param pipe Pipe
+/// @param xpos x map offset for bird
+/// @return True if some cell of the pipe is inside the window
+static bool pipe_near(const fbpipe *pipe, int xpos) {
+  int window_left = xpos - SPRITE_ANCHOR_BIT;
+  return pipe->enabled && pipe->position - PIPEHOLE_END_WIDTH <= window_left + 31 &&
+         pipe->position + pipe->pipewidth + 1 + PIPEHOLE_END_WIDTH >= window_left;
+}
+
+/// @brief Cells of a pipe on one map row, same cells as sim_pipe_covers_cell
+/// @param pipe Pipe
+/// @param y y map coordinate
+/// @param xpos x map offset for bird, it is bit SPRITE_ANCHOR_BIT of the result
+/// @return Occupancy bits of the row, cells outside of the map are never set
+static uint32_t pipe_row_bits(const fbpipe *pipe, int y, int xpos) {
+  if (y < 0 || y >= MAPSIZEY)
+    return 0;
+  int left = pipe->position;
+  int right = pipe->position + pipe->pipewidth + 1;
+  bool upper_end = y >= pipe->upheight - 1 && y <= pipe->upheight + 1;
+  bool lower_end = y >= MAPSIZEY - 2 - pipe->downheight && y <= MAPSIZEY - pipe->downheight;
+  if (upper_end || lower_end) {
+    left -= PIPEHOLE_END_WIDTH;
+    right += PIPEHOLE_END_WIDTH;
+  } else if (y >= pipe->upheight && y < MAPSIZEY - pipe->downheight) {
+    return 0;
+  }
+
+  int window_left = xpos - SPRITE_ANCHOR_BIT;
+  if (left < window_left)
+    left = window_left;
+  if (left < 0)
+    left = 0;
+  if (right > window_left + 31)
+    right = window_left + 31;
+  if (right > MAPSIZEX - 1)
+    right = MAPSIZEX - 1;
+  if (left > right)
+    return 0;
+  uint32_t bits = right - left == 31 ? ~0u : (1u << (right - left + 1)) - 1;
+  return bits << (left - window_left);
+}
+
+/// @brief Check the cells of the bird sprite frame against the pipe rows, a few shifted-word
+/// ANDs per pipe near the bird
+/// @details Pipe rows are masked with the sprite frame the bird is drawn with.
+/// @param sim State
+/// @param inpb Input bird pointer that needs to be checked
+/// @param xpos x map offset for bird
+/// @return true if there is collision
+bool sim_bird_hits_pipes(const sim_state *sim, const bird *inpb, int xpos) {
+  if (!inpb)
+    return false;
+  const sprite_shape *shape = &sprite_pick(bird_sprite(), inpb->act_speed)->shape;
+  int top = fixed_to_int(inpb->act_position) + shape->top;
+
+  for (int i = 0; i < MAX_PIPES; i++) {
+    const fbpipe *pipe = &sim->pipes[i];
+    // Most pipes are nowhere near the bird, skip them before testing its rows.
+    if (!pipe_near(pipe, xpos))
+      continue;
+    for (int r = 0; r < shape->rows; r++)
+      if (pipe_row_bits(pipe, top + r, xpos) & shape->mask[r])
+        return true;
+  }
+  return false;
+}
+
+/// @brief Rows where a bird would collide with the pipes of a world, same cells as
+/// sim_bird_hits_pipes for any sprite frame, the floor row and everything below it included
+/// @param sim State
+/// @param xpos x map offset for bird
+/// @return Bit y is set if a bird centered on row y collides
+uint32_t sim_blocked_rows(const sim_state *sim, int xpos) {
+  uint32_t occupied[MAPSIZEY] = {0};
+  for (int i = 0; i < MAX_PIPES; i++) {
+    const fbpipe *pipe = &sim->pipes[i];
+    if (!pipe_near(pipe, xpos))
+      continue;
+    for (int y = 0; y < MAPSIZEY; y++) occupied[y] |= pipe_row_bits(pipe, y, xpos);
+  }
+
+  const sprite_shape *shape = &bird_sprite()->any;
+  uint32_t blocked = ~0u << (MAPSIZEY - 1);
+  for (int y = 0; y < MAPSIZEY - 1; y++) {
+    for (int r = 0; r < shape->rows; r++) {
+      int row = y + shape->top + r;
+      if (row >= 0 && row < MAPSIZEY && (occupied[row] & shape->mask[r])) {
+        blocked |= 1u << y;
+        break;
+      }
+    }
+  }
+  return blocked;
+}
+
+/// @brief Generate pipe
+/// @param sim State, pipe sizes are drawn from its random streams
+/// @param x x offset
+/// @param inplvl Level struct pointer to use
+/// @param enable If enable pipe
+/// @param prevupheight Height of previous pipe
+/// @return Generated pipe struct
+fbpipe sim_get_pipe(sim_state *sim, int x, const level *inplvl, bool enable, int prevupheight) {
+  fbpipe newpipe = {0};
+
+  if (!inplvl)
+    return newpipe;
+
+  newpipe.pipewidth = rng_session_range(&sim->rng, RNG_STREAM_PIPE_WIDTH, inplvl->minimum_width,
+                                        inplvl->maximum_width);
+
+  int holeheight = rng_session_range(&sim->rng, RNG_STREAM_PIPE_HEIGHT, inplvl->minimum_space,
+                                     inplvl->maximum_space);
+  int full_allowed_height = MAPSIZEY - ((PIPEHOLE_END_HEIGHT + 1) * 2) - holeheight;
+
+  int minheight = 1, maxheight = full_allowed_height - 1;
+
+  if (prevupheight > 0) {
+    int useinterval = rng_session_range(&sim->rng, RNG_STREAM_PIPE_HEIGHT, 0, 1);
+    if (useinterval == 0) {
+      if (prevupheight - inplvl->maximum_distance_space <= 0)
+        useinterval = 1;
+    } else if (prevupheight + inplvl->minimum_distance_space >= full_allowed_height - 1)
+      useinterval = 0;
+
+    if (useinterval == 0) {
+      minheight = prevupheight - inplvl->maximum_distance_space;
+      maxheight = prevupheight - inplvl->minimum_distance_space;
+    } else {
+      minheight = prevupheight + inplvl->minimum_distance_space;
+      maxheight = prevupheight + inplvl->maximum_distance_space;
+    }
+
+    if (minheight <= 0)
+      minheight = 1;
+    else if (minheight >= full_allowed_height - 1)
+      minheight = full_allowed_height - 1;
+
+    if (maxheight >= full_allowed_height - 1)
+      maxheight = full_allowed_height - 1;
+    else if (maxheight <= 0)
+      maxheight = minheight;
+  }
+
+  if (minheight == maxheight)
+    newpipe.upheight = prevupheight;
+  else
+    newpipe.upheight = rng_session_range(&sim->rng, RNG_STREAM_PIPE_HEIGHT, minheight, maxheight);
+
+  newpipe.downheight = full_allowed_height - newpipe.upheight;
+
+  while (newpipe.downheight < 1) newpipe.downheight++;
+
+  newpipe.position = x;
+  newpipe.enabled = enable;
+
+  return newpipe;
+}
+
+/// @brief Move every pipe to the left by the same number of chars
+/// @param sim State
+/// @param shift Chars to move
+/// @return How many pipes the bird came across
+static int shift_pipes(sim_state *sim, int shift) {
+  int counter = 0;
+  for (int i = 0; i < MAX_PIPES; i++) {
+    fbpipe *pipe = &sim->pipes[i];
+    if (!pipe->enabled)
+      continue;
+    int posbef = pipe->position + 1 + pipe->pipewidth + PIPEHOLE_END_WIDTH;
+    pipe->position -= shift;
+    if (posbef > BIRDOFFX && posbef - shift <= BIRDOFFX)
+      counter++;
+  }
+  return counter;
+}
+
+/// @brief Move the pipes of an endless run by the whole chars its distance crossed, the rest of
+/// a char carries over to the next frame
+/// @return How many pipes the bird came across
+static int endless_move_pipes(sim_state *sim) {
+  endless_world *world = &sim->endless;
+  long long before = world->distance / 1000000;
+  if (world->last_clock > 0)
+    world->distance += endless_speed(sim) * (sim->clock - world->last_clock);
+  world->last_clock = sim->clock;
+  return shift_pipes(sim, (int)(world->distance / 1000000 - before));
+}
+
+/// @brief Function to proccess/move pipes/world
+/// @details The world moves by speed times the ms since the last move, kept exactly in
+/// sim->scroll. Pipes move by the whole chars of it and the rest carries over, so every pipe
+/// moves the same and no part of a char is lost.
+/// @param sim State
+/// @param inplvl Level struct pointer to use
+/// @return How many pipes has bird came accross
+int sim_move_pipes(sim_state *sim, const level *inplvl) {
+  if (!inplvl)
+    return -1;
+  if (sim->endless.enabled)
+    return endless_move_pipes(sim);
+
+  if (sim->last_move_time > 0)
+    sim->scroll += (long long)sim->speed_chars * (sim->clock - sim->last_move_time);
+  sim->last_move_time = sim->clock;
+  int shift = (int)(sim->scroll / SCROLL_CHAR_UNITS);
+  sim->scroll -= shift * SCROLL_CHAR_UNITS;
+  return shift_pipes(sim, shift);
+}
+
+/// @brief Generate the pipe that follows the farthest one
+static fbpipe next_pipe(sim_state *sim, const level *inplvl, const fbpipe *mostaway) {
+  return sim_get_pipe(sim,
+                      mostaway->position + mostaway->pipewidth + 1 + PIPEHOLE_END_WIDTH +
+                          rng_session_range(&sim->rng, RNG_STREAM_PIPE_DISTANCE,
+                                            inplvl->minimum_distance, inplvl->maximum_distance),
+                      inplvl, true, mostaway->upheight);
+}
+
+/// @brief Generate the course of an endless run up to ENDLESS_CHUNK_CHARS past the right map
+/// edge, as far as free slots allow. Pipes come from the random streams in the same order as
+/// one by one, so the course is the same as in a normal run.
+static void endless_generate_chunk(sim_state *sim, const level *inplvl) {
+  fbpipe *mostaway = NULL;
+  for (int i = 0; i < MAX_PIPES; i++)
+    if (sim->pipes[i].enabled && (!mostaway || sim->pipes[i].position > mostaway->position))
+      mostaway = &sim->pipes[i];
+  for (int i = 0; i < MAX_PIPES && mostaway; i++) {
+    fbpipe *pipe = &sim->pipes[i];
+    if (pipe->enabled)
+      continue;
+    if (mostaway->position + PIPEHOLE_END_WIDTH >= MAPSIZEX + ENDLESS_CHUNK_CHARS)
+      break;
+    *pipe = next_pipe(sim, inplvl, mostaway);
+    mostaway = pipe;
+  }
+}
+
+/// @brief Process pipes (Generate new one if there is need)
+/// @param sim State
+/// @param inplvl level struct pointer to use
+/// @return Error code
+int sim_process_pipes(sim_state *sim, const level *inplvl) {
+  if (!inplvl)
+    return -1;
+
+  // One pass finds the pipes with the biggest and lowest x and the first free slot.
+  fbpipe *mostaway = NULL;
+  fbpipe *leastaway = NULL;
+  fbpipe *freepipe = NULL;
+  for (int i = 0; i < MAX_PIPES; i++) {
+    fbpipe *pipe = &sim->pipes[i];
+    if (!pipe->enabled) {
+      if (!freepipe)
+        freepipe = pipe;
+      continue;
+    }
+    if (!mostaway || pipe->position > mostaway->position)
+      mostaway = pipe;
+    if (!leastaway || pipe->position < leastaway->position)
+      leastaway = pipe;
+  }
+
+  if (leastaway && leastaway->position + 1 + leastaway->pipewidth + PIPEHOLE_END_WIDTH < 0) {
+    leastaway->enabled = false;
+    if (!freepipe || leastaway < freepipe)
+      freepipe = leastaway;
+  }
+
+  if (freepipe) {
+    if (!mostaway)
+      *freepipe = sim_get_pipe(sim, MAPSIZEX - 1 + PIPEHOLE_END_WIDTH, inplvl, true, -1);
+    else if (mostaway->position + PIPEHOLE_END_WIDTH >= MAPSIZEX)
+      return 0;
+    else if (sim->endless.enabled)
+      endless_generate_chunk(sim, inplvl);
+    else
+      *freepipe = next_pipe(sim, inplvl, mostaway);
+  }
+  return 0;
+}
+
+/// @brief Increase speed based on last updated time variable
+/// @param sim State
+/// @param inplvl level struct pointer to use
+/// @return Error code
+int sim_increase_speed(sim_state *sim, const level *inplvl) {
+  if (!inplvl)
+    return -1;
+  if (sim->endless.enabled) {
+    sim->speed_chars = fixed_scale(FIXED_ONE, endless_speed(sim), 1000);
+    return 0;
+  }
+  if (sim->last_speed_time == 0) {
+    sim->last_speed_time = sim->clock;
+    return 0;
+  }
+
+  sim->speed_ms += sim->clock - sim->last_speed_time;
+  sim->last_speed_time = sim->clock;
+  // Computed from the whole rising time, so no rounding adds up over a run.
+  fixed per_min = fixed_from_double(METERTOCHARS * inplvl->speed_increase);
+  sim->speed_chars = sim_start_speed(inplvl) + fixed_scale(per_min, sim->speed_ms, 60000);
+  return 0;
+}
+
+/// @brief Count passed pipes into the streak, multiplier and metrics
+/// @param sim State
+/// @param passed_pipes Pipes passed in the frame
+/// @return Points scored
+int sim_score_pipes(sim_state *sim, int passed_pipes) {
+  if (passed_pipes <= 0)
+    return 0;
+  sim->metrics.pipes_passed += passed_pipes;
+  sim->score_streak += passed_pipes;
+  sim->score_multiplier = sim_streak_multiplier(sim->score_streak);
+  if (sim->score_multiplier > sim->metrics.highest_multiplier)
+    sim->metrics.highest_multiplier = sim->score_multiplier;
+  if (sim->score_streak > sim->metrics.highest_streak)
+    sim->metrics.highest_streak = sim->score_streak;
+  return passed_pipes * sim->score_multiplier;
+}
+
+/// @brief Count a collision, it breaks the streak
+/// @param sim State
+void sim_collide(sim_state *sim) {
+  sim->metrics.collisions++;
+  sim->score_streak = 0;
+  sim->score_multiplier = 1;
+}
+
+/// @brief Continue after a pause without moving the world by the paused time
+/// @param sim State
+/// @param inpb Bird of the run
+void sim_resume(sim_state *sim, bird *inpb) {
+  inpb->last_time_ms = sim->clock;
+  sim->last_move_time = sim->clock;
+  sim->last_speed_time = 0;
+}
+
+/// @brief Play the rest of a frame after its key was handled: move the bird, check collisions
+/// and advance the world and the clock. A collision leaves the clock like run_level does.
+/// @param sim State
+/// @param inplvl Level
+/// @param frame_ms Gameplay time of one frame
+/// @return Points scored, -1 on collision
+int sim_step(sim_state *sim, const level *inplvl, long long frame_ms) {
+  bird *usebird = &sim->bird;
+  sim_move_bird(sim, usebird);
+  if (sim_bird_hits_pipes(sim, usebird, BIRDOFFX) ||
+      usebird->act_position >= fixed_from_int(MAPSIZEY - 1)) {
+    sim_collide(sim);
+    return -1;
+  }
+  int points = sim_score_pipes(sim, sim_move_pipes(sim, inplvl));
+  sim_process_pipes(sim, inplvl);
+  sim_increase_speed(sim, inplvl);
+  sim->clock += frame_ms;
+  return points;
+}
+
+/// @brief Find the nearest pipes the bird has not passed yet
+/// @param sim State
+/// @param out Output, ordered by distance
+/// @param max Size of the output
+/// @return Number of pipes found
+int sim_next_pipes(const sim_state *sim, const fbpipe **out, int max) {
+  int count = 0;
+  for (int i = 0; i < MAX_PIPES; i++) {
+    const fbpipe *pipe = &sim->pipes[i];
+    if (!pipe->enabled || pipe->position + pipe->pipewidth + 1 + PIPEHOLE_END_WIDTH < BIRDOFFX - 2)
+      continue;
+    // Insertion into the few nearest slots, a pipe past the last slot is dropped.
+    int slot = count < max ? count++ : max;
+    while (slot > 0 && out[slot - 1]->position > pipe->position) {
+      if (slot < max)
+        out[slot] = out[slot - 1];
+      slot--;
+    }
+    if (slot < max)
+      out[slot] = pipe;
+  }
+  return count;
+}
+
+/// @brief Keys of a replay in the order run_level reads them.
+typedef struct sim_input {
+  const replay *rp;
+  size_t next;
+  long tick;
+} sim_input;
+
+static int next_frame_key(sim_input *in) {
+  if (in->tick >= in->rp->ticks)
+    return 'e';
+  long tick = in->tick++;
+  if (in->next < in->rp->count && in->rp->events[in->next].tick == tick)
+    return in->rp->events[in->next++].key;
+  return SIM_NO_KEY;
+}
+
+/// @brief Read dialog keys until one of them answers it, the keys carry the next frame's tick
+/// @return True if the run ends
+static bool dialog_ends_run(sim_input *in, int resume_key) {
+  while (true) {
+    int ch = 'e';
+    if (in->next < in->rp->count && in->rp->events[in->next].tick == in->tick)
+      ch = sim_tolower(in->rp->events[in->next++].key);
+    if (ch == resume_key)
+      return false;
+    if (ch == 'e')
+      return true;
+  }
+}
+
+/// @brief Play a replay the way run_level does without a screen, nothing outside sim is touched
+/// @param sim State, initialized with sim_init
+/// @param inplvl Level of the replay
+/// @param rp Replay, its frame period must be the one of the settings
+/// @param score Score output
+/// @return Error code
+int sim_run_replay(sim_state *sim, const level *inplvl, const replay *rp, int *score) {
+  if (!inplvl || !rp || !score)
+    return -1;
+
+  sim_reset(sim, inplvl, rp->seed);
+  sim_input in = {rp, 0, 0};
+  int actlives = inplvl->max_lives;
+  bool ended = false;
+  *score = 0;
+  while (actlives != 0) {
+    sim_clear_pipes(sim);
+    bird *usebird = &sim->bird;
+    *usebird = sim_get_bird(sim, inplvl);
+    sim->last_speed_time = 0;
+
+    while (true) {
+      int ch = next_frame_key(&in);
+      if (ch == ' ') {
+        jump_bird(usebird);
+        sim->metrics.jumps++;
+      } else if (sim_tolower(ch) == 'e') {
+        ended = true;
+        break;
+      } else if (sim_tolower(ch) == 'p') {
+        sim->metrics.pauses++;
+        if (dialog_ends_run(&in, 'p')) {
+          ended = true;
+          break;
+        }
+        sim_resume(sim, usebird);
+      }
+
+      int points = sim_step(sim, inplvl, rp->frame_ms);
+      if (points < 0)
+        break;
+      *score += points;
+    }
+    if (ended)
+      break;
+    actlives--;
+    if (actlives > 0 && dialog_ends_run(&in, 't'))
+      break;
+  }
+  return 0;
+}
@@ -0,0 +1,216 @@
+// Copyright 2022 <Maros Varchola - mvarchdev>
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "flappybird/spectate.h"
+
+#include <fcntl.h>
+#include <ncurses.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "flappybird/rendering.h"
+#include "flappybird/term_io.h"
+
+/// @brief Attempts to get a consistent copy before a reader gives up on a frame.
+#define SPECTATE_READ_TRIES 8
+
+/// @brief Feed of this process, NULL unless the game publishes.
+static spectate_feed *g_feed = NULL;
+
+/// @brief Copy the curses screen into the next slot of the ring. Only memory is touched, the
+/// game does no I/O for its spectators.
+/// @param feed Feed to write
+void spectate_publish_frame(spectate_feed *feed) {
+  uint32_t latest = atomic_load_explicit(&feed->latest, memory_order_relaxed);
+  uint32_t index = (latest + 1) % SPECTATE_SLOTS;
+  spectate_slot *slot = &feed->slots[index];
+  uint32_t seq = atomic_load_explicit(&slot->seq, memory_order_relaxed);
+  atomic_store_explicit(&slot->seq, seq + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+
+  int rows = getmaxy(curscr);
+  int cols = getmaxx(curscr);
+  slot->rows = (uint16_t)(rows < SPECTATE_MAX_ROWS ? rows : SPECTATE_MAX_ROWS);
+  slot->cols = (uint16_t)(cols < SPECTATE_MAX_COLS ? cols : SPECTATE_MAX_COLS);
+  slot->frame = ++feed->published;
+  chtype row[SPECTATE_MAX_COLS + 1];
+  for (int y = 0; y < slot->rows; y++) {
+    int n = mvwinchnstr(curscr, y, 0, row, slot->cols);
+    uint32_t *cells = &slot->cells[y * slot->cols];
+    for (int x = 0; x < slot->cols; x++) cells[x] = x < n ? (uint32_t)row[x] : ' ';
+  }
+
+  atomic_store_explicit(&slot->seq, seq + 2, memory_order_release);
+  atomic_store_explicit(&feed->latest, index, memory_order_release);
+}
+
+static void publish_sink(void *ctx) { spectate_publish_frame(ctx); }
+
+/// @brief Create the shared memory feed and publish every finished frame into it
+/// @return Error code
+int spectate_publish_start(void) {
+  int fd = shm_open(SPECTATE_SHM_NAME, O_CREAT | O_RDWR, 0644);
+  if (fd < 0) {
+    fprintf(stderr, "Cannot create shared memory " SPECTATE_SHM_NAME ".\n");
+    return -1;
+  }
+  void *map = MAP_FAILED;
+  if (ftruncate(fd, sizeof(spectate_feed)) == 0)
+    map = mmap(NULL, sizeof(spectate_feed), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    fprintf(stderr, "Cannot map shared memory " SPECTATE_SHM_NAME ".\n");
+    return -1;
+  }
+
+  g_feed = map;
+  g_feed->magic = SPECTATE_MAGIC;
+  g_feed->version = SPECTATE_VERSION;
+  atomic_store(&g_feed->live, 1);
+  term_io_sink sink = {NULL, publish_sink, g_feed};
+  if (!term_io_add_sink(&sink)) {
+    spectate_publish_stop();
+    return -1;
+  }
+  return 0;
+}
+
+/// @brief Tell spectators the game is over and remove the feed
+void spectate_publish_stop(void) {
+  if (g_feed == NULL)
+    return;
+  term_io_remove_sink(g_feed);
+  atomic_store(&g_feed->live, 0);
+  munmap(g_feed, sizeof(spectate_feed));
+  shm_unlink(SPECTATE_SHM_NAME);
+  g_feed = NULL;
+}
+
+/// @brief Copy the newest frame without blocking the game. A copy the game overwrote
+/// meanwhile is retried on the then newest frame.
+/// @param feed Mapped feed
+/// @param out Slot to fill
+/// @return True if out holds a consistent frame
+bool spectate_read_latest(const spectate_feed *feed, spectate_slot *out) {
+  for (int i = 0; i < SPECTATE_READ_TRIES; i++) {
+    uint32_t index = atomic_load_explicit(&feed->latest, memory_order_acquire) % SPECTATE_SLOTS;
+    const spectate_slot *slot = &feed->slots[index];
+    uint32_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+    if (seq & 1)
+      continue;
+    out->rows = slot->rows < SPECTATE_MAX_ROWS ? slot->rows : SPECTATE_MAX_ROWS;
+    out->cols = slot->cols < SPECTATE_MAX_COLS ? slot->cols : SPECTATE_MAX_COLS;
+    out->frame = slot->frame;
+    memcpy(out->cells, slot->cells, (size_t)out->rows * out->cols * sizeof(uint32_t));
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&slot->seq, memory_order_relaxed) == seq)
+      return true;
+  }
+  return false;
+}
+
+/// @brief Map the feed of a running game read-only
+/// @return Feed or NULL if no game publishes
+static const spectate_feed *attach_feed(void) {
+  int fd = shm_open(SPECTATE_SHM_NAME, O_RDONLY, 0);
+  if (fd < 0)
+    return NULL;
+  struct stat st;
+  void *map = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(spectate_feed))
+    map = mmap(NULL, sizeof(spectate_feed), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+    return NULL;
+
+  const spectate_feed *feed = map;
+  if (feed->magic != SPECTATE_MAGIC || feed->version != SPECTATE_VERSION ||
+      !atomic_load(&feed->live)) {
+    munmap(map, sizeof(spectate_feed));
+    return NULL;
+  }
+  return feed;
+}
+
+static void detach_feed(const spectate_feed *feed) {
+  if (feed)
+    munmap((void *)feed, sizeof(spectate_feed));
+}
+
+/// @brief Draw a frame, cells beyond the spectator terminal are cut
+static void draw_frame(const spectate_slot *frame) {
+  chtype row[SPECTATE_MAX_COLS + 1];
+  int rows = frame->rows < LINES ? frame->rows : LINES;
+  int cols = frame->cols < COLS ? frame->cols : COLS;
+  for (int y = 0; y < rows; y++) {
+    const uint32_t *cells = &frame->cells[y * frame->cols];
+    for (int x = 0; x < cols; x++) row[x] = (chtype)cells[x];
+    row[cols] = 0;
+    mvaddchnstr(y, 0, row, cols);
+  }
+  refresh();
+}
+
+static void draw_waiting(void) {
+  static const char text[] = "Waiting for a game started with --broadcast, Q quits";
+  erase();
+  mvaddstr(LINES / 2, (COLS - (int)strlen(text)) / 2, text);
+  refresh();
+}
+
+/// @brief Show the game of another process on this terminal at the frame rate of the
+/// settings, until Q. Waits for a game if none publishes.
+/// @return Error code
+int run_spectator(void) {
+  load_settings();
+  long long period = frame_period_ms();
+  spectate_slot *frame = malloc(sizeof(*frame));
+  if (frame == NULL || initscr() == NULL) {
+    free(frame);
+    fprintf(stderr, "Failed to initialize screen.\n");
+    return -1;
+  }
+  curs_set(0);
+  noecho();
+  cbreak();
+  start_color();
+  init_colorpairs();
+  timeout(period > 0 ? (int)period : 33);
+
+  const spectate_feed *feed = NULL;
+  uint64_t shown = 0;
+  bool waiting = false;
+  int ch;
+  while ((ch = getch()) != 'q' && ch != 'Q') {
+    if (feed && !atomic_load(&feed->live)) {
+      detach_feed(feed);
+      feed = NULL;
+    }
+    if (feed == NULL) {
+      feed = attach_feed();
+      shown = 0;
+    }
+    if (feed == NULL) {
+      if (!waiting)
+        draw_waiting();
+      waiting = true;
+      continue;
+    }
+    if (!spectate_read_latest(feed, frame) || (frame->frame == shown && !waiting))
+      continue;
+    if (waiting)
+      erase();
+    waiting = false;
+    shown = frame->frame;
+    draw_frame(frame);
+  }
+
+  detach_feed(feed);
+  endwin();
+  free(frame);
+  return 0;
+}
@@ -0,0 +1,198 @@
+// Copyright 2022 <Maros Varchola - mvarchdev>
+
+#include "flappybird/sprite.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/// @brief Bird used when no sprite file can be read, the cells of the original bird.
+static const char default_sprite[] =
+    "frame 0 1 2\n"
+    "..\\...\n"
+    "|###*|\n"
+    "../...\n";
+
+static sprite_set active_sprite;
+static pthread_once_t active_once = PTHREAD_ONCE_INIT;
+
+/// @brief Add the cells of a shape into another one
+/// @param dst Shape to extend
+/// @param src Shape to add
+static void shape_merge(sprite_shape *dst, const sprite_shape *src) {
+  if (src->rows == 0)
+    return;
+  if (dst->rows == 0) {
+    *dst = *src;
+    return;
+  }
+  int top = dst->top < src->top ? dst->top : src->top;
+  int dst_end = dst->top + dst->rows;
+  int src_end = src->top + src->rows;
+  int end = dst_end > src_end ? dst_end : src_end;
+  uint32_t mask[SPRITE_SHAPE_ROWS] = {0};
+  for (int r = 0; r < dst->rows; r++) mask[dst->top - top + r] |= dst->mask[r];
+  for (int r = 0; r < src->rows; r++) mask[src->top - top + r] |= src->mask[r];
+  dst->top = top;
+  dst->rows = end - top;
+  memcpy(dst->mask, mask, sizeof(mask));
+}
+
+/// @brief Turn the rows of a frame into masks and glyph runs
+/// @param frame Frame to fill, min_speed already set
+/// @param rows Row strings, '.' cells are transparent
+/// @param row_count Number of rows
+/// @param anchor_row Row of the bird position
+/// @param anchor_col Column of the bird position
+/// @return Error code
+static int build_frame(sprite_frame *frame, char rows[][SPRITE_MAX_COLS + 1], int row_count,
+                       int anchor_row, int anchor_col) {
+  if (row_count == 0 || anchor_row < 0 || anchor_row >= row_count || anchor_col < 0 ||
+      anchor_col >= SPRITE_MAX_COLS)
+    return -1;
+  frame->shape.top = -anchor_row;
+  frame->shape.rows = row_count;
+  frame->run_count = 0;
+  for (int r = 0; r < row_count; r++) {
+    frame->shape.mask[r] = 0;
+    sprite_run *run = NULL;
+    for (int c = 0; rows[r][c] != '\0'; c++) {
+      if (rows[r][c] == SPRITE_TRANSPARENT) {
+        run = NULL;
+        continue;
+      }
+      frame->shape.mask[r] |= 1u << (SPRITE_ANCHOR_BIT + c - anchor_col);
+      if (run == NULL) {
+        run = &frame->runs[frame->run_count++];
+        run->dy = r - anchor_row;
+        run->dx = c - anchor_col;
+        run->len = 0;
+      }
+      run->glyphs[run->len++] = rows[r][c];
+      run->glyphs[run->len] = '\0';
+    }
+  }
+  return 0;
+}
+
+/// @brief Read a sprite from text
+/// @details Each frame starts with a "frame <min_speed> <anchor_row> <anchor_col>" line followed
+/// by its rows, frames are listed from the lowest speed. Lines starting with ';' and empty lines
+/// are skipped.
+/// @param set Set to fill
+/// @param text Sprite text
+/// @return Error code, set is left empty on error
+int sprite_parse(sprite_set *set, const char *text) {
+  memset(set, 0, sizeof(*set));
+  char rows[SPRITE_MAX_ROWS][SPRITE_MAX_COLS + 1];
+  int row_count = 0;
+  int anchor_row = 0;
+  int anchor_col = 0;
+  sprite_frame *frame = NULL;
+  char current[64];
+  int err = 0;
+
+  const char *line = text;
+  while (err == 0 && line != NULL && *line != '\0') {
+    const char *line_start = line;
+    const char *next = strchr(line, '\n');
+    size_t len = next ? (size_t)(next - line) : strlen(line);
+    if (len > 0 && line[len - 1] == '\r')
+      len--;
+
+    line = next ? next + 1 : NULL;
+    if (len == 0 || line_start[0] == ';')
+      continue;
+    if (len >= sizeof(current)) {
+      err = -1;
+      continue;
+    }
+    memcpy(current, line_start, len);
+    current[len] = '\0';
+
+    if (strncmp(current, "frame ", 6) == 0) {
+      if (frame != NULL)
+        err = build_frame(frame, rows, row_count, anchor_row, anchor_col);
+      double speed = 0;
+      if (err == 0 && (set->count == SPRITE_MAX_FRAMES ||
+                       sscanf(current + 6, "%lf %d %d", &speed, &anchor_row, &anchor_col) != 3))
+        err = -1;
+      fixed min_speed = fixed_from_double(speed);
+      if (err == 0 && set->count > 0 && min_speed <= set->frames[set->count - 1].min_speed)
+        err = -1;
+      if (err == 0) {
+        frame = &set->frames[set->count++];
+        frame->min_speed = min_speed;
+        row_count = 0;
+      }
+    } else if (frame == NULL || row_count == SPRITE_MAX_ROWS || len > SPRITE_MAX_COLS) {
+      err = -1;
+    } else {
+      memcpy(rows[row_count++], current, len + 1);
+    }
+  }
+  if (err == 0 && frame != NULL)
+    err = build_frame(frame, rows, row_count, anchor_row, anchor_col);
+  if (err != 0 || set->count == 0) {
+    memset(set, 0, sizeof(*set));
+    return -1;
+  }
+
+  for (int i = 0; i < set->count; i++) shape_merge(&set->any, &set->frames[i].shape);
+  return 0;
+}
+
+/// @brief Read a sprite file
+/// @param set Set to fill
+/// @param path File path
+/// @return Error code
+int sprite_load(sprite_set *set, const char *path) {
+  memset(set, 0, sizeof(*set));
+  FILE *fp = fopen(path, "r");
+  if (fp == NULL)
+    return -1;
+  char *buf = malloc(SPRITE_MAX_BYTES + 1);
+  size_t size = buf ? fread(buf, 1, SPRITE_MAX_BYTES + 1, fp) : 0;
+  fclose(fp);
+  if (size == 0 || size > SPRITE_MAX_BYTES) {
+    free(buf);
+    return -1;
+  }
+  buf[size] = '\0';
+  int err = sprite_parse(set, buf);
+  free(buf);
+  return err;
+}
+
+/// @brief Frame shown at a vertical speed
+/// @param set Sprite
+/// @param speed Vertical speed of the bird, negative while rising
+/// @return Last frame whose min_speed is not above speed, the first one below all of them
+const sprite_frame *sprite_pick(const sprite_set *set, fixed speed) {
+  int i = set->count - 1;
+  while (i > 0 && set->frames[i].min_speed > speed) i--;
+  return &set->frames[i];
+}
+
+static void init_default_sprite(void) {
+  if (active_sprite.count == 0)
+    sprite_parse(&active_sprite, default_sprite);
+}
+
+/// @brief Sprite of the bird used for drawing and collisions
+/// @return Sprite, the built-in bird until set_bird_sprite is called
+const sprite_set *bird_sprite(void) {
+  pthread_once(&active_once, init_default_sprite);
+  return &active_sprite;
+}
+
+/// @brief Replace the bird sprite, call it before any run or worker thread starts
+/// @param set Sprite to copy, NULL or empty restores the built-in bird
+void set_bird_sprite(const sprite_set *set) {
+  pthread_once(&active_once, init_default_sprite);
+  if (set != NULL && set->count > 0)
+    active_sprite = *set;
+  else
+    sprite_parse(&active_sprite, default_sprite);
+}
@@ -0,0 +1,245 @@
+// Copyright 2022 <Maros Varchola - mvarchdev>
+
+#define _GNU_SOURCE
+
+#include "flappybird/term_io.h"
+
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/// @brief Escape character that starts every control sequence.
+#define ESCAPE_CHAR 0x1b
+
+/// @brief File descriptor ncurses writes the screen to, -1 if not attached.
+static int g_term_fd = -1;
+static term_io_screen g_screen = TERM_IO_SCREEN_STARTUP;
+static int g_level_slot = -1;
+
+static term_io_counters g_total = {0};
+static term_io_counters g_screens[TERM_IO_SCREEN_COUNT] = {{0}};
+static term_io_counters g_levels[TERM_IO_MAX_LEVELS] = {{0}};
+/// @brief Output of the frame that is currently being drawn.
+static term_io_counters g_frame = {0};
+static term_io_counters g_last_frame = {0};
+/// @brief Receivers of a copy of the output.
+static term_io_sink g_sinks[TERM_IO_MAX_SINKS] = {{0}};
+static int g_sink_count = 0;
+
+static const char *g_screen_names[TERM_IO_SCREEN_COUNT] = {
+    "startup", "nickname", "menu", "level select", "gameplay", "hall of fame", "statistics", "about",
+};
+
+static void add_counters(term_io_counters *dst, const term_io_counters *src) {
+  dst->bytes += src->bytes;
+  dst->writes += src->writes;
+  dst->escapes += src->escapes;
+}
+
+static unsigned long long count_escapes(const char *data, size_t len) {
+  unsigned long long escapes = 0;
+  const char *end = data + len;
+  while (data < end) {
+    const char *found = memchr(data, ESCAPE_CHAR, (size_t)(end - data));
+    if (found == NULL) {
+      break;
+    }
+    escapes++;
+    data = found + 1;
+  }
+  return escapes;
+}
+
+static void account_output(const char *data, size_t len) {
+  term_io_counters chunk = {0};
+  chunk.bytes = len;
+  chunk.writes = 1;
+  chunk.escapes = count_escapes(data, len);
+
+  add_counters(&g_total, &chunk);
+  add_counters(&g_screens[g_screen], &chunk);
+  add_counters(&g_frame, &chunk);
+  if (g_level_slot >= 0) {
+    add_counters(&g_levels[g_level_slot], &chunk);
+  }
+  for (int i = 0; i < g_sink_count; i++) {
+    if (g_sinks[i].write) {
+      g_sinks[i].write(g_sinks[i].ctx, data, len);
+    }
+  }
+}
+
+#if defined(__linux__)
+// ncurses 6 keeps its own output buffer and flushes it with write(2) on the
+// descriptor behind its FILE, bypassing stdio entirely, so neither setvbuf nor
+// a cookie stream ever sees the bytes. Interposing write() is the only place
+// where every screen update passes through.
+ssize_t write(int fd, const void *buf, size_t count) {
+  ssize_t written = (ssize_t)syscall(SYS_write, fd, buf, count);
+  if (written > 0 && fd == g_term_fd) {
+    account_output(buf, (size_t)written);
+  }
+  return written;
+}
+#endif
+
+/// @brief Start accounting output written to the terminal descriptor
+/// @param fd Descriptor the curses screen writes to
+/// @return True if output on this platform can be accounted
+bool term_io_attach(int fd) {
+  g_term_fd = fd;
+  return term_io_available();
+}
+
+/// @brief Check if output accounting works on this platform
+/// @return True if write() interposition is compiled in
+bool term_io_available(void) {
+#if defined(__linux__)
+  return g_term_fd >= 0;
+#else
+  return false;
+#endif
+}
+
+/// @brief Pass a copy of every accounted write to a sink, after the sinks added before it
+/// @param sink Sink to copy
+/// @return False if TERM_IO_MAX_SINKS sinks are attached already
+bool term_io_add_sink(const term_io_sink *sink) {
+  if (sink == NULL || g_sink_count >= TERM_IO_MAX_SINKS) {
+    return false;
+  }
+  g_sinks[g_sink_count++] = *sink;
+  return true;
+}
+
+/// @brief Detach the sinks with the given context
+/// @param ctx Context the sink was added with
+void term_io_remove_sink(const void *ctx) {
+  int kept = 0;
+  for (int i = 0; i < g_sink_count; i++) {
+    if (g_sinks[i].ctx != ctx) {
+      g_sinks[kept++] = g_sinks[i];
+    }
+  }
+  memset(&g_sinks[kept], 0, sizeof(g_sinks[0]) * (size_t)(g_sink_count - kept));
+  g_sink_count = kept;
+}
+
+/// @brief Attribute following output to the given screen
+/// @param screen Screen that is being drawn
+void term_io_set_screen(term_io_screen screen) {
+  if (screen < 0 || screen >= TERM_IO_SCREEN_COUNT) {
+    return;
+  }
+  g_screen = screen;
+}
+
+term_io_screen term_io_get_screen(void) { return g_screen; }
+
+/// @brief Close the frame that has just been refreshed
+void term_io_end_frame(void) {
+  g_frame.frames = 1;
+  g_frame.max_frame_bytes = g_frame.bytes;
+  g_last_frame = g_frame;
+
+  term_io_counters *targets[3] = {&g_total, &g_screens[g_screen], NULL};
+  if (g_level_slot >= 0) {
+    targets[2] = &g_levels[g_level_slot];
+  }
+  for (size_t i = 0; i < sizeof(targets) / sizeof(targets[0]); i++) {
+    if (targets[i] == NULL) {
+      continue;
+    }
+    targets[i]->frames++;
+    if (g_frame.bytes > targets[i]->max_frame_bytes) {
+      targets[i]->max_frame_bytes = g_frame.bytes;
+    }
+  }
+
+  memset(&g_frame, 0, sizeof(g_frame));
+  for (int i = 0; i < g_sink_count; i++) {
+    if (g_sinks[i].end_frame) {
+      g_sinks[i].end_frame(g_sinks[i].ctx);
+    }
+  }
+}
+
+/// @brief Attribute following output to a level
+/// @param levelnum Level number, levels above TERM_IO_MAX_LEVELS only count to totals
+void term_io_begin_level(int levelnum) {
+  g_level_slot = (levelnum >= 1 && levelnum <= TERM_IO_MAX_LEVELS) ? levelnum - 1 : -1;
+}
+
+void term_io_end_level(void) { g_level_slot = -1; }
+
+term_io_counters term_io_total(void) { return g_total; }
+
+term_io_counters term_io_last_frame(void) { return g_last_frame; }
+
+term_io_counters term_io_screen_counters(term_io_screen screen) {
+  term_io_counters empty = {0};
+  if (screen < 0 || screen >= TERM_IO_SCREEN_COUNT) {
+    return empty;
+  }
+  return g_screens[screen];
+}
+
+term_io_counters term_io_level_counters(int levelnum) {
+  term_io_counters empty = {0};
+  if (levelnum < 1 || levelnum > TERM_IO_MAX_LEVELS) {
+    return empty;
+  }
+  return g_levels[levelnum - 1];
+}
+
+const char *term_io_screen_name(term_io_screen screen) {
+  if (screen < 0 || screen >= TERM_IO_SCREEN_COUNT) {
+    return "unknown";
+  }
+  return g_screen_names[screen];
+}
+
+static void print_counters(FILE *out, const char *label, const term_io_counters *counters) {
+  unsigned long long avg = counters->frames > 0 ? counters->bytes / counters->frames : 0;
+  fprintf(out, "  %-14s %12llu B %9llu writes %10llu esc %8llu frames %8llu B/frame %8llu max\n",
+          label, counters->bytes, counters->writes, counters->escapes, counters->frames, avg,
+          counters->max_frame_bytes);
+}
+
+/// @brief Print terminal output report
+/// @param out Stream to print to
+void term_io_print_report(FILE *out) {
+  if (out == NULL) {
+    return;
+  }
+
+  fprintf(out, "Terminal output report\n");
+  if (!term_io_available()) {
+    fprintf(out, "  output accounting is not available on this platform\n");
+    return;
+  }
+
+  print_counters(out, "total", &g_total);
+  fprintf(out, "Per screen:\n");
+  for (int i = 0; i < TERM_IO_SCREEN_COUNT; i++) {
+    if (g_screens[i].bytes == 0 && g_screens[i].frames == 0) {
+      continue;
+    }
+    print_counters(out, g_screen_names[i], &g_screens[i]);
+  }
+
+  fprintf(out, "Per level:\n");
+  bool any_level = false;
+  for (int i = 0; i < TERM_IO_MAX_LEVELS; i++) {
+    if (g_levels[i].bytes == 0 && g_levels[i].frames == 0) {
+      continue;
+    }
+    char label[32] = {0};
+    snprintf(label, sizeof(label), "level %d", i + 1);
+    print_counters(out, label, &g_levels[i]);
+    any_level = true;
+  }
+  if (!any_level) {
+    fprintf(out, "  no level played\n");
+  }
+}
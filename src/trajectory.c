@@ -0,0 +1,119 @@
+// Copyright 2022 <Maros Varchola - mvarchdev>
+
+#include "flappybird/trajectory.h"
+
+#include <string.h>
+
+/// @brief Prepare the predictor for a level
+/// @param tr Trajectory
+/// @param inplvl Level to play, copied
+/// @param frame_ms Gameplay time of one frame
+void trajectory_init(trajectory *tr, const level *inplvl, long long frame_ms) {
+  memset(tr, 0, sizeof(*tr));
+  tr->lvl = *inplvl;
+  tr->frame_ms = frame_ms;
+  tr->frames = frame_ms > 0 ? (int)(TRAJECTORY_AHEAD_MS / frame_ms) : 1;
+  if (tr->frames > TRAJECTORY_MAX_FRAMES)
+    tr->frames = TRAJECTORY_MAX_FRAMES;
+  if (tr->frames < 2)
+    tr->frames = 2;
+}
+
+/// @brief Forget the prediction so the next update simulates the world again, needed whenever
+/// the world jumps: a new life, a rewind or a pause
+/// @param tr Trajectory
+void trajectory_reset(trajectory *tr) { tr->valid = false; }
+
+static int slot(const trajectory *tr, int k) { return (tr->head + k) % TRAJECTORY_MAX_FRAMES; }
+
+/// @brief Predict frame k of the world from the shadow world, then step the shadow world
+static void predict_world(trajectory *tr, int k) {
+  sim_state *world = &tr->ahead;
+  tr->blocked[slot(tr, k)] = sim_blocked_rows(world, BIRDOFFX);
+  tr->travel[slot(tr, k)] = tr->odometer;
+  // Every pipe moves by the same whole number of chars, any of them tells how many.
+  const fbpipe *ref = NULL;
+  for (int i = 0; i < MAX_PIPES && !ref; i++)
+    if (world->pipes[i].enabled)
+      ref = &world->pipes[i];
+  int before = ref ? ref->position : 0;
+  sim_move_pipes(world, &tr->lvl);
+  tr->odometer += ref ? before - ref->position : 0;
+  sim_process_pipes(world, &tr->lvl);
+  sim_increase_speed(world, &tr->lvl);
+  world->clock += tr->frame_ms;
+}
+
+/// @brief Predict the bird after frame k from the bird after the frame before
+static void predict_glide(trajectory *tr, int k, const bird *from) {
+  bird next = *from;
+  bird_advance(&next, tr->clock + k * tr->frame_ms);
+  tr->glide[slot(tr, k)] = next;
+}
+
+static bool same_bird(const bird *lhs, const bird *rhs) {
+  return lhs->act_position == rhs->act_position && lhs->act_speed == rhs->act_speed &&
+         lhs->last_time_ms == rhs->last_time_ms;
+}
+
+static bool blocked(const trajectory *tr, int k, const bird *inpb) {
+  return tr->blocked[slot(tr, k)] & (1u << fixed_to_int(inpb->act_position));
+}
+
+static int point_x(const trajectory *tr, int k) {
+  return BIRDOFFX + (int)(tr->travel[slot(tr, k)] - tr->travel[tr->head]);
+}
+
+/// @brief Bring the prediction to the frame about to be played. One frame after the last
+/// update only the new last frame is simulated, the glide arc is simulated again only if a
+/// key moved the bird off it.
+/// @param tr Trajectory
+/// @param sim World at the start of the frame, after its key was handled
+void trajectory_update(trajectory *tr, const sim_state *sim) {
+  tr->stats.updates++;
+  if (tr->valid && sim->clock == tr->clock + tr->frame_ms) {
+    bool on_glide = same_bird(&sim->bird, &tr->glide[tr->head]);
+    tr->head = slot(tr, 1);
+    tr->clock = sim->clock;
+    predict_world(tr, tr->frames - 1);
+    if (on_glide) {
+      predict_glide(tr, tr->frames - 1, &tr->glide[slot(tr, tr->frames - 2)]);
+    } else {
+      for (int k = 0; k < tr->frames; k++)
+        predict_glide(tr, k, k == 0 ? &sim->bird : &tr->glide[slot(tr, k - 1)]);
+      tr->stats.glide_rebuilds++;
+    }
+    tr->stats.extends++;
+  } else {
+    tr->head = 0;
+    tr->clock = sim->clock;
+    tr->ahead = *sim;
+    tr->odometer = 0;
+    for (int k = 0; k < tr->frames; k++) {
+      predict_world(tr, k);
+      predict_glide(tr, k, k == 0 ? &sim->bird : &tr->glide[slot(tr, k - 1)]);
+    }
+    tr->valid = true;
+    tr->stats.world_rebuilds++;
+  }
+
+  tr->glide_len = 0;
+  for (int k = 0; k < tr->frames && !blocked(tr, k, &tr->glide[slot(tr, k)]); k++) {
+    tr->glide_x[k] = point_x(tr, k);
+    tr->glide_y[k] = fixed_to_int(tr->glide[slot(tr, k)].act_position);
+    tr->glide_len++;
+  }
+
+  // A key pressed now is read at the start of the next frame, the jump arc leaves from there.
+  bird jump = tr->glide[tr->head];
+  jump_bird(&jump);
+  tr->jump_len = 0;
+  for (int k = 1; k < tr->frames; k++) {
+    bird_advance(&jump, tr->clock + k * tr->frame_ms);
+    if (blocked(tr, k, &jump))
+      break;
+    tr->jump_x[tr->jump_len] = point_x(tr, k);
+    tr->jump_y[tr->jump_len] = fixed_to_int(jump.act_position);
+    tr->jump_len++;
+  }
+}
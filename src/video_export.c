@@ -0,0 +1,467 @@
+// Copyright 2022 <Maros Varchola - mvarchdev>
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "flappybird/video_export.h"
+
+#include <ncurses.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "flappybird/audio.h"
+#include "flappybird/common_tools.h"
+#include "flappybird/headless.h"
+#include "flappybird/rendering.h"
+#include "flappybird/replay.h"
+#include "flappybird/term_io.h"
+
+/// @brief Characters the font covers, everything else is drawn as a blank cell.
+#define FONT_FIRST ' '
+#define FONT_LAST '~'
+
+/// @brief 8x8 public domain font (font8x8_basic), bit 0 is the left pixel. The bar is drawn
+/// solid so pipe walls do not have gaps.
+static const uint8_t font8x8[FONT_LAST - FONT_FIRST + 1][8] = {
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},  // ' '
+    {0x18, 0x3C, 0x3C, 0x18, 0x18, 0x00, 0x18, 0x00},  // '!'
+    {0x36, 0x36, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},  // '"'
+    {0x36, 0x36, 0x7F, 0x36, 0x7F, 0x36, 0x36, 0x00},  // '#'
+    {0x0C, 0x3E, 0x03, 0x1E, 0x30, 0x1F, 0x0C, 0x00},  // '$'
+    {0x00, 0x63, 0x33, 0x18, 0x0C, 0x66, 0x63, 0x00},  // '%'
+    {0x1C, 0x36, 0x1C, 0x6E, 0x3B, 0x33, 0x6E, 0x00},  // '&'
+    {0x06, 0x06, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00},  // '''
+    {0x18, 0x0C, 0x06, 0x06, 0x06, 0x0C, 0x18, 0x00},  // '('
+    {0x06, 0x0C, 0x18, 0x18, 0x18, 0x0C, 0x06, 0x00},  // ')'
+    {0x00, 0x66, 0x3C, 0xFF, 0x3C, 0x66, 0x00, 0x00},  // '*'
+    {0x00, 0x0C, 0x0C, 0x3F, 0x0C, 0x0C, 0x00, 0x00},  // '+'
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C, 0x06},  // ','
+    {0x00, 0x00, 0x00, 0x3F, 0x00, 0x00, 0x00, 0x00},  // '-'
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C, 0x00},  // '.'
+    {0x60, 0x30, 0x18, 0x0C, 0x06, 0x03, 0x01, 0x00},  // '/'
+    {0x3E, 0x63, 0x73, 0x7B, 0x6F, 0x67, 0x3E, 0x00},  // '0'
+    {0x0C, 0x0E, 0x0C, 0x0C, 0x0C, 0x0C, 0x3F, 0x00},  // '1'
+    {0x1E, 0x33, 0x30, 0x1C, 0x06, 0x33, 0x3F, 0x00},  // '2'
+    {0x1E, 0x33, 0x30, 0x1C, 0x30, 0x33, 0x1E, 0x00},  // '3'
+    {0x38, 0x3C, 0x36, 0x33, 0x7F, 0x30, 0x78, 0x00},  // '4'
+    {0x3F, 0x03, 0x1F, 0x30, 0x30, 0x33, 0x1E, 0x00},  // '5'
+    {0x1C, 0x06, 0x03, 0x1F, 0x33, 0x33, 0x1E, 0x00},  // '6'
+    {0x3F, 0x33, 0x30, 0x18, 0x0C, 0x0C, 0x0C, 0x00},  // '7'
+    {0x1E, 0x33, 0x33, 0x1E, 0x33, 0x33, 0x1E, 0x00},  // '8'
+    {0x1E, 0x33, 0x33, 0x3E, 0x30, 0x18, 0x0E, 0x00},  // '9'
+    {0x00, 0x0C, 0x0C, 0x00, 0x00, 0x0C, 0x0C, 0x00},  // ':'
+    {0x00, 0x0C, 0x0C, 0x00, 0x00, 0x0C, 0x0C, 0x06},  // ';'
+    {0x18, 0x0C, 0x06, 0x03, 0x06, 0x0C, 0x18, 0x00},  // '<'
+    {0x00, 0x00, 0x3F, 0x00, 0x00, 0x3F, 0x00, 0x00},  // '='
+    {0x06, 0x0C, 0x18, 0x30, 0x18, 0x0C, 0x06, 0x00},  // '>'
+    {0x1E, 0x33, 0x30, 0x18, 0x0C, 0x00, 0x0C, 0x00},  // '?'
+    {0x3E, 0x63, 0x7B, 0x7B, 0x7B, 0x03, 0x1E, 0x00},  // '@'
+    {0x0C, 0x1E, 0x33, 0x33, 0x3F, 0x33, 0x33, 0x00},  // 'A'
+    {0x3F, 0x66, 0x66, 0x3E, 0x66, 0x66, 0x3F, 0x00},  // 'B'
+    {0x3C, 0x66, 0x03, 0x03, 0x03, 0x66, 0x3C, 0x00},  // 'C'
+    {0x1F, 0x36, 0x66, 0x66, 0x66, 0x36, 0x1F, 0x00},  // 'D'
+    {0x7F, 0x46, 0x16, 0x1E, 0x16, 0x46, 0x7F, 0x00},  // 'E'
+    {0x7F, 0x46, 0x16, 0x1E, 0x16, 0x06, 0x0F, 0x00},  // 'F'
+    {0x3C, 0x66, 0x03, 0x03, 0x73, 0x66, 0x7C, 0x00},  // 'G'
+    {0x33, 0x33, 0x33, 0x3F, 0x33, 0x33, 0x33, 0x00},  // 'H'
+    {0x1E, 0x0C, 0x0C, 0x0C, 0x0C, 0x0C, 0x1E, 0x00},  // 'I'
+    {0x78, 0x30, 0x30, 0x30, 0x33, 0x33, 0x1E, 0x00},  // 'J'
+    {0x67, 0x66, 0x36, 0x1E, 0x36, 0x66, 0x67, 0x00},  // 'K'
+    {0x0F, 0x06, 0x06, 0x06, 0x46, 0x66, 0x7F, 0x00},  // 'L'
+    {0x63, 0x77, 0x7F, 0x7F, 0x6B, 0x63, 0x63, 0x00},  // 'M'
+    {0x63, 0x67, 0x6F, 0x7B, 0x73, 0x63, 0x63, 0x00},  // 'N'
+    {0x1C, 0x36, 0x63, 0x63, 0x63, 0x36, 0x1C, 0x00},  // 'O'
+    {0x3F, 0x66, 0x66, 0x3E, 0x06, 0x06, 0x0F, 0x00},  // 'P'
+    {0x1E, 0x33, 0x33, 0x33, 0x3B, 0x1E, 0x38, 0x00},  // 'Q'
+    {0x3F, 0x66, 0x66, 0x3E, 0x36, 0x66, 0x67, 0x00},  // 'R'
+    {0x1E, 0x33, 0x07, 0x0E, 0x38, 0x33, 0x1E, 0x00},  // 'S'
+    {0x3F, 0x2D, 0x0C, 0x0C, 0x0C, 0x0C, 0x1E, 0x00},  // 'T'
+    {0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x3F, 0x00},  // 'U'
+    {0x33, 0x33, 0x33, 0x33, 0x33, 0x1E, 0x0C, 0x00},  // 'V'
+    {0x63, 0x63, 0x63, 0x6B, 0x7F, 0x77, 0x63, 0x00},  // 'W'
+    {0x63, 0x63, 0x36, 0x1C, 0x1C, 0x36, 0x63, 0x00},  // 'X'
+    {0x33, 0x33, 0x33, 0x1E, 0x0C, 0x0C, 0x1E, 0x00},  // 'Y'
+    {0x7F, 0x63, 0x31, 0x18, 0x4C, 0x66, 0x7F, 0x00},  // 'Z'
+    {0x1E, 0x06, 0x06, 0x06, 0x06, 0x06, 0x1E, 0x00},  // '['
+    {0x03, 0x06, 0x0C, 0x18, 0x30, 0x60, 0x40, 0x00},  // '\'
+    {0x1E, 0x18, 0x18, 0x18, 0x18, 0x18, 0x1E, 0x00},  // ']'
+    {0x08, 0x1C, 0x36, 0x63, 0x00, 0x00, 0x00, 0x00},  // '^'
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF},  // '_'
+    {0x0C, 0x0C, 0x18, 0x00, 0x00, 0x00, 0x00, 0x00},  // '`'
+    {0x00, 0x00, 0x1E, 0x30, 0x3E, 0x33, 0x6E, 0x00},  // 'a'
+    {0x07, 0x06, 0x06, 0x3E, 0x66, 0x66, 0x3B, 0x00},  // 'b'
+    {0x00, 0x00, 0x1E, 0x33, 0x03, 0x33, 0x1E, 0x00},  // 'c'
+    {0x38, 0x30, 0x30, 0x3E, 0x33, 0x33, 0x6E, 0x00},  // 'd'
+    {0x00, 0x00, 0x1E, 0x33, 0x3F, 0x03, 0x1E, 0x00},  // 'e'
+    {0x1C, 0x36, 0x06, 0x0F, 0x06, 0x06, 0x0F, 0x00},  // 'f'
+    {0x00, 0x00, 0x6E, 0x33, 0x33, 0x3E, 0x30, 0x1F},  // 'g'
+    {0x07, 0x06, 0x36, 0x6E, 0x66, 0x66, 0x67, 0x00},  // 'h'
+    {0x0C, 0x00, 0x0E, 0x0C, 0x0C, 0x0C, 0x1E, 0x00},  // 'i'
+    {0x30, 0x00, 0x30, 0x30, 0x30, 0x33, 0x33, 0x1E},  // 'j'
+    {0x07, 0x06, 0x66, 0x36, 0x1E, 0x36, 0x67, 0x00},  // 'k'
+    {0x0E, 0x0C, 0x0C, 0x0C, 0x0C, 0x0C, 0x1E, 0x00},  // 'l'
+    {0x00, 0x00, 0x33, 0x7F, 0x7F, 0x6B, 0x63, 0x00},  // 'm'
+    {0x00, 0x00, 0x1F, 0x33, 0x33, 0x33, 0x33, 0x00},  // 'n'
+    {0x00, 0x00, 0x1E, 0x33, 0x33, 0x33, 0x1E, 0x00},  // 'o'
+    {0x00, 0x00, 0x3B, 0x66, 0x66, 0x3E, 0x06, 0x0F},  // 'p'
+    {0x00, 0x00, 0x6E, 0x33, 0x33, 0x3E, 0x30, 0x78},  // 'q'
+    {0x00, 0x00, 0x3B, 0x6E, 0x66, 0x06, 0x0F, 0x00},  // 'r'
+    {0x00, 0x00, 0x3E, 0x03, 0x1E, 0x30, 0x1F, 0x00},  // 's'
+    {0x08, 0x0C, 0x3E, 0x0C, 0x0C, 0x2C, 0x18, 0x00},  // 't'
+    {0x00, 0x00, 0x33, 0x33, 0x33, 0x33, 0x6E, 0x00},  // 'u'
+    {0x00, 0x00, 0x33, 0x33, 0x33, 0x1E, 0x0C, 0x00},  // 'v'
+    {0x00, 0x00, 0x63, 0x6B, 0x7F, 0x7F, 0x36, 0x00},  // 'w'
+    {0x00, 0x00, 0x63, 0x36, 0x1C, 0x36, 0x63, 0x00},  // 'x'
+    {0x00, 0x00, 0x33, 0x33, 0x33, 0x3E, 0x30, 0x1F},  // 'y'
+    {0x00, 0x00, 0x3F, 0x19, 0x0C, 0x26, 0x3F, 0x00},  // 'z'
+    {0x38, 0x0C, 0x0C, 0x07, 0x0C, 0x0C, 0x38, 0x00},  // '{'
+    {0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18},  // '|'
+    {0x07, 0x0C, 0x0C, 0x38, 0x0C, 0x0C, 0x07, 0x00},  // '}'
+    {0x6E, 0x3B, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},  // '~'
+};
+
+/// @brief RGB of the curses colors COLOR_BLACK to COLOR_WHITE, bold text uses the bright row.
+static const uint8_t palette[2][8][3] = {
+    {{0, 0, 0}, {170, 0, 0}, {0, 170, 0}, {170, 85, 0},
+     {0, 0, 170}, {170, 0, 170}, {0, 170, 170}, {170, 170, 170}},
+    {{85, 85, 85}, {255, 85, 85}, {85, 255, 85}, {255, 255, 85},
+     {85, 85, 255}, {255, 85, 255}, {85, 255, 255}, {255, 255, 255}},
+};
+
+typedef struct yuv_color {
+  uint8_t y;
+  uint8_t u;
+  uint8_t v;
+} yuv_color;
+
+typedef enum slot_state { SLOT_FREE, SLOT_CAPTURED, SLOT_RENDERING, SLOT_RENDERED } slot_state;
+
+/// @brief One frame in flight: the captured cells and the picture made from them.
+typedef struct video_slot {
+  slot_state state;
+  long index;
+  chtype *cells;
+  /// Y plane followed by the quarter size U and V planes.
+  uint8_t *image;
+} video_slot;
+
+/// @brief Frames go through a ring of slots: the game captures into a free slot, rasterizer
+/// threads draw captured slots in any order and the writer thread writes them in order.
+typedef struct video_export {
+  int rows;
+  int cols;
+  int width;
+  int height;
+  size_t image_size;
+  int threads;
+  int window;
+  video_slot *slots;
+  /// Native foreground and background of every color pair.
+  short pair_fg[256];
+  short pair_bg[256];
+  yuv_color colors[2][8];
+  long captured;
+  long next_render;
+  long written;
+  bool done;
+  bool failed;
+  pthread_mutex_t lock;
+  pthread_cond_t changed;
+  FILE *out;
+  unsigned long long bytes;
+} video_export;
+
+/// @brief Parse video export arguments
+/// @param argc Argument count
+/// @param argv Arguments
+/// @param opts Options to fill
+/// @return 0 on success, -1 if the arguments are not a video export
+int video_parse_args(int argc, char *argv[], video_options *opts) {
+  memset(opts, 0, sizeof(*opts));
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--export-video") == 0 && i + 1 < argc) {
+      opts->replay_path = argv[++i];
+    } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+      opts->output_path = argv[++i];
+    } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+      opts->threads = atoi(argv[++i]);
+    } else {
+      return -1;
+    }
+  }
+  return opts->replay_path && opts->output_path && opts->threads >= 0 ? 0 : -1;
+}
+
+/// @brief BT.601 studio range
+static yuv_color rgb_to_yuv(const uint8_t rgb[3]) {
+  int r = rgb[0], g = rgb[1], b = rgb[2];
+  yuv_color c = {(uint8_t)(16 + (66 * r + 129 * g + 25 * b + 128) / 256),
+                 (uint8_t)(128 + (-38 * r - 74 * g + 112 * b + 128) / 256),
+                 (uint8_t)(128 + (112 * r - 94 * g - 18 * b + 128) / 256)};
+  return c;
+}
+
+/// @brief Colors of every pair the game can use, see get_col_pairnum
+static void init_colors(video_export *ve) {
+  for (int bright = 0; bright < 2; bright++)
+    for (int color = 0; color < 8; color++)
+      ve->colors[bright][color] = rgb_to_yuv(palette[bright][color]);
+  for (int pair = 0; pair < 256; pair++) {
+    bool game_pair = pair & 0x80;
+    ve->pair_fg[pair] = game_pair ? bits_to_native_color(pair & 7) : COLOR_WHITE;
+    ve->pair_bg[pair] = game_pair ? bits_to_native_color((pair >> 4) & 7) : COLOR_BLACK;
+  }
+}
+
+/// @brief Draw one cell. Font rows are doubled, so each 2x2 chroma block covers two font
+/// pixels of one row.
+static void draw_cell(const video_export *ve, uint8_t *image, int row, int col, chtype cell) {
+  int pair = PAIR_NUMBER(cell) & 0xff;
+  short fg = ve->pair_fg[pair];
+  short bg = ve->pair_bg[pair];
+  if (cell & A_REVERSE) {
+    short tmp = fg;
+    fg = bg;
+    bg = tmp;
+  }
+  yuv_color f = ve->colors[(cell & A_BOLD) ? 1 : 0][fg & 7];
+  yuv_color b = ve->colors[0][bg & 7];
+  int ch = (int)(cell & A_CHARTEXT);
+  const uint8_t *glyph = font8x8[ch >= FONT_FIRST && ch <= FONT_LAST ? ch - FONT_FIRST : 0];
+
+  int cw = ve->width / 2;
+  uint8_t *luma = image + (size_t)row * VIDEO_CELL_HEIGHT * ve->width + col * VIDEO_CELL_WIDTH;
+  uint8_t *cb = image + (size_t)ve->width * ve->height +
+                (size_t)row * (VIDEO_CELL_HEIGHT / 2) * cw + col * (VIDEO_CELL_WIDTH / 2);
+  uint8_t *cr = cb + (size_t)cw * (ve->height / 2);
+  for (int gy = 0; gy < 8; gy++) {
+    uint8_t bits = glyph[gy];
+    uint8_t *line = luma + (size_t)gy * 2 * ve->width;
+    for (int gx = 0; gx < 8; gx++) line[gx] = (bits >> gx) & 1 ? f.y : b.y;
+    memcpy(line + ve->width, line, VIDEO_CELL_WIDTH);
+    for (int k = 0; k < VIDEO_CELL_WIDTH / 2; k++) {
+      int n = ((bits >> (2 * k)) & 1) + ((bits >> (2 * k + 1)) & 1);
+      cb[(size_t)gy * cw + k] = (uint8_t)((n * f.u + (2 - n) * b.u) / 2);
+      cr[(size_t)gy * cw + k] = (uint8_t)((n * f.v + (2 - n) * b.v) / 2);
+    }
+  }
+}
+
+static void rasterize(const video_export *ve, video_slot *slot) {
+  for (int row = 0; row < ve->rows; row++)
+    for (int col = 0; col < ve->cols; col++)
+      draw_cell(ve, slot->image, row, col, slot->cells[row * ve->cols + col]);
+}
+
+static void *rasterizer_main(void *arg) {
+  video_export *ve = arg;
+  pthread_mutex_lock(&ve->lock);
+  while (true) {
+    video_slot *slot = &ve->slots[ve->next_render % ve->window];
+    if (slot->state == SLOT_CAPTURED && slot->index == ve->next_render) {
+      ve->next_render++;
+      slot->state = SLOT_RENDERING;
+      pthread_mutex_unlock(&ve->lock);
+      rasterize(ve, slot);
+      pthread_mutex_lock(&ve->lock);
+      slot->state = SLOT_RENDERED;
+      pthread_cond_broadcast(&ve->changed);
+    } else if ((ve->done && ve->next_render == ve->captured) || ve->failed) {
+      break;
+    } else {
+      pthread_cond_wait(&ve->changed, &ve->lock);
+    }
+  }
+  pthread_mutex_unlock(&ve->lock);
+  return NULL;
+}
+
+/// @brief Write the frames in capture order, each slot is freed right after
+static void *writer_main(void *arg) {
+  video_export *ve = arg;
+  pthread_mutex_lock(&ve->lock);
+  while (true) {
+    video_slot *slot = &ve->slots[ve->written % ve->window];
+    if (slot->state == SLOT_RENDERED && slot->index == ve->written) {
+      pthread_mutex_unlock(&ve->lock);
+      bool ok = fputs("FRAME\n", ve->out) >= 0 &&
+                fwrite(slot->image, 1, ve->image_size, ve->out) == ve->image_size;
+      pthread_mutex_lock(&ve->lock);
+      ve->bytes += ve->image_size + 6;
+      ve->failed |= !ok;
+      slot->state = SLOT_FREE;
+      ve->written++;
+      pthread_cond_broadcast(&ve->changed);
+    } else if ((ve->done && ve->written == ve->captured) || ve->failed) {
+      break;
+    } else {
+      pthread_cond_wait(&ve->changed, &ve->lock);
+    }
+  }
+  pthread_mutex_unlock(&ve->lock);
+  return NULL;
+}
+
+/// @brief Frame sink of the game, waits for a free slot and copies the screen into it
+static void capture_frame(void *ctx) {
+  video_export *ve = ctx;
+  pthread_mutex_lock(&ve->lock);
+  video_slot *slot = &ve->slots[ve->captured % ve->window];
+  while (slot->state != SLOT_FREE && !ve->failed) pthread_cond_wait(&ve->changed, &ve->lock);
+  bool failed = ve->failed;
+  pthread_mutex_unlock(&ve->lock);
+  if (failed)
+    return;
+
+  for (int row = 0; row < ve->rows; row++) {
+    chtype *cells = &slot->cells[row * ve->cols];
+    int n = mvwinchnstr(curscr, row, 0, cells, ve->cols);
+    for (int col = n < 0 ? 0 : n; col < ve->cols; col++) cells[col] = ' ';
+  }
+
+  pthread_mutex_lock(&ve->lock);
+  slot->index = ve->captured++;
+  slot->state = SLOT_CAPTURED;
+  pthread_cond_broadcast(&ve->changed);
+  pthread_mutex_unlock(&ve->lock);
+}
+
+static void free_slots(video_export *ve) {
+  for (int i = 0; ve->slots && i < ve->window; i++) {
+    free(ve->slots[i].cells);
+    free(ve->slots[i].image);
+  }
+  free(ve->slots);
+  ve->slots = NULL;
+}
+
+/// @brief Size the pictures after the screen and allocate the frame window
+static int init_export(video_export *ve, const video_options *opts) {
+  long threads = opts->threads > 0 ? opts->threads : sysconf(_SC_NPROCESSORS_ONLN);
+  ve->threads = (int)(threads < 1 ? 1 : threads > VIDEO_MAX_THREADS ? VIDEO_MAX_THREADS : threads);
+  ve->window = ve->threads * VIDEO_FRAMES_PER_THREAD;
+  ve->rows = LINES;
+  ve->cols = COLS;
+  ve->width = ve->cols * VIDEO_CELL_WIDTH;
+  ve->height = ve->rows * VIDEO_CELL_HEIGHT;
+  ve->image_size = (size_t)ve->width * ve->height * 3 / 2;
+  init_colors(ve);
+
+  ve->slots = calloc((size_t)ve->window, sizeof(*ve->slots));
+  if (ve->slots == NULL)
+    return -1;
+  for (int i = 0; i < ve->window; i++) {
+    ve->slots[i].cells = malloc(sizeof(chtype) * (size_t)ve->rows * (size_t)ve->cols);
+    ve->slots[i].image = malloc(ve->image_size);
+    if (ve->slots[i].cells == NULL || ve->slots[i].image == NULL)
+      return -1;
+  }
+  return 0;
+}
+
+/// @brief Run the replay through all pipeline threads
+/// @return Error code
+static int export_frames(video_export *ve, const replay *rp, int *score) {
+  pthread_mutex_init(&ve->lock, NULL);
+  pthread_cond_init(&ve->changed, NULL);
+  pthread_t workers[VIDEO_MAX_THREADS];
+  pthread_t writer;
+  int started = 0;
+  bool writing = pthread_create(&writer, NULL, writer_main, ve) == 0;
+  while (writing && started < ve->threads &&
+         pthread_create(&workers[started], NULL, rasterizer_main, ve) == 0)
+    started++;
+
+  int err = -1;
+  term_io_sink sink = {NULL, capture_frame, ve};
+  if (writing && started > 0 && term_io_add_sink(&sink)) {
+    err = replay_render(rp, score);
+    term_io_remove_sink(ve);
+  }
+
+  pthread_mutex_lock(&ve->lock);
+  ve->done = true;
+  ve->failed |= err != 0;
+  pthread_cond_broadcast(&ve->changed);
+  pthread_mutex_unlock(&ve->lock);
+  for (int i = 0; i < started; i++) pthread_join(workers[i], NULL);
+  if (writing)
+    pthread_join(writer, NULL);
+  pthread_cond_destroy(&ve->changed);
+  pthread_mutex_destroy(&ve->lock);
+  return err == 0 && !ve->failed ? 0 : -1;
+}
+
+static void print_report(const video_export *ve, const replay *rp, int score, long long wall_ns,
+                         FILE *out) {
+  double wall_s = (double)wall_ns / 1e9;
+  fprintf(out, "{\n  \"mode\": \"video\",\n  \"level\": %d,\n  \"score\": %d,\n", rp->levelnum,
+          score);
+  fprintf(out, "  \"frames\": %ld,\n  \"width\": %d,\n  \"height\": %d,\n", ve->written,
+          ve->width, ve->height);
+  fprintf(out, "  \"video_s\": %.2f,\n  \"threads\": %d,\n  \"window\": %d,\n",
+          (double)ve->written * (double)rp->frame_ms / 1e3, ve->threads, ve->window);
+  fprintf(out, "  \"bytes\": %llu,\n  \"wall_s\": %.3f,\n  \"frames_per_s\": %.1f\n}\n",
+          ve->bytes, wall_s, wall_s > 0 ? (double)ve->written / wall_s : 0);
+}
+
+/// @brief Render a replay into a Y4M video without a terminal. The game runs on an off-screen
+/// curses screen, every finished frame is rasterized with the built-in font on a pool of
+/// threads and written in order.
+/// @param opts Export options
+/// @param report Stream the JSON summary is written to
+/// @return Error code
+int run_video_export(const video_options *opts, FILE *report) {
+  replay rp;
+  if (replay_load(&rp, opts->replay_path) != 0) {
+    fprintf(stderr, "Cannot read replay %s.\n", opts->replay_path);
+    return -1;
+  }
+  FILE *null_out = fopen("/dev/null", "w");
+  FILE *null_in = fopen("/dev/null", "r");
+  if (!null_out || !null_in || init_screen_term(HEADLESS_TERM_TYPE, null_out, null_in) != 0) {
+    fprintf(stderr, "Cannot initialize the off-screen renderer.\n");
+    if (null_out)
+      fclose(null_out);
+    if (null_in)
+      fclose(null_in);
+    replay_free(&rp);
+    return -1;
+  }
+  audio_set_enabled(false);
+
+  video_export ve;
+  memset(&ve, 0, sizeof(ve));
+  int err = init_export(&ve, opts);
+  if (err == 0)
+    ve.out = fopen(opts->output_path, "wb");
+  if (err != 0 || ve.out == NULL) {
+    fprintf(stderr, "Cannot write video %s.\n", opts->output_path);
+    err = -1;
+  }
+
+  int score = 0;
+  long long start = timeInNanoseconds();
+  if (err == 0) {
+    fprintf(ve.out, "YUV4MPEG2 W%d H%d F1000:%lld Ip A1:1 C420jpeg\n", ve.width, ve.height,
+            rp.frame_ms);
+    err = export_frames(&ve, &rp, &score);
+    if (fclose(ve.out) != 0 && err == 0) {
+      fprintf(stderr, "Cannot write video %s.\n", opts->output_path);
+      err = -1;
+    }
+  }
+  long long wall_ns = timeInNanoseconds() - start;
+
+  endwin();
+  fclose(null_out);
+  fclose(null_in);
+  if (err == 0)
+    print_report(&ve, &rp, score, wall_ns, report);
+  free_slots(&ve);
+  replay_free(&rp);
+  return err;
+}
@@ -0,0 +1,693 @@
+// Copyright 2022 <Maros Varchola - mvarchdev>
+
+#include "flappybird/vterm.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "flappybird/common_tools.h"
+
+/// @brief Escape character that starts every control sequence.
+#define ESC 0x1b
+/// @brief Tab stop width.
+#define TAB_WIDTH 8
+/// @brief Replacement character for malformed UTF-8.
+#define REPLACEMENT_CHAR 0xfffd
+/// @brief Largest accepted numeric parameter, longer digit runs are clamped.
+#define MAX_PARAM_VALUE 9999
+
+#define FNV_OFFSET 1469598103934665603ULL
+#define FNV_PRIME 1099511628211ULL
+
+static vterm_cell blank_cell(const vterm *vt) {
+  vterm_cell cell = {' ', VTERM_DEFAULT_COLOR, vt->pen.bg, 0};
+  return cell;
+}
+
+static vterm_cell *cell_ptr(vterm *vt, int y, int x) { return &vt->cells[y * vt->cols + x]; }
+
+static void fill_cells(vterm *vt, int y, int from_x, int to_x) {
+  vterm_cell blank = blank_cell(vt);
+  for (int x = from_x; x < to_x; x++) {
+    *cell_ptr(vt, y, x) = blank;
+  }
+}
+
+static void fill_rows(vterm *vt, int from_y, int to_y) {
+  for (int y = from_y; y < to_y; y++) {
+    fill_cells(vt, y, 0, vt->cols);
+  }
+}
+
+static int clamp(int value, int min, int max) {
+  if (value < min) {
+    return min;
+  }
+  return value > max ? max : value;
+}
+
+static void move_cursor(vterm *vt, int y, int x) {
+  vt->cur_y = clamp(y, 0, vt->rows - 1);
+  vt->cur_x = clamp(x, 0, vt->cols - 1);
+  vt->wrap_pending = false;
+}
+
+/// @brief Scroll rows top..bottom (inclusive) up by n, new rows are blank
+static void scroll_up(vterm *vt, int top, int bottom, int n) {
+  int height = bottom - top + 1;
+  n = clamp(n, 0, height);
+  if (n < height) {
+    memmove(cell_ptr(vt, top, 0), cell_ptr(vt, top + n, 0),
+            (size_t)(height - n) * (size_t)vt->cols * sizeof(vterm_cell));
+  }
+  fill_rows(vt, bottom - n + 1, bottom + 1);
+  vt->stats.scrolls++;
+}
+
+/// @brief Scroll rows top..bottom (inclusive) down by n, new rows are blank
+static void scroll_down(vterm *vt, int top, int bottom, int n) {
+  int height = bottom - top + 1;
+  n = clamp(n, 0, height);
+  if (n < height) {
+    memmove(cell_ptr(vt, top + n, 0), cell_ptr(vt, top, 0),
+            (size_t)(height - n) * (size_t)vt->cols * sizeof(vterm_cell));
+  }
+  fill_rows(vt, top, top + n);
+  vt->stats.scrolls++;
+}
+
+static void line_feed(vterm *vt) {
+  vt->wrap_pending = false;
+  if (vt->cur_y == vt->scroll_bottom) {
+    scroll_up(vt, vt->scroll_top, vt->scroll_bottom, 1);
+  } else if (vt->cur_y < vt->rows - 1) {
+    vt->cur_y++;
+  }
+}
+
+static void reverse_index(vterm *vt) {
+  vt->wrap_pending = false;
+  if (vt->cur_y == vt->scroll_top) {
+    scroll_down(vt, vt->scroll_top, vt->scroll_bottom, 1);
+  } else if (vt->cur_y > 0) {
+    vt->cur_y--;
+  }
+}
+
+static void insert_cells(vterm *vt, int n) {
+  vterm_cell *row = cell_ptr(vt, vt->cur_y, 0);
+  n = clamp(n, 0, vt->cols - vt->cur_x);
+  memmove(row + vt->cur_x + n, row + vt->cur_x,
+          (size_t)(vt->cols - vt->cur_x - n) * sizeof(vterm_cell));
+  fill_cells(vt, vt->cur_y, vt->cur_x, vt->cur_x + n);
+}
+
+static void delete_cells(vterm *vt, int n) {
+  vterm_cell *row = cell_ptr(vt, vt->cur_y, 0);
+  n = clamp(n, 0, vt->cols - vt->cur_x);
+  memmove(row + vt->cur_x, row + vt->cur_x + n,
+          (size_t)(vt->cols - vt->cur_x - n) * sizeof(vterm_cell));
+  fill_cells(vt, vt->cur_y, vt->cols - n, vt->cols);
+}
+
+static void put_char(vterm *vt, uint32_t ch) {
+  if (vt->wrap_pending) {
+    vt->cur_x = 0;
+    line_feed(vt);
+  }
+  if (vt->insert_mode) {
+    insert_cells(vt, 1);
+  }
+
+  vterm_cell *cell = cell_ptr(vt, vt->cur_y, vt->cur_x);
+  *cell = vt->pen;
+  cell->ch = ch;
+  vt->last_ch = ch;
+  vt->stats.printed++;
+
+  if (vt->cur_x == vt->cols - 1) {
+    vt->wrap_pending = vt->autowrap;
+  } else {
+    vt->cur_x++;
+  }
+}
+
+static int param(const vterm *vt, int idx, int def) {
+  if (idx >= vt->param_count || vt->params[idx] <= 0) {
+    return def;
+  }
+  return vt->params[idx];
+}
+
+static void erase_display(vterm *vt, int mode) {
+  if (mode == 0) {
+    fill_cells(vt, vt->cur_y, vt->cur_x, vt->cols);
+    fill_rows(vt, vt->cur_y + 1, vt->rows);
+  } else if (mode == 1) {
+    fill_rows(vt, 0, vt->cur_y);
+    fill_cells(vt, vt->cur_y, 0, vt->cur_x + 1);
+  } else {
+    fill_rows(vt, 0, vt->rows);
+  }
+}
+
+static void erase_line(vterm *vt, int mode) {
+  if (mode == 0) {
+    fill_cells(vt, vt->cur_y, vt->cur_x, vt->cols);
+  } else if (mode == 1) {
+    fill_cells(vt, vt->cur_y, 0, vt->cur_x + 1);
+  } else {
+    fill_cells(vt, vt->cur_y, 0, vt->cols);
+  }
+}
+
+static int16_t sgr_color(int idx) { return (int16_t)idx; }
+
+/// @brief Parse the 256 color and true color forms of SGR 38/48, returns parameters consumed
+static int extended_color(const vterm *vt, int idx, int16_t *color) {
+  if (idx + 1 >= vt->param_count) {
+    return 0;
+  }
+  if (vt->params[idx + 1] == 5 && idx + 2 < vt->param_count) {
+    *color = sgr_color(vt->params[idx + 2]);
+    return 2;
+  }
+  if (vt->params[idx + 1] == 2) {
+    return 4;
+  }
+  return 0;
+}
+
+static void select_graphic_rendition(vterm *vt) {
+  if (vt->param_count == 0) {
+    vt->param_count = 1;
+    vt->params[0] = 0;
+  }
+  for (int i = 0; i < vt->param_count; i++) {
+    int p = vt->params[i];
+    if (p == 0) {
+      vt->pen.fg = VTERM_DEFAULT_COLOR;
+      vt->pen.bg = VTERM_DEFAULT_COLOR;
+      vt->pen.attrs = 0;
+    } else if (p == 1) {
+      vt->pen.attrs |= VTERM_ATTR_BOLD;
+    } else if (p == 2) {
+      vt->pen.attrs |= VTERM_ATTR_DIM;
+    } else if (p == 4) {
+      vt->pen.attrs |= VTERM_ATTR_UNDERLINE;
+    } else if (p == 5) {
+      vt->pen.attrs |= VTERM_ATTR_BLINK;
+    } else if (p == 7) {
+      vt->pen.attrs |= VTERM_ATTR_REVERSE;
+    } else if (p == 8) {
+      vt->pen.attrs |= VTERM_ATTR_INVISIBLE;
+    } else if (p == 22) {
+      vt->pen.attrs &= (uint8_t) ~(VTERM_ATTR_BOLD | VTERM_ATTR_DIM);
+    } else if (p == 24) {
+      vt->pen.attrs &= (uint8_t)~VTERM_ATTR_UNDERLINE;
+    } else if (p == 25) {
+      vt->pen.attrs &= (uint8_t)~VTERM_ATTR_BLINK;
+    } else if (p == 27) {
+      vt->pen.attrs &= (uint8_t)~VTERM_ATTR_REVERSE;
+    } else if (p == 28) {
+      vt->pen.attrs &= (uint8_t)~VTERM_ATTR_INVISIBLE;
+    } else if (p >= 30 && p <= 37) {
+      vt->pen.fg = sgr_color(p - 30);
+    } else if (p == 38) {
+      i += extended_color(vt, i, &vt->pen.fg);
+    } else if (p == 39) {
+      vt->pen.fg = VTERM_DEFAULT_COLOR;
+    } else if (p >= 40 && p <= 47) {
+      vt->pen.bg = sgr_color(p - 40);
+    } else if (p == 48) {
+      i += extended_color(vt, i, &vt->pen.bg);
+    } else if (p == 49) {
+      vt->pen.bg = VTERM_DEFAULT_COLOR;
+    } else if (p >= 90 && p <= 97) {
+      vt->pen.fg = sgr_color(p - 90 + 8);
+    } else if (p >= 100 && p <= 107) {
+      vt->pen.bg = sgr_color(p - 100 + 8);
+    }
+  }
+}
+
+static void set_private_mode(vterm *vt, bool enable) {
+  for (int i = 0; i < vt->param_count; i++) {
+    int mode = vt->params[i];
+    if (mode == 7) {
+      vt->autowrap = enable;
+    } else if (mode == 1049 || mode == 1047 || mode == 47) {
+      // One buffer only, entering and leaving the alternate screen both start clean.
+      fill_rows(vt, 0, vt->rows);
+    } else {
+      vt->stats.ignored++;
+    }
+  }
+}
+
+static void save_cursor(vterm *vt) {
+  vt->saved_y = vt->cur_y;
+  vt->saved_x = vt->cur_x;
+  vt->saved_pen = vt->pen;
+}
+
+static void restore_cursor(vterm *vt) {
+  move_cursor(vt, vt->saved_y, vt->saved_x);
+  vt->pen = vt->saved_pen;
+}
+
+static void dispatch_csi(vterm *vt, char final) {
+  vt->stats.sequences++;
+  if (vt->private_marker == '?') {
+    if (final == 'h' || final == 'l') {
+      set_private_mode(vt, final == 'h');
+    } else {
+      vt->stats.ignored++;
+    }
+    return;
+  } else if (vt->private_marker != 0) {
+    vt->stats.ignored++;
+    return;
+  }
+
+  int n = param(vt, 0, 1);
+  switch (final) {
+    case '@':
+      insert_cells(vt, n);
+      break;
+    case 'A':
+      move_cursor(vt, vt->cur_y - n, vt->cur_x);
+      break;
+    case 'B':
+    case 'e':
+      move_cursor(vt, vt->cur_y + n, vt->cur_x);
+      break;
+    case 'C':
+    case 'a':
+      move_cursor(vt, vt->cur_y, vt->cur_x + n);
+      break;
+    case 'D':
+      move_cursor(vt, vt->cur_y, vt->cur_x - n);
+      break;
+    case 'E':
+      move_cursor(vt, vt->cur_y + n, 0);
+      break;
+    case 'F':
+      move_cursor(vt, vt->cur_y - n, 0);
+      break;
+    case 'G':
+    case '`':
+      move_cursor(vt, vt->cur_y, n - 1);
+      break;
+    case 'H':
+    case 'f':
+      move_cursor(vt, n - 1, param(vt, 1, 1) - 1);
+      break;
+    case 'J':
+      erase_display(vt, vt->param_count > 0 ? vt->params[0] : 0);
+      break;
+    case 'K':
+      erase_line(vt, vt->param_count > 0 ? vt->params[0] : 0);
+      break;
+    case 'L':
+      if (vt->cur_y >= vt->scroll_top && vt->cur_y <= vt->scroll_bottom) {
+        scroll_down(vt, vt->cur_y, vt->scroll_bottom, n);
+      }
+      break;
+    case 'M':
+      if (vt->cur_y >= vt->scroll_top && vt->cur_y <= vt->scroll_bottom) {
+        scroll_up(vt, vt->cur_y, vt->scroll_bottom, n);
+      }
+      break;
+    case 'P':
+      delete_cells(vt, n);
+      break;
+    case 'S':
+      scroll_up(vt, vt->scroll_top, vt->scroll_bottom, n);
+      break;
+    case 'T':
+      scroll_down(vt, vt->scroll_top, vt->scroll_bottom, n);
+      break;
+    case 'X':
+      fill_cells(vt, vt->cur_y, vt->cur_x, clamp(vt->cur_x + n, 0, vt->cols));
+      break;
+    case 'b':
+      for (int i = 0; i < n && vt->last_ch != 0; i++) {
+        put_char(vt, vt->last_ch);
+      }
+      break;
+    case 'd':
+      move_cursor(vt, n - 1, vt->cur_x);
+      break;
+    case 'm':
+      select_graphic_rendition(vt);
+      break;
+    case 'r': {
+      int top = param(vt, 0, 1) - 1;
+      int bottom = param(vt, 1, vt->rows) - 1;
+      if (top < bottom && bottom < vt->rows) {
+        vt->scroll_top = top;
+        vt->scroll_bottom = bottom;
+        move_cursor(vt, 0, 0);
+      }
+      break;
+    }
+    case 'h':
+    case 'l':
+      if (param(vt, 0, 0) == 4) {
+        vt->insert_mode = final == 'h';
+      } else {
+        vt->stats.ignored++;
+      }
+      break;
+    case 's':
+      save_cursor(vt);
+      break;
+    case 'u':
+      restore_cursor(vt);
+      break;
+    default:
+      vt->stats.ignored++;
+      break;
+  }
+}
+
+static void dispatch_escape(vterm *vt, char ch) {
+  vt->stats.sequences++;
+  switch (ch) {
+    case '[':
+      vt->state = VTERM_STATE_CSI;
+      vt->param_count = 0;
+      vt->private_marker = 0;
+      memset(vt->params, 0, sizeof(vt->params));
+      vt->stats.sequences--;
+      return;
+    case ']':
+    case 'P':
+    case '_':
+    case '^':
+      vt->state = VTERM_STATE_STRING;
+      return;
+    case '(':
+    case ')':
+    case '*':
+    case '+':
+      vt->state = VTERM_STATE_CHARSET;
+      return;
+    case '7':
+      save_cursor(vt);
+      break;
+    case '8':
+      restore_cursor(vt);
+      break;
+    case 'D':
+      line_feed(vt);
+      break;
+    case 'E':
+      vt->cur_x = 0;
+      line_feed(vt);
+      break;
+    case 'M':
+      reverse_index(vt);
+      break;
+    case 'c':
+      vterm_reset(vt);
+      break;
+    default:
+      vt->stats.ignored++;
+      break;
+  }
+  vt->state = VTERM_STATE_GROUND;
+}
+
+static void control_char(vterm *vt, unsigned char ch) {
+  vt->stats.controls++;
+  switch (ch) {
+    case '\a':
+      vt->stats.bells++;
+      break;
+    case '\b':
+      move_cursor(vt, vt->cur_y, vt->cur_x - 1);
+      break;
+    case '\t':
+      move_cursor(vt, vt->cur_y, (vt->cur_x / TAB_WIDTH + 1) * TAB_WIDTH);
+      break;
+    case '\n':
+    case '\v':
+    case '\f':
+      line_feed(vt);
+      break;
+    case '\r':
+      vt->cur_x = 0;
+      vt->wrap_pending = false;
+      break;
+    default:
+      break;
+  }
+}
+
+static void ground_byte(vterm *vt, unsigned char ch) {
+  if (vt->utf8_left > 0) {
+    if ((ch & 0xc0) == 0x80) {
+      vt->utf8_ch = (vt->utf8_ch << 6) | (ch & 0x3f);
+      if (--vt->utf8_left == 0) {
+        put_char(vt, vt->utf8_ch);
+      }
+      return;
+    }
+    vt->utf8_left = 0;
+    put_char(vt, REPLACEMENT_CHAR);
+  }
+
+  if (ch == ESC) {
+    vt->state = VTERM_STATE_ESCAPE;
+  } else if (ch < 0x20 || ch == 0x7f) {
+    control_char(vt, ch);
+  } else if (ch < 0x80) {
+    put_char(vt, ch);
+  } else if ((ch & 0xe0) == 0xc0) {
+    vt->utf8_ch = ch & 0x1f;
+    vt->utf8_left = 1;
+  } else if ((ch & 0xf0) == 0xe0) {
+    vt->utf8_ch = ch & 0x0f;
+    vt->utf8_left = 2;
+  } else if ((ch & 0xf8) == 0xf0) {
+    vt->utf8_ch = ch & 0x07;
+    vt->utf8_left = 3;
+  } else {
+    put_char(vt, REPLACEMENT_CHAR);
+  }
+}
+
+static void csi_byte(vterm *vt, unsigned char ch) {
+  if (ch >= '0' && ch <= '9') {
+    if (vt->param_count == 0) {
+      vt->param_count = 1;
+    }
+    int *p = &vt->params[vt->param_count - 1];
+    *p = *p * 10 + (ch - '0');
+    if (*p > MAX_PARAM_VALUE) {
+      *p = MAX_PARAM_VALUE;
+    }
+  } else if (ch == ';' || ch == ':') {
+    if (vt->param_count == 0) {
+      vt->param_count = 1;
+    }
+    if (vt->param_count < VTERM_MAX_PARAMS) {
+      vt->params[vt->param_count++] = 0;
+    }
+  } else if (ch >= '<' && ch <= '?') {
+    vt->private_marker = (char)ch;
+  } else if (ch >= 0x40 && ch <= 0x7e) {
+    vt->state = VTERM_STATE_GROUND;
+    dispatch_csi(vt, (char)ch);
+  } else if (ch < 0x20) {
+    control_char(vt, ch);
+  }
+}
+
+/// @brief Initialize a virtual terminal with a blank screen
+/// @param vt Terminal to initialize
+/// @param rows Rows of the screen
+/// @param cols Columns of the screen
+/// @return Error code
+int vterm_init(vterm *vt, int rows, int cols) {
+  memset(vt, 0, sizeof(*vt));
+  return vterm_resize(vt, rows, cols);
+}
+
+void vterm_free(vterm *vt) {
+  free(vt->cells);
+  vt->cells = NULL;
+  vt->rows = 0;
+  vt->cols = 0;
+}
+
+/// @brief Resize the screen, this clears it and resets the terminal state
+/// @param vt Terminal
+/// @param rows New rows
+/// @param cols New columns
+/// @return Error code
+int vterm_resize(vterm *vt, int rows, int cols) {
+  if (rows <= 0 || cols <= 0) {
+    return -1;
+  }
+  vterm_cell *cells = calloc((size_t)rows * (size_t)cols, sizeof(vterm_cell));
+  if (cells == NULL) {
+    return -1;
+  }
+  free(vt->cells);
+  vt->cells = cells;
+  vt->rows = rows;
+  vt->cols = cols;
+  vterm_reset(vt);
+  return 0;
+}
+
+/// @brief Reset cursor, modes and pen and clear the screen, statistics are kept
+/// @param vt Terminal
+void vterm_reset(vterm *vt) {
+  vt->cur_y = 0;
+  vt->cur_x = 0;
+  vt->wrap_pending = false;
+  vt->autowrap = true;
+  vt->insert_mode = false;
+  vt->scroll_top = 0;
+  vt->scroll_bottom = vt->rows - 1;
+  vt->pen.ch = ' ';
+  vt->pen.fg = VTERM_DEFAULT_COLOR;
+  vt->pen.bg = VTERM_DEFAULT_COLOR;
+  vt->pen.attrs = 0;
+  vt->saved_pen = vt->pen;
+  vt->saved_y = 0;
+  vt->saved_x = 0;
+  vt->last_ch = 0;
+  vt->state = VTERM_STATE_GROUND;
+  vt->utf8_left = 0;
+  fill_rows(vt, 0, vt->rows);
+}
+
+/// @brief Parse terminal output and apply it to the screen
+/// @param vt Terminal
+/// @param data Output bytes
+/// @param len Number of bytes
+void vterm_feed(vterm *vt, const char *data, size_t len) {
+  long long start = timeInNanoseconds();
+  for (size_t i = 0; i < len; i++) {
+    unsigned char ch = (unsigned char)data[i];
+    switch (vt->state) {
+      case VTERM_STATE_GROUND:
+        ground_byte(vt, ch);
+        break;
+      case VTERM_STATE_ESCAPE:
+        dispatch_escape(vt, (char)ch);
+        break;
+      case VTERM_STATE_CHARSET:
+        vt->stats.ignored++;
+        vt->state = VTERM_STATE_GROUND;
+        break;
+      case VTERM_STATE_CSI:
+        csi_byte(vt, ch);
+        break;
+      case VTERM_STATE_STRING:
+        // OSC, DCS, APC and PM strings end with BEL or ST (ESC \).
+        if (ch == '\a') {
+          vt->state = VTERM_STATE_GROUND;
+        } else if (ch == ESC) {
+          vt->state = VTERM_STATE_STRING_ESCAPE;
+        }
+        break;
+      case VTERM_STATE_STRING_ESCAPE:
+        vt->state = ch == '\\' ? VTERM_STATE_GROUND : VTERM_STATE_STRING;
+        break;
+    }
+  }
+  vt->stats.bytes += len;
+  vt->stats.parse_ns += timeInNanoseconds() - start;
+}
+
+/// @brief Mark the end of a frame and chain the screen into the frames hash
+/// @param vt Terminal
+void vterm_end_frame(vterm *vt) {
+  vt->stats.frames++;
+  vt->frames_hash = (vt->frames_hash ^ vterm_screen_hash(vt)) * FNV_PRIME;
+}
+
+const vterm_cell *vterm_cell_at(const vterm *vt, int y, int x) {
+  if (y < 0 || y >= vt->rows || x < 0 || x >= vt->cols) {
+    return NULL;
+  }
+  return &vt->cells[y * vt->cols + x];
+}
+
+static uint64_t hash_value(uint64_t hash, uint32_t value) {
+  for (int i = 0; i < 4; i++) {
+    hash = (hash ^ (value & 0xff)) * FNV_PRIME;
+    value >>= 8;
+  }
+  return hash;
+}
+
+/// @brief FNV-1a hash of the visible screen, characters, colors and attributes
+/// @param vt Terminal
+/// @return Screen hash
+uint64_t vterm_screen_hash(const vterm *vt) {
+  uint64_t hash = hash_value(FNV_OFFSET, (uint32_t)vt->rows);
+  hash = hash_value(hash, (uint32_t)vt->cols);
+  for (int i = 0; i < vt->rows * vt->cols; i++) {
+    const vterm_cell *cell = &vt->cells[i];
+    hash = hash_value(hash, cell->ch);
+    hash = hash_value(hash, (uint32_t)(uint16_t)cell->fg << 16 | (uint16_t)cell->bg);
+    hash = hash_value(hash, cell->attrs);
+  }
+  return hash;
+}
+
+/// @brief Text of one screen row without trailing blanks, non-ASCII characters become '?'
+/// @param vt Terminal
+/// @param y Row
+/// @param buf Output buffer
+/// @param size Size of output buffer
+/// @return Length of text, -1 if row is out of range
+int vterm_row_text(const vterm *vt, int y, char *buf, size_t size) {
+  if (y < 0 || y >= vt->rows || size == 0) {
+    return -1;
+  }
+  int len = 0;
+  for (int x = 0; x < vt->cols && (size_t)x + 1 < size; x++) {
+    uint32_t ch = vt->cells[y * vt->cols + x].ch;
+    buf[x] = ch < 0x80 ? (char)ch : '?';
+    if (ch != ' ') {
+      len = x + 1;
+    }
+  }
+  buf[len] = '\0';
+  return len;
+}
+
+/// @brief Print the screen as text
+/// @param vt Terminal
+/// @param out Stream to print to
+void vterm_dump(const vterm *vt, FILE *out) {
+  char *line = malloc((size_t)vt->cols + 1);
+  if (line == NULL) {
+    return;
+  }
+  for (int y = 0; y < vt->rows; y++) {
+    vterm_row_text(vt, y, line, (size_t)vt->cols + 1);
+    fprintf(out, "%s\n", line);
+  }
+  free(line);
+}
+
+static void sink_write(void *ctx, const char *data, size_t len) { vterm_feed(ctx, data, len); }
+
+static void sink_end_frame(void *ctx) { vterm_end_frame(ctx); }
+
+/// @brief Sink that feeds terminal output into the virtual terminal
+/// @param vt Terminal
+/// @return Sink for term_io_add_sink
+term_io_sink vterm_sink(vterm *vt) {
+  term_io_sink sink = {sink_write, sink_end_frame, vt};
+  return sink;
+}